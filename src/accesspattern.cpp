@@ -0,0 +1,242 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "accesspattern.h"
+#include "parallel.h"
+
+#include <QHash>
+
+#include <algorithm>
+
+// Share of the nonzero deltas that must be multiples of the stride
+#define PATTERN_MIN_SHARE 0.75
+
+QString patternName(int pattern)
+{
+    switch(pattern)
+    {
+    case PATTERN_SEQUENTIAL:
+        return "sequential";
+    case PATTERN_STRIDED:
+        return "strided";
+    case PATTERN_IRREGULAR:
+        return "irregular";
+    }
+    return "unknown";
+}
+
+static qint64 gcd64(qint64 a, qint64 b)
+{
+    while(b)
+    {
+        qint64 t = a%b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static void classify(AccessPattern &p, const QHash<qint64,qint64> &hist)
+{
+    QVector<DeltaCount> counts;
+    qint64 nonzero = 0;
+    for(QHash<qint64,qint64>::const_iterator it=hist.constBegin(); it!=hist.constEnd(); it++)
+    {
+        DeltaCount dc = {it.key(), it.value()};
+        counts.push_back(dc);
+        if(it.key())
+            nonzero += it.value();
+    }
+    std::sort(counts.begin(),counts.end(),[](const DeltaCount &a, const DeltaCount &b)
+        { return a.count > b.count || (a.count == b.count && a.delta < b.delta); });
+    p.topDeltas = counts.mid(0,PATTERN_TOP_DELTAS);
+
+    if(p.deltas < PATTERN_MIN_DELTAS)
+    {
+        p.pattern = PATTERN_UNKNOWN;
+        return;
+    }
+
+    // A single address stays cached
+    if(nonzero == 0)
+    {
+        p.pattern = PATTERN_SEQUENTIAL;
+        return;
+    }
+
+    qint64 stride = 0;
+    for(int i=0; i<counts.size() && !stride; i++)
+        if(counts.at(i).delta && 2*counts.at(i).count >= nonzero)
+            stride = counts.at(i).delta;
+
+    // Sampling skips accesses, the stride divides the repeating deltas
+    if(!stride)
+    {
+        qint64 g = 0, direction = 0;
+        for(int i=0, used=0; i<counts.size() && used<PATTERN_TOP_DELTAS; i++)
+        {
+            const DeltaCount &c = counts.at(i);
+            if(c.count < 2)
+                break;
+            if(!c.delta)
+                continue;
+            g = gcd64(g,qAbs(c.delta));
+            direction += c.delta > 0 ? c.count : -c.count;
+            used++;
+        }
+        stride = direction >= 0 ? g : -g;
+    }
+
+    qint64 multiples = 0;
+    for(int i=0; i<counts.size() && stride; i++)
+    {
+        qint64 delta = counts.at(i).delta;
+        if(delta && delta % stride == 0 && (delta > 0) == (stride > 0))
+            multiples += counts.at(i).count;
+    }
+    p.strideShare = (qreal)multiples/nonzero;
+
+    if(!stride || p.strideShare < PATTERN_MIN_SHARE)
+        p.pattern = PATTERN_IRREGULAR;
+    else
+    {
+        p.stride = stride;
+        p.pattern = qAbs(stride) <= PATTERN_SEQUENTIAL_BYTES ? PATTERN_SEQUENTIAL
+                                                             : PATTERN_STRIDED;
+    }
+}
+
+QVector<AccessPattern> accessPatterns(DataObject *d, const Bitmap &mask,
+                                      QVector<qint64> *patterns,
+                                      QVector<qint64> *strides)
+{
+    const qint64 *uids = d->column(SampleAxes::instructionUid).constData();
+    const QVector<ElemIndex> &order = d->sortedIndex(SampleAxes::instructionUid);
+    const Sample *samples = d->samples.constData();
+    int numElements = d->numElements;
+
+    QVector<int> begins;
+    for(int i=0; i<numElements; i++)
+        if(i == 0 || uids[order.at(i)] != uids[order.at(i-1)])
+            begins.push_back(i);
+    int numInstructions = begins.size();
+    begins.push_back(numElements);
+
+    qint64 *pat = NULL, *str = NULL;
+    if(patterns)
+    {
+        patterns->fill(PATTERN_UNKNOWN,numElements);
+        pat = patterns->data();
+    }
+    if(strides)
+    {
+        strides->fill(0,numElements);
+        str = strides->data();
+    }
+
+    QVector<AccessPattern> found(numInstructions);
+    QVector<char> present(numInstructions,0);
+    parallelFor(numInstructions,[&](qint64 begin, qint64 end)
+    {
+        QVector<ElemIndex> members;
+        QHash<qint64,qint64> hist;
+        for(qint64 ins=begin; ins<end; ins++)
+        {
+            members.clear();
+            for(int i=begins.at(ins); i<begins.at(ins+1); i++)
+                if(mask.test(order.at(i)))
+                    members.push_back(order.at(i));
+            if(members.isEmpty())
+                continue;
+
+            std::sort(members.begin(),members.end(),[samples](ElemIndex a, ElemIndex b)
+            {
+                const Sample &sa = samples[a], &sb = samples[b];
+                if(sa.tid != sb.tid)
+                    return sa.tid < sb.tid;
+                if(sa.time != sb.time)
+                    return sa.time < sb.time;
+                return a < b;
+            });
+
+            AccessPattern &p = found[ins];
+            p.instruction = samples[members.first()].instructionUid;
+            p.sample = members.first();
+            p.samples = 0;
+            p.latency = 0;
+            p.deltas = 0;
+            p.stride = 0;
+            p.strideShare = 0;
+
+            hist.clear();
+            for(int m=0; m<members.size(); m++)
+            {
+                const Sample &s = samples[members.at(m)];
+                p.samples += s.weight;
+                p.latency += (qreal)s.latency*s.weight;
+                if(m > 0 && samples[members.at(m-1)].tid == s.tid)
+                {
+                    hist[s.addr-samples[members.at(m-1)].addr]++;
+                    p.deltas++;
+                }
+            }
+
+            classify(p,hist);
+            present[ins] = 1;
+
+            for(int m=0; m<members.size(); m++)
+            {
+                if(pat)
+                    pat[members.at(m)] = p.pattern;
+                if(str)
+                    str[members.at(m)] = p.stride;
+            }
+        }
+    },16);
+
+    QVector<AccessPattern> result;
+    for(int i=0; i<numInstructions; i++)
+        if(present.at(i))
+            result.push_back(found.at(i));
+
+    std::sort(result.begin(),result.end(),
+              [](const AccessPattern &a, const AccessPattern &b)
+              { return a.latency > b.latency; });
+
+    return result;
+}
@@ -0,0 +1,95 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ACCESSPATTERN_H
+#define ACCESSPATTERN_H
+
+#include <QVector>
+
+#include "dataobject.h"
+
+#define PATTERN_UNKNOWN -1
+#define PATTERN_SEQUENTIAL 0
+#define PATTERN_STRIDED 1
+#define PATTERN_IRREGULAR 2
+
+// Instructions with fewer consecutive sample pairs are not classified
+#define PATTERN_MIN_DELTAS 8
+
+// Strides up to a cache line touch every line in order
+#define PATTERN_SEQUENTIAL_BYTES 64
+
+// Most frequent deltas kept per instruction
+#define PATTERN_TOP_DELTAS 4
+
+struct DeltaCount
+{
+    qint64 delta;
+    qint64 count;
+};
+
+struct AccessPattern
+{
+    ElemIndex instruction;
+    ElemIndex sample;       // first sample, for ip, source and line
+    qint64 samples;
+    qreal latency;
+    qint64 deltas;          // pairs of consecutive samples of one thread
+    int pattern;
+    qint64 stride;          // bytes, 0 unless sequential or strided
+    qreal strideShare;      // share of the nonzero deltas that are stride multiples
+    QVector<DeltaCount> topDeltas;
+};
+
+QString patternName(int pattern);
+
+// Access pattern of every instruction with samples in mask, highest latency
+// first. Samples of an instruction are ordered by thread and time, the
+// address deltas of consecutive samples are histogrammed and their dominant
+// stride found. Samples only see every n-th access, so deltas are stride
+// multiples: the stride is the most common delta if it holds half of them,
+// else the gcd of the repeating deltas if most of them are multiples of it
+// in the same direction. Instructions run in parallel.
+//
+// If patterns/strides are given they are filled with the pattern and stride
+// of every sample, PATTERN_UNKNOWN and 0 outside mask.
+QVector<AccessPattern> accessPatterns(DataObject *d, const Bitmap &mask,
+                                      QVector<qint64> *patterns = NULL,
+                                      QVector<qint64> *strides = NULL);
+
+#endif // ACCESSPATTERN_H
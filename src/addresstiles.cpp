@@ -0,0 +1,321 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "addresstiles.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+void AddressAxis::build(DataObject *d)
+{
+    segments.clear();
+
+    const Sample *samples = d->samples.constData();
+    qint64 numElements = d->numElements;
+    if(numElements == 0)
+        return;
+
+    // Address range of every variable, per chunk of samples and merged
+    typedef QHash<ElemIndex,AddressSegment> RangeTable;
+    int numChunks = parallelChunkCount(numElements,1 << 14);
+    QVector<RangeTable> tables(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        RangeTable &t = tables[c];
+        qint64 begin = numElements*c/numChunks;
+        qint64 end = numElements*(c+1)/numChunks;
+        for(qint64 e=begin; e<end; e++)
+        {
+            const Sample &s = samples[e];
+            quint64 a = (quint64)s.addr;
+            RangeTable::iterator it = t.find(s.variableUid);
+            if(it == t.end())
+            {
+                AddressSegment r = {a, a, 0, 0, 0, (ElemIndex)e};
+                it = t.insert(s.variableUid,r);
+            }
+
+            AddressSegment &r = it.value();
+            r.lo = std::min(r.lo,a);
+            r.hi = std::max(r.hi,a);
+            r.samples += s.weight;
+        }
+    });
+
+    RangeTable merged = tables.at(0);
+    for(int c=1; c<numChunks; c++)
+    {
+        const RangeTable &t = tables.at(c);
+        for(RangeTable::const_iterator it=t.constBegin(); it!=t.constEnd(); it++)
+        {
+            RangeTable::iterator m = merged.find(it.key());
+            if(m == merged.end())
+            {
+                merged.insert(it.key(),it.value());
+                continue;
+            }
+
+            m.value().lo = std::min(m.value().lo,it.value().lo);
+            m.value().hi = std::max(m.value().hi,it.value().hi);
+            m.value().samples += it.value().samples;
+        }
+    }
+
+    QVector<AddressSegment> ranges;
+    for(RangeTable::const_iterator it=merged.constBegin(); it!=merged.constEnd(); it++)
+        ranges.push_back(it.value());
+
+    std::sort(ranges.begin(),ranges.end(),
+              [](const AddressSegment &a, const AddressSegment &b)
+              { return a.lo < b.lo || (a.lo == b.lo && a.sample < b.sample); });
+
+    // Merge overlapping and nearby ranges, named by their largest variable
+    qint64 largest = 0;
+    for(int i=0; i<ranges.size(); i++)
+    {
+        const AddressSegment &r = ranges.at(i);
+        if(!segments.isEmpty() && r.lo <= segments.last().hi + AXIS_MERGE_GAP)
+        {
+            AddressSegment &s = segments.last();
+            s.hi = std::max(s.hi,r.hi);
+            s.samples += r.samples;
+            if(r.samples > largest)
+            {
+                largest = r.samples;
+                s.sample = r.sample;
+            }
+            continue;
+        }
+
+        segments.push_back(r);
+        largest = r.samples;
+    }
+
+    int n = segments.size();
+    qreal y = 0;
+    for(int i=0; i<n; i++)
+    {
+        AddressSegment &s = segments[i];
+        s.y0 = y;
+        y += 0.5/n + 0.5*s.samples/d->totalWeight;
+        s.y1 = y;
+    }
+    segments.last().y1 = 1;
+}
+
+qreal AddressAxis::toAxis(quint64 addr) const
+{
+    QVector<AddressSegment>::const_iterator it =
+            std::upper_bound(segments.constBegin(),segments.constEnd(),addr,
+                             [](quint64 a, const AddressSegment &s)
+                             { return a < s.lo; });
+    if(it == segments.constBegin())
+        return -1;
+
+    const AddressSegment &s = *(it-1);
+    if(addr > s.hi)
+        return -1;
+
+    // Keep the top end of the segment below y1
+    qreal t = (qreal)(addr-s.lo) / ((qreal)(s.hi-s.lo)+1);
+    return s.y0 + t*(s.y1-s.y0);
+}
+
+int AddressAxis::segmentAt(qreal y) const
+{
+    QVector<AddressSegment>::const_iterator it =
+            std::upper_bound(segments.constBegin(),segments.constEnd(),y,
+                             [](qreal v, const AddressSegment &s)
+                             { return v < s.y0; });
+    if(it == segments.constBegin())
+        return -1;
+    return std::min((int)(it-segments.constBegin())-1,segments.size()-1);
+}
+
+quint64 AddressAxis::toAddress(qreal y) const
+{
+    int i = segmentAt(y);
+    if(i < 0)
+        return 0;
+
+    const AddressSegment &s = segments.at(i);
+    qreal t = clamp((y-s.y0)/(s.y1-s.y0),0.0,1.0);
+    return s.lo + (quint64)(t*((qreal)(s.hi-s.lo)));
+}
+
+static inline quint32 spreadBits(quint32 v)
+{
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+static inline quint32 compactBits(quint32 v)
+{
+    v &= 0x55555555;
+    v = (v | (v >> 1)) & 0x33333333;
+    v = (v | (v >> 2)) & 0x0f0f0f0f;
+    v = (v | (v >> 4)) & 0x00ff00ff;
+    v = (v | (v >> 8)) & 0x0000ffff;
+    return v;
+}
+
+quint32 TilePyramid::morton(quint32 x, quint32 y)
+{
+    return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+void TilePyramid::demorton(quint32 code, quint32 &x, quint32 &y)
+{
+    x = compactBits(code);
+    y = compactBits(code >> 1);
+}
+
+TilePyramid::TilePyramid()
+{
+}
+
+void TilePyramid::build(const QVector<float> &xs, const QVector<float> &ys,
+                        const QVector<quint32> &weights, const Bitmap &mask)
+{
+    const int cells = 1 << TILE_MAX_LEVEL;
+    const int radixBits = TILE_MAX_LEVEL;
+    const int buckets = 1 << radixBits;
+    const quint64 *words = mask.constData();
+    const float *px = xs.constData();
+    const float *py = ys.constData();
+    const quint32 *pw = weights.constData();
+    int numWords = mask.numWords();
+    int numChunks = parallelChunkCount(numWords,256);
+
+    // Finest cell of every sample above its weight, gathered per chunk
+    QVector<QVector<quint64> > chunkCodes(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        QVector<quint64> &codes = chunkCodes[c];
+        int begin = (qint64)numWords*c/numChunks;
+        int end = (qint64)numWords*(c+1)/numChunks;
+        for(int w=begin; w<end; w++)
+        {
+            quint64 bits = words[w];
+            while(bits)
+            {
+                qint64 e = ((qint64)w << 6) + qCountTrailingZeroBits(bits);
+                bits &= bits-1;
+
+                int cx = std::max(0,std::min((int)(px[e]*cells),cells-1));
+                int cy = std::max(0,std::min((int)(py[e]*cells),cells-1));
+                codes.push_back(((quint64)morton(cx,cy) << 32) | pw[e]);
+            }
+        }
+    });
+
+    QVector<quint64> codes;
+    for(int c=0; c<numChunks; c++)
+        codes += chunkCodes.at(c);
+    chunkCodes.clear();
+
+    // Two radix passes over the 2*TILE_MAX_LEVEL bit codes
+    QVector<quint64> sorted(codes.size());
+    for(int pass=0; pass<2; pass++)
+    {
+        int shift = 32+pass*radixBits;
+        QVector<int> offsets(buckets+1,0);
+        for(int i=0; i<codes.size(); i++)
+            offsets[((codes.at(i) >> shift) & (buckets-1))+1]++;
+        for(int b=0; b<buckets; b++)
+            offsets[b+1] += offsets.at(b);
+        for(int i=0; i<codes.size(); i++)
+            sorted[offsets[(codes.at(i) >> shift) & (buckets-1)]++] = codes.at(i);
+        codes.swap(sorted);
+    }
+    sorted.clear();
+
+    levels.clear();
+    levels.resize(TILE_MAX_LEVEL+1);
+
+    // Finest level from runs of equal codes, the coarser ones from runs of
+    // equal parents, which Morton order keeps adjacent
+    for(int l=TILE_MAX_LEVEL; l>=0; l--)
+    {
+        Level &level = levels[l];
+        level.maxCount = 0;
+
+        if(l == TILE_MAX_LEVEL)
+        {
+            for(int i=0; i<codes.size(); i++)
+            {
+                quint32 code = codes.at(i) >> 32;
+                if(level.codes.isEmpty() || level.codes.last() != code)
+                {
+                    level.codes.push_back(code);
+                    level.counts.push_back(0);
+                }
+                level.counts.last() += (quint32)codes.at(i);
+            }
+        }
+        else
+        {
+            const Level &child = levels.at(l+1);
+            for(int i=0; i<child.codes.size(); i++)
+            {
+                quint32 parent = child.codes.at(i) >> 2;
+                if(level.codes.isEmpty() || level.codes.last() != parent)
+                {
+                    level.codes.push_back(parent);
+                    level.counts.push_back(0);
+                }
+                level.counts.last() += child.counts.at(i);
+            }
+        }
+
+        for(int i=0; i<level.codes.size(); i++)
+        {
+            level.maxCount = std::max(level.maxCount,level.counts.at(i));
+
+            quint32 tile = level.codes.at(i) >> (2*TILE_BITS);
+            if(i == 0 || tile != (level.codes.at(i-1) >> (2*TILE_BITS)))
+                level.tiles.insert(tile,qMakePair(i,i+1));
+            else
+                level.tiles[tile].second = i+1;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ADDRESSTILES_H
+#define ADDRESSTILES_H
+
+#include <QVector>
+#include <QHash>
+#include <QPair>
+
+#include "dataobject.h"
+
+// Variables closer than this share one segment of the address axis
+#define AXIS_MERGE_GAP 4096
+
+// A tile is 64x64 cells, the finest level 4096x4096 cells
+#define TILE_BITS 6
+#define TILE_MAX_LEVEL 12
+
+struct AddressSegment
+{
+    quint64 lo;         // first and last address
+    quint64 hi;
+    qreal y0;           // extent on the axis, in [0,1]
+    qreal y1;
+    qint64 samples;
+    ElemIndex sample;   // of the variable with most samples, for its name
+};
+
+// Address axis compacted to the address ranges of the variables. Ranges
+// are merged where they overlap, the gaps between them are left out and
+// every segment gets half its height evenly and half by samples, so a
+// sparse 64 bit address space does not waste the resolution.
+class AddressAxis
+{
+public:
+    void build(DataObject *d);
+
+    int numSegments() const { return segments.size(); }
+    const AddressSegment &segment(int i) const { return segments.at(i); }
+
+    // Position in [0,1) of an address, -1 outside every segment
+    qreal toAxis(quint64 addr) const;
+    quint64 toAddress(qreal y) const;
+    int segmentAt(qreal y) const;
+
+private:
+    QVector<AddressSegment> segments;
+};
+
+// Sparse count pyramid over [0,1)^2, level l has 2^l x 2^l cells. Occupied
+// cells are kept in Morton order, so the parent of a cell is its code >> 2
+// and coarser levels are merged runs of the finer one, and every tile is
+// a contiguous run found through a hash.
+class TilePyramid
+{
+public:
+    TilePyramid();
+
+    // Counts the samples of mask at (xs[i],ys[i]) by their weights[i],
+    // coordinates in [0,1)
+    void build(const QVector<float> &xs, const QVector<float> &ys,
+               const QVector<quint32> &weights, const Bitmap &mask);
+
+    bool isEmpty() const { return levels.isEmpty() || levels.at(0).codes.isEmpty(); }
+    quint32 maxCount(int level) const { return levels.at(level).maxCount; }
+
+    // Calls fn(cx,cy,count) for every occupied cell of tile (tx,ty)
+    template<typename Fn>
+    void forEachCell(int level, int tx, int ty, Fn fn) const
+    {
+        const Level &l = levels.at(level);
+        QHash<quint32,QPair<int,int> >::const_iterator it = l.tiles.constFind(morton(tx,ty));
+        if(it == l.tiles.constEnd())
+            return;
+
+        for(int i=it.value().first; i<it.value().second; i++)
+        {
+            quint32 cx, cy;
+            demorton(l.codes.at(i),cx,cy);
+            fn(cx,cy,l.counts.at(i));
+        }
+    }
+
+    static quint32 morton(quint32 x, quint32 y);
+    static void demorton(quint32 code, quint32 &x, quint32 &y);
+
+private:
+    struct Level
+    {
+        QVector<quint32> codes;
+        QVector<quint32> counts;
+        QHash<quint32,QPair<int,int> > tiles;
+        quint32 maxCount;
+    };
+
+    QVector<Level> levels;
+};
+
+#endif // ADDRESSTILES_H
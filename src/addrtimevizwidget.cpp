@@ -0,0 +1,493 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "addrtimevizwidget.h"
+#include "parallel.h"
+
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+
+#include <algorithm>
+#include <cmath>
+
+// Narrowest view, well past the finest tiles
+#define MIN_VIEW_SIZE 1e-6
+
+AddrTimeViz::AddrTimeViz(QWidget *parent) :
+    VizWidget(parent)
+{
+    view = QRectF(0,0,1,1);
+    level = 0;
+    visVersion = 0;
+    needsRender = true;
+
+    brushing = false;
+    panning = false;
+
+    setMouseTracking(true);
+}
+
+AddrTimeViz::~AddrTimeViz()
+{
+}
+
+void AddrTimeViz::processData()
+{
+    // Positions only change with the data, the tiles follow visibility and
+    // the selection. The task reads the samples, so it is tagged with both
+    // inputs: loading data invalidates them and waits for it. Any selection
+    // or visibility change cancels it too, the slots then start it over.
+    processed = false;
+    runCompute<AddrTimeLayout>("addrtimelayout",COMPUTE_SELECTION|COMPUTE_VISIBILITY,
+                               [this](const ComputeToken &token)
+    {
+        AddrTimeLayout l;
+        l.axis.build(dataSet);
+
+        const Sample *samples = dataSet->samples.constData();
+        qint64 n = dataSet->numElements;
+        l.minTime = 0;
+        l.maxTime = 0;
+        for(qint64 e=0; e<n; e++)
+        {
+            if(e == 0 || samples[e].time < l.minTime)
+                l.minTime = samples[e].time;
+            if(e == 0 || samples[e].time > l.maxTime)
+                l.maxTime = samples[e].time;
+        }
+
+        l.xs.resize(n);
+        l.ys.resize(n);
+        l.weights.resize(n);
+        float *xs = l.xs.data();
+        float *ys = l.ys.data();
+        quint32 *ws = l.weights.data();
+        qreal span = (qreal)(l.maxTime-l.minTime)+1;
+        parallelFor(n,[&](qint64 begin, qint64 end)
+        {
+            if(token.cancelled())
+                return;
+
+            for(qint64 e=begin; e<end; e++)
+            {
+                xs[e] = (samples[e].time-l.minTime)/span;
+                ys[e] = std::max(0.0,l.axis.toAxis((quint64)samples[e].addr));
+                ws[e] = samples[e].weight;
+            }
+        });
+
+        return l;
+    },
+    [this](const AddrTimeLayout &l)
+    {
+        positions = l;
+        visVersion = dataSet->visibilityVersion();
+        visibleTiles = TilePyramid();
+        selectedTiles = TilePyramid();
+
+        processed = true;
+        buildTiles(COMPUTE_SELECTION|COMPUTE_VISIBILITY);
+    });
+}
+
+void AddrTimeViz::buildTiles(int inputs)
+{
+    // Positions of a previous data set until processData() finishes
+    if(!processed || positions.xs.size() != (int)dataSet->numElements)
+        return;
+
+    // Masks are copied here, the pyramids are built in the background.
+    // Every change rebuilds the whole pyramid of its mask from the samples,
+    // down to the TILE_MAX_LEVEL grid of 4096x4096 cells.
+    QVector<float> xs = positions.xs;
+    QVector<float> ys = positions.ys;
+    QVector<quint32> ws = positions.weights;
+
+    if(inputs & COMPUTE_VISIBILITY)
+    {
+        Bitmap mask = dataSet->visibilityMask();
+        runCompute<TilePyramid>("addrtimevisible",COMPUTE_VISIBILITY,
+                                [xs,ys,ws,mask](const ComputeToken &token)
+        {
+            Q_UNUSED(token);
+
+            TilePyramid t;
+            t.build(xs,ys,ws,mask);
+            return t;
+        },
+        [this](const TilePyramid &t)
+        {
+            visibleTiles = t;
+            needsRender = true;
+            needsRepaint = true;
+            requestFrame();
+        });
+    }
+
+    if(inputs & COMPUTE_SELECTION)
+    {
+        Bitmap mask = dataSet->selectionMask(ACTIVE_GROUP);
+        runCompute<TilePyramid>("addrtimeselected",COMPUTE_SELECTION,
+                                [xs,ys,ws,mask](const ComputeToken &token)
+        {
+            Q_UNUSED(token);
+
+            TilePyramid t;
+            t.build(xs,ys,ws,mask);
+            return t;
+        },
+        [this](const TilePyramid &t)
+        {
+            selectedTiles = t;
+            needsRender = true;
+            needsRepaint = true;
+            requestFrame();
+        });
+    }
+}
+
+void AddrTimeViz::selectionChangedSlot()
+{
+    if(!processed && dataSet && !dataSet->empty())
+    {
+        processData();
+        return;
+    }
+    buildTiles(COMPUTE_SELECTION);
+}
+
+void AddrTimeViz::visibilityChangedSlot()
+{
+    if(!processed && dataSet && !dataSet->empty())
+    {
+        processData();
+        return;
+    }
+
+    // Nothing flipped since the tiles were built, e.g. show all twice
+    if(processed && dataSet->visibilityVersion() == visVersion)
+        return;
+    visVersion = dataSet->visibilityVersion();
+
+    buildTiles(COMPUTE_VISIBILITY);
+}
+
+QRect AddrTimeViz::plotRect() const
+{
+    return rect().adjusted(140,margin,-margin,-margin-16);
+}
+
+QPointF AddrTimeViz::toView(QPointF pixel) const
+{
+    QRect plot = plotRect();
+    qreal x = (pixel.x()-plot.left()) / std::max(1,plot.width());
+    qreal y = (plot.bottom()+1-pixel.y()) / std::max(1,plot.height());
+    return QPointF(view.x()+x*view.width(), view.y()+y*view.height());
+}
+
+void AddrTimeViz::setView(QRectF v)
+{
+    qreal w = clamp(v.width(),MIN_VIEW_SIZE,1.0);
+    qreal h = clamp(v.height(),MIN_VIEW_SIZE,1.0);
+    qreal x = clamp(v.x(),0.0,1.0-w);
+    qreal y = clamp(v.y(),0.0,1.0-h);
+    view = QRectF(x,y,w,h);
+
+    needsRender = true;
+    needsRepaint = true;
+    requestFrame();
+}
+
+void AddrTimeViz::renderImage()
+{
+    QRect plot = plotRect();
+    int w = plot.width();
+    int h = plot.height();
+    if(w <= 0 || h <= 0)
+    {
+        image = QImage();
+        return;
+    }
+
+    image = QImage(w,h,QImage::Format_RGB32);
+    image.fill(bgColor);
+    if(visibleTiles.isEmpty())
+        return;
+
+    // Finest level with at least a pixel per cell
+    qreal cellsAcross = std::min(w/view.width(),h/view.height());
+    level = (int)clamp(std::floor(std::log2(cellsAcross)),0.0,(qreal)TILE_MAX_LEVEL);
+    qreal cells = 1 << level;
+    int tilesAcross = std::max(1,(1 << level) >> TILE_BITS);
+
+    int tx0 = std::max(0,(int)std::floor(view.left()*tilesAcross));
+    int tx1 = std::min(tilesAcross-1,(int)std::floor(view.right()*tilesAcross));
+    int ty0 = std::max(0,(int)std::floor(view.top()*tilesAcross));
+    int ty1 = std::min(tilesAcross-1,(int)std::floor(view.bottom()*tilesAcross));
+
+    QVector<QPoint> tiles;
+    for(int ty=ty0; ty<=ty1; ty++)
+        for(int tx=tx0; tx<=tx1; tx++)
+            tiles.push_back(QPoint(tx,ty));
+
+    // Cells cover whole pixels and tiles disjoint ones, so tiles are
+    // drawn in parallel without sharing pixels
+    QVector<quint32> visCounts(w*h,0);
+    QVector<quint32> selCounts(w*h,0);
+    qreal sx = w/(view.width()*cells);
+    qreal sy = h/(view.height()*cells);
+    qreal ox = view.x()*cells;
+    qreal oy = view.y()*cells;
+    parallelTasks(tiles.size(),[&](int i)
+    {
+        auto fill = [&](quint32 *counts)
+        {
+            return [&,counts](quint32 cx, quint32 cy, quint32 count)
+            {
+                int x0 = std::max(0,(int)qRound((cx-ox)*sx));
+                int x1 = std::min(w,(int)qRound((cx+1-ox)*sx));
+                int y0 = std::max(0,h-(int)qRound((cy+1-oy)*sy));
+                int y1 = std::min(h,h-(int)qRound((cy-oy)*sy));
+                for(int y=y0; y<y1; y++)
+                    for(int x=x0; x<x1; x++)
+                        counts[y*w+x] = count;
+            };
+        };
+
+        const QPoint &t = tiles.at(i);
+        visibleTiles.forEachCell(level,t.x(),t.y(),fill(visCounts.data()));
+        if(!selectedTiles.isEmpty())
+            selectedTiles.forEachCell(level,t.x(),t.y(),fill(selCounts.data()));
+    });
+
+    // Log scale over the whole level, selected cells toward the group color
+    qreal visNorm = 1.0 / std::log1p((qreal)visibleTiles.maxCount(level));
+    QColor selColor = groupColor(dataSet->activeGroup());
+    QColor dense(40,40,40);
+    parallelFor(h,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 y=begin; y<end; y++)
+        {
+            QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            const quint32 *vis = visCounts.constData()+y*w;
+            const quint32 *sel = selCounts.constData()+y*w;
+            for(int x=0; x<w; x++)
+            {
+                if(vis[x] == 0 && sel[x] == 0)
+                    continue;
+
+                qreal t = 0.15 + 0.85*clamp(std::log1p((qreal)vis[x])*visNorm,0.0,1.0);
+                qreal r = lerp(t,bgColor.redF(),dense.redF());
+                qreal g = lerp(t,bgColor.greenF(),dense.greenF());
+                qreal b = lerp(t,bgColor.blueF(),dense.blueF());
+                if(sel[x])
+                {
+                    qreal f = 0.5 + 0.5*clamp((qreal)sel[x]/std::max(vis[x],1u),0.0,1.0);
+                    r = lerp(f,r,selColor.redF());
+                    g = lerp(f,g,selColor.greenF());
+                    b = lerp(f,b,selColor.blueF());
+                }
+                line[x] = qRgb(r*255,g*255,b*255);
+            }
+        }
+    },16);
+}
+
+void AddrTimeViz::drawQtPainter(QPainter *painter)
+{
+    painter->fillRect(rect(),bgColor);
+
+    if(!processed)
+        return;
+
+    QRect plot = plotRect();
+    if(needsRender || image.size() != plot.size())
+    {
+        renderImage();
+        needsRender = false;
+    }
+
+    painter->drawImage(plot.topLeft(),image);
+    painter->setBrush(Qt::NoBrush);
+    painter->setPen(Qt::black);
+    painter->drawRect(plot);
+
+    // Segments of the address axis, named by their largest variable
+    qreal yScale = plot.height()/view.height();
+    for(int i=0; i<positions.axis.numSegments(); i++)
+    {
+        const AddressSegment &s = positions.axis.segment(i);
+        if(s.y1 <= view.top() || s.y0 >= view.bottom())
+            continue;
+
+        int top = plot.bottom()+1 - (int)((std::min(s.y1,view.bottom())-view.y())*yScale);
+        int bottom = plot.bottom()+1 - (int)((std::max(s.y0,view.top())-view.y())*yScale);
+
+        painter->setPen(Qt::gray);
+        painter->drawLine(QPoint(plot.left()-margin,bottom),QPoint(plot.left(),bottom));
+        if(bottom-top < 14)
+            continue;
+
+        // Address at the bottom of the visible part of the segment
+        quint64 lo = positions.axis.toAddress(std::max(s.y0,view.top()));
+        QString name = dataSet->samples.at(s.sample).variable;
+        QRect label(0,top,plot.left()-4,bottom-top);
+        painter->setPen(Qt::black);
+        painter->drawText(label,Qt::AlignRight|Qt::AlignTop,name);
+        if(bottom-top >= 28)
+            painter->drawText(label,Qt::AlignRight|Qt::AlignBottom,
+                              "0x"+QString::number(lo,16));
+    }
+
+    // Time range of the view
+    qreal span = (qreal)(positions.maxTime-positions.minTime)+1;
+    qint64 t0 = positions.minTime + (qint64)(view.left()*span);
+    qint64 t1 = positions.minTime + (qint64)(view.right()*span);
+    painter->setPen(Qt::black);
+    painter->drawText(plot.bottomLeft()+QPoint(0,14),QString::number(t0));
+    QString end = QString::number(t1);
+    painter->drawText(plot.bottomRight()+QPoint(-painter->fontMetrics().width(end),14),end);
+
+    if(brushing)
+    {
+        QColor c = groupColor(dataSet->activeGroup());
+        painter->setPen(c);
+        c.setAlpha(40);
+        painter->setBrush(c);
+        painter->drawRect(QRect(pressPos,lastPos).normalized());
+    }
+}
+
+void AddrTimeViz::selectBrush()
+{
+    QRectF r = QRectF(toView(pressPos),toView(lastPos)).normalized();
+    const float *xs = positions.xs.constData();
+    const float *ys = positions.ys.constData();
+
+    // Visible samples inside the brush, a word of the mask per step
+    const Bitmap &visible = dataSet->visibilityMask();
+    const quint64 *vis = visible.constData();
+    Bitmap mask(dataSet->numElements,false);
+    quint64 *words = mask.data();
+    parallelFor(mask.numWords(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 w=begin; w<end; w++)
+        {
+            quint64 bits = vis[w];
+            quint64 in = 0;
+            while(bits)
+            {
+                int b = qCountTrailingZeroBits(bits);
+                bits &= bits-1;
+
+                qint64 e = (w << 6) + b;
+                if(xs[e] >= r.left() && xs[e] <= r.right() &&
+                   ys[e] >= r.top() && ys[e] <= r.bottom())
+                    in |= Q_UINT64_C(1) << b;
+            }
+            words[w] = in;
+        }
+    });
+
+    dataSet->selectMask(mask);
+    emit selectionChangedSig();
+}
+
+void AddrTimeViz::mousePressEvent(QMouseEvent *e)
+{
+    if(!processed)
+        return;
+
+    pressPos = e->pos();
+    lastPos = e->pos();
+    if(e->button() == Qt::LeftButton && plotRect().contains(e->pos()))
+        brushing = true;
+    else if(e->button() == Qt::RightButton)
+        panning = true;
+}
+
+void AddrTimeViz::mouseMoveEvent(QMouseEvent *e)
+{
+    if(brushing)
+    {
+        lastPos = e->pos();
+        needsRepaint = true;
+        requestFrame();
+    }
+    else if(panning)
+    {
+        QRect plot = plotRect();
+        QPoint d = e->pos()-lastPos;
+        lastPos = e->pos();
+        setView(view.translated(-d.x()*view.width()/std::max(1,plot.width()),
+                                d.y()*view.height()/std::max(1,plot.height())));
+    }
+}
+
+void AddrTimeViz::mouseReleaseEvent(QMouseEvent *e)
+{
+    if(brushing)
+    {
+        lastPos = e->pos();
+        brushing = false;
+        if((lastPos-pressPos).manhattanLength() > 2)
+            selectBrush();
+        needsRepaint = true;
+        requestFrame();
+    }
+    panning = false;
+}
+
+void AddrTimeViz::mouseDoubleClickEvent(QMouseEvent *e)
+{
+    Q_UNUSED(e);
+    setView(QRectF(0,0,1,1));
+}
+
+void AddrTimeViz::wheelEvent(QWheelEvent *e)
+{
+    if(!processed)
+        return;
+
+    // Zoom around the point under the cursor
+    qreal f = std::pow(0.8,e->angleDelta().y()/120.0);
+    QPointF p = toView(e->pos());
+    setView(QRectF(p.x()-(p.x()-view.x())*f, p.y()-(p.y()-view.y())*f,
+                   view.width()*f, view.height()*f));
+}
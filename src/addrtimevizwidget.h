@@ -0,0 +1,108 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ADDRTIMEVIZWIDGET_H
+#define ADDRTIMEVIZWIDGET_H
+
+#include <QImage>
+
+#include "vizwidget.h"
+#include "addresstiles.h"
+
+// Sample positions in [0,1)^2, time on x and the compacted address on y
+struct AddrTimeLayout
+{
+    AddressAxis axis;
+    QVector<float> xs;
+    QVector<float> ys;
+    QVector<quint32> weights;
+    qint64 minTime;
+    qint64 maxTime;
+};
+
+// Density of samples over time and address, drawn from the tile pyramids
+// of the visible and selected samples. Wheel zooms, right drag pans,
+// left drag selects and double click shows everything again.
+class AddrTimeViz : public VizWidget
+{
+    Q_OBJECT
+public:
+    AddrTimeViz(QWidget *parent = 0);
+    ~AddrTimeViz();
+
+public slots:
+    void selectionChangedSlot();
+    void visibilityChangedSlot();
+
+protected:
+    void processData();
+    void drawQtPainter(QPainter *painter);
+
+    void mousePressEvent(QMouseEvent *e);
+    void mouseMoveEvent(QMouseEvent *e);
+    void mouseReleaseEvent(QMouseEvent *e);
+    void mouseDoubleClickEvent(QMouseEvent *e);
+    void wheelEvent(QWheelEvent *e);
+
+private:
+    void buildTiles(int inputs);
+    void renderImage();
+    void selectBrush();
+
+    QRect plotRect() const;
+    QPointF toView(QPointF pixel) const;
+    void setView(QRectF v);
+
+private:
+    AddrTimeLayout positions;
+    TilePyramid visibleTiles;
+    TilePyramid selectedTiles;
+    quint64 visVersion;
+
+    QRectF view;        // of [0,1]^2 shown, y grows upwards
+    int level;
+    QImage image;
+    bool needsRender;
+
+    bool brushing;
+    bool panning;
+    QPoint pressPos;
+    QPoint lastPos;
+};
+
+#endif // ADDRTIMEVIZWIDGET_H
@@ -0,0 +1,253 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "allocations.h"
+#include "parseUtil.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <QHash>
+
+#include <algorithm>
+
+// Subtrees this small are scanned instead of descended
+#define SCAN_LEVEL 3
+
+AllocationIndex::AllocationIndex()
+{
+    maxLevel = -1;
+    numSkipped = 0;
+}
+
+static quint64 parseAddress(const QString &s, bool *ok)
+{
+    if(s.startsWith("0x") || s.startsWith("0X"))
+        return s.mid(2).toULongLong(ok,16);
+    return s.toULongLong(ok,10);
+}
+
+int AllocationIndex::load(QString filename)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+
+    QTextStream stream(&file);
+    QStringList header = splitCSVLine(stream.readLine());
+    int addrCol = header.indexOf("addr");
+    int sizeCol = header.indexOf("size");
+    int timeCol = header.indexOf("time");
+    int freeCol = header.indexOf("free_time");
+    int siteCol = header.indexOf("site");
+    int nameCol = header.indexOf("name");
+    int eventCol = header.indexOf("event");
+    if(addrCol < 0 || sizeCol < 0)
+        return -1;
+
+    allocs.clear();
+    labelNames.clear();
+    numSkipped = 0;
+
+    QHash<QString,int> labelIds;
+    QHash<quint64,int> live;
+    while(!stream.atEnd())
+    {
+        // Quoted fields may span lines
+        bool complete = false;
+        QString line = stream.readLine();
+        QStringList values = splitCSVLine(line,&complete);
+        while(!complete && !stream.atEnd())
+        {
+            line += "\n"+stream.readLine();
+            values = splitCSVLine(line,&complete);
+        }
+
+        bool ok = (values.size() == header.size());
+        quint64 addr = ok ? parseAddress(values.at(addrCol),&ok) : 0;
+        if(!ok)
+        {
+            numSkipped++;
+            continue;
+        }
+
+        qint64 time = timeCol >= 0 ? values.at(timeCol).toLongLong() : 0;
+        if(eventCol >= 0 && values.at(eventCol) == "free")
+        {
+            QHash<quint64,int>::iterator it = live.find(addr);
+            if(it != live.end())
+            {
+                allocs[it.value()].freeTime = time;
+                live.erase(it);
+            }
+            continue;
+        }
+
+        quint64 size = values.at(sizeCol).toULongLong(&ok);
+        if(!ok)
+        {
+            numSkipped++;
+            continue;
+        }
+        if(size == 0)
+            continue;
+
+        QString label = nameCol >= 0 ? values.at(nameCol) : QString();
+        if(label.isEmpty() && siteCol >= 0)
+            label = values.at(siteCol);
+        if(label.isEmpty())
+            label = "alloc@0x" + QString::number(addr,16);
+
+        QHash<QString,int>::const_iterator id = labelIds.constFind(label);
+        if(id == labelIds.constEnd())
+        {
+            id = labelIds.insert(label,labelNames.size());
+            labelNames.push_back(label);
+        }
+
+        qint64 freeTime = ALLOCATION_NEVER_FREED;
+        if(freeCol >= 0 && !values.at(freeCol).isEmpty())
+            freeTime = values.at(freeCol).toLongLong();
+
+        Allocation a = {addr, addr+size, time, freeTime, id.value(), 0};
+        live.insert(addr,allocs.size());
+        allocs.push_back(a);
+    }
+
+    build();
+    return 0;
+}
+
+void AllocationIndex::build()
+{
+    std::sort(allocs.begin(),allocs.end(),
+              [](const Allocation &a, const Allocation &b)
+              { return a.start < b.start || (a.start == b.start && a.allocTime < b.allocTime); });
+
+    int n = allocs.size();
+    maxLevel = -1;
+    if(n == 0)
+        return;
+
+    // Leaves sit at even indices. Nodes of level k are at i with the low
+    // k bits set and bit k clear, their children at i -/+ 2^(k-1). Right
+    // children past n are covered by the last node of the level below.
+    Allocation *a = allocs.data();
+    int lastIndex = 0;
+    quint64 last = 0;
+    for(int i=0; i<n; i+=2)
+    {
+        lastIndex = i;
+        a[i].maxEnd = a[i].end;
+        last = a[i].maxEnd;
+    }
+
+    int k = 1;
+    for(; (1 << k) <= n; k++)
+    {
+        int x = 1 << (k-1);
+        int first = (x << 1) - 1;
+        int step = x << 2;
+        for(int i=first; i<n; i+=step)
+        {
+            quint64 left = a[i-x].maxEnd;
+            quint64 right = i+x < n ? a[i+x].maxEnd : last;
+            a[i].maxEnd = std::max(a[i].end,std::max(left,right));
+        }
+
+        lastIndex = ((lastIndex >> k) & 1) ? lastIndex-x : lastIndex+x;
+        if(lastIndex < n && a[lastIndex].maxEnd > last)
+            last = a[lastIndex].maxEnd;
+    }
+    maxLevel = k-1;
+}
+
+int AllocationIndex::find(quint64 addr, qint64 time) const
+{
+    if(maxLevel < 0)
+        return -1;
+
+    struct Frame { int x; int k; bool leftDone; };
+    Frame stack[128];
+    int top = 0;
+    Frame root = {(1 << maxLevel)-1, maxLevel, false};
+    stack[top++] = root;
+
+    int n = allocs.size();
+    const Allocation *a = allocs.constData();
+    int found = -1;
+    auto consider = [&](int i)
+    {
+        const Allocation &c = a[i];
+        if(addr < c.end && time >= c.allocTime && time < c.freeTime &&
+           (found < 0 || c.allocTime > a[found].allocTime))
+            found = i;
+    };
+
+    while(top > 0)
+    {
+        Frame f = stack[--top];
+        if(f.k <= SCAN_LEVEL)
+        {
+            int begin = f.x >> f.k << f.k;
+            int end = std::min(begin + (1 << (f.k+1)) - 1,n);
+            for(int i=begin; i<end && a[i].start <= addr; i++)
+                consider(i);
+        }
+        else if(!f.leftDone)
+        {
+            Frame self = {f.x, f.k, true};
+            stack[top++] = self;
+
+            int y = f.x - (1 << (f.k-1));
+            if(y >= n || a[y].maxEnd > addr)
+            {
+                Frame left = {y, f.k-1, false};
+                stack[top++] = left;
+            }
+        }
+        else if(f.x < n && a[f.x].start <= addr)
+        {
+            consider(f.x);
+            Frame right = {f.x + (1 << (f.k-1)), f.k-1, false};
+            stack[top++] = right;
+        }
+    }
+
+    return found;
+}
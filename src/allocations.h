@@ -0,0 +1,100 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+#include <QVector>
+#include <QString>
+
+#include <limits>
+
+// Allocation log read next to samples.csv
+#define ALLOCATION_LOG "allocations.csv"
+
+// Allocations without a free are live until the end
+#define ALLOCATION_NEVER_FREED std::numeric_limits<qint64>::max()
+
+struct Allocation
+{
+    quint64 start;
+    quint64 end;        // one past the last byte
+    qint64 allocTime;
+    qint64 freeTime;
+    int label;          // index into AllocationIndex::labels()
+    quint64 maxEnd;     // largest end in the subtree rooted here
+};
+
+// Allocations sorted by start address, laid out as an implicit interval
+// tree: the node at index i of level k covers i-2^k+1..i+2^k-1 and keeps
+// the largest end below it. A point query visits O(log A) nodes plus the
+// allocations that contain the point, the ones reusing its address.
+class AllocationIndex
+{
+public:
+    AllocationIndex();
+
+    // Reads a log with a header line naming the columns addr and size, and
+    // optionally time, free_time, site, name and event. Addresses may be
+    // hex with 0x. Rows with event "free" end the newest live allocation
+    // at their addr. Samples are labelled by name, else by site. Fields are
+    // CSV as in samples.csv; rows that do not parse are skipped and counted.
+    int load(QString filename);
+
+    // Rows the last load() could not parse
+    int skippedRows() const { return numSkipped; }
+
+    int size() const { return allocs.size(); }
+    const Allocation &at(int i) const { return allocs.at(i); }
+    const QVector<QString> &labels() const { return labelNames; }
+
+    // Allocation holding addr at time, the newest one if several do, -1 if
+    // none is live
+    int find(quint64 addr, qint64 time) const;
+
+private:
+    void build();
+
+private:
+    QVector<Allocation> allocs;
+    QVector<QString> labelNames;
+    int maxLevel;
+    int numSkipped;
+};
+
+#endif // ALLOCATIONS_H
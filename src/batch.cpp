@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "batch.h"
+#include "dataobject.h"
+#include "scriptengine.h"
+
+#include <QDir>
+#include <QThreadPool>
+
+#include <iostream>
+#include <cstring>
+
+bool isBatchMode(int argc, char *argv[])
+{
+    for(int i=1; i<argc; i++)
+        if(strcmp(argv[i],"--batch") == 0)
+            return true;
+    return false;
+}
+
+static int usage()
+{
+    std::cerr << "Usage: MemAxes --batch <data dir> <script|-> [<output dir>] [--threads=N] [--merge-duplicates]" << std::endl;
+    return 1;
+}
+
+int runBatch(QStringList args)
+{
+    QStringList positional;
+    bool mergeDuplicates = false;
+    for(int i=1; i<args.size(); i++)
+    {
+        QString arg = args.at(i);
+        if(arg == "--batch")
+            continue;
+
+        if(arg.startsWith("--threads="))
+        {
+            // Lets a node run many captures side by side without oversubscribing
+            int threads = arg.mid(10).toInt();
+            if(threads <= 0)
+                return usage();
+            QThreadPool::globalInstance()->setMaxThreadCount(threads);
+            continue;
+        }
+
+        if(arg == "--merge-duplicates")
+        {
+            mergeDuplicates = true;
+            continue;
+        }
+
+        positional.push_back(arg);
+    }
+
+    if(positional.size() < 2 || positional.size() > 3)
+        return usage();
+
+    QString dataDir = positional.at(0);
+    QString script = positional.at(1);
+    QString outputDir = (positional.size() == 3) ? positional.at(2) : QDir::currentPath();
+
+    if(!QDir().mkpath(outputDir))
+    {
+        std::cerr << "Error creating output directory: " << outputDir.toStdString() << std::endl;
+        return 1;
+    }
+
+    DataObject dataSet;
+    dataSet.setMergeDuplicates(mergeDuplicates);
+
+    QString topoDir(dataDir+QString("/hardware.xml"));
+    if(dataSet.loadHardwareTopology(topoDir) != 0)
+    {
+        std::cerr << "Error loading hardware: " << topoDir.toStdString() << std::endl;
+        return 1;
+    }
+
+    QString dataSetDir(dataDir+QString("/data/samples.csv"));
+    if(dataSet.loadData(dataSetDir) != 0)
+    {
+        std::cerr << "Error loading dataset: " << dataSetDir.toStdString() << std::endl;
+        return 1;
+    }
+
+    ScriptEngine engine;
+    engine.setDataSet(&dataSet);
+    engine.setOutputDir(outputDir);
+    QObject::connect(&engine,&ScriptEngine::output,[](QString msg)
+    {
+        std::cout << msg.toStdString() << std::endl;
+    });
+
+    return engine.executeScript(script) ? 0 : 2;
+}
@@ -0,0 +1,153 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "bitmap.h"
+#include "parallel.h"
+
+#include <QtAlgorithms>
+
+#define BITMAP_GRAIN 4096
+
+Bitmap::Bitmap(qint64 size, bool value) :
+    n(size),
+    words(wordsFor(size))
+{
+    fill(value);
+}
+
+void Bitmap::clearTail()
+{
+    if(n & 63)
+        words.last() &= ((quint64)1 << (n & 63)) - 1;
+}
+
+void Bitmap::fill(bool value)
+{
+    words.fill(value ? ~(quint64)0 : 0);
+    clearTail();
+}
+
+qint64 Bitmap::count() const
+{
+    const quint64 *w = words.constData();
+    int numChunks = parallelChunkCount(words.size(),1024);
+    QVector<qint64> partial(numChunks);
+
+    parallelTasks(numChunks,[&](int c)
+    {
+        int begin = (qint64)words.size()*c/numChunks;
+        int end = (qint64)words.size()*(c+1)/numChunks;
+        qint64 sum = 0;
+        for(int i=begin; i<end; i++)
+            sum += qPopulationCount(w[i]);
+        partial[c] = sum;
+    });
+
+    qint64 total = 0;
+    for(int c=0; c<numChunks; c++)
+        total += partial.at(c);
+    return total;
+}
+
+bool Bitmap::any() const
+{
+    for(int i=0; i<words.size(); i++)
+        if(words.at(i))
+            return true;
+    return false;
+}
+
+Bitmap &Bitmap::operator&=(const Bitmap &other)
+{
+    quint64 *w = words.data();
+    const quint64 *o = other.words.constData();
+    parallelFor(words.size(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+            w[i] &= o[i];
+    }, BITMAP_GRAIN);
+    return *this;
+}
+
+Bitmap &Bitmap::operator|=(const Bitmap &other)
+{
+    quint64 *w = words.data();
+    const quint64 *o = other.words.constData();
+    parallelFor(words.size(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+            w[i] |= o[i];
+    }, BITMAP_GRAIN);
+    return *this;
+}
+
+Bitmap &Bitmap::operator^=(const Bitmap &other)
+{
+    quint64 *w = words.data();
+    const quint64 *o = other.words.constData();
+    parallelFor(words.size(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+            w[i] ^= o[i];
+    }, BITMAP_GRAIN);
+    return *this;
+}
+
+Bitmap &Bitmap::andNot(const Bitmap &other)
+{
+    quint64 *w = words.data();
+    const quint64 *o = other.words.constData();
+    parallelFor(words.size(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+            w[i] &= ~o[i];
+    }, BITMAP_GRAIN);
+    return *this;
+}
+
+Bitmap &Bitmap::invert()
+{
+    quint64 *w = words.data();
+    parallelFor(words.size(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+            w[i] = ~w[i];
+    }, BITMAP_GRAIN);
+    clearTail();
+    return *this;
+}
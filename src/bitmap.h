@@ -0,0 +1,100 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QtAlgorithms>
+
+// Dense bit set over sample indices. Bits past size() are kept zero so
+// word-wise operations and counts never see them.
+class Bitmap
+{
+public:
+    Bitmap() : n(0) {}
+    explicit Bitmap(qint64 size, bool value = false);
+
+    qint64 size() const { return n; }
+    int numWords() const { return words.size(); }
+
+    bool test(qint64 i) const { return (words.at(i>>6) >> (i&63)) & 1; }
+    void set(qint64 i) { words[i>>6] |= (quint64)1 << (i&63); }
+    void reset(qint64 i) { words[i>>6] &= ~((quint64)1 << (i&63)); }
+
+    void fill(bool value);
+    qint64 count() const;
+    bool any() const;
+
+    Bitmap &operator&=(const Bitmap &other);
+    Bitmap &operator|=(const Bitmap &other);
+    Bitmap &operator^=(const Bitmap &other);
+    Bitmap &andNot(const Bitmap &other);
+    Bitmap &invert();
+
+    quint64 *data() { return words.data(); }
+    const quint64 *constData() const { return words.constData(); }
+
+    // Calls fn(i) for every set bit in increasing order
+    template<typename Fn>
+    void forEachSet(Fn fn) const
+    {
+        for(int w=0; w<words.size(); w++)
+        {
+            quint64 bits = words.at(w);
+            while(bits)
+            {
+                int b = qCountTrailingZeroBits(bits);
+                fn(((qint64)w << 6) + b);
+                bits &= bits-1;
+            }
+        }
+    }
+
+    static int wordsFor(qint64 size) { return (int)((size+63) >> 6); }
+
+private:
+    void clearTail();
+
+private:
+    qint64 n;
+    QVector<quint64> words;
+};
+
+#endif // BITMAP_H
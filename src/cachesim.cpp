@@ -0,0 +1,276 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "cachesim.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+SetAssocCache::SetAssocCache(const CacheGeometry &g)
+{
+    int line = (g.lineSize > 0 && (g.lineSize & (g.lineSize-1)) == 0) ? g.lineSize : 64;
+    lineShift = qCountTrailingZeroBits((quint32)line);
+    ways = std::max(1,g.ways);
+    numSets = std::max((qint64)1,g.size/((qint64)ways*line));
+    pow2 = (numSets & (numSets-1)) == 0;
+    tags.fill(0,numSets*ways);
+}
+
+bool SetAssocCache::access(quint64 addr)
+{
+    quint64 line = addr >> lineShift;
+    quint64 set = pow2 ? (line & (numSets-1)) : (line % numSets);
+    quint64 tag = line+1;
+    quint64 *t = tags.data() + set*ways;
+
+    for(int i=0; i<ways; i++)
+    {
+        if(t[i] == tag)
+        {
+            // Move to the front
+            std::memmove(t+1,t,i*sizeof(quint64));
+            t[0] = tag;
+            return true;
+        }
+    }
+
+    std::memmove(t+1,t,(ways-1)*sizeof(quint64));
+    t[0] = tag;
+    return false;
+}
+
+CacheSimulator::CacheSimulator(DataObject *d)
+{
+    dataSet = d;
+    topology = false;
+
+    // Distinct cpus of the samples, each mapped to its chain of caches
+    QVector<qint64> cpus = d->column(SampleAxes::cpu);
+    std::sort(cpus.begin(),cpus.end());
+    cpus.erase(std::unique(cpus.begin(),cpus.end()),cpus.end());
+
+    QHash<qint64,QVector<Component*> > chains;
+    int depth = 0;
+    for(int i=0; i<cpus.size() && d->node; i++)
+    {
+        QVector<Component*> chain(SIM_MAX_LEVELS,NULL);
+        Component *c = d->node->FindSubcomponentById(cpus.at(i), SYS_SAGE_COMPONENT_THREAD);
+        for(; c != NULL; c = c->GetParent())
+        {
+            if(c->GetComponentType() != SYS_SAGE_COMPONENT_CACHE)
+                continue;
+
+            int level = ((Cache*)c)->GetCacheLevel();
+            if(level >= 1 && level <= SIM_MAX_LEVELS && !chain[level-1])
+                chain[level-1] = c;
+        }
+
+        // Only levels present from L1 up count
+        int n = 0;
+        while(n < SIM_MAX_LEVELS && chain.at(n))
+            n++;
+        depth = std::max(depth,n);
+        chains.insert(cpus.at(i),chain);
+    }
+
+    if(depth == 0)
+    {
+        defaultHierarchy(cpus);
+        return;
+    }
+
+    topology = true;
+    geom.resize(depth);
+    for(int level=1; level<=depth; level++)
+    {
+        CacheGeometry g = {0, 0, 0};
+        QHash<qint64,QVector<Component*> >::const_iterator it;
+        for(it=chains.constBegin(); it!=chains.constEnd() && g.size == 0; it++)
+        {
+            Cache *c = (Cache*)it.value().at(level-1);
+            if(c == NULL)
+                continue;
+
+            g.size = c->GetCacheSize();
+            g.ways = c->GetCacheAssociativityWays();
+            g.lineSize = c->GetCacheLineSize();
+        }
+
+        // hardware.xml may leave out associativity and line size
+        if(g.ways <= 0)
+            g.ways = 8;
+        if(g.lineSize <= 0)
+            g.lineSize = 64;
+        geom[level-1] = g;
+    }
+
+    // Threads without a cache at some level get one of their own there
+    for(int i=0; i<cpus.size(); i++)
+    {
+        const QVector<Component*> &chain = chains[cpus.at(i)];
+        QVector<qint64> ids(depth);
+        for(int l=0; l<depth; l++)
+            ids[l] = chain.at(l) ? (qint64)(quintptr)chain.at(l) : -1-cpus.at(i);
+        instances.insert(cpus.at(i),ids);
+    }
+}
+
+void CacheSimulator::defaultHierarchy(const QVector<qint64> &cpus)
+{
+    // Private L1 and L2 per cpu, one shared L3
+    CacheGeometry l1 = {32*1024, 8, 64};
+    CacheGeometry l2 = {1024*1024, 16, 64};
+    CacheGeometry l3 = {32*1024*1024, 16, 64};
+    geom.clear();
+    geom << l1 << l2 << l3;
+
+    for(int i=0; i<cpus.size(); i++)
+    {
+        QVector<qint64> ids;
+        ids << cpus.at(i) << cpus.at(i) << 0;
+        instances.insert(cpus.at(i),ids);
+    }
+}
+
+void CacheSimulator::run(QVector<qint8> &levels) const
+{
+    qint64 n = dataSet->numElements;
+    int numLevels = geom.size();
+    levels.fill(SIM_MEMORY,n);
+    if(n == 0 || numLevels == 0)
+        return;
+
+    const qint64 *cpu = dataSet->column(SampleAxes::cpu).constData();
+    const qint64 *addr = dataSet->column(SampleAxes::addr).constData();
+    const qint64 *time = dataSet->column(SampleAxes::time).constData();
+    const QVector<ElemIndex> &order = dataSet->sortedIndex(SampleAxes::time);
+
+    // Number the cache instances of every level and give every cpu a slot
+    // holding its instance numbers, so replay needs no hashing
+    QVector<QHash<qint64,int> > instanceIdx(numLevels);
+    QHash<qint64,int> slotOf;
+    QVector<QVector<int> > slotCaches;
+    QHash<qint64,QVector<qint64> >::const_iterator it;
+    for(it=instances.constBegin(); it!=instances.constEnd(); it++)
+    {
+        QVector<int> caches(numLevels);
+        for(int l=0; l<numLevels; l++)
+        {
+            qint64 id = it.value().at(l);
+            if(!instanceIdx.at(l).contains(id))
+                instanceIdx[l].insert(id,instanceIdx.at(l).size());
+            caches[l] = instanceIdx.at(l).value(id);
+        }
+        slotOf.insert(it.key(),slotCaches.size());
+        slotCaches.push_back(caches);
+    }
+
+    // Workers only touch their own instances, through plain pointers
+    QVector<QVector<SetAssocCache> > caches(numLevels);
+    QVector<SetAssocCache*> levelCaches(numLevels);
+    for(int l=0; l<numLevels; l++)
+    {
+        caches[l].fill(SetAssocCache(geom.at(l)),instanceIdx.at(l).size());
+        levelCaches[l] = caches[l].data();
+    }
+
+    QVector<int> slot(n);
+    int *sl = slot.data();
+    parallelFor(n,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 e=begin; e<end; e++)
+            sl[e] = slotOf.value(cpu[e]);
+    });
+
+    // Private levels: one domain per instance of the level below the last,
+    // the instances under it are touched by no other domain. A single level
+    // has nothing private, its domains are the shared instances.
+    int priv = numLevels-1;
+    int llcLevel = numLevels-1;
+    int domainLevel = priv ? priv-1 : llcLevel;
+    int numDomains = caches.at(domainLevel).size();
+    QVector<QVector<ElemIndex> > domains(numDomains);
+    for(int i=0; i<order.size(); i++)
+    {
+        ElemIndex e = order.at(i);
+        domains[slotCaches.at(sl[e]).at(domainLevel)].push_back(e);
+    }
+
+    qint8 *out = levels.data();
+    QVector<QVector<ElemIndex> > missed(numDomains);
+    parallelTasks(numDomains,[&](int dom)
+    {
+        QVector<ElemIndex> &miss = missed[dom];
+        for(ElemIndex e : domains.at(dom))
+        {
+            const QVector<int> &sc = slotCaches.at(sl[e]);
+            int l = 0;
+            while(l < priv && !levelCaches.at(l)[sc.at(l)].access(addr[e]))
+                l++;
+
+            if(l < priv)
+                out[e] = l+1;
+            else
+                miss.push_back(e);
+        }
+    });
+
+    // Shared level: misses of all domains below an instance, back in time order
+    QVector<QVector<ElemIndex> > shared(caches.at(llcLevel).size());
+    for(int dom=0; dom<numDomains; dom++)
+    {
+        const QVector<ElemIndex> &miss = missed.at(dom);
+        if(miss.isEmpty())
+            continue;
+
+        int llc = slotCaches.at(sl[miss.first()]).at(llcLevel);
+        shared[llc] += miss;
+    }
+
+    parallelTasks(shared.size(),[&](int llc)
+    {
+        QVector<ElemIndex> &trace = shared[llc];
+        std::stable_sort(trace.begin(),trace.end(),
+                         [time](ElemIndex a, ElemIndex b) { return time[a] < time[b]; });
+
+        SetAssocCache &cache = levelCaches.at(llcLevel)[llc];
+        for(ElemIndex e : trace)
+            out[e] = cache.access(addr[e]) ? llcLevel+1 : SIM_MEMORY;
+    });
+}
@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <QVector>
+#include <QHash>
+
+#include "dataobject.h"
+
+// Highest simulated cache level, the predicted level of a memory access
+// follows so results line up with Sample::data_src (see dseDepth)
+#define SIM_MAX_LEVELS 3
+#define SIM_MEMORY 4
+
+struct CacheGeometry
+{
+    qint64 size;
+    int ways;
+    int lineSize;
+};
+
+// Set associative LRU cache over line addresses. Every set keeps its tags
+// most recently used first, so a lookup is a short linear scan.
+class SetAssocCache
+{
+public:
+    SetAssocCache() : ways(0), numSets(0), lineShift(6), pow2(true) {}
+    explicit SetAssocCache(const CacheGeometry &g);
+
+    // True on a hit, a miss inserts the line and evicts the LRU one
+    bool access(quint64 addr);
+
+private:
+    int ways;
+    quint64 numSets;
+    int lineShift;
+    bool pow2;
+    QVector<quint64> tags; // line+1, 0 is empty
+};
+
+// Replays the sampled loads through a cache hierarchy taken from the loaded
+// topology. Levels below the last one are private to their instance and
+// replayed per instance in parallel. Their misses are then merged in time
+// order per last level instance, which is shared by its cores.
+class CacheSimulator
+{
+public:
+    explicit CacheSimulator(DataObject *d);
+
+    int numLevels() const { return geom.size(); }
+    CacheGeometry geometry(int level) const { return geom.at(level-1); }
+    void setGeometry(int level, const CacheGeometry &g) { geom[level-1] = g; }
+
+    // True if the levels came from hardware.xml rather than defaults
+    bool fromTopology() const { return topology; }
+
+    // Predicted source of every sample, 1..numLevels() or SIM_MEMORY
+    void run(QVector<qint8> &levels) const;
+
+private:
+    void defaultHierarchy(const QVector<qint64> &cpus);
+
+private:
+    DataObject *dataSet;
+    QVector<CacheGeometry> geom;
+    bool topology;
+
+    // Cache instance of every level for each cpu id
+    QHash<qint64,QVector<qint64> > instances;
+};
+
+#endif // CACHESIM_H
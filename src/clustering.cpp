@@ -0,0 +1,432 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "clustering.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <limits>
+
+// Below this many active clusters a nearest neighbor scan runs serially
+#define SERIAL_SCAN 4096
+
+// Nearest active cluster of x by plain distance() calls
+template<class Linkage>
+static void scanNearest(const Linkage &L, int x, const QVector<int> &active,
+                        int *best, qreal *bestDist)
+{
+    const int *act = active.constData();
+    int n = active.size();
+    int numChunks = parallelChunkCount(n,SERIAL_SCAN);
+    QVector<int> chunkBest(numChunks,-1);
+    QVector<qreal> chunkDist(numChunks,std::numeric_limits<qreal>::max());
+
+    parallelTasks(numChunks,[&](int c)
+    {
+        int begin = (qint64)n*c/numChunks;
+        int end = (qint64)n*(c+1)/numChunks;
+        int b = -1;
+        qreal bd = std::numeric_limits<qreal>::max();
+        for(int i=begin; i<end; i++)
+        {
+            if(act[i] == x)
+                continue;
+            qreal d = L.distance(x,act[i]);
+            if(d < bd)
+            {
+                bd = d;
+                b = act[i];
+            }
+        }
+        chunkBest[c] = b;
+        chunkDist[c] = bd;
+    });
+
+    *best = -1;
+    *bestDist = std::numeric_limits<qreal>::max();
+    for(int c=0; c<numChunks; c++)
+    {
+        if(chunkBest.at(c) >= 0 && chunkDist.at(c) < *bestDist)
+        {
+            *best = chunkBest.at(c);
+            *bestDist = chunkDist.at(c);
+        }
+    }
+}
+
+// Nearest neighbor chain. Follows nearest neighbors until two clusters are
+// each other's nearest and merges them, valid for reducible linkages. With
+// those a merged cluster is never closer to another cluster than the
+// nearer of its parts, so cached nearest neighbors stay valid unless they
+// pointed at one of the merged clusters.
+template<class Linkage>
+static Dendrogram nnChain(Linkage &L, int n, const ComputeToken &token)
+{
+    Dendrogram dg;
+    dg.numLeaves = n;
+    if(n < 2)
+        return dg;
+    dg.merges.reserve(n-1);
+
+    // Slot of a cluster is the slot of one of its leaves
+    QVector<int> node(n), size(n,1), active(n), pos(n);
+    for(int i=0; i<n; i++)
+        node[i] = active[i] = pos[i] = i;
+
+    QVector<int> nn(n,-1);
+    QVector<qreal> nnDist(n,0);
+    QVector<QVector<int> > watchers(n);
+    QVector<int> chain;
+
+    while(active.size() > 1 && !token.cancelled())
+    {
+        if(chain.isEmpty())
+            chain.push_back(active.first());
+
+        int x = chain.last();
+        if(nn.at(x) < 0)
+        {
+            L.nearest(x,active,&nn[x],&nnDist[x]);
+            watchers[nn.at(x)].push_back(x);
+        }
+
+        int y = nn.at(x);
+        qreal dxy = nnDist.at(x);
+
+        // Ties go to the previous link, otherwise the chain could cycle
+        int prev = chain.size() > 1 ? chain.at(chain.size()-2) : -1;
+        if(prev >= 0 && y != prev)
+        {
+            qreal dp = L.distance(x,prev);
+            if(dp <= dxy)
+            {
+                y = prev;
+                dxy = dp;
+            }
+        }
+
+        if(y != prev)
+        {
+            chain.push_back(y);
+            continue;
+        }
+
+        chain.pop_back();
+        chain.pop_back();
+
+        // y keeps its slot and becomes the merged cluster
+        ClusterMerge m = {node.at(y), node.at(x), dxy, size.at(x)+size.at(y)};
+        dg.merges.push_back(m);
+        L.merge(y,x,active);
+        node[y] = n + dg.merges.size()-1;
+        size[y] = m.size;
+
+        int last = active.last();
+        active[pos.at(x)] = last;
+        pos[last] = pos.at(x);
+        active.removeLast();
+
+        for(int s : {x, y})
+        {
+            for(int w : watchers.at(s))
+                if(nn.at(w) == x || nn.at(w) == y)
+                    nn[w] = -1;
+            watchers[s].clear();
+        }
+        nn[x] = nn[y] = -1;
+    }
+
+    return dg;
+}
+
+// Centroids are stored by position in the active list, one array per
+// dimension, so a nearest neighbor scan runs over contiguous floats
+struct WardLinkage
+{
+    int dims;
+    int capacity;
+    QVector<float> coords;      // dim*capacity + position
+    QVector<float> weights;
+    QVector<int> posOf;
+    int numActive;
+
+    WardLinkage(const QVector<float> &features, int d, const QVector<qreal> &w)
+    {
+        dims = d;
+        capacity = numActive = w.size();
+        coords.resize(dims*capacity);
+        weights.resize(capacity);
+        posOf.resize(capacity);
+        for(int i=0; i<capacity; i++)
+        {
+            for(int k=0; k<dims; k++)
+                coords[k*capacity+i] = features.at(i*dims+k);
+            weights[i] = w.at(i);
+            posOf[i] = i;
+        }
+    }
+
+    qreal distance(int a, int b) const
+    {
+        int pa = posOf.at(a), pb = posOf.at(b);
+        const float *c = coords.constData();
+        float sq = 0;
+        for(int k=0; k<dims; k++)
+        {
+            float d = c[k*capacity+pa] - c[k*capacity+pb];
+            sq += d*d;
+        }
+
+        float wa = weights.at(pa), wb = weights.at(pb);
+        return sq*wa*wb/(wa+wb);
+    }
+
+    void nearest(int x, const QVector<int> &active, int *best, qreal *bestDist) const
+    {
+        const int block = 256;
+        int px = posOf.at(x);
+        const float *c = coords.constData();
+        const float *w = weights.constData();
+        QVector<float> cx(dims);
+        for(int k=0; k<dims; k++)
+            cx[k] = c[k*capacity+px];
+        float wx = w[px];
+
+        int n = numActive;
+        int numChunks = parallelChunkCount(n,SERIAL_SCAN);
+        QVector<int> chunkBest(numChunks,-1);
+        QVector<float> chunkDist(numChunks,std::numeric_limits<float>::max());
+
+        parallelTasks(numChunks,[&](int ch)
+        {
+            int begin = (qint64)n*ch/numChunks;
+            int end = (qint64)n*(ch+1)/numChunks;
+            float dist[block];
+            int b = -1;
+            float bd = std::numeric_limits<float>::max();
+
+            // Distances of a block one dimension at a time, then the minimum
+            for(int first=begin; first<end; first+=block)
+            {
+                int len = std::min(block,end-first);
+                std::fill(dist,dist+len,0.0f);
+                for(int k=0; k<dims; k++)
+                {
+                    const float *ck = c + k*capacity + first;
+                    float v = cx.at(k);
+                    for(int i=0; i<len; i++)
+                        dist[i] += (v-ck[i])*(v-ck[i]);
+                }
+                for(int i=0; i<len; i++)
+                    dist[i] = dist[i]*wx*w[first+i]/(wx+w[first+i]);
+                if(px >= first && px < first+len)
+                    dist[px-first] = std::numeric_limits<float>::max();
+
+                for(int i=0; i<len; i++)
+                {
+                    if(dist[i] < bd)
+                    {
+                        bd = dist[i];
+                        b = first+i;
+                    }
+                }
+            }
+            chunkBest[ch] = b;
+            chunkDist[ch] = bd;
+        });
+
+        *best = -1;
+        *bestDist = std::numeric_limits<qreal>::max();
+        for(int ch=0; ch<numChunks; ch++)
+        {
+            if(chunkBest.at(ch) >= 0 && chunkDist.at(ch) < *bestDist)
+            {
+                *best = active.at(chunkBest.at(ch));
+                *bestDist = chunkDist.at(ch);
+            }
+        }
+    }
+
+    // b leaves the active list the way nnChain() removes it, the last
+    // position moves into its place
+    void merge(int a, int b, const QVector<int> &active)
+    {
+        int pa = posOf.at(a), pb = posOf.at(b);
+        float *c = coords.data();
+        float wa = weights.at(pa), wb = weights.at(pb);
+        for(int k=0; k<dims; k++)
+            c[k*capacity+pa] = (wa*c[k*capacity+pa] + wb*c[k*capacity+pb]) / (wa+wb);
+        weights[pa] = wa+wb;
+
+        int last = numActive-1;
+        int moved = active.at(last);
+        for(int k=0; k<dims; k++)
+            c[k*capacity+pb] = c[k*capacity+last];
+        weights[pb] = weights.at(last);
+        posOf[moved] = pb;
+        numActive--;
+    }
+};
+
+struct AverageLinkage
+{
+    int n;
+    QVector<float> dist;    // condensed upper triangle
+    QVector<qreal> sizes;
+
+    qint64 index(int a, int b) const
+    {
+        if(a > b)
+            std::swap(a,b);
+        return (qint64)a*(2*(qint64)n-a-1)/2 + (b-a-1);
+    }
+
+    qreal distance(int a, int b) const { return dist.at(index(a,b)); }
+
+    void nearest(int x, const QVector<int> &active, int *best, qreal *bestDist) const
+    {
+        scanNearest(*this,x,active,best,bestDist);
+    }
+
+    void merge(int a, int b, const QVector<int> &active)
+    {
+        qreal sa = sizes.at(a), sb = sizes.at(b);
+        float *d = dist.data();
+        const int *act = active.constData();
+        parallelFor(active.size(),[&](qint64 begin, qint64 end)
+        {
+            for(qint64 i=begin; i<end; i++)
+            {
+                int x = act[i];
+                if(x == a || x == b)
+                    continue;
+                d[index(a,x)] = (sa*d[index(a,x)] + sb*d[index(b,x)]) / (sa+sb);
+            }
+        }, SERIAL_SCAN);
+        sizes[a] = sa+sb;
+    }
+};
+
+Dendrogram clusterFeatures(const QVector<float> &features, int dims,
+                           const QVector<qreal> &weights,
+                           const ComputeToken &token)
+{
+    WardLinkage L(features,dims,weights);
+    return nnChain(L,weights.size(),token);
+}
+
+Dendrogram clusterPairwise(const QVector<qreal> &sizes,
+                           std::function<qreal(int,int)> distance,
+                           const ComputeToken &token)
+{
+    AverageLinkage L;
+    L.n = std::min(sizes.size(),CLUSTER_MAX_PAIRWISE);
+    L.sizes = sizes.mid(0,L.n);
+    L.dist.resize((qint64)L.n*(L.n-1)/2);
+
+    // Rows get shorter, deal them out round robin
+    int numTasks = parallelChunkCount(L.n,1);
+    float *d = L.dist.data();
+    parallelTasks(numTasks,[&](int t)
+    {
+        for(int i=t; i<L.n && !token.cancelled(); i+=numTasks)
+        {
+            float *row = d + L.index(i,i+1);
+            for(int j=i+1; j<L.n; j++)
+                row[j-i-1] = distance(i,j);
+        }
+    });
+
+    return nnChain(L,L.n,token);
+}
+
+QVector<int> Dendrogram::cut(int k) const
+{
+    int n = numLeaves;
+    k = std::max(1,std::min(k,n));
+
+    // A leaf of every node stands for it
+    QVector<int> leaf(n+merges.size());
+    for(int i=0; i<n; i++)
+        leaf[i] = i;
+    for(int i=0; i<merges.size(); i++)
+        leaf[n+i] = leaf.at(merges.at(i).a);
+
+    // Heights of reducible linkages grow towards the root, so the n-k
+    // lowest merges form the clusters
+    QVector<int> order(merges.size());
+    for(int i=0; i<order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(),order.end(),[this](int a, int b)
+        { return merges.at(a).distance < merges.at(b).distance; });
+
+    QVector<int> parent(n);
+    for(int i=0; i<n; i++)
+        parent[i] = i;
+    auto root = [&parent](int i)
+    {
+        while(parent.at(i) != i)
+            i = parent[i] = parent.at(parent.at(i));
+        return i;
+    };
+
+    for(int i=0; i<n-k && i<order.size(); i++)
+    {
+        const ClusterMerge &m = merges.at(order.at(i));
+        parent[root(leaf.at(m.a))] = root(leaf.at(m.b));
+    }
+
+    // Number the clusters by size
+    QVector<int> count(n,0);
+    for(int i=0; i<n; i++)
+        count[root(i)]++;
+
+    QVector<int> roots;
+    for(int i=0; i<n; i++)
+        if(parent.at(i) == i)
+            roots.push_back(i);
+    std::stable_sort(roots.begin(),roots.end(),[&count](int a, int b)
+        { return count.at(a) > count.at(b); });
+
+    QVector<int> label(n,0), clusters(n,0);
+    for(int i=0; i<roots.size(); i++)
+        label[roots.at(i)] = i;
+    for(int i=0; i<n; i++)
+        clusters[i] = label.at(root(i));
+    return clusters;
+}
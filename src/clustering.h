@@ -0,0 +1,84 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLUSTERING_H
+#define CLUSTERING_H
+
+#include <QVector>
+
+#include <functional>
+
+#include "computepool.h"
+
+// Most items clustered from a full distance matrix
+#define CLUSTER_MAX_PAIRWISE 8192
+
+struct ClusterMerge
+{
+    int a;
+    int b;
+    qreal distance;
+    int size;       // leaves below
+};
+
+// Merges in the order they were made. Leaves are 0..numLeaves-1, merge i
+// creates node numLeaves+i.
+struct Dendrogram
+{
+    int numLeaves;
+    QVector<ClusterMerge> merges;
+
+    Dendrogram() : numLeaves(0) {}
+
+    // Cluster of every leaf when cut into k clusters, 0 is the largest
+    QVector<int> cut(int k) const;
+};
+
+// Ward linkage over weighted feature vectors, dims floats per item. A
+// cancelled token stops the merging early with a partial dendrogram.
+Dendrogram clusterFeatures(const QVector<float> &features, int dims,
+                           const QVector<qreal> &weights,
+                           const ComputeToken &token = ComputeToken());
+
+// Average linkage over any distance, the pairwise distances are evaluated
+// in parallel once and updated in place as clusters merge
+Dendrogram clusterPairwise(const QVector<qreal> &sizes,
+                           std::function<qreal(int,int)> distance,
+                           const ComputeToken &token = ComputeToken());
+
+#endif // CLUSTERING_H
@@ -37,8 +37,11 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "codevizwidget.h"
+#include "accesspattern.h"
+#include "util.h"
 
 #include <QFile>
+#include <QHash>
 #include <QMouseEvent>
 
 #include <iostream>
@@ -54,6 +57,101 @@ bool operator<(const lineBlock &lhs, const lineBlock &rhs)
     return lhs.val > rhs.val; // reverse sort ;-)
 }
 
+// Adds sign times a sample to the blocks of its file and line, creating
+// them on first use. Merged samples stand for weight samples of their mean
+// latency.
+static void addToBlocks(QVector<sourceBlock> &blocks, QHash<QString,int> &fileIds,
+                        QVector<QHash<int,int> > &lineIds, const Sample &s,
+                        int layer, qint64 pattern, int numGroups, int sign)
+{
+    int sourceIdx = fileIds.value(s.source,-1);
+    if(sourceIdx == -1)
+    {
+        sourceBlock newBlock = {s.source, NULL, 0, QRect(),
+                                QVector<qreal>(numGroups+1,0),
+                                0, QVector<lineBlock>(), 0};
+        sourceIdx = blocks.size();
+        blocks.push_back(newBlock);
+        fileIds.insert(s.source,sourceIdx);
+        lineIds.push_back(QHash<int,int>());
+    }
+    qreal latency = sign*(qreal)s.latency*s.weight;
+    qint64 weight = sign*(qint64)s.weight;
+    sourceBlock &src = blocks[sourceIdx];
+    src.val += latency;
+    src.samples += weight;
+    if(layer < src.groupVals.size())
+        src.groupVals[layer] += latency;
+
+    int lineIdx = lineIds[sourceIdx].value(s.line,-1);
+    if(lineIdx == -1)
+    {
+        lineBlock newBlock = {(int)s.line, 0, QRect(), {0,0,0}, PATTERN_UNKNOWN, 0};
+        lineIdx = src.lineBlocks.size();
+        src.lineBlocks.push_back(newBlock);
+        lineIds[sourceIdx].insert(s.line,lineIdx);
+    }
+    lineBlock &lb = src.lineBlocks[lineIdx];
+    lb.val += latency;
+    lb.samples += weight;
+    if(pattern >= 0)
+        lb.patternVals[pattern] += latency;
+}
+
+// Drops emptied blocks, labels every line with its main access pattern and
+// sorts files and lines by value
+static void finishBlocks(QVector<sourceBlock> &blocks)
+{
+    int numKept = 0;
+    for(int j=0; j<blocks.size(); j++)
+    {
+        if(blocks.at(j).samples > 0)
+            blocks[numKept++] = blocks.at(j);
+        else if(blocks.at(j).file)
+            blocks.at(j).file->close();
+    }
+    blocks.resize(numKept);
+
+    // Sort based on value
+    qSort(blocks.begin(),blocks.end());
+
+    for(int j=0; j<blocks.size(); j++)
+    {
+        QVector<lineBlock> &lines = blocks[j].lineBlocks;
+        int numLines = 0;
+        for(int l=0; l<lines.size(); l++)
+            if(lines.at(l).samples > 0)
+                lines[numLines++] = lines.at(l);
+        lines.resize(numLines);
+
+        blocks[j].lineMaxVal = 0;
+        for(int l=0; l<lines.size(); l++)
+        {
+            lineBlock &lb = lines[l];
+            lb.pattern = PATTERN_UNKNOWN;
+            for(int p=0; p<3; p++)
+                if(lb.patternVals[p] > 0 && (lb.pattern < 0 || lb.patternVals[p] > lb.patternVals[lb.pattern]))
+                    lb.pattern = p;
+            blocks[j].lineMaxVal = std::max(blocks[j].lineMaxVal,lb.val);
+        }
+        qSort(lines.begin(),lines.end());
+    }
+}
+
+static void indexBlocks(const QVector<sourceBlock> &blocks, QHash<QString,int> &fileIds,
+                        QVector<QHash<int,int> > &lineIds)
+{
+    fileIds.clear();
+    lineIds.resize(blocks.size());
+    for(int j=0; j<blocks.size(); j++)
+    {
+        fileIds.insert(blocks.at(j).name,j);
+        lineIds[j].clear();
+        for(int l=0; l<blocks.at(j).lineBlocks.size(); l++)
+            lineIds[j].insert(blocks.at(j).lineBlocks.at(l).line,l);
+    }
+}
+
 CodeViz::CodeViz(QWidget *parent) :
     VizWidget(parent)
 {
@@ -67,6 +165,9 @@ CodeViz::CodeViz(QWidget *parent) :
 
     processed = false;
     sourceDir = "NOT SELECTED";
+    sourceMaxVal = 0;
+    visVersion = 0;
+    pending = false;
 }
 
 CodeViz::~CodeViz()
@@ -74,109 +175,116 @@ CodeViz::~CodeViz()
     closeAll();
 }
 
-int CodeViz::getFileID(QString name)
+void CodeViz::processData()
 {
-    for(int i=0; i<sourceBlocks.size(); i++)
+    // Access patterns once the patterns command has run, shared copy
+    int patternAxis = dataSet->axisIndex("pattern");
+    QVector<qint64> patterns;
+    if(patternAxis >= NUM_SAMPLE_AXES)
+        patterns = dataSet->column(patternAxis);
+
+    // Visibility changes cancel the task, so the result matches this version
+    visVersion = dataSet->visibilityVersion();
+    pending = true;
+
+    // Aggregate off the GUI thread, files are only opened once the result is in
+    runCompute<QVector<sourceBlock> >("codeviz",COMPUTE_SELECTION|COMPUTE_VISIBILITY,
+                                      [this,patterns](const ComputeToken &token)
     {
-        if(sourceBlocks[i].name == name)
-            return i;
-    }
+        QVector<sourceBlock> blocks;
+        QHash<QString,int> fileIds;
+        QVector<QHash<int,int> > lineIds;
+
+        bool selectionDefined = dataSet->selectionDefined();
+        const quint8 *groups = dataSet->groupColumn();
+        int numGroups = dataSet->maxGroup();
+        for(ElemIndex elem=0; elem<dataSet->numElements; elem++)
+        {
+            if((elem & 0xffff) == 0 && token.cancelled())
+                break;
 
-    // First time we see this name, new entry
-    QString srcFile = sourceDir+"/"+name;
-    QFile *src = new QFile(srcFile);
-    src->open(QIODevice::ReadOnly | QIODevice::Text);
+            int layer = groups[elem];
+            if(!dataSet->visible(elem) || (selectionDefined && !layer))
+                continue;
 
-    sourceBlock newBlock = {name, src, 0, QRect(), 0, QVector<lineBlock>()};
-    sourceBlocks.push_back(newBlock);
+            qint64 pattern = (elem < (ElemIndex)patterns.size()) ? patterns.at(elem) : -1;
+            addToBlocks(blocks,fileIds,lineIds,dataSet->samples.at(elem),
+                        layer,pattern,numGroups,1);
+        }
 
-    return sourceBlocks.size()-1;
-}
+        finishBlocks(blocks);
 
-int CodeViz::getLineID(sourceBlock *src, int line)
-{
-    for(int i=0; i<src->lineBlocks.size(); i++)
+        return blocks;
+    },
+    [this](const QVector<sourceBlock> &blocks)
     {
-        if(src->lineBlocks[i].line == line)
-            return i;
-    }
+        closeAll();
 
-    // First time we see this line, new entry
-    lineBlock newBlock = {line, 0, QRect()};
-    src->lineBlocks.push_back(newBlock);
-
-    return src->lineBlocks.size()-1;
-}
+        pending = false;
+        sourceBlocks = blocks;
+        indexBlocks(sourceBlocks,fileIds,lineIds);
+        openFiles();
 
-void CodeViz::processData()
-{
-    processed = false;
+        processed = true;
+        needsRepaint = true;
+        requestFrame();
 
-    closeAll();
+        if(sourceBlocks.empty())
+            return;
 
-    sourceMaxVal = 0;
-    sourceBlocks.clear();
+        emit sourceFileSelected(sourceBlocks[0].file);
+        emit sourceLineSelected(sourceBlocks[0].lineBlocks[0].line);
+    });
+}
 
-    // Get metric values
-    for(Sample s: dataSet->samples)
+void CodeViz::selectionChangedSlot()
+{
+    // A dropped first result leaves processed unset, so check the data
+    if(dataSet && !dataSet->empty())
     {
-        if(dataSet->selectionDefined() && !dataSet->selected(s.sampleId))
-            continue;
-
-        int sourceIdx = this->getFileID(s.source);
-        sourceBlocks[sourceIdx].val += s.latency;
-        sourceMaxVal = std::max(sourceMaxVal,sourceBlocks[sourceIdx].val);
-
-        int lineIdx = this->getLineID(&sourceBlocks[sourceIdx],s.line);
-        sourceBlocks[sourceIdx].lineBlocks[lineIdx].val += s.latency;
-
-        sourceBlocks[sourceIdx].lineMaxVal = std::max(sourceBlocks[sourceIdx].lineMaxVal,
-                                                  sourceBlocks[sourceIdx].lineBlocks[lineIdx].val);
+        processData();
     }
+}
 
-    // int elem = 0;
-    // QVector<qreal>::Iterator p;
-    // for(elem=0, p=dataSet->begin; p!=dataSet->end; elem++, p+=dataSet->numDimensions)
-    // {
-    //     if(dataSet->selectionDefined() && !dataSet->selected(elem))
-    //         continue;
-    //
-    //     int sourceIdx = this->getFileID(dataSet->fileNames[elem]);
-    //     sourceBlocks[sourceIdx].val += *(p+dataSet->latencyDim);
-    //     sourceMaxVal = std::max(sourceMaxVal,sourceBlocks[sourceIdx].val);
-    //
-    //     int lineIdx = this->getLineID(&sourceBlocks[sourceIdx],*(p+dataSet->lineDim));
-    //     sourceBlocks[sourceIdx].lineBlocks[lineIdx].val += *(p+dataSet->latencyDim);
-    //
-    //     sourceBlocks[sourceIdx].lineMaxVal = std::max(sourceBlocks[sourceIdx].lineMaxVal,
-    //                                               sourceBlocks[sourceIdx].lineBlocks[lineIdx].val);
-    // }
-
-    if(sourceBlocks.empty())
+void CodeViz::visibilityChangedSlot()
+{
+    if(!dataSet || dataSet->empty())
+        return;
+
+    // The sums are additive, so a small change only moves the samples that
+    // flipped. Anything else aggregates again.
+    if(!processed || pending || !visibilityDeltaApplies(visVersion))
     {
-        processed = true;
+        processData();
         return;
     }
 
-    // Sort based on value
-    qSort(sourceBlocks.begin(),sourceBlocks.end());
-
-    for(int j=0; j<sourceBlocks.size(); j++)
-        qSort(sourceBlocks[j].lineBlocks.begin(),sourceBlocks[j].lineBlocks.end());
-
-    emit sourceFileSelected(sourceBlocks[0].file);
-    emit sourceLineSelected(sourceBlocks[0].lineBlocks[0].line);
+    int patternAxis = dataSet->axisIndex("pattern");
+    const QVector<qint64> *patterns = NULL;
+    if(patternAxis >= NUM_SAMPLE_AXES)
+        patterns = &dataSet->column(patternAxis);
 
-    processed = true;
-}
-
-void CodeViz::selectionChangedSlot()
-{
-    if(processed)
+    bool selectionDefined = dataSet->selectionDefined();
+    const quint8 *groups = dataSet->groupColumn();
+    int numGroups = dataSet->maxGroup();
+    dataSet->visibilityDelta().forEachSet([&](qint64 elem)
     {
-        processData();
-        needsRepaint = true;
-    }
+        int layer = groups[elem];
+        if(selectionDefined && !layer)
+            return;
+
+        qint64 pattern = (patterns && elem < patterns->size()) ? patterns->at(elem) : -1;
+        addToBlocks(sourceBlocks,fileIds,lineIds,dataSet->samples.at(elem),
+                    layer,pattern,numGroups,dataSet->visible(elem) ? 1 : -1);
+    });
+
+    finishBlocks(sourceBlocks);
+    indexBlocks(sourceBlocks,fileIds,lineIds);
+    openFiles();
+    visVersion = dataSet->visibilityVersion();
+
+    needsRepaint = true;
+    requestFrame();
 }
 
 void CodeViz::drawQtPainter(QPainter *painter)
@@ -197,7 +305,19 @@ void CodeViz::drawQtPainter(QPainter *painter)
         sourceBlocks[i].block.setWidth(sourceBlocks[i].val/sourceMaxVal*drawSpace.width());
         sourceBlocks[i].block.setHeight(blockHeight);
 
-        painter->fillRect(sourceBlocks[i].block,Qt::lightGray);
+        // Split the file bar by the share of each selection group
+        const sourceBlock &src = sourceBlocks.at(i);
+        int left = src.block.left();
+        for(int l=0; l<src.groupVals.size(); l++)
+        {
+            if(src.groupVals.at(l) <= 0 || src.val <= 0)
+                continue;
+
+            int w = qRound(src.groupVals.at(l)/src.val*src.block.width());
+            QColor col = (l == 0) ? QColor(Qt::lightGray) : groupColor(l).lighter(160);
+            painter->fillRect(QRect(left,src.block.top(),w,src.block.height()),col);
+            left += w;
+        }
 
         int numLines = std::min(numVisibleLineBlocks,sourceBlocks[i].lineBlocks.size());
         int lineHeight = blockHeight / numLines;
@@ -213,6 +333,10 @@ void CodeViz::drawQtPainter(QPainter *painter)
             painter->drawText(QPoint(sourceBlocks[i].block.right(),sourceBlocks[i].lineBlocks[j].block.top())
                               +QPoint(-40,16),
                               QString::number(sourceBlocks[i].lineBlocks[j].line));
+            if(sourceBlocks[i].lineBlocks[j].pattern != PATTERN_UNKNOWN)
+                painter->drawText(QPoint(sourceBlocks[i].block.right(),sourceBlocks[i].lineBlocks[j].block.top())
+                                  +QPoint(-120,16),
+                                  patternName(sourceBlocks[i].lineBlocks[j].pattern));
         }
 
         painter->setPen(Qt::black);
@@ -267,3 +391,18 @@ void CodeViz::closeAll()
         sourceBlocks[i].file->close();
     }
 }
+
+void CodeViz::openFiles()
+{
+    sourceMaxVal = 0;
+    for(int i=0; i<sourceBlocks.size(); i++)
+    {
+        if(sourceBlocks[i].file == NULL)
+        {
+            QString srcFile = sourceDir+"/"+sourceBlocks[i].name;
+            sourceBlocks[i].file = new QFile(srcFile);
+            sourceBlocks[i].file->open(QIODevice::ReadOnly | QIODevice::Text);
+        }
+        sourceMaxVal = std::max(sourceMaxVal,sourceBlocks[i].val);
+    }
+}
@@ -41,11 +41,19 @@
 
 #include "vizwidget.h"
 
+#include <QHash>
+
 struct lineBlock
 {
     int line;
     qreal val;
     QRect block;
+
+    // Latency per access pattern, the line is labeled with the largest
+    qreal patternVals[3];
+    int pattern;
+
+    qint64 samples;     // counted with their weight
 };
 
 struct sourceBlock
@@ -55,8 +63,13 @@ struct sourceBlock
     qreal val;
     QRect block;
 
+    // Latency per selection group, 0 is unselected
+    QVector<qreal> groupVals;
+
     qreal lineMaxVal;
     QVector<lineBlock> lineBlocks;
+
+    qint64 samples;     // counted with their weight
 };
 
 class CodeViz : public VizWidget
@@ -73,7 +86,7 @@ signals:
 protected:
     void processData();
     void selectionChangedSlot();
-    //void visibilityChangedSlot();
+    void visibilityChangedSlot();
     void drawQtPainter(QPainter *painter);
 
     void mouseReleaseEvent(QMouseEvent *e);
@@ -82,9 +95,8 @@ public slots:
     void setSourceDir(QString dir);
 
 private:
-    int getFileID(QString name);
-    int getLineID(sourceBlock *src, int line);
     void closeAll();
+    void openFiles();
 
 private:
     int margin;
@@ -97,6 +109,13 @@ private:
 
     qreal sourceMaxVal;
     QVector<sourceBlock> sourceBlocks;
+
+    // Blocks by file name and line and the visibility they were aggregated
+    // from, for applying visibility deltas
+    QHash<QString,int> fileIds;
+    QVector<QHash<int,int> > lineIds;
+    quint64 visVersion;
+    bool pending;
 };
 
 #endif // CODEVIZ_H
@@ -0,0 +1,158 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "computepool.h"
+
+ComputePool::ComputePool(QObject *parent) :
+    QObject(parent)
+{
+    nextId = 0;
+    selectionVersion = 0;
+    visibilityVersion = 0;
+    selectionState = 0;
+}
+
+ComputePool::~ComputePool()
+{
+    cancelAll();
+}
+
+quint64 ComputePool::versionOf(int inputs) const
+{
+    quint64 v = 0;
+    if(inputs & COMPUTE_SELECTION)
+        v += selectionVersion;
+    if(inputs & COMPUTE_VISIBILITY)
+        v += visibilityVersion;
+    return v;
+}
+
+bool ComputePool::isCurrent(quint64 id, int inputs, quint64 version) const
+{
+    if(versionOf(inputs) != version)
+        return false;
+
+    for(int i=0; i<tasks.size(); i++)
+        if(tasks.at(i).id == id)
+            return tasks.at(i).cancel->load() == 0;
+
+    return false;
+}
+
+void ComputePool::finished(quint64 id)
+{
+    for(int i=0; i<tasks.size(); i++)
+    {
+        if(tasks.at(i).id == id)
+        {
+            tasks.removeAt(i);
+            return;
+        }
+    }
+}
+
+void ComputePool::invalidate(int inputs)
+{
+    if(inputs & COMPUTE_SELECTION)
+    {
+        selectionVersion++;
+        selectionState = 0;
+    }
+    if(inputs & COMPUTE_VISIBILITY)
+    {
+        // Cached results were computed with the old visibility
+        visibilityVersion++;
+        results.clear();
+    }
+
+    // Tasks read the data set directly, none may run while it changes
+    for(int i=0; i<tasks.size(); i++)
+        if(tasks.at(i).inputs & inputs)
+            tasks[i].cancel->store(1);
+
+    for(int i=0; i<tasks.size(); i++)
+        if(tasks.at(i).inputs & inputs)
+            tasks[i].future.waitForFinished();
+}
+
+QSharedPointer<ComputePool::CachedValue> ComputePool::cached(const QString &key, quint64 state)
+{
+    for(int i=0; i<results.size(); i++)
+    {
+        if(results.at(i).key == key && results.at(i).state == state)
+        {
+            results.move(i,0);
+            return results.first().value;
+        }
+    }
+    return QSharedPointer<CachedValue>();
+}
+
+void ComputePool::store(const QString &key, quint64 state, QSharedPointer<CachedValue> value)
+{
+    CachedResult r;
+    r.key = key;
+    r.state = state;
+    r.value = value;
+    results.push_front(r);
+
+    while(results.size() > COMPUTE_CACHE_SIZE)
+        results.removeLast();
+}
+
+void ComputePool::cancelAll()
+{
+    invalidate(COMPUTE_SELECTION | COMPUTE_VISIBILITY);
+}
+
+void ComputePool::cancel(QObject *context)
+{
+    for(int i=0; i<tasks.size(); i++)
+        if(tasks.at(i).context == context)
+            tasks[i].cancel->store(1);
+
+    // Their watchers go with the context, so finished() never comes
+    for(int i=tasks.size()-1; i>=0; i--)
+    {
+        if(tasks.at(i).context == context)
+        {
+            tasks[i].future.waitForFinished();
+            tasks.removeAt(i);
+        }
+    }
+}
@@ -0,0 +1,213 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef COMPUTEPOOL_H
+#define COMPUTEPOOL_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QList>
+
+#include <functional>
+
+// Inputs a compute task reads from the data set
+#define COMPUTE_SELECTION 0x1
+#define COMPUTE_VISIBILITY 0x2
+
+// Results kept for revisited selection states
+#define COMPUTE_CACHE_SIZE 64
+
+// Handed to a running task, long loops poll cancelled() and return early
+class ComputeToken
+{
+public:
+    ComputeToken() {}
+    explicit ComputeToken(QSharedPointer<QAtomicInt> f) : flag(f) {}
+
+    bool cancelled() const { return flag && flag->load() != 0; }
+
+private:
+    QSharedPointer<QAtomicInt> flag;
+};
+
+// Runs view computations off the GUI thread. Every task is tagged with the
+// versions of the inputs it reads; the data set invalidates inputs before
+// modifying them, which cancels the tasks reading them and waits until they
+// have returned. Results are delivered on the GUI thread through a queued
+// signal and dropped if they are stale, so views only swap in finished data.
+//
+// Results of tasks reading only the selection are also kept per selection
+// state, so going back to a state through undo/redo reuses them without
+// running the task again.
+class ComputePool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ComputePool(QObject *parent = 0);
+    ~ComputePool();
+
+    // Called on the GUI thread before the given inputs are modified
+    void invalidate(int inputs);
+
+    // Run work(token) in the pool and call done(result) in context's thread.
+    // A newer task with the same key replaces the older one.
+    template<typename T>
+    void submit(const QString &key, int inputs, QObject *context,
+                const std::function<T(const ComputeToken&)> &work,
+                const std::function<void(const T&)> &done);
+
+    void cancelAll();
+
+    // Cancel the tasks delivering to context and wait until they have
+    // returned, called before the context is destroyed
+    void cancel(QObject *context);
+
+    // Id of the selection the data set currently holds, 0 if it has no id
+    // yet. Set after invalidate(COMPUTE_SELECTION), which resets it.
+    void setSelectionState(quint64 state) { selectionState = state; }
+
+private:
+    struct Task
+    {
+        quint64 id;
+        QString key;
+        int inputs;
+        QObject *context;
+        QSharedPointer<QAtomicInt> cancel;
+        QFuture<void> future;
+    };
+
+    struct CachedValue
+    {
+        virtual ~CachedValue() {}
+    };
+
+    template<typename T>
+    struct CachedValueOf : public CachedValue
+    {
+        CachedValueOf(const T &v) : value(v) {}
+        T value;
+    };
+
+    struct CachedResult
+    {
+        QString key;
+        quint64 state;
+        QSharedPointer<CachedValue> value;
+    };
+
+    quint64 versionOf(int inputs) const;
+    bool isCurrent(quint64 id, int inputs, quint64 version) const;
+    void finished(quint64 id);
+
+    QSharedPointer<CachedValue> cached(const QString &key, quint64 state);
+    void store(const QString &key, quint64 state, QSharedPointer<CachedValue> value);
+
+private:
+    QThreadPool pool;
+    QList<Task> tasks;
+
+    quint64 nextId;
+    quint64 selectionVersion;
+    quint64 visibilityVersion;
+
+    // Most recently used first
+    quint64 selectionState;
+    QList<CachedResult> results;
+};
+
+template<typename T>
+void ComputePool::submit(const QString &key, int inputs, QObject *context,
+                         const std::function<T(const ComputeToken&)> &work,
+                         const std::function<void(const T&)> &done)
+{
+    for(int i=0; i<tasks.size(); i++)
+        if(tasks.at(i).key == key)
+            tasks[i].cancel->store(1);
+
+    // Only results of the selection alone are reused, the state does not
+    // cover the visibility
+    quint64 state = (inputs == COMPUTE_SELECTION) ? selectionState : 0;
+    if(state)
+    {
+        QSharedPointer<CachedValue> hit = cached(key,state);
+        CachedValueOf<T> *v = dynamic_cast<CachedValueOf<T>*>(hit.data());
+        if(v)
+        {
+            done(v->value);
+            return;
+        }
+    }
+
+    Task t;
+    t.id = nextId++;
+    t.key = key;
+    t.inputs = inputs;
+    t.context = context;
+    t.cancel = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+
+    ComputeToken token(t.cancel);
+    QFuture<T> future = QtConcurrent::run(&pool,[work,token]() { return work(token); });
+    t.future = QFuture<void>(future);
+    tasks.push_back(t);
+
+    quint64 id = t.id;
+    quint64 version = versionOf(inputs);
+
+    // The watcher lives in the context's thread, finished() arrives queued
+    QFutureWatcher<T> *watcher = new QFutureWatcher<T>(context);
+    connect(watcher,&QFutureWatcherBase::finished,context,[this,watcher,id,key,inputs,version,state,done]()
+    {
+        if(isCurrent(id,inputs,version))
+        {
+            if(state)
+                store(key,state,QSharedPointer<CachedValue>(new CachedValueOf<T>(watcher->result())));
+            done(watcher->result());
+        }
+        finished(id);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(future);
+}
+
+#endif // COMPUTEPOOL_H
@@ -44,35 +44,11 @@
 #include <QScrollBar>
 
 #include "dataobject.h"
+#include "scriptengine.h"
 #include "util.h"
 
 class DataObject;
 
-enum CMD_TYPE {
-    CMD_HELP = 0,
-    CMD_SELECT,
-    CMD_INSPECT,
-    CMD_UNKNOWN
-};
-
-enum QUERY_TYPE {
-    QUERY_DIMRANGE = 0,
-    QUERY_RESOURCE,
-    QUERY_UNKNOWN
-};
-
-struct dimRangeQuery {
-    QVector<QString> dims;
-    QVector<qreal> mins;
-    QVector<qreal> maxes;
-};
-
-struct dimRange {
-    QString dim;
-    qreal min;
-    qreal max;
-};
-
 class console : public QTextBrowser
 {
     Q_OBJECT
@@ -85,25 +61,17 @@ public:
 
 signals:
     void selectionChangedSig();
+    void visibilityChangedSig();
+    void axesChangedSig();
 
 public slots:
-    CMD_TYPE getCommandType(QString cmd);
-    QUERY_TYPE getQueryType(QString qtype);
-
-    struct dimRange createDimRange(QString str);
-    struct dimRangeQuery createDimRangeQuery(QStringList *args);
-
-    void helpCommand(QStringList *args);
-    void inspectCommand(QStringList *args);
-    void selectCommand(QStringList *args);
-
     void command(int i);
     void log(const char *msg);
     void log(QString msg);
 
 private:
     QPlainTextEdit *console_input;
-    DataObject *dataSet;
+    ScriptEngine *engine;
     QScrollBar *sb;
 };
 
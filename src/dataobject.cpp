@@ -38,25 +38,53 @@
 
 #include "dataobject.h"
 #include "parseUtil.h"
+#include "parallel.h"
+#include "derivedexpr.h"
+#include "dedup.h"
 
 #include <iostream>
 #include <algorithm>
 #include <functional>
+#include <random>
+#include <cstring>
 
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
 #include <QTextStream>
+#include <QSet>
 
 DataObject::DataObject()
 {
     // numDimensions = 0;
     numElements = 0;
     numSelected = 0;
+    selectedWeight = 0;
     numVisible = 0;
+    visibleWeight = 0;
+    totalWeight = 0;
+    lastShown = 0;
+    lastHidden = 0;
+    lastShownWeight = 0;
+    lastHiddenWeight = 0;
+    visVersion = 0;
 
     node = NULL;
+    cpu = NULL;
+    con = NULL;
+    pool = NULL;
+
+    selectionSetsDirty = false;
+    selectionUnrecorded = false;
+    postingsBuilt = false;
+    columns.resize(NUM_SAMPLE_AXES);
+    sortedIndices.resize(NUM_SAMPLE_AXES);
 
     selMode = MODE_NEW;
     selGroup = 1;
+    mergeDuplicates = false;
+    groupSizes.fill(0,MAX_SELECTION_GROUPS+1);
+    groupWeights.fill(0,MAX_SELECTION_GROUPS+1);
 }
 
 int DataObject::loadHardwareTopology(QString filename)
@@ -81,10 +109,30 @@ int DataObject::loadHardwareTopology(QString filename)
 
 int DataObject::loadData(QString filename)
 {
+    invalidate(COMPUTE_SELECTION | COMPUTE_VISIBILITY);
+
     int err = parseCSVFile(filename);
     if(err)
         return err;
 
+    // Samples the collector could not place are resolved from the binary
+    QString binary = QFileInfo(filename).dir().filePath(SYMBOL_BINARY);
+    SymbolIndex symbols;
+    if(QFile::exists(binary) && symbols.load(binary) == 0)
+        resolveSymbols(symbols);
+
+    // Heap samples are named by their allocation when a log comes with them
+    QString allocFile = QFileInfo(filename).dir().filePath(ALLOCATION_LOG);
+    AllocationIndex allocs;
+    if(QFile::exists(allocFile) && allocs.load(allocFile) == 0)
+    {
+        if(allocs.skippedRows() > 0)
+            std::cerr << "WARNING: skipped " << allocs.skippedRows()
+                      << " malformed rows of " << ALLOCATION_LOG << std::endl;
+        attributeAllocations(allocs);
+    }
+
+    recomputeDerivedAxes();
     calcStatistics();
     // constructSortedLists();
 
@@ -94,31 +142,95 @@ int DataObject::loadData(QString filename)
 void DataObject::allocate()
 {
     numElements = samples.size();
+    totalWeight = 0;
+    for(ElemIndex e=0; e<numElements; e++)
+        totalWeight += samples.at(e).weight;
     // numDimensions = meta.size();
     // numElements = vals.size() / numDimensions;
     //
     // begin = vals.begin();
     // end = vals.end();
 
-    // visibility.resize(numElements);
-    // visibility.fill(VISIBLE);
+    visibility = Bitmap(numElements,VISIBLE);
+    visibilityChange = Bitmap(numElements);
+    numVisible = numElements;
+    visibleWeight = totalWeight;
+    lastShown = numElements;
+    lastHidden = 0;
+    lastShownWeight = totalWeight;
+    lastHiddenWeight = 0;
+    visVersion++;
 
     selectionGroup.resize(numElements);
     selectionGroup.fill(0); // all belong to 0 (unselected)
 
-    selectionSets.push_back(ElemSet());
-    selectionSets.push_back(ElemSet());
+    groupSizes.fill(0);
+    groupWeights.fill(0);
+    numSelected = 0;
+    selectedWeight = 0;
+    selectionSets.assign(MAX_SELECTION_GROUPS+1,ElemSet());
+
+    history.reset(numElements);
+    selectionUnrecorded = false;
+    publishSelectionState();
+
+    // Query structures describe the previous data
+    columns.fill(QVector<qint64>(),numAxes());
+    sortedIndices.fill(QVector<ElemIndex>(),numAxes());
+    sourcePosts.clear();
+    variablePosts.clear();
+    postingsBuilt = false;
+
+    clusterTree = Dendrogram();
+    clusterLeaf.clear();
+
+    calcProgressiveOrder();
 }
 
-int DataObject::selected(ElemIndex index)
+void DataObject::calcProgressiveOrder()
 {
-    return selectionGroup.at((int)index);
+    ElemIndex n = numElements;
+    progressiveOrder.resize(n);
+    if(n == 0)
+        return;
+
+    ElemIndex numStrata = std::min((ElemIndex)PROGRESSIVE_STRATA,n);
+
+    // Shuffle within each stratum (fixed seeds, so the order is reproducible)
+    QVector<ElemIndex> shuffled(n);
+    ElemIndex *sh = shuffled.data();
+    parallelFor(numStrata,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 s=begin; s<end; s++)
+        {
+            ElemIndex first = s*n/numStrata;
+            ElemIndex last = (s+1)*n/numStrata;
+            for(ElemIndex i=first; i<last; i++)
+                sh[i] = i;
+
+            std::mt19937 rng(s);
+            std::shuffle(sh+first,sh+last,rng);
+        }
+    }, 256);
+
+    // Interleave, round r takes the r-th sample of every stratum
+    ElemIndex maxStratumSize = (n+numStrata-1)/numStrata;
+    ElemIndex pos = 0;
+    for(ElemIndex r=0; r<maxStratumSize; r++)
+    {
+        for(ElemIndex s=0; s<numStrata; s++)
+        {
+            ElemIndex first = s*n/numStrata;
+            ElemIndex last = (s+1)*n/numStrata;
+            if(first+r < last)
+                progressiveOrder[pos++] = sh[first+r];
+        }
+    }
 }
 
-bool DataObject::visible(ElemIndex index)
+int DataObject::selected(ElemIndex index)
 {
-    return samples[(int)index].visible;
-    // return visibility.at((int)index);
+    return selectionGroup.at((int)index);
 }
 
 bool DataObject::selectionDefined()
@@ -128,89 +240,334 @@ bool DataObject::selectionDefined()
 
 void DataObject::selectData(ElemIndex index, int group)
 {
-    if(visible(index))
+    group = groupOf(group);
+
+    if(selectionSetsDirty)
+        syncSelectionSets();
+
+    int old = selectionGroup.at(index);
+    if(!visible(index) || old == group)
+        return;
+
+    // A sample belongs to one group at a time
+    quint32 weight = samples.at(index).weight;
+    if(old)
+    {
+        selectionSets.at(old).erase(index);
+        groupSizes[old]--;
+        groupWeights[old] -= weight;
+    }
+    else
     {
-        selectionGroup[index] = group;
-        selectionSets.at(group).insert(index);
         numSelected++;
+        selectedWeight += weight;
     }
+
+    selectionGroup[index] = group;
+    selectionSets.at(group).insert(index);
+    groupSizes[group]++;
+    groupWeights[group] += weight;
 }
 
-void DataObject::selectAll(int group)
+void DataObject::setActiveGroup(int group)
 {
-    selectionGroup.fill(group);
+    selGroup = std::max(1,std::min(group,MAX_SELECTION_GROUPS));
+}
 
-    for(ElemIndex i=0; i<numElements; i++)
+int DataObject::maxGroup() const
+{
+    for(int g=MAX_SELECTION_GROUPS; g>0; g--)
+        if(groupSizes.at(g))
+            return g;
+    return 0;
+}
+
+void DataObject::countGroups()
+{
+    // Byte histograms of the group column by rows and by weight, one per
+    // chunk
+    int numChunks = parallelChunkCount(numElements,65536);
+    QVector<QVector<ElemIndex> > counts(numChunks), weights(numChunks);
+    const quint8 *g = selectionGroup.constData();
+    const Sample *s = samples.constData();
+
+    parallelTasks(numChunks,[&](int c)
     {
-        selectionSets.at(group).insert(i);
+        ElemIndex begin = numElements*c/numChunks;
+        ElemIndex end = numElements*(c+1)/numChunks;
+        QVector<ElemIndex> &count = counts[c];
+        QVector<ElemIndex> &weight = weights[c];
+        count.fill(0,MAX_SELECTION_GROUPS+1);
+        weight.fill(0,MAX_SELECTION_GROUPS+1);
+        for(ElemIndex elem=begin; elem<end; elem++)
+        {
+            count[g[elem]]++;
+            weight[g[elem]] += s[elem].weight;
+        }
+    });
+
+    groupSizes.fill(0);
+    groupWeights.fill(0);
+    for(int c=0; c<numChunks; c++)
+    {
+        for(int i=0; i<=MAX_SELECTION_GROUPS; i++)
+        {
+            groupSizes[i] += counts.at(c).at(i);
+            groupWeights[i] += weights.at(c).at(i);
+        }
     }
 
-    numSelected = numElements;
+    numSelected = numElements - groupSizes.at(0);
+    selectedWeight = totalWeight - groupWeights.at(0);
+}
+
+void DataObject::assignGroup(const Bitmap &m, int group, bool exclusive)
+{
+    // Samples in m move to the group, with exclusive the ones outside m
+    // leave it. The ordered sets are only rebuilt when someone asks.
+    quint8 *g = selectionGroup.data();
+    const quint64 *w = m.constData();
+    quint8 gid = group;
+    parallelFor(m.numWords(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+        {
+            ElemIndex first = i << 6;
+            int num = std::min((ElemIndex)64,numElements-first);
+            for(int b=0; b<num; b++)
+            {
+                if((w[i] >> b) & 1)
+                    g[first+b] = gid;
+                else if(exclusive && g[first+b] == gid)
+                    g[first+b] = 0;
+            }
+        }
+    }, 1024);
+
+    countGroups();
+    selectionSetsDirty = true;
+}
+
+void DataObject::deselectGroup(int group)
+{
+    group = groupOf(group);
+    invalidate(COMPUTE_SELECTION);
+    assignGroup(Bitmap(numElements),group,true);
+}
+
+void DataObject::invalidate(int inputs)
+{
+    if(pool)
+        pool->invalidate(inputs);
+
+    if(inputs & COMPUTE_SELECTION)
+        selectionUnrecorded = true;
+}
+
+void DataObject::publishSelectionState()
+{
+    if(pool)
+        pool->setSelectionState(history.state());
+}
+
+void DataObject::recordSelection()
+{
+    if(!selectionUnrecorded)
+        return;
+
+    history.record(selectionGroup);
+    selectionUnrecorded = false;
+    publishSelectionState();
+}
+
+bool DataObject::undoSelection()
+{
+    recordSelection();
+    if(!history.canUndo())
+        return false;
+
+    applySelectionDelta(history.undo());
+    return true;
+}
+
+bool DataObject::redoSelection()
+{
+    recordSelection();
+    if(!history.canRedo())
+        return false;
+
+    applySelectionDelta(history.redo());
+    return true;
+}
+
+void DataObject::applySelectionDelta(const SelectionDelta &d)
+{
+    invalidate(COMPUTE_SELECTION);
+
+    // Only the samples in the delta change, per chunk group size changes
+    // are merged afterwards
+    quint8 *g = selectionGroup.data();
+    qint64 size = numElements;
+    int numChunks = parallelChunkCount(d.words.size(),1024);
+    QVector<QVector<qint64> > changes(numChunks), weightChanges(numChunks);
+    const Sample *s = samples.constData();
+
+    parallelTasks(numChunks,[&](int c)
+    {
+        int begin = (qint64)d.words.size()*c/numChunks;
+        int end = (qint64)d.words.size()*(c+1)/numChunks;
+        QVector<qint64> &change = changes[c];
+        QVector<qint64> &weightChange = weightChanges[c];
+        change.fill(0,MAX_SELECTION_GROUPS+1);
+        weightChange.fill(0,MAX_SELECTION_GROUPS+1);
+
+        for(int i=begin; i<end; i++)
+        {
+            qint64 first = (qint64)d.words.at(i)*8;
+            quint8 x[8];
+            std::memcpy(x,&d.bits.at(i),8);
+            for(int k=0; k<8 && first+k<size; k++)
+            {
+                if(!x[k])
+                    continue;
+                quint8 &v = g[first+k];
+                quint32 w = s[first+k].weight;
+                change[v]--;
+                weightChange[v] -= w;
+                v ^= x[k];
+                change[v]++;
+                weightChange[v] += w;
+            }
+        }
+    });
+
+    for(int c=0; c<numChunks; c++)
+    {
+        for(int i=0; i<=MAX_SELECTION_GROUPS; i++)
+        {
+            groupSizes[i] += changes.at(c).at(i);
+            groupWeights[i] += weightChanges.at(c).at(i);
+        }
+    }
+
+    numSelected = numElements - groupSizes.at(0);
+    selectedWeight = totalWeight - groupWeights.at(0);
+    selectionSetsDirty = true;
+
+    selectionUnrecorded = false;
+    publishSelectionState();
+}
+
+void DataObject::selectAll(int group)
+{
+    group = groupOf(group);
+    invalidate(COMPUTE_SELECTION);
+
+    selectionGroup.fill(group);
+    countGroups();
+    selectionSetsDirty = true;
 }
 
 void DataObject::deselectAll()
 {
+    invalidate(COMPUTE_SELECTION);
+
     selectionGroup.fill(0);
 
     for(unsigned int i=0; i<selectionSets.size(); i++)
         selectionSets.at(i).clear();
+    selectionSetsDirty = false;
 
+    groupSizes.fill(0);
+    groupWeights.fill(0);
     numSelected = 0;
+    selectedWeight = 0;
 }
 
 void DataObject::selectAllVisible(int group)
 {
-    ElemIndex elem;
-    for(elem=0; elem<numElements; elem++)
-    {
-        if(visible(elem))
-            selectData(elem,group);
-    }
+    group = groupOf(group);
+    invalidate(COMPUTE_SELECTION);
+
+    assignGroup(visibilityMask(),group,false);
 }
 
-void DataObject::showData(unsigned int index)
+void DataObject::setVisibility(const Bitmap &next)
 {
-    if(!visible(index))
+    invalidate(COMPUTE_VISIBILITY);
+
+    // Word-wise diff against the current state, counts by popcount per chunk
+    // and weights over the flipped samples only
+    const quint64 *cur = visibility.constData();
+    const quint64 *nxt = next.constData();
+    quint64 *delta = visibilityChange.data();
+    const Sample *s = samples.constData();
+    int numWords = visibility.numWords();
+    int numChunks = parallelChunkCount(numWords,1024);
+    QVector<ElemIndex> shown(numChunks,0);
+    QVector<ElemIndex> hidden(numChunks,0);
+    QVector<ElemIndex> shownWeight(numChunks,0);
+    QVector<ElemIndex> hiddenWeight(numChunks,0);
+
+    parallelTasks(numChunks,[&](int c)
     {
-        samples[(int)index].visible = VISIBLE;
-        //visibility[index] = VISIBLE;
-        numVisible++;
-    }
-}
+        int begin = (qint64)numWords*c/numChunks;
+        int end = (qint64)numWords*(c+1)/numChunks;
+        for(int i=begin; i<end; i++)
+        {
+            quint64 d = cur[i] ^ nxt[i];
+            delta[i] = d;
+            shown[c] += qPopulationCount(d & nxt[i]);
+            hidden[c] += qPopulationCount(d & cur[i]);
+            while(d)
+            {
+                int b = qCountTrailingZeroBits(d);
+                d &= d-1;
+                ElemIndex w = s[(qint64)i*64+b].weight;
+                if(nxt[i] & ((quint64)1 << b))
+                    shownWeight[c] += w;
+                else
+                    hiddenWeight[c] += w;
+            }
+        }
+    });
 
-void DataObject::hideData(unsigned int index)
-{
-    if(visible(index))
+    lastShown = 0;
+    lastHidden = 0;
+    lastShownWeight = 0;
+    lastHiddenWeight = 0;
+    for(int c=0; c<numChunks; c++)
     {
-        samples[(int)index].visible = INVISIBLE;
-        //visibility[index] = INVISIBLE;
-        numVisible--;
+        lastShown += shown.at(c);
+        lastHidden += hidden.at(c);
+        lastShownWeight += shownWeight.at(c);
+        lastHiddenWeight += hiddenWeight.at(c);
     }
+
+    visibility = next;
+    numVisible = numVisible + lastShown - lastHidden;
+    visibleWeight = visibleWeight + lastShownWeight - lastHiddenWeight;
+    if(lastShown || lastHidden)
+        visVersion++;
 }
 
 void DataObject::showAll()
 {
-    for(Sample s: samples)
-        s.visible = VISIBLE;
-    // visibility.fill(VISIBLE);
-    numVisible = numElements;
+    setVisibility(Bitmap(numElements,VISIBLE));
 }
 
 void DataObject::hideAll()
 {
-    for(Sample s: samples)
-        s.visible = INVISIBLE;
-    // visibility.fill(INVISIBLE);
-    numVisible = 0;
+    setVisibility(Bitmap(numElements,INVISIBLE));
 }
 
 void DataObject::selectBySourceFileName(QString str, int group)
 {
     ElemSet selSet;
-    for(Sample s: samples)
+    for(ElemIndex elem=0; elem<numElements; elem++)
     {
-        if(s.source == str)
-            selSet.insert(s.sampleId);
+        if(samples.at(elem).source == str)
+            selSet.insert(selSet.end(),elem);
     }
     // ElemIndex elem;
     // QVector<qreal>::Iterator p;
@@ -237,10 +594,11 @@ void DataObject::selectBySourceFileName(QString str, int group)
 void DataObject::selectByLineRange(qreal vmin, qreal vmax, int group)
 {
     ElemSet selSet;
-    for(Sample sample : samples)
+    for(ElemIndex elem=0; elem<numElements; elem++)
     {
+        const Sample &sample = samples.at(elem);
         if(sample.line >= vmin && sample.line < vmax)
-            selSet.insert(sample.sampleId);
+            selSet.insert(selSet.end(),elem);
     }
     selectSet(selSet,group);
 }
@@ -287,56 +645,45 @@ void DataObject::selectByLineRange(qreal vmin, qreal vmax, int group)
 //     selectSet(selSet,group);
 // }
 
-void DataObject::selectByMultiDimRange(QVector<int> dims, QVector<qreal> mins, QVector<qreal> maxes, int group)
+ElemSet DataObject::queryByMultiDimRange(QVector<int> dims, QVector<qreal> mins, QVector<qreal> maxes)
 {
-    //TODO !!!
-    //TODO !!!
-    //TODO !!!
-    //TODO !!!
-    //TODO !!!
+    // Scan contiguous chunks in parallel, matches stay in index order so the
+    // set is built with end hints
+    int numChunks = parallelChunkCount(numElements,1);
+    QVector<QVector<ElemIndex> > chunkMatches(numChunks);
 
-    // ElemSet selSet;
-    // for(int d=0; d<dims.size(); d++)
-    // {
-    //     int dim = dims[d];
-    //     std::vector<indexedValue>::iterator itMin;
-    //     std::vector<indexedValue>::iterator itMax;
-    //
-    //     struct indexedValue ivMinQuery;
-    //     ivMinQuery.val = mins[d];
-    //
-    //     struct indexedValue ivMaxQuery;
-    //     ivMaxQuery.val = maxes[d];
-    //
-    //     if(ivMinQuery.val <= this->minimumValues[dim])
-    //     {
-    //         itMin = dimSortedLists.at(dim).begin();
-    //     }
-    //     else
-    //     {
-    //         itMin = std::find_if(dimSortedLists.at(dim).begin(),
-    //                              dimSortedLists.at(dim).end(),
-    //                              indexedValueLtFunctor(ivMinQuery));
-    //     }
-    //
-    //     if(ivMaxQuery.val >= this->maximumValues[dim])
-    //     {
-    //         itMax = dimSortedLists.at(dim).end();
-    //     }
-    //     else
-    //     {
-    //         itMax = std::find_if(dimSortedLists.at(dim).begin(),
-    //                              dimSortedLists.at(dim).end(),
-    //                              indexedValueLtFunctor(ivMaxQuery));
-    //     }
-    //
-    //     for(/*itMin*/; itMin != itMax; itMin++)
-    //     {
-    //         selSet.insert(itMin->idx);
-    //     }
-    // }
-    //
-    // selectSet(selSet,group);
+    parallelTasks(numChunks,[&](int c)
+    {
+        ElemIndex begin = numElements*c/numChunks;
+        ElemIndex end = numElements*(c+1)/numChunks;
+        QVector<ElemIndex> &matches = chunkMatches[c];
+
+        for(ElemIndex elem=begin; elem<end; elem++)
+        {
+            const Sample *s = &samples.at(elem);
+            bool match = true;
+            for(int d=0; d<dims.size() && match; d++)
+            {
+                long long val = GetSampleAttribByIndex(s, dims.at(d));
+                match = val >= mins.at(d) && val <= maxes.at(d);
+            }
+            if(match)
+                matches.push_back(elem);
+        }
+    });
+
+    ElemSet result;
+    for(int c=0; c<numChunks; c++)
+        for(ElemIndex elem : chunkMatches.at(c))
+            result.insert(result.end(),elem);
+
+    return result;
+}
+
+void DataObject::selectByMultiDimRange(QVector<int> dims, QVector<qreal> mins, QVector<qreal> maxes, int group)
+{
+    ElemSet selSet = queryByMultiDimRange(dims,mins,maxes);
+    selectSet(selSet,group);
 }
 
 void DataObject::selectByVarName(QString str, int group)
@@ -351,10 +698,10 @@ void DataObject::selectByVarName(QString str, int group)
     //         selSet.insert(elem);
     // }
 
-    for(Sample sample: samples)
+    for(ElemIndex elem=0; elem<numElements; elem++)
     {
-        if(sample.variable == str)
-            selSet.insert(sample.sampleId);
+        if(samples.at(elem).variable == str)
+            selSet.insert(selSet.end(),elem);
     }
     selectSet(selSet,group);
 }
@@ -372,78 +719,343 @@ void DataObject::selectByResource(Component *c, int group)
     //selectSet(node->sampleSets[this].totSamples,group);
 }
 
+void DataObject::showSet(ElemSet &s)
+{
+    Bitmap m(numElements);
+    for(ElemSet::iterator it = s.begin(); it != s.end(); it++)
+        m.set(*it);
+
+    showMask(m);
+}
+
+void DataObject::hideSet(ElemSet &s)
+{
+    Bitmap m(numElements);
+    for(ElemSet::iterator it = s.begin(); it != s.end(); it++)
+        m.set(*it);
+
+    hideMask(m);
+}
+
 void DataObject::hideSelected()
 {
-    ElemIndex elem;
-    for(elem=0; elem<numElements; elem++)
+    hideMask(selectionMask(ANY_GROUP));
+}
+
+void DataObject::hideUnselected()
+{
+    Bitmap next = visibility;
+    next &= selectionMask(ANY_GROUP);
+    setVisibility(next);
+}
+
+void DataObject::selectSet(ElemSet &s, int group)
+{
+    Bitmap m(numElements);
+    for(ElemSet::iterator it = s.begin(); it != s.end(); it++)
+        m.set(*it);
+
+    selectMask(m,group);
+}
+
+void DataObject::syncSelectionSets()
+{
+    if(!selectionSetsDirty)
+        return;
+
+    for(unsigned int i=0; i<selectionSets.size(); i++)
+        selectionSets.at(i).clear();
+
+    for(ElemIndex elem=0; elem<numElements; elem++)
     {
-        if(selected(elem))
-            hideData(elem);
+        int group = selectionGroup.at(elem);
+        if(group > 0)
+            selectionSets.at(group).insert(selectionSets.at(group).end(),elem);
     }
+
+    selectionSetsDirty = false;
 }
 
-void DataObject::hideUnselected()
+ElemSet& DataObject::getSelectionSet(int group)
 {
-    ElemIndex elem;
-    for(elem=0; elem<numElements; elem++)
+    syncSelectionSets();
+    return selectionSets.at(groupOf(group));
+}
+
+Bitmap DataObject::selectionMask(int group)
+{
+    group = groupOf(group);
+
+    Bitmap m(numElements);
+    quint64 *w = m.data();
+    const quint8 *g = selectionGroup.constData();
+
+    parallelFor(m.numWords(),[&](qint64 begin, qint64 end)
     {
-        if(!selected(elem) && visible(elem))
-            hideData(elem);
+        for(qint64 i=begin; i<end; i++)
+        {
+            ElemIndex first = i << 6;
+            int num = std::min((ElemIndex)64,numElements-first);
+            quint64 bits = 0;
+            if(group == ANY_GROUP)
+                for(int b=0; b<num; b++)
+                    bits |= (quint64)(g[first+b] != 0) << b;
+            else
+                for(int b=0; b<num; b++)
+                    bits |= (quint64)(g[first+b] == group) << b;
+            w[i] = bits;
+        }
+    }, 1024);
+
+    return m;
+}
+
+void DataObject::selectMask(const Bitmap &m, int group)
+{
+    group = groupOf(group);
+
+    Bitmap sel = m;
+    if(selMode == MODE_APPEND)
+        sel |= selectionMask(group);
+    else if(selMode == MODE_FILTER)
+        sel &= selectionMask(group);
+    sel &= visibilityMask();
+
+    invalidate(COMPUTE_SELECTION);
+
+    // The group is rebuilt from scratch, other groups only lose the
+    // samples that move into it
+    assignGroup(sel,group,true);
+}
+
+void DataObject::showMask(const Bitmap &m)
+{
+    Bitmap next = visibility;
+    next |= m;
+    setVisibility(next);
+}
+
+void DataObject::hideMask(const Bitmap &m)
+{
+    Bitmap next = visibility;
+    next.andNot(m);
+    setVisibility(next);
+}
+
+const QVector<qint64>& DataObject::column(int axis)
+{
+    QVector<qint64> &col = columns[axis];
+    if(col.size() == (int)numElements || axis >= NUM_SAMPLE_AXES)
+        return col;
+
+    col.resize(numElements);
+    qint64 *c = col.data();
+    const Sample *s = samples.constData();
+    parallelFor(numElements,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+            c[i] = GetSampleAttribByIndex(&s[i],axis);
+    });
+
+    return col;
+}
+
+const QVector<ElemIndex>& DataObject::sortedIndex(int axis)
+{
+    QVector<ElemIndex> &idx = sortedIndices[axis];
+    if(idx.size() == (int)numElements)
+        return idx;
+
+    const qint64 *c = column(axis).constData();
+    auto less = [c](ElemIndex a, ElemIndex b)
+        { return c[a] < c[b] || (c[a] == c[b] && a < b); };
+
+    idx.resize(numElements);
+    for(ElemIndex i=0; i<numElements; i++)
+        idx[i] = i;
+
+    // Sort chunks in parallel, then merge neighbours pairwise
+    int numChunks = std::max((ElemIndex)1,std::min(numElements,(ElemIndex)parallelWorkerCount()));
+    QVector<ElemIndex> bounds(numChunks+1);
+    for(int i=0; i<=numChunks; i++)
+        bounds[i] = numElements*i/numChunks;
+
+    ElemIndex *d = idx.data();
+    parallelTasks(numChunks,[&](int i)
+    {
+        std::sort(d+bounds.at(i),d+bounds.at(i+1),less);
+    });
+
+    for(int width=1; width<numChunks; width*=2)
+    {
+        int numMerges = (numChunks+2*width-1)/(2*width);
+        parallelTasks(numMerges,[&](int m)
+        {
+            int lo = m*2*width;
+            int mid = std::min(lo+width,numChunks);
+            int hi = std::min(lo+2*width,numChunks);
+            if(mid < hi)
+                std::inplace_merge(d+bounds.at(lo),d+bounds.at(mid),d+bounds.at(hi),less);
+        });
     }
+
+    return idx;
 }
 
-void DataObject::selectSet(ElemSet &s, int group)
+void DataObject::buildPostings()
 {
-    ElemSet *newSel = NULL;
-    if(selMode == MODE_NEW)
+    if(postingsBuilt)
+        return;
+
+    sourcePosts.clear();
+    variablePosts.clear();
+    for(ElemIndex elem=0; elem<numElements; elem++)
     {
-        newSel = &s;
+        const Sample &s = samples.at(elem);
+        sourcePosts[s.source].push_back(elem);
+        variablePosts[s.variable].push_back(elem);
     }
-    else if(selMode == MODE_APPEND)
+
+    postingsBuilt = true;
+}
+
+const QHash<QString,QVector<ElemIndex> >& DataObject::sourcePostings()
+{
+    buildPostings();
+    return sourcePosts;
+}
+
+const QHash<QString,QVector<ElemIndex> >& DataObject::variablePostings()
+{
+    buildPostings();
+    return variablePosts;
+}
+
+QString DataObject::axisName(int axis) const
+{
+    if(axis < NUM_SAMPLE_AXES)
+        return SampleAxes::SampleAxesNames.at(axis);
+    return derivedAxes.at(axis-NUM_SAMPLE_AXES).name;
+}
+
+int DataObject::axisIndex(QString name) const
+{
+    bool isNumber = false;
+    int idx = name.toInt(&isNumber);
+    if(isNumber)
+        return (idx >= 0 && idx < numAxes()) ? idx : -1;
+
+    for(int i=0; i<derivedAxes.size(); i++)
+        if(derivedAxes.at(i).name.compare(name,Qt::CaseInsensitive) == 0)
+            return NUM_SAMPLE_AXES+i;
+
+    return SampleAxes::axisIndex(name);
+}
+
+int DataObject::addDerivedAxis(QString name, QString expr, QString &error)
+{
+    if(name.isEmpty() || axisIndex(name) >= 0)
     {
-        newSel = new ElemSet();
-        std::set_union(selectionSets.at(group).begin(),
-                       selectionSets.at(group).end(),
-                       s.begin(),
-                       s.end(),
-                       std::inserter(*newSel,
-                                     newSel->begin()));
+        error = "Dimension "+name+" already exists";
+        return -1;
     }
-    else if(selMode == MODE_FILTER)
+
+    QSharedPointer<DerivedExpr> e(new DerivedExpr());
+    if(!e->compile(expr,this))
     {
-        newSel = new ElemSet();
-        std::set_intersection(selectionSets.at(group).begin(),
-                              selectionSets.at(group).end(),
-                              s.begin(),
-                              s.end(),
-                              std::inserter(*newSel,
-                                            newSel->begin()));
+        error = e->error();
+        return -1;
     }
-    else
+
+    // Background views read columns through GetSampleAttribByIndex
+    invalidate(COMPUTE_SELECTION | COMPUTE_VISIBILITY);
+
+    QVector<qint64> values;
+    e->evaluate(this,values);
+
+    DerivedAxis a;
+    a.name = name;
+    a.expr = e;
+    derivedAxes.push_back(a);
+    columns.push_back(values);
+    sortedIndices.push_back(QVector<ElemIndex>());
+
+    return numAxes()-1;
+}
+
+int DataObject::setColumnAxis(QString name, const QVector<qint64> &values)
+{
+    int axis = axisIndex(name);
+    if(axis >= 0 && (axis < NUM_SAMPLE_AXES || derivedAxes.at(axis-NUM_SAMPLE_AXES).expr))
+        return -1;
+
+    invalidate(COMPUTE_SELECTION | COMPUTE_VISIBILITY);
+
+    if(axis < 0)
     {
-        std::cerr << "MANATEES! EVERYWHERE!" << std::endl;
-        return;
+        DerivedAxis a;
+        a.name = name;
+        derivedAxes.push_back(a);
+        columns.push_back(values);
+        sortedIndices.push_back(QVector<ElemIndex>());
+        return numAxes()-1;
     }
 
-    // Reprocess groups
-    selectionSets.at(group).clear();
-    selectionGroup.fill(0);
+    columns[axis] = values;
+    sortedIndices[axis].clear();
+    return axis;
+}
 
-    for(ElemSet::iterator it = newSel->begin();
-        it != newSel->end();
-        it++)
+void DataObject::recomputeDerivedAxes()
+{
+    // Expressions only refer to earlier axes, evaluate in order. Fixed
+    // columns described the previous samples.
+    for(int i=0; i<derivedAxes.size(); i++)
     {
-        selectData(*it,group);
+        if(derivedAxes.at(i).expr)
+            derivedAxes.at(i).expr->evaluate(this,columns[NUM_SAMPLE_AXES+i]);
+        else
+            columns[NUM_SAMPLE_AXES+i].fill(-1,numElements);
     }
 }
 
+int SampleAxes::axisIndex(QString name)
+{
+    bool isNumber = false;
+    int idx = name.toInt(&isNumber);
+    if(isNumber)
+        return (idx >= 0 && idx < NUM_SAMPLE_AXES) ? idx : -1;
+
+    name = name.toLower();
+    for(int i=0; i<SampleAxesKeys.size(); i++)
+        if(SampleAxesKeys.at(i).toLower() == name)
+            return i;
+
+    name.replace('_',' ');
+    for(int i=0; i<SampleAxesNames.size(); i++)
+        if(SampleAxesNames.at(i).toLower() == name)
+            return i;
+
+    return -1;
+}
+
 void DataObject::collectTopoSamples()
 {
+    applyTopoSelection(computeTopoSelection(ComputeToken()));
+}
+
+TopoSelection DataObject::computeTopoSelection(const ComputeToken &token)
+{
+    TopoSelection sel;
+    if(cpu == NULL)
+        return sel;
+
+    int numGroups = maxGroup()+1;
+
     vector<Component*> allComponents;
     cpu->GetSubtreeNodeList(&allComponents);
     for(Component* c : allComponents)
     {
-        *(int*)c->attrib["transactions"] = 0;
         //count incoming DP on a thread (all DPs point to a thread)
         if(c->GetComponentType() == SYS_SAGE_COMPONENT_THREAD)
         {
@@ -456,21 +1068,66 @@ void DataObject::collectTopoSamples()
             }
             for(DataPath* dp_in : dp_in_vec)
             {
-                SampleSet *ss = (SampleSet*)dp_in->attrib["sample_set"];
-                ss->selSamples.clear();
-                ss->selCycles = 0;
+                if(token.cancelled())
+                    return sel;
 
+                SampleSet *ss = (SampleSet*)dp_in->attrib["sample_set"];
+                ElemSet selSamples;
+                int selCycles = 0;
+                int selWeight = 0;
+                QVector<int> groupWeights(numGroups,0);
+                QVector<int> groupCycles(numGroups,0);
+
+                // Combined selection and every group in the same pass,
+                // merged samples count as many as they stand for
                 for(ElemIndex elemid : ss->totSamples)
                 {
-                    if(!selectionDefined() || selected(elemid))
+                    int group = selectionGroup.at(elemid);
+                    const Sample &s = samples.at(elemid);
+                    int cycles = s.latency*s.weight;
+                    groupWeights[group] += s.weight;
+                    groupCycles[group] += cycles;
+
+                    if(!selectionDefined() || group)
                     {
-                        ss->selSamples.insert(elemid);
-                        ss->selCycles += samples[elemid].latency;
+                        selSamples.insert(selSamples.end(),elemid);
+                        selCycles += cycles;
+                        selWeight += s.weight;
                     }
                 }
+
+                sel.sets.push_back(ss);
+                sel.selSamples.push_back(selSamples);
+                sel.selCycles.push_back(selCycles);
+                sel.selWeights.push_back(selWeight);
+                sel.groupWeights.push_back(groupWeights);
+                sel.groupCycles.push_back(groupCycles);
             }
         }
     }
+
+    return sel;
+}
+
+void DataObject::applyTopoSelection(const TopoSelection &sel)
+{
+    for(int i=0; i<sel.sets.size(); i++)
+    {
+        sel.sets[i]->selSamples = sel.selSamples.at(i);
+        sel.sets[i]->selCycles = sel.selCycles.at(i);
+        sel.sets[i]->selWeight = sel.selWeights.at(i);
+        sel.sets[i]->groupWeights = sel.groupWeights.at(i);
+        sel.sets[i]->groupCycles = sel.groupCycles.at(i);
+    }
+
+    if(cpu == NULL)
+        return;
+
+    vector<Component*> allComponents;
+    cpu->GetSubtreeNodeList(&allComponents);
+    for(Component* c : allComponents)
+        *(int*)c->attrib["transactions"] = 0;
+
     for(Component* c : allComponents)
     {
         if(c->GetComponentType() == SYS_SAGE_COMPONENT_THREAD)
@@ -481,7 +1138,7 @@ void DataObject::collectTopoSamples()
                 //add the number of samples to this thread and then to all parent nodes until the source
                 Component* parent = c;
                 do {
-                    *(int*)parent->attrib["transactions"] += ((SampleSet*)dp_in->attrib["sample_set"])->selSamples.size();
+                    *(int*)parent->attrib["transactions"] += ((SampleSet*)dp_in->attrib["sample_set"])->selWeight;
                     parent = parent->GetParent();
                 } while(parent != dp_in->GetSource() && parent != NULL && parent->GetComponentType() != SYS_SAGE_COMPONENT_CHIP);
             }
@@ -596,6 +1253,123 @@ void DataObject::collectTopoSamples()
     // qDebug( "collectTopoSamples3");
 }
 
+qint64 DataObject::attributeAllocations(const AllocationIndex &allocs)
+{
+    // Lookups are independent, the renaming below is not
+    QVector<int> owners(numElements);
+    int *own = owners.data();
+    const Sample *s = samples.constData();
+    parallelFor(numElements,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 e=begin; e<end; e++)
+            own[e] = allocs.find((quint64)s[e].addr,s[e].time);
+    });
+
+    // Variable ids are handed out in order of appearance, as when parsing
+    qint64 attributed = 0;
+    QHash<QString,ElemIndex> ids;
+    for(ElemIndex e=0; e<numElements; e++)
+    {
+        Sample &smp = samples[e];
+        if(owners.at(e) >= 0)
+        {
+            const Allocation &a = allocs.at(owners.at(e));
+            smp.variable = allocs.labels().at(a.label);
+            smp.buffer_size = a.end-a.start;
+            attributed++;
+        }
+
+        QHash<QString,ElemIndex>::const_iterator id = ids.constFind(smp.variable);
+        if(id == ids.constEnd())
+            id = ids.insert(smp.variable,ids.size());
+        smp.variableUid = id.value();
+    }
+
+    return attributed;
+}
+
+qint64 DataObject::resolveSymbols(const SymbolIndex &symbols)
+{
+    const Sample *s = samples.constData();
+    int numChunks = parallelChunkCount(numElements,1 << 14);
+
+    // Distinct instruction pointers, so every one is looked up once
+    QVector<QSet<quint64> > chunkIps(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        ElemIndex begin = numElements*c/numChunks;
+        ElemIndex end = numElements*(c+1)/numChunks;
+        for(ElemIndex e=begin; e<end; e++)
+            chunkIps[c].insert((quint64)s[e].ip);
+    });
+
+    QSet<quint64> distinct;
+    for(int c=0; c<numChunks; c++)
+        distinct.unite(chunkIps.at(c));
+    chunkIps.clear();
+
+    QVector<quint64> ips;
+    ips.reserve(distinct.size());
+    for(QSet<quint64>::const_iterator it=distinct.constBegin(); it!=distinct.constEnd(); it++)
+        ips.push_back(*it);
+    QVector<SymbolInfo> infos(ips.size());
+    parallelFor(ips.size(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+            infos[i] = symbols.resolve(ips.at(i));
+    },256);
+
+    QHash<quint64,int> ipIndex;
+    ipIndex.reserve(ips.size());
+    for(int i=0; i<ips.size(); i++)
+        ipIndex.insert(ips.at(i),i);
+
+    // Code view matches sources by file name
+    QVector<QString> fileNames(symbols.numFiles());
+    for(int f=0; f<fileNames.size(); f++)
+        fileNames[f] = QFileInfo(symbols.file(f)).fileName();
+
+    Sample *out = samples.data();
+    QVector<qint64> placed(numChunks,0);
+    parallelTasks(numChunks,[&](int c)
+    {
+        ElemIndex begin = numElements*c/numChunks;
+        ElemIndex end = numElements*(c+1)/numChunks;
+        for(ElemIndex e=begin; e<end; e++)
+        {
+            Sample &smp = out[e];
+            const SymbolInfo &info = infos.at(ipIndex.value((quint64)smp.ip));
+            if(info.function >= 0)
+                smp.function = symbols.function(info.function);
+            if(info.file < 0 || (smp.line != 0 && smp.source != "??" && !smp.source.isEmpty()))
+                continue;
+
+            smp.source = fileNames.at(info.file);
+            smp.line = info.line;
+            placed[c]++;
+        }
+    });
+
+    qint64 total = 0;
+    for(int c=0; c<numChunks; c++)
+        total += placed.at(c);
+    if(total == 0)
+        return 0;
+
+    // Source ids are handed out in order of appearance, as when parsing
+    QHash<QString,ElemIndex> ids;
+    for(ElemIndex e=0; e<numElements; e++)
+    {
+        Sample &smp = samples[e];
+        QHash<QString,ElemIndex>::const_iterator id = ids.constFind(smp.source);
+        if(id == ids.constEnd())
+            id = ids.insert(smp.source,ids.size());
+        smp.sourceUid = id.value();
+    }
+
+    return total;
+}
+
 int DataObject::parseCSVFile(QString dataFileName)
 {
     // Open the file
@@ -630,14 +1404,22 @@ int DataObject::parseCSVFile(QString dataFileName)
     QVector<QString> varVec;
     QVector<QString> sourceVec;
     QVector<QString> instrVec;
-    QStringList header = line.split(',');
+    QStringList header = splitCSVLine(line);
     ElemIndex numHeaderDimensions = header.size();
+    int weightDim = header.indexOf("weight"); // optional, samples merged by the collector
 
     // Get data
     while(!dataStream.atEnd())
     {
+        // Quoted fields may span lines
+        bool complete = false;
         line = dataStream.readLine();
-        lineValues = line.split(',');
+        lineValues = splitCSVLine(line,&complete);
+        while(!complete && !dataStream.atEnd())
+        {
+            line += "\n"+dataStream.readLine();
+            lineValues = splitCSVLine(line,&complete);
+        }
 
         if(lineValues.size() != numHeaderDimensions)
         {
@@ -668,9 +1450,29 @@ int DataObject::parseCSVFile(QString dataFileName)
         s.addr = lineValues[header.indexOf("addr")].toLongLong();
         s.cpu = lineValues[header.indexOf("cpu")].toInt();
         s.latency = lineValues[header.indexOf("latency")].toLongLong();
-        s.data_src = dseDepth(lineValues[header.indexOf("data_src")].toInt(NULL,10));
-        s.visible = VISIBLE;
+        s.data_src_enc = lineValues[header.indexOf("data_src")].toInt(NULL,10);
+        s.data_src = dseDepth(s.data_src_enc);
+        s.dse_flags = dseFlags(s.data_src_enc);
+        s.weight = (weightDim < 0) ? 1 : std::max(1u,lineValues[weightDim].toUInt());
         samples.push_back(s);
+        elemid++;
+    }
+
+    dataFile.close();
+
+    // Merged before the topology keeps pointers to samples
+    if(mergeDuplicates)
+    {
+        qint64 merged = mergeDuplicateSamples(samples);
+        if(con != NULL && merged > 0)
+            con->append(QString("Merged %1 samples into %2 weighted ones")
+                        .arg(merged+samples.size()).arg(samples.size()));
+    }
+
+    // Without a topology the samples are loaded but not placed on it
+    for(elemid=0; node != NULL && elemid<samples.size(); elemid++)
+    {
+        const Sample &s = samples.at(elemid);
 
         //add samples as DataPath pointers
         Component * compTarget = node->FindSubcomponentById(s.cpu, SYS_SAGE_COMPONENT_THREAD);
@@ -717,19 +1519,21 @@ int DataObject::parseCSVFile(QString dataFileName)
                 SampleSet *ss = (SampleSet*)dp->attrib["sample_set"];
                 ss->totCycles = 0;
                 ss->selCycles = 0;
+                ss->totWeight = 0;
+                ss->selWeight = 0;
                 ss->totSamples.clear();
                 ss->selSamples.clear();
             }
             ((vector<Sample*>*)(dp->attrib["samples"]))->push_back(&(samples[elemid]));
             ((vector<Sample*>*)(dp->attrib["sel_samples"]))->push_back(&(samples[elemid]));
             SampleSet *ss = (SampleSet*)dp->attrib["sample_set"];
-            ss->totCycles += s.latency;
-            ss->selCycles += s.latency;
+            ss->totCycles += s.latency*s.weight;
+            ss->selCycles += s.latency*s.weight;
+            ss->totWeight += s.weight;
+            ss->selWeight += s.weight;
             ss->totSamples.insert(elemid);
             ss->selSamples.insert(elemid);
         }
-        elemid++;
-
 
 
         //
@@ -765,9 +1569,6 @@ int DataObject::parseCSVFile(QString dataFileName)
 
     }
 
-    // Close and return
-    dataFile.close();
-
     this->allocate();
 
     return 0;
@@ -777,7 +1578,7 @@ void DataObject::setSelectionMode(selection_mode mode, bool silent)
 {
     selMode = mode;
 
-    if(silent)
+    if(silent || con == NULL)
         return;
 
     QString selcmd("select MODE=");
@@ -796,7 +1597,7 @@ void DataObject::setSelectionMode(selection_mode mode, bool silent)
     con->log(selcmd);
 }
 
-long long DataObject::GetSampleAttribByIndex(Sample* s, int attrib_idx)
+long long DataObject::GetSampleAttribByIndex(const Sample* s, int attrib_idx)
 {
     switch((SampleAxes::SampleAxes)attrib_idx){
         case SampleAxes::sampleId://0
@@ -837,18 +1638,34 @@ long long DataObject::GetSampleAttribByIndex(Sample* s, int attrib_idx)
             return s->latency;
         case SampleAxes::dataSrc://18
             return s->data_src;
+        case SampleAxes::stlbMiss://19
+            return (s->dse_flags & DSE_FLAG_STLB) != 0;
+        case SampleAxes::locked://20
+            return (s->dse_flags & DSE_FLAG_LOCKED) != 0;
+        case SampleAxes::dirty://21
+            return (s->dse_flags & DSE_FLAG_DIRTY) != 0;
+        case SampleAxes::snoop://22
+            return (s->dse_flags & DSE_FLAG_SNOOP) != 0;
+        case SampleAxes::weight://23
+            return s->weight;
         default:
+        {
+            // Derived columns are indexed by the position of the sample,
+            // its id survives merging and is no index
+            qint64 elem = s - samples.constData();
+            if(attrib_idx >= NUM_SAMPLE_AXES && attrib_idx < columns.size() &&
+               elem >= 0 && elem < columns.at(attrib_idx).size())
+                return columns.at(attrib_idx).at(elem);
             return -999999999;
+        }
     }
 }
 
-long long DataObject::GetSampleAttribByIndex(int sampleId, int attrib_idx)
+long long DataObject::GetSampleAttribByIndex(int elem, int attrib_idx)
 {
-
-    if(sampleId >= samples.size())
+    if(elem < 0 || elem >= samples.size())
         return -999999999;
-    Sample s = samples[sampleId];
-    return GetSampleAttribByIndex(&s,attrib_idx);
+    return GetSampleAttribByIndex(&samples.at(elem),attrib_idx);
 }
 
 void DataObject::calcStatistics()
@@ -891,13 +1708,14 @@ void DataObject::calcStatistics()
         for(int i=0; i<NUM_SAMPLE_AXES; i++)
         {
             long long val = GetSampleAttribByIndex(&s, i);
-            sample_sums[i] += val;
+            sample_sums[i] += (qreal)val*s.weight;
             sample_mins[i] = std::min((qreal)val,sample_mins[i]);
             sample_maxes[i] = std::max((qreal)val,sample_maxes[i]);
         }
     }
 
-    int numSamples = samples.size();
+    // Merged samples count as many as they stand for
+    qreal numSamples = totalWeight;
     for(int i=0; i<NUM_SAMPLE_AXES; i++)
     {
         sample_means[i] = sample_sums[i]/numSamples;
@@ -908,7 +1726,7 @@ void DataObject::calcStatistics()
         for(int i=0; i<NUM_SAMPLE_AXES; i++)
         {
             long long val = GetSampleAttribByIndex(&s, i);
-            sample_stdevs[i] += (val-sample_means[i])*(val-sample_means[i]);
+            sample_stdevs[i] += s.weight*(val-sample_means[i])*(val-sample_means[i]);
         }
     }
 
@@ -1002,89 +1820,155 @@ void DataObject::calcStatistics()
 //     }
 // }
 
-qreal distanceHardware(DataObject *d, ElemSet *s1, ElemSet *s2)
+static inline void addToProfile(const Sample &s, float *profile)
 {
+    int level = (s.data_src >= 1 && s.data_src <= 4) ? s.data_src : 0;
+    profile[level] += (float)s.latency*s.weight;
+}
+
+void hardwareProfile(DataObject *d, const ElemSet *s, float *profile)
+{
+    std::fill(profile,profile+HW_PROFILE_DIMS,0.0f);
+    qint64 weight = 0;
+    for(ElemSet::const_iterator it = s->begin(); it != s->end(); it++)
+    {
+        addToProfile(d->samples.at(*it),profile);
+        weight += d->samples.at(*it).weight;
+    }
 
-    int cpuDepth = d->cpu->GetTopoTreeDepth();
-    int dseDepth;
+    for(int i=0; i<HW_PROFILE_DIMS && weight > 0; i++)
+        profile[i] /= weight;
+}
 
-    // Vars
-    std::vector<qreal> t1,t2;
-    std::vector<qreal> t1means,t2means;
-    std::vector<qreal> t1stddev,t2stddev;
+qreal distanceHardware(DataObject *d, ElemSet *s1, ElemSet *s2)
+{
+    // Euclidean distance of the latency profiles
+    float p1[HW_PROFILE_DIMS], p2[HW_PROFILE_DIMS];
+    hardwareProfile(d,s1,p1);
+    hardwareProfile(d,s2,p2);
 
-    t1.resize(cpuDepth,0);
-    t2.resize(cpuDepth,0);
-    t1means.resize(cpuDepth,0);
-    t1stddev.resize(cpuDepth,0);
-    t2means.resize(cpuDepth,0);
-    t2stddev.resize(cpuDepth,0);
+    qreal dist = 0;
+    for(int i=0; i<HW_PROFILE_DIMS; i++)
+        dist += (p1[i]-p2[i])*(p1[i]-p2[i]);
+    return sqrt(dist);
+}
 
-    qreal n1 = s1->size();
-    qreal n2 = s2->size();
+bool DataObject::cluster(distance_metric_fn_t dfn, int groupAxis)
+{
+    SampleClusters c = computeClusters(ComputeToken(),dfn,column(groupAxis),sortedIndex(groupAxis));
+    if(c.leaf.isEmpty())
+        return false;
 
-    ElemSet::iterator it;
-    qreal lat;
+    applyClusters(c);
+    return true;
+}
 
-    // Collect s1 topo data
-    for(it = s1->begin(); it != s1->end(); it++)
-    {
-        lat = d->samples[*it].latency;
-        dseDepth = d->samples[*it].data_src;
-        // lat = d->at(*it,d->latencyDim);
-        // dseDepth = d->at(*it,d->dataSourceDim);
-        t1[cpuDepth] += lat;
-        t1[dseDepth] += dseDepth;
-    }
+SampleClusters DataObject::computeClusters(const ComputeToken &token, distance_metric_fn_t dfn,
+                                           const QVector<qint64> &keys,
+                                           const QVector<ElemIndex> &order)
+{
+    SampleClusters c;
 
-    // Collect s2 topo data
-    for(it = s2->begin(); it != s2->end(); it++)
+    // Visible samples in value order, a new leaf at every new value
+    QVector<ElemIndex> members;
+    QVector<int> leafBegin;
+    QVector<int> leaf(numElements,-1);
+    members.reserve(numVisible);
+    for(ElemIndex i=0; i<numElements; i++)
     {
-        lat = d->samples[*it].latency;
-        dseDepth = d->samples[*it].data_src;
-        // lat = d->at(*it,d->latencyDim);
-        // dseDepth = d->at(*it,d->dataSourceDim);
-        t2[cpuDepth] += lat;
-        t2[dseDepth] += dseDepth;
+        ElemIndex e = order.at(i);
+        if(!visible(e))
+            continue;
+
+        if(members.isEmpty() || keys.at(e) != keys.at(members.last()))
+            leafBegin.push_back(members.size());
+        leaf[e] = leafBegin.size()-1;
+        members.push_back(e);
     }
 
-    // Compute means
-    for(int i=0; i<cpuDepth; i++)
-    {
-        t1means[i] = t1.at(i) / n1;
-        t2means[i] = t2.at(i) / n2;
-    }
+    int numLeaves = leafBegin.size();
+    leafBegin.push_back(members.size());
+    if(dfn != distanceHardware && numLeaves > CLUSTER_MAX_PAIRWISE)
+        return c;
 
-    // Compute standard deviations
-    for(it = s1->begin(); it != s1->end(); it++)
+    // Leaves are as large as the samples they stand for
+    QVector<qreal> sizes(numLeaves,0);
+    for(int l=0; l<numLeaves; l++)
+        for(int m=leafBegin.at(l); m<leafBegin.at(l+1); m++)
+            sizes[l] += samples.at(members.at(m)).weight;
+
+    if(dfn == distanceHardware)
     {
-        lat = d->samples[*it].latency;
-        dseDepth = d->samples[*it].data_src;
-        // lat = d->at(*it,d->latencyDim);
-        // dseDepth = d->at(*it,d->dataSourceDim);
-        t1stddev[dseDepth] += (lat-t1means.at(dseDepth))*(lat-t1means.at(dseDepth));
+        // Profiles once per leaf, Ward linkage then only needs vector loops
+        QVector<float> profiles(numLeaves*HW_PROFILE_DIMS,0.0f);
+        float *p = profiles.data();
+        parallelFor(numLeaves,[&](qint64 begin, qint64 end)
+        {
+            for(qint64 l=begin; l<end; l++)
+            {
+                float *profile = p + l*HW_PROFILE_DIMS;
+                for(int m=leafBegin.at(l); m<leafBegin.at(l+1); m++)
+                    addToProfile(samples.at(members.at(m)),profile);
+                for(int i=0; i<HW_PROFILE_DIMS; i++)
+                    profile[i] /= sizes.at(l);
+            }
+        });
+        c.tree = clusterFeatures(profiles,HW_PROFILE_DIMS,sizes,token);
     }
-    for(it = s2->begin(); it != s2->end(); it++)
+    else
     {
-        lat = d->samples[*it].latency;
-        dseDepth = d->samples[*it].data_src;
-        // lat = d->at(*it,d->latencyDim);
-        // dseDepth = d->at(*it,d->dataSourceDim);
-        t2stddev[dseDepth] += (lat-t2means.at(dseDepth))*(lat-t2means.at(dseDepth));
+        QVector<ElemSet> sets(numLeaves);
+        for(int l=0; l<numLeaves; l++)
+            sets[l].insert(members.constBegin()+leafBegin.at(l),
+                           members.constBegin()+leafBegin.at(l+1));
+
+        c.tree = clusterPairwise(sizes,[&](int a, int b)
+            { return dfn(this,&sets[a],&sets[b]); },token);
     }
-    for(int i=0; i<cpuDepth; i++)
+
+    if(!token.cancelled())
+        c.leaf = leaf;
+    return c;
+}
+
+void DataObject::applyClusters(const SampleClusters &c)
+{
+    clusterTree = c.tree;
+    clusterLeaf = c.leaf;
+}
+
+void DataObject::selectClusters(int k)
+{
+    if(clusterLeaf.size() != (int)numElements || clusterTree.numLeaves == 0)
+        return;
+
+    QVector<int> labels = clusterTree.cut(std::min(k,MAX_SELECTION_GROUPS));
+    invalidate(COMPUTE_SELECTION);
+
+    quint8 *g = selectionGroup.data();
+    const int *leaf = clusterLeaf.constData();
+    parallelFor(numElements,[&](qint64 begin, qint64 end)
     {
-        t1stddev[i] /= n1;
-        t2stddev[i] /= n2;
-    }
+        for(qint64 e=begin; e<end; e++)
+            g[e] = (leaf[e] >= 0 && visible(e)) ? labels.at(leaf[e])+1 : 0;
+    });
 
-    // Euclidean length of means vector
-    qreal dist = 0;
-    for(int i=0; i<cpuDepth; i++)
+    countGroups();
+    selectionSetsDirty = true;
+}
+
+void DataObject::selectLabels(const QVector<qint64> &labels)
+{
+    invalidate(COMPUTE_SELECTION);
+
+    quint8 *g = selectionGroup.data();
+    const qint64 *l = labels.constData();
+    parallelFor(numElements,[&](qint64 begin, qint64 end)
     {
-        dist += (t1means[i]+t2means[i])*(t1means[i]+t2means[i]);
-    }
-    dist = sqrt(dist);
+        for(qint64 e=begin; e<end; e++)
+            g[e] = (l[e] >= 0 && l[e] < MAX_SELECTION_GROUPS && visible(e)) ? l[e]+1 : 0;
+    });
 
-    return dist;
+    countGroups();
+    selectionSetsDirty = true;
 }
@@ -41,6 +41,8 @@
 
 #include <QWidget>
 #include <QBitArray>
+#include <QHash>
+#include <QSharedPointer>
 
 #include <map>
 #include <set>
@@ -52,17 +54,30 @@
 #include "hwtopo.h"
 #include "util.h"
 #include "console.h"
+#include "computepool.h"
+#include "bitmap.h"
+#include "selectionhistory.h"
+#include "clustering.h"
+#include "allocations.h"
+#include "symbolizer.h"
 
 #include "sys-sage.hpp"
 
 #define INVISIBLE false
 #define VISIBLE true
 #define SYS_SAGE_MITOS_SAMPLE 4096
-#define NUM_SAMPLE_AXES 19
+#define NUM_SAMPLE_AXES 24
+#define PROGRESSIVE_STRATA 100000
+
+// Selection groups 1..MAX_SELECTION_GROUPS, 0 is unselected
+#define MAX_SELECTION_GROUPS 255
+#define ACTIVE_GROUP -1
+#define ANY_GROUP -2
 
 // class hwTopo;
 // class hwNode;
 class console;
+class DerivedExpr;
 
 typedef unsigned long long ElemIndex;
 typedef std::set<ElemIndex> ElemSet;
@@ -76,6 +91,7 @@ public:
     long long line;
     ElemIndex instructionUid;
     QString instruction;
+    QString function;   // from the binary's symbols, empty without
     long long bytes;
     long long ip;
     ElemIndex variableUid;
@@ -92,13 +108,14 @@ public:
     int cpu;
     long long latency;
     int data_src;
-
-    bool visible;
+    int data_src_enc;   // raw PEBS data source
+    quint8 dse_flags;   // DSE_FLAG_* bits of data_src_enc
+    quint32 weight;     // samples merged into this one, latency is their mean
 };
 
 namespace SampleAxes
 {
-    enum SampleAxes{ //#define NUM_SAMPLE_AXES 19
+    enum SampleAxes{ //#define NUM_SAMPLE_AXES 24
         sampleId = 0,
         sourceUid = 1,
         line = 2,
@@ -117,7 +134,12 @@ namespace SampleAxes
         addr = 15,
         cpu = 16,
         latency = 17,
-        dataSrc = 18
+        dataSrc = 18,
+        stlbMiss = 19,
+        locked = 20,
+        dirty = 21,
+        snoop = 22,
+        weight = 23
     };
     const QStringList SampleAxesNames = {
         "sample ID", //0
@@ -138,8 +160,24 @@ namespace SampleAxes
         "data address", //15
         "CPU core", //16
         "load latency", //17
-        "data source" //18
+        "data source", //18
+        "STLB miss", //19
+        "locked", //20
+        "dirty", //21
+        "snoop", //22
+        "weight" //23
     };
+    // Short names accepted by queries next to the display names
+    const QStringList SampleAxesKeys = {
+        "sampleId", "sourceUid", "line", "instructionUid", "bytes", "ip",
+        "variableUid", "buffer_size", "dims", "xidx", "yidx", "zidx",
+        "pid", "tid", "time", "addr", "cpu", "latency", "dataSrc",
+        "stlbMiss", "locked", "dirty", "snoop", "weight"
+    };
+
+    // Axis from a number, a key or a display name with spaces written as
+    // '_', case insensitive. -1 if unknown.
+    int axisIndex(QString name);
 }
 
 
@@ -163,10 +201,42 @@ struct indexedValue
 
 typedef std::vector<indexedValue> IndexList;
 
+// Selected samples of every hardware thread sample set, computed off the GUI
+// thread and swapped into the topology afterwards
+struct TopoSelection
+{
+    QVector<SampleSet*> sets;
+    QVector<ElemSet> selSamples;
+    QVector<int> selCycles;
+    QVector<int> selWeights;
+    QVector<QVector<int> > groupWeights;
+    QVector<QVector<int> > groupCycles;
+};
+
+// Dendrogram of the visible samples and the leaf of every sample, -1 if
+// not clustered. No leaves at all if the clustering failed or was cancelled.
+struct SampleClusters
+{
+    Dendrogram tree;
+    QVector<int> leaf;
+};
+
+// User defined axis, appended after the sample axes
+struct DerivedAxis
+{
+    QString name;
+    QSharedPointer<DerivedExpr> expr;
+};
+
 // Distance Functions (for clustering)
 typedef qreal (*distance_metric_fn_t)(DataObject *d, ElemSet *s1, ElemSet *s2);
 qreal distanceHardware(DataObject *d, ElemSet *s1, ElemSet *s2);
 
+// Mean latency per sample spent at each memory level, unknown sources
+// first, then L1, L2, L3 and RAM
+#define HW_PROFILE_DIMS 5
+void hardwareProfile(DataObject *d, const ElemSet *s, float *profile);
+
 class DataObject
 {
 public:
@@ -179,14 +249,44 @@ public:
     int loadData(QString filename);
     int loadHardwareTopology(QString filename);
 
+    // Merge repeated samples into weighted ones when loading, see
+    // mergeDuplicateSamples()
+    void setMergeDuplicates(bool merge) { mergeDuplicates = merge; }
+    bool mergingDuplicates() const { return mergeDuplicates; }
+
+    // Names samples by the allocation live at their address and time, and
+    // returns how many were renamed
+    qint64 attributeAllocations(const AllocationIndex &allocs);
+
+    // Places samples the collector left without source (?? or line 0) by
+    // their ip, and returns how many were placed
+    qint64 resolveSymbols(const SymbolIndex &symbols);
+
     void selectionChanged() { collectTopoSamples(); }
     void visibilityChanged() { collectTopoSamples(); }
 
     void setConsole(console *c) { con = c; }
+    void setComputePool(ComputePool *p) { pool = p; }
+    ComputePool *computePool() const { return pool; }
+
+    // Topology sample collection split for background computation
+    TopoSelection computeTopoSelection(const ComputeToken &token);
+    void applyTopoSelection(const TopoSelection &sel);
 
 private:
     void allocate();
+    void calcProgressiveOrder();
     void collectTopoSamples();
+    void invalidate(int inputs);
+    int groupOf(int group) const { return (group == ACTIVE_GROUP) ? selGroup : group; }
+    void assignGroup(const Bitmap &m, int group, bool exclusive);
+    void countGroups();
+    void setVisibility(const Bitmap &next);
+    void applySelectionDelta(const SelectionDelta &d);
+    void publishSelectionState();
+    void recomputeDerivedAxes();
+    void syncSelectionSets();
+    void buildPostings();
     int parseCSVFile(QString dataFileName);
 
 public:
@@ -194,30 +294,89 @@ public:
     selection_mode selectionMode() { return selMode; }
     void setSelectionMode(selection_mode mode, bool silent = false);
     int selected(ElemIndex index);
-    bool visible(ElemIndex index);
+    const quint8 *groupColumn() const { return selectionGroup.constData(); }
+    bool visible(ElemIndex index) const { return visibility.test(index); }
     bool selectionDefined();
 
-    void selectData(ElemIndex index, int group = 1);
-    void selectAll(int group = 1);
+    void selectData(ElemIndex index, int group = ACTIVE_GROUP);
+    void selectAll(int group = ACTIVE_GROUP);
     void deselectAll();
-    void selectAllVisible(int group = 1);
+    void selectAllVisible(int group = ACTIVE_GROUP);
+
+    // Selections without an explicit group go to the active one
+    int activeGroup() const { return selGroup; }
+    void setActiveGroup(int group);
+    ElemIndex numSelectedIn(int group) const { return groupSizes.at(group); }
+    ElemIndex selectedWeightIn(int group) const { return groupWeights.at(group); }
+    int maxGroup() const;
+    void deselectGroup(int group);
 
-    void showData(unsigned int index);
-    void hideData(unsigned int index);
     void showAll();
     void hideAll();
     void hideSelected();
     void hideUnselected();
-
-    void selectSet(ElemSet &s, int group = 1);
+    void showSet(ElemSet &s);
+    void hideSet(ElemSet &s);
+
+    // Samples flipped by the last visibility change and how many of them
+    // were shown or hidden, as rows and by weight. The version only moves
+    // when something flipped.
+    const Bitmap &visibilityDelta() const { return visibilityChange; }
+    ElemIndex numShownLast() const { return lastShown; }
+    ElemIndex numHiddenLast() const { return lastHidden; }
+    ElemIndex weightShownLast() const { return lastShownWeight; }
+    ElemIndex weightHiddenLast() const { return lastHiddenWeight; }
+    quint64 visibilityVersion() const { return visVersion; }
+
+    void selectSet(ElemSet &s, int group = ACTIVE_GROUP);
     //void selectByDimRange(int dim, qreal vmin, qreal vmax, int group = 1);
-    void selectByLineRange(qreal vmin, qreal vmax, int group = 1);
-    void selectByMultiDimRange(QVector<int> dims, QVector<qreal> mins, QVector<qreal> maxes, int group = 1);
-    void selectBySourceFileName(QString str, int group = 1);
-    void selectByVarName(QString str, int group = 1);
-    void selectByResource(Component *c, int group = 1);
-
-    ElemSet& getSelectionSet(int group = 1) { return selectionSets.at(group); }
+    void selectByLineRange(qreal vmin, qreal vmax, int group = ACTIVE_GROUP);
+    void selectByMultiDimRange(QVector<int> dims, QVector<qreal> mins, QVector<qreal> maxes, int group = ACTIVE_GROUP);
+    ElemSet queryByMultiDimRange(QVector<int> dims, QVector<qreal> mins, QVector<qreal> maxes);
+    void selectBySourceFileName(QString str, int group = ACTIVE_GROUP);
+    void selectByVarName(QString str, int group = ACTIVE_GROUP);
+    void selectByResource(Component *c, int group = ACTIVE_GROUP);
+
+    ElemSet& getSelectionSet(int group = ACTIVE_GROUP);
+
+    // Selection history. A state is recorded once per published change,
+    // undo and redo restore it from the deltas between states.
+    void recordSelection();
+    bool undoSelection();
+    bool redoSelection();
+    bool canUndoSelection() const { return history.canUndo(); }
+    bool canRedoSelection() const { return history.canRedo(); }
+
+    // Selection and visibility as bitmaps over sample indices, ANY_GROUP
+    // covers every selected sample
+    Bitmap selectionMask(int group = ACTIVE_GROUP);
+    const Bitmap &visibilityMask() const { return visibility; }
+    void selectMask(const Bitmap &m, int group = ACTIVE_GROUP);
+    void showMask(const Bitmap &m);
+    void hideMask(const Bitmap &m);
+
+    // Query support, built on first use and kept until the next load
+    bool hasColumn(int axis) const { return !columns.at(axis).isEmpty(); }
+    bool hasSortedIndex(int axis) const { return !sortedIndices.at(axis).isEmpty(); }
+    bool hasPostings() const { return postingsBuilt; }
+    const QVector<qint64>& column(int axis);
+    const QVector<ElemIndex>& sortedIndex(int axis);
+    const QHash<QString,QVector<ElemIndex> >& sourcePostings();
+    const QHash<QString,QVector<ElemIndex> >& variablePostings();
+
+    // Axes, the sample axes followed by derived ones
+    int numAxes() const { return NUM_SAMPLE_AXES + derivedAxes.size(); }
+    QString axisName(int axis) const;
+    int axisIndex(QString name) const;
+
+    // Adds an axis computed from an expression over existing axes, see
+    // DerivedExpr. Returns the new axis, or -1 and sets error.
+    int addDerivedAxis(QString name, QString expr, QString &error);
+
+    // Adds an axis with fixed values, one per sample, or replaces the values
+    // of an earlier one with this name. Returns the axis, or -1 if the name
+    // belongs to another kind of axis.
+    int setColumnAxis(QString name, const QVector<qint64> &values);
 
     // Calculated statistics
     void calcStatistics();
@@ -234,8 +393,25 @@ public:
     // qreal correlationBtwn(int d1,int d2) const
     //     { return correlationMatrix[ROWMAJOR_2D(d1,d2,numDimensions)]; }
 
-    // Hierarchical clustering
-    void cluster(distance_metric_fn_t dfn);
+    // Hierarchical clustering of the visible samples grouped by their value
+    // on groupAxis, the leaves are the groups in increasing value order.
+    // False if dfn needs pairwise distances of too many groups.
+    bool cluster(distance_metric_fn_t dfn, int groupAxis);
+
+    // Clustering split for background computation, keys and order are the
+    // column and sorted index of the group axis
+    SampleClusters computeClusters(const ComputeToken &token, distance_metric_fn_t dfn,
+                                   const QVector<qint64> &keys,
+                                   const QVector<ElemIndex> &order);
+    void applyClusters(const SampleClusters &c);
+    const Dendrogram &clusterDendrogram() const { return clusterTree; }
+
+    // Selection groups 1..k from cutting the last dendrogram
+    void selectClusters(int k);
+
+    // Selection group label+1 for every visible sample with a label below
+    // MAX_SELECTION_GROUPS, the rest are deselected
+    void selectLabels(const QVector<qint64> &labels);
 
 public:
     Node *node;
@@ -244,8 +420,11 @@ public:
     // Counts
     //ElemIndex numDimensions;
     ElemIndex numElements;
-    ElemIndex numSelected;
+    ElemIndex numSelected;      // rows, selectedWeight counts merged samples
+    ElemIndex selectedWeight;
     ElemIndex numVisible;
+    ElemIndex visibleWeight;
+    ElemIndex totalWeight;  // samples in the capture, numElements unless merged
 
     // Hard-coded dimensions
     // int sourceDim;
@@ -267,13 +446,49 @@ public:
     // QVector<qreal>::Iterator end;
 
     QVector<Sample> samples;
-    long long GetSampleAttribByIndex(Sample* s, int attrib_idx);
-    long long GetSampleAttribByIndex(int sampleId, int attrib_idx);
+
+    // Stratified random order of all samples for progressive passes. Any
+    // prefix of k*PROGRESSIVE_STRATA entries holds k samples of every
+    // stratum (contiguous slice of the input). Only the PC view (lines and
+    // axis histograms) and the query sampler read it; the other views
+    // compute their aggregates in one pass on the compute pool.
+    QVector<ElemIndex> progressiveOrder;
+
+    // Derived axes are looked up by element index, so s must point into
+    // samples, not at a copy
+    long long GetSampleAttribByIndex(const Sample* s, int attrib_idx);
+    long long GetSampleAttribByIndex(int elem, int attrib_idx);
 
 private:
-    // QBitArray visibility; //TODO move to Sample struct?
-    QVector<int> selectionGroup;
+    Bitmap visibility;
+    Bitmap visibilityChange;
+    ElemIndex lastShown;
+    ElemIndex lastHidden;
+    ElemIndex lastShownWeight;
+    ElemIndex lastHiddenWeight;
+    quint64 visVersion;
+
+    QVector<quint8> selectionGroup;
+    QVector<ElemIndex> groupSizes;
+    QVector<ElemIndex> groupWeights;
     std::vector<ElemSet> selectionSets;
+    bool selectionSetsDirty;
+
+    SelectionHistory history;
+    bool selectionUnrecorded;
+
+    // Per-axis columns, value-sorted sample indices and name posting lists.
+    // Columns of derived axes are always filled.
+    QVector<QVector<qint64> > columns;
+    QVector<QVector<ElemIndex> > sortedIndices;
+    QHash<QString,QVector<ElemIndex> > sourcePosts;
+    QHash<QString,QVector<ElemIndex> > variablePosts;
+    bool postingsBuilt;
+
+    QVector<DerivedAxis> derivedAxes;
+
+    Dendrogram clusterTree;
+    QVector<int> clusterLeaf;   // leaf of every sample, -1 if not clustered
 
     QVector<qreal> sample_sums;
     QVector<qreal> sample_mins;
@@ -295,10 +510,12 @@ private:
 
 private:
     console *con;
+    ComputePool *pool;
     // QVector<DataObject*> dataObjects;
 
     int selGroup;
     selection_mode selMode;
+    bool mergeDuplicates;
 };
 
 #endif // DATAOBJECT_H
@@ -0,0 +1,187 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "dedup.h"
+#include "parallel.h"
+
+#include <QHash>
+
+#include <algorithm>
+#include <limits>
+
+// Keys are spread over 1 << PARTITION_BITS hash partitions
+#define PARTITION_BITS 6
+
+struct DedupKey
+{
+    long long ip;
+    long long line;
+    int cpu;
+    int dataSrc;
+    int latency;
+
+    bool operator==(const DedupKey &o) const
+    {
+        return ip == o.ip && line == o.line && cpu == o.cpu &&
+               dataSrc == o.dataSrc && latency == o.latency;
+    }
+};
+
+struct DedupAgg
+{
+    qint64 first;       // lowest sample index of the key
+    qint64 weight;
+    qreal latency;      // sum of latency*weight
+};
+
+typedef QHash<DedupKey,DedupAgg> DedupTable;
+
+static inline quint64 mix(const DedupKey &k)
+{
+    quint64 h = (quint64)k.ip * Q_UINT64_C(0x9E3779B97F4A7C15);
+    h = (h ^ (quint64)k.line) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+    h = (h ^ (((quint64)(quint32)k.cpu << 32) | (quint32)k.dataSrc)) * Q_UINT64_C(0x94D049BB133111EB);
+    h = (h ^ (quint32)k.latency) * Q_UINT64_C(0x9E3779B97F4A7C15);
+    return h ^ (h >> 31);
+}
+
+static inline uint qHash(const DedupKey &k, uint seed = 0)
+{
+    return (uint)mix(k) ^ seed;
+}
+
+int latencyBucket(long long latency)
+{
+    quint64 l = std::max(latency,0LL);
+    if(l < ((quint64)1 << DEDUP_LATENCY_BITS))
+        return (int)l;
+
+    // Leading bit and the DEDUP_LATENCY_BITS below it
+    int e = 63-qCountLeadingZeroBits(l);
+    int mantissa = (int)((l >> (e-DEDUP_LATENCY_BITS)) & ((1 << DEDUP_LATENCY_BITS)-1));
+    return ((e-DEDUP_LATENCY_BITS+1) << DEDUP_LATENCY_BITS) | mantissa;
+}
+
+qint64 mergeDuplicateSamples(QVector<Sample> &samples)
+{
+    const int numParts = 1 << PARTITION_BITS;
+    const Sample *s = samples.constData();
+    qint64 numSamples = samples.size();
+    int numChunks = parallelChunkCount(numSamples,1 << 14);
+
+    QVector<QVector<DedupTable> > tables(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        QVector<DedupTable> &parts = tables[c];
+        parts.resize(numParts);
+
+        qint64 begin = numSamples*c/numChunks;
+        qint64 end = numSamples*(c+1)/numChunks;
+        for(qint64 e=begin; e<end; e++)
+        {
+            const Sample &smp = s[e];
+            DedupKey k = {smp.ip, (long long)((quint64)smp.addr >> DEDUP_LINE_SHIFT),
+                          smp.cpu, smp.data_src_enc, latencyBucket(smp.latency)};
+
+            DedupTable &t = parts[hashPartition(mix(k),PARTITION_BITS)];
+            DedupTable::iterator it = t.find(k);
+            if(it == t.end())
+            {
+                DedupAgg zero = {e, 0, 0};
+                it = t.insert(k,zero);
+            }
+            it.value().weight += smp.weight;
+            it.value().latency += (qreal)smp.latency*smp.weight;
+        }
+    });
+
+    // Chunks are merged in sample order, so a key keeps its first sample
+    QVector<QVector<DedupAgg> > found(numParts);
+    parallelTasks(numParts,[&](int p)
+    {
+        DedupTable merged = tables.at(0).at(p);
+        for(int c=1; c<numChunks; c++)
+        {
+            const DedupTable &t = tables.at(c).at(p);
+            for(DedupTable::const_iterator it=t.constBegin(); it!=t.constEnd(); it++)
+            {
+                DedupTable::iterator m = merged.find(it.key());
+                if(m == merged.end())
+                {
+                    merged.insert(it.key(),it.value());
+                    continue;
+                }
+                m.value().weight += it.value().weight;
+                m.value().latency += it.value().latency;
+            }
+        }
+
+        found[p].reserve(merged.size());
+        for(DedupTable::const_iterator it=merged.constBegin(); it!=merged.constEnd(); it++)
+            found[p].push_back(it.value());
+    });
+    tables.clear();
+
+    QVector<DedupAgg> kept;
+    for(int p=0; p<numParts; p++)
+        kept += found.at(p);
+    found.clear();
+
+    if(kept.size() == numSamples)
+        return 0;
+
+    std::sort(kept.begin(),kept.end(),
+              [](const DedupAgg &a, const DedupAgg &b)
+              { return a.first < b.first; });
+
+    QVector<Sample> merged(kept.size());
+    Sample *out = merged.data();
+    parallelFor(kept.size(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+        {
+            const DedupAgg &a = kept.at(i);
+            out[i] = s[a.first];
+            out[i].weight = (quint32)std::min(a.weight,(qint64)std::numeric_limits<quint32>::max());
+            out[i].latency = qRound64(a.latency/a.weight);
+        }
+    },1024);
+
+    samples.swap(merged);
+    return numSamples-kept.size();
+}
@@ -0,0 +1,263 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "densityraster.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define RASTER_BLOCK 256
+
+DensityRaster::DensityRaster()
+{
+    w = 0;
+    h = 0;
+    setNumLayers(1);
+}
+
+void DensityRaster::resize(int iw, int ih)
+{
+    w = std::max(0,iw);
+    h = std::max(0,ih);
+
+    for(int l=0; l<density.size(); l++)
+        density[l].resize(w*h);
+}
+
+void DensityRaster::setNumLayers(int n)
+{
+    density.resize(n);
+    maxVals.resize(n);
+    maxVals.fill(0);
+
+    for(int l=0; l<density.size(); l++)
+        density[l].resize(w*h);
+}
+
+void DensityRaster::clearBundles()
+{
+    bundles.clear();
+}
+
+void DensityRaster::addBundle(qreal xa, qreal xb,
+                              const float *ya, const float *yb,
+                              const quint8 *layers, const float *weights,
+                              qint64 count)
+{
+    if(count <= 0)
+        return;
+
+    Bundle b = {(float)xa, (float)xb, ya, yb, layers, weights, count};
+    bundles.push_back(b);
+}
+
+void DensityRaster::clear()
+{
+    for(int l=0; l<density.size(); l++)
+        density[l].fill(0);
+
+    maxVals.fill(0);
+}
+
+void DensityRaster::rasterize(qint64 begin, qint64 end)
+{
+    if(w <= 0 || h <= 0 || begin >= end)
+        return;
+
+    QVector<float*> layerData(density.size());
+    for(int l=0; l<density.size(); l++)
+        layerData[l] = density[l].data();
+
+    // One task per strip of columns; strips never share a pixel, so no
+    // locking is needed while accumulating
+    int numStrips = parallelChunkCount(w,1);
+    int stripWidth = (w+numStrips-1)/numStrips;
+    numStrips = (w+stripWidth-1)/stripWidth;
+
+    float * const *data = layerData.constData();
+    parallelTasks(numStrips,[&](int s)
+    {
+        int sx0 = s*stripWidth;
+        int sx1 = std::min(w,sx0+stripWidth);
+
+        const int numLayers = density.size();
+        const float ymax = h-1;
+        const float xscale = w-1;
+
+        float y[RASTER_BLOCK];
+        float dy[RASTER_BLOCK];
+
+        for(int bi=0; bi<bundles.size(); bi++)
+        {
+            const Bundle &b = bundles.at(bi);
+
+            float px0 = b.xa*xscale;
+            float px1 = b.xb*xscale;
+            const float *ya = b.ya;
+            const float *yb = b.yb;
+            if(px1 < px0)
+            {
+                std::swap(px0,px1);
+                std::swap(ya,yb);
+            }
+
+            int c0 = std::max(sx0,(int)std::ceil(px0));
+            int c1 = std::min(sx1-1,(int)std::floor(px1));
+            if(c0 > c1)
+                continue;
+
+            float span = px1-px0;
+            float invSpan = (span > 0) ? 1.0f/span : 0.0f;
+
+            qint64 last = std::min(end,b.count);
+            for(qint64 first=begin; first<last; first+=RASTER_BLOCK)
+            {
+                int n = std::min((qint64)RASTER_BLOCK,last-first);
+                const float *a = ya+first;
+                const float *e = yb+first;
+                const quint8 *lay = b.layers ? b.layers+first : NULL;
+                const float *wt = b.weights ? b.weights+first : NULL;
+
+                // Pixel row at the first column and per-column step
+                for(int k=0; k<n; k++)
+                {
+                    float ra = (1.0f-a[k])*ymax;
+                    float rb = (1.0f-e[k])*ymax;
+                    dy[k] = (rb-ra)*invSpan;
+                    y[k] = ra + dy[k]*(c0-px0);
+                }
+
+                for(int c=c0; c<=c1; c++)
+                {
+                    size_t colOffset = (size_t)c*h;
+
+                    // Split each crossing between the two nearest rows
+                    for(int k=0; k<n; k++)
+                    {
+                        int l = lay ? lay[k] : 0;
+                        if(l >= numLayers)
+                            continue;
+
+                        float yk = std::min(std::max(y[k],0.0f),ymax);
+                        int yi = (int)yk;
+                        float f = yk-yi;
+                        float wk = wt ? wt[k] : 1.0f;
+
+                        float *col = data[l] + colOffset;
+                        col[yi] += (1.0f-f)*wk;
+                        if(yi+1 < h)
+                            col[yi+1] += f*wk;
+                    }
+
+                    // Plain array stepping, left for the compiler to vectorize
+                    for(int k=0; k<n; k++)
+                        y[k] += dy[k];
+                }
+            }
+        }
+    });
+
+    for(int l=0; l<density.size(); l++)
+        maxVals[l] = *std::max_element(density[l].constBegin(),density[l].constEnd());
+}
+
+QImage DensityRaster::toneMap(const QVector<QColor> &colors,
+                              const QVector<qreal> &opacities,
+                              qreal densityScale) const
+{
+    QImage img(std::max(w,1),std::max(h,1),QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::transparent);
+
+    if(w <= 0 || h <= 0)
+        return img;
+
+    int numLayers = density.size();
+
+    QVector<const float*> layerData(numLayers);
+    QVector<float> k(numLayers);
+    QVector<float> cr(numLayers), cg(numLayers), cb(numLayers);
+    for(int l=0; l<numLayers; l++)
+    {
+        layerData[l] = density[l].constData();
+
+        float op = std::min(std::max(opacities.value(l,1.0),0.0),1.0);
+        k[l] = (op >= 1.0f) ? 1e6f : -std::log(1.0f-op);
+        k[l] *= densityScale;
+
+        QColor col = colors.value(l,Qt::black);
+        cr[l] = col.redF();
+        cg[l] = col.greenF();
+        cb[l] = col.blueF();
+    }
+
+    uchar *bits = img.bits();
+    int bytesPerLine = img.bytesPerLine();
+
+    parallelFor(w,[&](qint64 x0, qint64 x1)
+    {
+        for(qint64 x=x0; x<x1; x++)
+        {
+            for(int y=0; y<h; y++)
+            {
+                float r = 0, g = 0, b = 0, a = 0;
+                for(int l=0; l<numLayers; l++)
+                {
+                    float d = layerData[l][x*h+y];
+                    if(d <= 0)
+                        continue;
+
+                    // Composite layers in order, premultiplied
+                    float alpha = 1.0f - std::exp(-k[l]*d);
+                    r = cr[l]*alpha + r*(1.0f-alpha);
+                    g = cg[l]*alpha + g*(1.0f-alpha);
+                    b = cb[l]*alpha + b*(1.0f-alpha);
+                    a = alpha + a*(1.0f-alpha);
+                }
+
+                QRgb *line = (QRgb*)(bits + y*bytesPerLine);
+                line[x] = qRgba((int)(r*255+0.5f),
+                                (int)(g*255+0.5f),
+                                (int)(b*255+0.5f),
+                                (int)(a*255+0.5f));
+            }
+        }
+    }, 16);
+
+    return img;
+}
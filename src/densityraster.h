@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef DENSITYRASTER_H
+#define DENSITYRASTER_H
+
+#include <QVector>
+#include <QColor>
+#include <QImage>
+
+// Software rasterizer for parallel coordinate polylines. Segments are added
+// as bundles sharing the same pair of axis positions, density is accumulated
+// per layer into float buffers and tone-mapped into an image afterwards.
+class DensityRaster
+{
+public:
+    DensityRaster();
+
+    void resize(int w, int h);
+    void setNumLayers(int n);
+
+    int width() const { return w; }
+    int height() const { return h; }
+    int numLayers() const { return density.size(); }
+
+    // Segments run from (xa,ya[i]) to (xb,yb[i]), coordinates in [0,1] with
+    // y=1 at the top. layers[i] picks the density layer of segment i and
+    // weights[i] the density it adds, 1 without weights.
+    void clearBundles();
+    void addBundle(qreal xa, qreal xb,
+                   const float *ya, const float *yb,
+                   const quint8 *layers, const float *weights,
+                   qint64 count);
+
+    // Accumulate segments [begin,end) of every bundle on top of what is
+    // already in the buffers, so a large set can be drawn over several passes
+    void clear();
+    void rasterize(qint64 begin, qint64 end);
+
+    // Emulates alpha blending of overlapping lines: a pixel crossed by d
+    // lines of opacity a gets coverage 1-(1-a)^d. densityScale extrapolates
+    // a partial pass to the full set.
+    QImage toneMap(const QVector<QColor> &colors,
+                   const QVector<qreal> &opacities,
+                   qreal densityScale = 1.0) const;
+
+    float maxDensity(int layer) const { return maxVals.at(layer); }
+
+private:
+    struct Bundle
+    {
+        float xa;
+        float xb;
+        const float *ya;
+        const float *yb;
+        const quint8 *layers;
+        const float *weights;
+        qint64 count;
+    };
+
+    int w;
+    int h;
+
+    QVector<Bundle> bundles;
+
+    // Column-major (x*h+y) so each strip of columns is contiguous
+    QVector<QVector<float> > density;
+    QVector<float> maxVals;
+};
+
+#endif // DENSITYRASTER_H
@@ -0,0 +1,452 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "derivedexpr.h"
+#include "dataobject.h"
+#include "parallel.h"
+#include "reusedistance.h"
+
+#include <algorithm>
+
+// Samples per block, every register holds one block
+#define DERIVED_BLOCK 1024
+
+// Recursive descent with one function per precedence level, emitting
+// instructions into the target expression as it goes
+class DerivedParser
+{
+public:
+    DerivedParser(const QString &t, DataObject *d, DerivedExpr *e)
+        : text(t), pos(0), dataSet(d), target(e) {}
+
+    bool parse()
+    {
+        int r = parseOr();
+        skipSpace();
+        if(r >= 0 && pos < text.size())
+            return fail(QString("Unexpected '%1'").arg(text.mid(pos)));
+        return r >= 0;
+    }
+
+    QString error;
+
+private:
+    bool fail(const QString &msg)
+    {
+        if(error.isEmpty())
+            error = msg;
+        return false;
+    }
+
+    void skipSpace()
+    {
+        while(pos < text.size() && text.at(pos).isSpace())
+            pos++;
+    }
+
+    bool accept(const char *op)
+    {
+        skipSpace();
+        QString s(op);
+        if(!text.midRef(pos).startsWith(s))
+            return false;
+
+        pos += s.size();
+        return true;
+    }
+
+    int binary(DerivedExpr::OpCode op, int a, int b)
+    {
+        if(a < 0 || b < 0)
+            return -1;
+        return target->push(op,a,b);
+    }
+
+    int parseOr()
+    {
+        int r = parseXor();
+        while(r >= 0 && accept("|"))
+            r = binary(DerivedExpr::OP_OR,r,parseXor());
+        return r;
+    }
+
+    int parseXor()
+    {
+        int r = parseAnd();
+        while(r >= 0 && accept("^"))
+            r = binary(DerivedExpr::OP_XOR,r,parseAnd());
+        return r;
+    }
+
+    int parseAnd()
+    {
+        int r = parseShift();
+        while(r >= 0 && accept("&"))
+            r = binary(DerivedExpr::OP_AND,r,parseShift());
+        return r;
+    }
+
+    int parseShift()
+    {
+        int r = parseSum();
+        while(r >= 0)
+        {
+            if(accept("<<"))
+                r = binary(DerivedExpr::OP_SHL,r,parseSum());
+            else if(accept(">>"))
+                r = binary(DerivedExpr::OP_SHR,r,parseSum());
+            else
+                break;
+        }
+        return r;
+    }
+
+    int parseSum()
+    {
+        int r = parseProduct();
+        while(r >= 0)
+        {
+            if(accept("+"))
+                r = binary(DerivedExpr::OP_ADD,r,parseProduct());
+            else if(accept("-"))
+                r = binary(DerivedExpr::OP_SUB,r,parseProduct());
+            else
+                break;
+        }
+        return r;
+    }
+
+    int parseProduct()
+    {
+        int r = parseUnary();
+        while(r >= 0)
+        {
+            if(accept("*"))
+                r = binary(DerivedExpr::OP_MUL,r,parseUnary());
+            else if(accept("/"))
+                r = binary(DerivedExpr::OP_DIV,r,parseUnary());
+            else if(accept("%"))
+                r = binary(DerivedExpr::OP_MOD,r,parseUnary());
+            else
+                break;
+        }
+        return r;
+    }
+
+    int parseUnary()
+    {
+        if(accept("-"))
+        {
+            int r = parseUnary();
+            return (r < 0) ? r : target->push(DerivedExpr::OP_NEG,r);
+        }
+        return parsePrimary();
+    }
+
+    int parsePrimary()
+    {
+        skipSpace();
+        if(pos >= text.size())
+        {
+            fail("Incomplete expression");
+            return -1;
+        }
+
+        if(accept("("))
+        {
+            int r = parseOr();
+            if(r >= 0 && !accept(")"))
+            {
+                fail("Missing ')'");
+                return -1;
+            }
+            return r;
+        }
+
+        QChar c = text.at(pos);
+        if(c.isDigit())
+        {
+            int start = pos;
+            while(pos < text.size() && (text.at(pos).isLetterOrNumber()))
+                pos++;
+
+            bool ok = false;
+            qint64 v = text.mid(start,pos-start).toLongLong(&ok,0);
+            if(!ok)
+            {
+                fail("Invalid number "+text.mid(start,pos-start));
+                return -1;
+            }
+            return target->push(DerivedExpr::OP_CONST,-1,-1,v);
+        }
+
+        if(c.isLetter() || c == '_')
+        {
+            int start = pos;
+            while(pos < text.size() && (text.at(pos).isLetterOrNumber() || text.at(pos) == '_'))
+                pos++;
+            QString name = text.mid(start,pos-start);
+
+            if(accept("("))
+                return parseCall(name.toLower());
+
+            int axis = dataSet->axisIndex(name);
+            if(axis < 0)
+            {
+                fail("Unknown dimension "+name);
+                return -1;
+            }
+            return target->push(DerivedExpr::OP_AXIS,-1,-1,axis);
+        }
+
+        fail(QString("Unexpected '%1'").arg(c));
+        return -1;
+    }
+
+    // Parses one argument into its own program, evaluated to a column
+    QSharedPointer<DerivedExpr> parseArgument()
+    {
+        QSharedPointer<DerivedExpr> arg(new DerivedExpr());
+        DerivedExpr *outer = target;
+        target = arg.data();
+        int r = parseOr();
+        target = outer;
+
+        if(r < 0)
+            return QSharedPointer<DerivedExpr>();
+        return arg;
+    }
+
+    int parseCall(const QString &fn)
+    {
+        if(fn == "delta" || fn == "reuse")
+        {
+            DerivedExpr::Input in;
+            in.kind = (fn == "delta") ? DerivedExpr::INPUT_DELTA : DerivedExpr::INPUT_REUSE;
+            in.arg = parseArgument();
+            if(in.arg && in.kind == DerivedExpr::INPUT_REUSE && accept(","))
+            {
+                in.stream = parseArgument();
+                if(!in.stream)
+                    in.arg.clear();
+            }
+
+            if(!in.arg || !accept(")"))
+            {
+                fail("Invalid argument of "+fn+"()");
+                return -1;
+            }
+
+            target->inputs.push_back(in);
+            return target->push(DerivedExpr::OP_INPUT,-1,-1,target->inputs.size()-1);
+        }
+
+        int a = parseOr();
+        if(a < 0)
+            return a;
+
+        if(fn == "abs")
+        {
+            if(!accept(")"))
+            {
+                fail("abs() takes one argument");
+                return -1;
+            }
+            return target->push(DerivedExpr::OP_ABS,a);
+        }
+
+        if(fn == "min" || fn == "max")
+        {
+            int b = accept(",") ? parseOr() : -1;
+            if(b < 0 || !accept(")"))
+            {
+                fail(fn+"() takes two arguments");
+                return -1;
+            }
+            return target->push(fn == "min" ? DerivedExpr::OP_MIN : DerivedExpr::OP_MAX,a,b);
+        }
+
+        fail("Unknown function "+fn);
+        return -1;
+    }
+
+private:
+    QString text;
+    int pos;
+    DataObject *dataSet;
+    DerivedExpr *target;
+};
+
+DerivedExpr::DerivedExpr()
+{
+}
+
+int DerivedExpr::push(OpCode op, int a, int b, qint64 value)
+{
+    Instr ins = {op, a, b, value};
+    program.push_back(ins);
+    return program.size()-1;
+}
+
+bool DerivedExpr::compile(QString text, DataObject *d)
+{
+    src = text.simplified();
+    err.clear();
+    program.clear();
+    inputs.clear();
+
+    DerivedParser parser(src,d,this);
+    if(!parser.parse())
+    {
+        err = parser.error;
+        program.clear();
+        inputs.clear();
+        return false;
+    }
+    return true;
+}
+
+// Change of x since the previous sample of the same thread, by time
+static void deltaColumn(DataObject *d, const QVector<qint64> &x, QVector<qint64> &out)
+{
+    const qint64 *tid = d->column(SampleAxes::tid).constData();
+    QVector<ElemIndex> order = d->sortedIndex(SampleAxes::time);
+    std::stable_sort(order.begin(),order.end(),
+                     [tid](ElemIndex a, ElemIndex b) { return tid[a] < tid[b]; });
+
+    out.resize(d->numElements);
+    for(int i=0; i<order.size(); i++)
+    {
+        ElemIndex e = order.at(i);
+        ElemIndex prev = (i > 0) ? order.at(i-1) : e;
+        out[e] = (i > 0 && tid[prev] == tid[e]) ? x.at(e)-x.at(prev) : 0;
+    }
+}
+
+void DerivedExpr::evaluate(DataObject *d, QVector<qint64> &out) const
+{
+    qint64 n = d->numElements;
+    out.resize(n);
+    if(n == 0 || program.isEmpty())
+        return;
+
+    // Columns are built lazily and not thread safe, fetch them first
+    QVector<QVector<qint64> > inputCols(inputs.size());
+    for(int k=0; k<inputs.size(); k++)
+    {
+        const Input &in = inputs.at(k);
+        QVector<qint64> x;
+        in.arg->evaluate(d,x);
+
+        if(in.kind == INPUT_DELTA)
+        {
+            deltaColumn(d,x,inputCols[k]);
+            continue;
+        }
+
+        QVector<qint64> streams;
+        if(in.stream)
+            in.stream->evaluate(d,streams);
+        else
+            streams = d->column(SampleAxes::tid);
+        reuseDistances(d,x,streams,inputCols[k]);
+    }
+
+    int numRegs = program.size();
+    QVector<const qint64*> columns(numRegs,NULL);
+    for(int i=0; i<numRegs; i++)
+    {
+        if(program.at(i).op == OP_AXIS)
+            columns[i] = d->column(program.at(i).value).constData();
+        else if(program.at(i).op == OP_INPUT)
+            columns[i] = inputCols.at(program.at(i).value).constData();
+    }
+
+    qint64 *o = out.data();
+    parallelFor(n,[&](qint64 begin, qint64 end)
+    {
+        QVector<qint64> regs(numRegs*DERIVED_BLOCK);
+        QVector<const qint64*> val(numRegs);
+
+        for(qint64 first=begin; first<end; first+=DERIVED_BLOCK)
+        {
+            int m = std::min((qint64)DERIVED_BLOCK,end-first);
+
+            for(int i=0; i<numRegs; i++)
+            {
+                const Instr &ins = program.at(i);
+                if(columns.at(i))
+                {
+                    val[i] = columns.at(i)+first;
+                    continue;
+                }
+
+                qint64 *r = regs.data()+(qint64)i*DERIVED_BLOCK;
+                const qint64 *a = (ins.a >= 0) ? val.at(ins.a) : NULL;
+                const qint64 *b = (ins.b >= 0) ? val.at(ins.b) : NULL;
+                qint64 v = ins.value;
+
+                switch(ins.op)
+                {
+                case(OP_CONST): for(int k=0; k<m; k++) r[k] = v; break;
+                // Arithmetic wraps around in two's complement like OP_SHL,
+                // x / -1 is negated since INT64_MIN / -1 traps
+                case(OP_NEG):   for(int k=0; k<m; k++) r[k] = (qint64)(0-(quint64)a[k]); break;
+                case(OP_ABS):   for(int k=0; k<m; k++) r[k] = a[k] < 0 ? (qint64)(0-(quint64)a[k]) : a[k]; break;
+                case(OP_ADD):   for(int k=0; k<m; k++) r[k] = (qint64)((quint64)a[k] + (quint64)b[k]); break;
+                case(OP_SUB):   for(int k=0; k<m; k++) r[k] = (qint64)((quint64)a[k] - (quint64)b[k]); break;
+                case(OP_MUL):   for(int k=0; k<m; k++) r[k] = (qint64)((quint64)a[k] * (quint64)b[k]); break;
+                case(OP_DIV):   for(int k=0; k<m; k++) r[k] = b[k] == -1 ? (qint64)(0-(quint64)a[k]) : b[k] ? a[k] / b[k] : 0; break;
+                case(OP_MOD):   for(int k=0; k<m; k++) r[k] = (b[k] == 0 || b[k] == -1) ? 0 : a[k] % b[k]; break;
+                case(OP_SHL):   for(int k=0; k<m; k++) r[k] = (qint64)((quint64)a[k] << (b[k] & 63)); break;
+                case(OP_SHR):   for(int k=0; k<m; k++) r[k] = a[k] >> (b[k] & 63); break;
+                case(OP_AND):   for(int k=0; k<m; k++) r[k] = a[k] & b[k]; break;
+                case(OP_OR):    for(int k=0; k<m; k++) r[k] = a[k] | b[k]; break;
+                case(OP_XOR):   for(int k=0; k<m; k++) r[k] = a[k] ^ b[k]; break;
+                case(OP_MIN):   for(int k=0; k<m; k++) r[k] = std::min(a[k],b[k]); break;
+                case(OP_MAX):   for(int k=0; k<m; k++) r[k] = std::max(a[k],b[k]); break;
+                default: break;
+                }
+                val[i] = r;
+            }
+
+            const qint64 *res = val.at(numRegs-1);
+            std::copy(res,res+m,o+first);
+        }
+    }, DERIVED_BLOCK*4);
+}
@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef DERIVEDEXPR_H
+#define DERIVEDEXPR_H
+
+#include <QString>
+#include <QVector>
+#include <QSharedPointer>
+
+class DataObject;
+
+// Integer expression over sample axes, evaluated for all samples at once:
+//
+//   latency / bytes      addr >> 12      addr & 63      delta(time)
+//
+// Operators follow C precedence: * / %, + -, << >>, &, ^, |, unary -.
+// Functions are abs(x), min(a,b), max(a,b) and delta(x), the change of x
+// since the previous sample of the same thread in time order. reuse(x) is
+// the reuse distance of x within the thread, reuse(x,s) within streams
+// of equal s instead, e.g. reuse(addr >> 6, variableUid).
+//
+// The expression is compiled into a register program whose instructions
+// each run one tight loop over a block of samples, so the compiler can
+// vectorize them.
+class DerivedExpr
+{
+public:
+    DerivedExpr();
+
+    // Axes are resolved through the data set, so derived axes can be used
+    // in later expressions. Returns false and sets error() on failure.
+    bool compile(QString text, DataObject *d);
+    QString error() const { return err; }
+    QString text() const { return src; }
+
+    // Values for every sample, in sample order
+    void evaluate(DataObject *d, QVector<qint64> &out) const;
+
+private:
+    enum OpCode {
+        OP_AXIS = 0,
+        OP_INPUT,
+        OP_CONST,
+        OP_NEG,
+        OP_ABS,
+        OP_ADD,
+        OP_SUB,
+        OP_MUL,
+        OP_DIV,
+        OP_MOD,
+        OP_SHL,
+        OP_SHR,
+        OP_AND,
+        OP_OR,
+        OP_XOR,
+        OP_MIN,
+        OP_MAX
+    };
+
+    struct Instr
+    {
+        OpCode op;
+        int a;
+        int b;
+        qint64 value; // axis, input or constant
+    };
+
+    // Columns computed over the whole data set before the program runs
+    enum InputKind {
+        INPUT_DELTA = 0,
+        INPUT_REUSE
+    };
+
+    struct Input
+    {
+        InputKind kind;
+        QSharedPointer<DerivedExpr> arg;
+        QSharedPointer<DerivedExpr> stream; // thread if null
+    };
+
+    friend class DerivedParser;
+
+    int push(OpCode op, int a = -1, int b = -1, qint64 value = 0);
+
+private:
+    QString src;
+    QString err;
+
+    // Register i holds the result of program[i], the last one is the value
+    QVector<Instr> program;
+
+    QVector<Input> inputs;
+};
+
+#endif // DERIVEDEXPR_H
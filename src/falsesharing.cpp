@@ -0,0 +1,325 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "falsesharing.h"
+#include "parallel.h"
+
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
+#include <cstring>
+
+// Lines are spread over 1 << PARTITION_BITS hash partitions
+#define PARTITION_BITS 6
+
+struct LineAgg
+{
+    qint64 samples;
+    qint64 hitm;
+    qreal latency;
+    qreal hitmLatency;
+    int firstCpu;       // cpu of the sample that created the entry
+    bool multiCpu;      // some sample came from another cpu
+
+    int numTracked;
+    bool overflow;
+    int cpus[CONTENTION_MAX_CPUS];
+    quint64 bytes[CONTENTION_MAX_CPUS];
+
+    void addCpu(int cpu, quint64 mask)
+    {
+        if(cpu != firstCpu)
+            multiCpu = true;
+
+        for(int i=0; i<numTracked; i++)
+        {
+            if(cpus[i] == cpu)
+            {
+                bytes[i] |= mask;
+                return;
+            }
+        }
+
+        if(numTracked == CONTENTION_MAX_CPUS)
+        {
+            overflow = true;
+            return;
+        }
+        cpus[numTracked] = cpu;
+        bytes[numTracked] = mask;
+        numTracked++;
+    }
+
+    void merge(const LineAgg &o)
+    {
+        samples += o.samples;
+        hitm += o.hitm;
+        latency += o.latency;
+        hitmLatency += o.hitmLatency;
+        multiCpu = multiCpu || o.multiCpu || o.firstCpu != firstCpu;
+        overflow = overflow || o.overflow;
+        for(int i=0; i<o.numTracked; i++)
+            addCpu(o.cpus[i],o.bytes[i]);
+    }
+
+    bool disjoint() const
+    {
+        if(overflow || numTracked < 2)
+            return false;
+
+        for(int i=0; i<numTracked; i++)
+            for(int j=i+1; j<numTracked; j++)
+                if(bytes[i] & bytes[j])
+                    return false;
+        return true;
+    }
+};
+
+typedef QHash<qint64,LineAgg> LineTable;
+
+// Bytes of the line covered by an access
+static inline quint64 byteMask(qint64 addr, qint64 bytes)
+{
+    int off = addr & ((1 << CACHE_LINE_SHIFT)-1);
+    int len = std::max((qint64)1,std::min(bytes,(qint64)(64-off)));
+    quint64 m = (len == 64) ? ~(quint64)0 : (((quint64)1 << len)-1);
+    return m << off;
+}
+
+bool isContendedSource(int dataSrcEnc)
+{
+    // 0x6 and 0x7 hit a modified line in another core's cache, dseDirty()
+    // covers dirty snoops from local and remote memory
+    int src = dataSrcEnc & 0xF;
+    return src == 0x6 || src == 0x7 || src == 0xC || src == 0xD;
+}
+
+QVector<LineContention> findLineContention(DataObject *d, const Bitmap &mask,
+                                           int maxLines)
+{
+    const int numParts = 1 << PARTITION_BITS;
+    const Sample *samples = d->samples.constData();
+    const quint64 *words = mask.constData();
+    int numWords = mask.numWords();
+    int numChunks = parallelChunkCount(numWords,256);
+
+    // Every chunk aggregates its samples into one table per partition
+    QVector<QVector<LineTable> > tables(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        QVector<LineTable> &parts = tables[c];
+        parts.resize(numParts);
+
+        int begin = (qint64)numWords*c/numChunks;
+        int end = (qint64)numWords*(c+1)/numChunks;
+        for(int w=begin; w<end; w++)
+        {
+            quint64 bits = words[w];
+            while(bits)
+            {
+                const Sample &s = samples[((qint64)w << 6) + qCountTrailingZeroBits(bits)];
+                bits &= bits-1;
+
+                qint64 line = s.addr >> CACHE_LINE_SHIFT;
+                LineTable &t = parts[hashPartition(line,PARTITION_BITS)];
+                LineTable::iterator it = t.find(line);
+                if(it == t.end())
+                {
+                    LineAgg zero;
+                    std::memset(&zero,0,sizeof(zero));
+                    zero.firstCpu = s.cpu;
+                    it = t.insert(line,zero);
+                }
+
+                LineAgg &a = it.value();
+                qreal latency = (qreal)s.latency*s.weight;
+                a.samples += s.weight;
+                a.latency += latency;
+                if(isContendedSource(s.data_src_enc))
+                {
+                    a.hitm += s.weight;
+                    a.hitmLatency += latency;
+                }
+                a.addCpu(s.cpu,byteMask(s.addr,s.bytes));
+            }
+        }
+    });
+
+    // Partitions hold disjoint lines, merge them independently
+    QVector<QVector<LineContention> > found(numParts);
+    parallelTasks(numParts,[&](int p)
+    {
+        LineTable merged = tables.at(0).at(p);
+        for(int c=1; c<numChunks; c++)
+        {
+            const LineTable &t = tables.at(c).at(p);
+            for(LineTable::const_iterator it=t.constBegin(); it!=t.constEnd(); it++)
+            {
+                LineTable::iterator m = merged.find(it.key());
+                if(m == merged.end())
+                    merged.insert(it.key(),it.value());
+                else
+                    m.value().merge(it.value());
+            }
+        }
+
+        for(LineTable::const_iterator it=merged.constBegin(); it!=merged.constEnd(); it++)
+        {
+            const LineAgg &a = it.value();
+            if(!a.multiCpu || a.hitm == 0)
+                continue;
+
+            LineContention lc;
+            lc.line = it.key();
+            lc.samples = a.samples;
+            lc.hitm = a.hitm;
+            lc.latency = a.latency;
+            lc.hitmLatency = a.hitmLatency;
+            lc.numCpus = 0;
+            lc.falseSharing = a.disjoint();
+            lc.variableSample = 0;
+            lc.sourceSample = 0;
+            found[p].push_back(lc);
+        }
+    });
+
+    QVector<LineContention> result;
+    for(int p=0; p<numParts; p++)
+        result += found.at(p);
+
+    std::sort(result.begin(),result.end(),
+              [](const LineContention &a, const LineContention &b)
+              { return a.hitmLatency > b.hitmLatency; });
+    if(maxLines >= 0 && result.size() > maxLines)
+        result.resize(maxLines);
+
+    if(result.isEmpty())
+        return result;
+
+    // Second pass over the reported lines only: exact cpu count, and the
+    // variable and source line with the most latency on each
+    QHash<qint64,int> reported;
+    for(int i=0; i<result.size(); i++)
+        reported.insert(result.at(i).line,i);
+
+    typedef QHash<qint64,QPair<qreal,ElemIndex> > KeyLatency;
+    int numLines = result.size();
+    QVector<QVector<KeyLatency> > varLat(numChunks), srcLat(numChunks);
+    QVector<QVector<QSet<int> > > lineCpus(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        varLat[c].resize(numLines);
+        srcLat[c].resize(numLines);
+        lineCpus[c].resize(numLines);
+
+        int begin = (qint64)numWords*c/numChunks;
+        int end = (qint64)numWords*(c+1)/numChunks;
+        for(int w=begin; w<end; w++)
+        {
+            quint64 bits = words[w];
+            while(bits)
+            {
+                ElemIndex e = ((qint64)w << 6) + qCountTrailingZeroBits(bits);
+                bits &= bits-1;
+
+                const Sample &s = samples[e];
+                int r = reported.value(s.addr >> CACHE_LINE_SHIFT,-1);
+                if(r < 0)
+                    continue;
+
+                lineCpus[c][r].insert(s.cpu);
+
+                QPair<qreal,ElemIndex> &v = varLat[c][r][s.variableUid];
+                v.first += (qreal)s.latency*s.weight;
+                v.second = e;
+
+                qint64 srcKey = ((qint64)s.sourceUid << 40) ^ s.line;
+                QPair<qreal,ElemIndex> &l = srcLat[c][r][srcKey];
+                l.first += (qreal)s.latency*s.weight;
+                l.second = e;
+            }
+        }
+    });
+
+    for(int r=0; r<numLines; r++)
+    {
+        KeyLatency vars, srcs;
+        QSet<int> cpus;
+        for(int c=0; c<numChunks; c++)
+        {
+            cpus.unite(lineCpus.at(c).at(r));
+            for(KeyLatency::const_iterator it=varLat.at(c).at(r).constBegin(); it!=varLat.at(c).at(r).constEnd(); it++)
+            {
+                QPair<qreal,ElemIndex> &v = vars[it.key()];
+                v.first += it.value().first;
+                v.second = it.value().second;
+            }
+            for(KeyLatency::const_iterator it=srcLat.at(c).at(r).constBegin(); it!=srcLat.at(c).at(r).constEnd(); it++)
+            {
+                QPair<qreal,ElemIndex> &l = srcs[it.key()];
+                l.first += it.value().first;
+                l.second = it.value().second;
+            }
+        }
+
+        result[r].numCpus = cpus.size();
+
+        qreal best = -1;
+        for(KeyLatency::const_iterator it=vars.constBegin(); it!=vars.constEnd(); it++)
+        {
+            if(it.value().first > best)
+            {
+                best = it.value().first;
+                result[r].variableSample = it.value().second;
+            }
+        }
+
+        best = -1;
+        for(KeyLatency::const_iterator it=srcs.constBegin(); it!=srcs.constEnd(); it++)
+        {
+            if(it.value().first > best)
+            {
+                best = it.value().first;
+                result[r].sourceSample = it.value().second;
+            }
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,627 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "flatclustering.h"
+#include "parallel.h"
+
+#include <QAtomicInt>
+#include <QHash>
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <random>
+
+// Rows per distance block, the accumulators stay in registers/L1
+#define KERNEL_BLOCK 256
+
+// Squared distances of rows [begin,end) of a dim-major matrix with stride
+// floats per dimension to one point, end-begin <= KERNEL_BLOCK
+static inline void distancesTo(const float *values, qint64 stride, int dims,
+                               const float *point, int begin, int end, float *acc)
+{
+    int m = end-begin;
+    std::fill(acc,acc+m,0.0f);
+    for(int d=0; d<dims; d++)
+    {
+        const float *x = values + d*stride + begin;
+        float p = point[d];
+        for(int r=0; r<m; r++)
+        {
+            float t = x[r]-p;
+            acc[r] += t*t;
+        }
+    }
+}
+
+// Nearest of k centers (dims floats each) for n rows of a dim-major matrix
+static void nearestCenters(const float *values, qint64 stride, int n, int dims,
+                           const float *centers, int k, int *label, float *dist)
+{
+    float acc[KERNEL_BLOCK];
+    for(int b=0; b<n; b+=KERNEL_BLOCK)
+    {
+        int e = std::min(b+KERNEL_BLOCK,n);
+        std::fill(dist+b,dist+e,FLT_MAX);
+        for(int j=0; j<k; j++)
+        {
+            distancesTo(values,stride,dims,centers+j*dims,b,e,acc);
+            for(int r=b; r<e; r++)
+            {
+                if(acc[r-b] < dist[r])
+                {
+                    dist[r] = acc[r-b];
+                    label[r] = j;
+                }
+            }
+        }
+    }
+}
+
+// Renumbers clusters 0..numClusters-1 by decreasing weight, negative
+// labels are kept
+static void relabelBySize(QVector<int> &labels, int numClusters,
+                          const QVector<quint32> &weights)
+{
+    QVector<qint64> sizes(numClusters,0);
+    for(int i=0; i<labels.size(); i++)
+        if(labels.at(i) >= 0)
+            sizes[labels.at(i)] += weights.at(i);
+
+    QVector<int> order(numClusters);
+    for(int c=0; c<numClusters; c++)
+        order[c] = c;
+    std::sort(order.begin(),order.end(),[&](int a, int b)
+        { return sizes.at(a) > sizes.at(b) || (sizes.at(a) == sizes.at(b) && a < b); });
+
+    QVector<int> rank(numClusters);
+    for(int c=0; c<numClusters; c++)
+        rank[order.at(c)] = c;
+
+    int *l = labels.data();
+    parallelFor(labels.size(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+            if(l[i] >= 0)
+                l[i] = rank.at(l[i]);
+    });
+}
+
+FeatureMatrix featureMatrix(DataObject *d, const Bitmap &mask,
+                            const QVector<int> &axes)
+{
+    FeatureMatrix f;
+    f.dims = axes.size();
+    f.elems.reserve(mask.count());
+    mask.forEachSet([&](qint64 e) { f.elems.push_back(e); });
+    f.rows = f.elems.size();
+    f.values.resize((qint64)f.dims*f.rows);
+    f.weights.resize(f.rows);
+    for(int r=0; r<f.rows; r++)
+        f.weights[r] = d->samples.at(f.elems.at(r)).weight;
+
+    int numChunks = parallelChunkCount(f.rows,65536);
+    const ElemIndex *elems = f.elems.constData();
+    for(int a=0; a<f.dims; a++)
+    {
+        // Columns are built on first use, not inside the workers
+        const qint64 *col = d->column(axes.at(a)).constData();
+        float *out = f.values.data() + (qint64)a*f.rows;
+
+        QVector<qint64> lo(numChunks,LLONG_MAX), hi(numChunks,LLONG_MIN);
+        parallelTasks(numChunks,[&](int c)
+        {
+            int begin = (qint64)f.rows*c/numChunks;
+            int end = (qint64)f.rows*(c+1)/numChunks;
+            for(int r=begin; r<end; r++)
+            {
+                qint64 v = col[elems[r]];
+                lo[c] = std::min(lo.at(c),v);
+                hi[c] = std::max(hi.at(c),v);
+            }
+        });
+
+        qint64 minVal = *std::min_element(lo.constBegin(),lo.constEnd());
+        qint64 maxVal = *std::max_element(hi.constBegin(),hi.constEnd());
+        double scale = maxVal > minVal ? 1.0/((double)maxVal-(double)minVal) : 0.0;
+
+        parallelFor(f.rows,[&](qint64 begin, qint64 end)
+        {
+            for(qint64 r=begin; r<end; r++)
+                out[r] = (float)(((double)col[elems[r]]-(double)minVal)*scale);
+        });
+    }
+
+    return f;
+}
+
+QVector<int> kmeansMiniBatch(const FeatureMatrix &f, int k, int batchSize,
+                             int iterations, quint32 seed)
+{
+    QVector<int> labels(f.rows,0);
+    if(f.rows == 0 || f.dims == 0 || k <= 1)
+        return labels;
+
+    std::mt19937 rng(seed);
+    batchSize = std::max(1,batchSize);
+
+    // Rows are drawn by weight, a merged sample as often as the samples it
+    // stands for
+    QVector<qint64> cumWeight(f.rows);
+    qint64 totalWeight = 0;
+    for(int r=0; r<f.rows; r++)
+        cumWeight[r] = totalWeight += f.weights.at(r);
+    std::uniform_int_distribution<qint64> anyWeight(0,std::max(totalWeight,(qint64)1)-1);
+    auto anyRow = [&]()
+    {
+        qint64 w = anyWeight(rng);
+        int r = std::upper_bound(cumWeight.constBegin(),cumWeight.constEnd(),w)
+                - cumWeight.constBegin();
+        return std::min(r,f.rows-1);
+    };
+
+    // Random rows gathered into a dim-major buffer
+    QVector<float> batch;
+    auto gather = [&](int n)
+    {
+        batch.resize((qint64)n*f.dims);
+        for(int i=0; i<n; i++)
+        {
+            int r = anyRow();
+            for(int d=0; d<f.dims; d++)
+                batch[d*n+i] = f.dim(d)[r];
+        }
+    };
+
+    // k-means++ seeding on a sample
+    int n = std::min(f.rows,std::max(batchSize,16*k));
+    gather(n);
+    QVector<float> centers(k*f.dims);
+    QVector<float> nearest(n,FLT_MAX), dist(n);
+    QVector<int> unused(n);
+    int numCenters = 0;
+    int pick = std::uniform_int_distribution<int>(0,n-1)(rng);
+    while(numCenters < k)
+    {
+        float *center = centers.data() + numCenters*f.dims;
+        for(int d=0; d<f.dims; d++)
+            center[d] = batch.at(d*n+pick);
+        numCenters++;
+
+        nearestCenters(batch.constData(),n,n,f.dims,center,1,
+                       unused.data(),dist.data());
+        double total = 0;
+        for(int i=0; i<n; i++)
+        {
+            nearest[i] = std::min(nearest.at(i),dist.at(i));
+            total += nearest.at(i);
+        }
+
+        // Fewer distinct points than k
+        if(total <= 0)
+            break;
+
+        double target = std::uniform_real_distribution<double>(0,total)(rng);
+        for(pick=0; pick<n-1 && (target -= nearest.at(pick)) > 0; pick++);
+    }
+
+    k = numCenters;
+
+    // Per-center learning rate 1/count
+    QVector<qint64> counts(k,0);
+    QVector<int> assigned(batchSize);
+    QVector<float> batchDist(batchSize);
+    for(int it=0; it<iterations; it++)
+    {
+        gather(batchSize);
+        nearestCenters(batch.constData(),batchSize,batchSize,f.dims,
+                       centers.constData(),k,assigned.data(),batchDist.data());
+
+        for(int i=0; i<batchSize; i++)
+        {
+            int c = assigned.at(i);
+            float eta = 1.0f/(float)(++counts[c]);
+            for(int d=0; d<f.dims; d++)
+            {
+                float &v = centers[c*f.dims+d];
+                v += eta*(batch.at(d*batchSize+i)-v);
+            }
+        }
+    }
+
+    QVector<float> rowDist(f.rows);
+    int *l = labels.data();
+    float *rd = rowDist.data();
+    parallelFor(f.rows,[&](qint64 begin, qint64 end)
+    {
+        nearestCenters(f.values.constData()+begin,f.rows,end-begin,f.dims,
+                       centers.constData(),k,l+begin,rd+begin);
+    },KERNEL_BLOCK*16);
+
+    relabelBySize(labels,k,f.weights);
+    return labels;
+}
+
+// Lock-free union-find, a root only ever links to a lower root so parents
+// decrease along every path
+static int findRoot(QAtomicInt *parent, int x)
+{
+    for(;;)
+    {
+        int p = parent[x].loadAcquire();
+        if(p == x)
+            return x;
+
+        // Path halving
+        int gp = parent[p].loadAcquire();
+        if(gp != p)
+            parent[x].testAndSetRelaxed(p,gp);
+        x = gp;
+    }
+}
+
+static void unite(QAtomicInt *parent, int a, int b)
+{
+    for(;;)
+    {
+        a = findRoot(parent,a);
+        b = findRoot(parent,b);
+        if(a == b)
+            return;
+        if(a < b)
+            std::swap(a,b);
+        if(parent[a].testAndSetOrdered(a,b))
+            return;
+    }
+}
+
+QVector<int> dbscan(const FeatureMatrix &f, float eps, int minPts)
+{
+    int n = f.rows;
+    int dims = f.dims;
+    QVector<int> labels(n,DBSCAN_NOISE);
+    if(n == 0 || dims == 0 || dims > DBSCAN_MAX_DIMS || eps <= 0)
+        return labels;
+
+    // Cells of diagonal eps, so the points of a cell are all neighbors and
+    // neighbors are at most reach cells apart. 16 bits per cell coordinate.
+    float side = eps/std::sqrt((float)dims);
+    int reach = (int)std::ceil(std::sqrt((float)dims));
+    int maxCell = std::min(0xFFFF,(int)(1.0f/side));
+    auto cellOf = [&](float v) { return (quint64)std::min(maxCell,(int)(v/side)); };
+
+    QVector<QPair<quint64,int> > keyed(n);
+    parallelFor(n,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 r=begin; r<end; r++)
+        {
+            quint64 key = 0;
+            for(int d=0; d<dims; d++)
+                key |= cellOf(f.dim(d)[r]) << (16*d);
+            keyed[r] = qMakePair(key,(int)r);
+        }
+    });
+    std::sort(keyed.begin(),keyed.end());
+
+    // Points in cell order, dim-major, and their weights
+    QVector<float> pts(n*dims);
+    QVector<qint64> wts(n);
+    float *p = pts.data();
+    qint64 *w = wts.data();
+    parallelFor(n,[&](qint64 begin, qint64 end)
+    {
+        for(int d=0; d<dims; d++)
+            for(qint64 i=begin; i<end; i++)
+                p[d*n+i] = f.dim(d)[keyed.at(i).second];
+        for(qint64 i=begin; i<end; i++)
+            w[i] = f.weights.at(keyed.at(i).second);
+    });
+
+    QVector<int> cellBegin;
+    QVector<int> pointCell(n);
+    QHash<quint64,int> cellIndex;
+    for(int i=0; i<n; i++)
+    {
+        if(i == 0 || keyed.at(i).first != keyed.at(i-1).first)
+        {
+            cellIndex.insert(keyed.at(i).first,cellBegin.size());
+            cellBegin.push_back(i);
+        }
+        pointCell[i] = cellBegin.size()-1;
+    }
+    int numCells = cellBegin.size();
+    cellBegin.push_back(n);
+
+    QVector<qint64> cellWeight(numCells,0);
+    for(int i=0; i<n; i++)
+        cellWeight[pointCell.at(i)] += wts.at(i);
+
+    // Cell offsets whose closest points can be within eps, nearest first
+    // so scans that stop early stop sooner
+    QVector<QPair<int,QVector<int> > > offsets;
+    int span = 2*reach+1;
+    int numOffsets = 1;
+    for(int d=0; d<dims; d++)
+        numOffsets *= span;
+    for(int o=0; o<numOffsets; o++)
+    {
+        QVector<int> offset(dims);
+        int gap = 0, dist = 0;
+        for(int d=0, rest=o; d<dims; d++, rest/=span)
+        {
+            offset[d] = rest%span - reach;
+            int g = std::max(std::abs(offset.at(d))-1,0);
+            gap += g*g;
+            dist += offset.at(d)*offset.at(d);
+        }
+        if(gap <= dims)
+            offsets.push_back(qMakePair(dist,offset));
+    }
+    std::stable_sort(offsets.begin(),offsets.end(),
+                     [](const QPair<int,QVector<int> > &a, const QPair<int,QVector<int> > &b)
+                     { return a.first < b.first; });
+
+    QVector<QVector<int> > neighbors(numCells);
+    parallelFor(numCells,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 c=begin; c<end; c++)
+        {
+            quint64 key = keyed.at(cellBegin.at(c)).first;
+            for(int o=0; o<offsets.size(); o++)
+            {
+                quint64 nkey = 0;
+                bool inside = true;
+                for(int d=0; d<dims; d++)
+                {
+                    int coord = (int)((key >> (16*d)) & 0xFFFF) + offsets.at(o).second.at(d);
+                    inside = inside && coord >= 0 && coord <= maxCell;
+                    nkey |= (quint64)(coord & 0xFFFF) << (16*d);
+                }
+                if(!inside)
+                    continue;
+
+                QHash<quint64,int>::const_iterator it = cellIndex.constFind(nkey);
+                if(it != cellIndex.constEnd())
+                    neighbors[c].push_back(it.value());
+            }
+        }
+    },64);
+
+    // Calls fn(j) for every point j of cell nc within eps of point, until
+    // fn returns false. False if stopped.
+    const float eps2 = eps*eps;
+    auto scanCell = [&](int nc, const float *point, float *acc,
+                        const std::function<bool(int)> &fn)
+    {
+        int end = cellBegin.at(nc+1);
+        for(int b=cellBegin.at(nc); b<end; b+=KERNEL_BLOCK)
+        {
+            int e = std::min(b+KERNEL_BLOCK,end);
+            distancesTo(pts.constData(),n,dims,point,b,e,acc);
+            for(int j=b; j<e; j++)
+                if(acc[j-b] <= eps2 && !fn(j))
+                    return false;
+        }
+        return true;
+    };
+
+    // Cells weighing at least minPts are all core, the rest count
+    QVector<char> core(n,0);
+    QVector<char> cellCore(numCells,0);
+    parallelFor(numCells,[&](qint64 begin, qint64 end)
+    {
+        float point[DBSCAN_MAX_DIMS];
+        float acc[KERNEL_BLOCK];
+        for(qint64 c=begin; c<end; c++)
+        {
+            for(int i=cellBegin.at(c); i<cellBegin.at(c+1); i++)
+            {
+                qint64 count = cellWeight.at(c);
+                if(count < minPts)
+                {
+                    for(int d=0; d<dims; d++)
+                        point[d] = pts.at(d*n+i);
+
+                    count = 0;
+                    const QVector<int> &cells = neighbors.at(c);
+                    for(int nc=0; nc<cells.size() && count<minPts; nc++)
+                    {
+                        int cellEnd = cellBegin.at(cells.at(nc)+1);
+                        for(int b=cellBegin.at(cells.at(nc)); b<cellEnd && count<minPts; b+=KERNEL_BLOCK)
+                        {
+                            int e = std::min(b+KERNEL_BLOCK,cellEnd);
+                            distancesTo(pts.constData(),n,dims,point,b,e,acc);
+                            for(int j=0; j<e-b; j++)
+                                count += (acc[j] <= eps2) ? w[b+j] : 0;
+                        }
+                    }
+                }
+
+                core[i] = count >= minPts;
+                cellCore[c] = cellCore.at(c) || core.at(i);
+            }
+        }
+    },16);
+
+    // Core points of every cell, packed dim-major for the cell links
+    QVector<int> coreBegin(numCells+1,0);
+    for(int c=0; c<numCells; c++)
+    {
+        int count = 0;
+        for(int i=cellBegin.at(c); i<cellBegin.at(c+1); i++)
+            count += core.at(i);
+        coreBegin[c+1] = coreBegin.at(c)+count;
+    }
+    int numCore = coreBegin.at(numCells);
+    QVector<float> corePts(numCore*dims);
+    float *cp = corePts.data();
+    parallelFor(numCells,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 c=begin; c<end; c++)
+        {
+            int k = coreBegin.at(c);
+            for(int i=cellBegin.at(c); i<cellBegin.at(c+1); i++)
+            {
+                if(!core.at(i))
+                    continue;
+                for(int d=0; d<dims; d++)
+                    cp[d*numCore+k] = pts.at(d*n+i);
+                k++;
+            }
+        }
+    },64);
+
+    // Core cells are connected when any of their core points are within
+    // eps, each pair of cells is tested once. Points of the smaller cell
+    // farther than eps from the box of the other are skipped.
+    QVector<QAtomicInt> parent(numCells);
+    QAtomicInt *parents = parent.data();
+    for(int c=0; c<numCells; c++)
+        parents[c].store(c);
+
+    auto cellsLinked = [&](int a, int b, float *point, float *acc)
+    {
+        if(coreBegin.at(a+1)-coreBegin.at(a) > coreBegin.at(b+1)-coreBegin.at(b))
+            std::swap(a,b);
+
+        quint64 key = keyed.at(cellBegin.at(b)).first;
+        float lo[DBSCAN_MAX_DIMS];
+        for(int d=0; d<dims; d++)
+            lo[d] = ((key >> (16*d)) & 0xFFFF)*side;
+
+        for(int i=coreBegin.at(a); i<coreBegin.at(a+1); i++)
+        {
+            float boxDist = 0;
+            for(int d=0; d<dims; d++)
+            {
+                point[d] = corePts.at(d*numCore+i);
+                float t = std::max(std::max(lo[d]-point[d],point[d]-lo[d]-side),0.0f);
+                boxDist += t*t;
+            }
+            if(boxDist > eps2)
+                continue;
+
+            int end = coreBegin.at(b+1);
+            for(int j=coreBegin.at(b); j<end; j+=KERNEL_BLOCK)
+            {
+                int e = std::min(j+KERNEL_BLOCK,end);
+                distancesTo(corePts.constData(),numCore,dims,point,j,e,acc);
+                for(int r=0; r<e-j; r++)
+                    if(acc[r] <= eps2)
+                        return true;
+            }
+        }
+        return false;
+    };
+
+    parallelFor(numCells,[&](qint64 begin, qint64 end)
+    {
+        float point[DBSCAN_MAX_DIMS];
+        float acc[KERNEL_BLOCK];
+        for(qint64 c=begin; c<end; c++)
+        {
+            if(!cellCore.at(c))
+                continue;
+
+            const QVector<int> &cells = neighbors.at(c);
+            for(int nc=0; nc<cells.size(); nc++)
+            {
+                int other = cells.at(nc);
+                if(other <= c || !cellCore.at(other)
+                   || findRoot(parents,c) == findRoot(parents,other))
+                    continue;
+
+                if(cellsLinked(c,other,point,acc))
+                    unite(parents,c,other);
+            }
+        }
+    },16);
+
+    // Border points join the cluster of a core point within eps, in their
+    // own cell if it has one, the rest is noise
+    QVector<int> sorted(n,DBSCAN_NOISE);
+    parallelFor(numCells,[&](qint64 begin, qint64 end)
+    {
+        float point[DBSCAN_MAX_DIMS];
+        float acc[KERNEL_BLOCK];
+        for(qint64 c=begin; c<end; c++)
+        {
+            for(int i=cellBegin.at(c); i<cellBegin.at(c+1); i++)
+            {
+                if(cellCore.at(c))
+                {
+                    sorted[i] = findRoot(parents,c);
+                    continue;
+                }
+
+                for(int d=0; d<dims; d++)
+                    point[d] = pts.at(d*n+i);
+                const QVector<int> &cells = neighbors.at(c);
+                for(int nc=0; nc<cells.size() && sorted.at(i) < 0; nc++)
+                {
+                    scanCell(cells.at(nc),point,acc,[&](int j)
+                    {
+                        if(!core.at(j))
+                            return true;
+                        sorted[i] = findRoot(parents,pointCell.at(j));
+                        return false;
+                    });
+                }
+            }
+        }
+    },16);
+
+    // Roots are cells, number them densely
+    QVector<int> cluster(numCells,-1);
+    int numClusters = 0;
+    for(int c=0; c<numCells; c++)
+        if(cellCore.at(c) && findRoot(parents,c) == c)
+            cluster[c] = numClusters++;
+
+    int *l = labels.data();
+    parallelFor(n,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+            if(sorted.at(i) >= 0)
+                l[keyed.at(i).second] = cluster.at(sorted.at(i));
+    });
+
+    relabelBySize(labels,numClusters,f.weights);
+    return labels;
+}
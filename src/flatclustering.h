@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef FLATCLUSTERING_H
+#define FLATCLUSTERING_H
+
+#include <QVector>
+
+#include "dataobject.h"
+
+// The DBSCAN grid has 16 bits per dimension in a 64 bit cell key
+#define DBSCAN_MAX_DIMS 4
+#define DBSCAN_NOISE -1
+
+// Samples of a mask on some axes, min-max normalized to [0,1]. Values of
+// one axis are contiguous so distance loops vectorize over rows.
+struct FeatureMatrix
+{
+    int dims;
+    int rows;
+    QVector<ElemIndex> elems;   // sample of each row
+    QVector<float> values;      // values[d*rows + r]
+    QVector<quint32> weights;   // samples each row stands for
+
+    FeatureMatrix() : dims(0), rows(0) {}
+    const float *dim(int d) const { return values.constData() + (qint64)d*rows; }
+};
+
+FeatureMatrix featureMatrix(DataObject *d, const Bitmap &mask,
+                            const QVector<int> &axes);
+
+// Mini-batch k-means (Sculley), seeded by k-means++ on a sample. Batches
+// draw rows in proportion to their weight. Returns the cluster of every
+// row, 0 is the largest by weight.
+QVector<int> kmeansMiniBatch(const FeatureMatrix &f, int k, int batchSize,
+                             int iterations, quint32 seed);
+
+// DBSCAN over at most DBSCAN_MAX_DIMS dimensions. Points are binned into
+// grid cells of diagonal eps, cells are connected instead of points. A
+// point counts as many neighbors as its weight towards minPts. Returns the
+// cluster of every row, 0 is the largest by weight, or DBSCAN_NOISE.
+QVector<int> dbscan(const FeatureMatrix &f, float eps, int minPts);
+
+#endif // FLATCLUSTERING_H
@@ -0,0 +1,128 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "framescheduler.h"
+#include "vizwidget.h"
+
+#include <algorithm>
+
+FrameScheduler::FrameScheduler(QObject *parent) :
+    QObject(parent)
+{
+    running = false;
+
+    timer.setSingleShot(true);
+    connect(&timer,SIGNAL(timeout()),this,SLOT(runFrame()));
+}
+
+void FrameScheduler::requestFrame(VizWidget *w)
+{
+    for(int i=0; i<pendingWidgets.size(); i++)
+        if(pendingWidgets.at(i) == w)
+            return;
+
+    pendingWidgets.push_back(QPointer<VizWidget>(w));
+    schedule();
+}
+
+void FrameScheduler::postJob(const QString &key, const std::function<void()> &fn)
+{
+    // A newer post replaces the pending one, so a burst runs only once
+    for(int i=0; i<pendingJobs.size(); i++)
+    {
+        if(pendingJobs.at(i).first == key)
+        {
+            pendingJobs[i].second = fn;
+            return;
+        }
+    }
+
+    pendingJobs.push_back(qMakePair(key,fn));
+    schedule();
+}
+
+qint64 FrameScheduler::remainingBudget() const
+{
+    if(!running)
+        return FRAME_BUDGET_MS;
+
+    return std::max((qint64)0,FRAME_BUDGET_MS-frameClock.elapsed());
+}
+
+void FrameScheduler::schedule()
+{
+    // Requests made while a frame runs are picked up when it finishes
+    if(running || timer.isActive())
+        return;
+
+    int delay = 0;
+    if(lastFrame.isValid())
+        delay = std::max((qint64)0,FRAME_INTERVAL_MS-lastFrame.elapsed());
+
+    timer.start(delay);
+}
+
+void FrameScheduler::runFrame()
+{
+    running = true;
+    frameClock.start();
+    lastFrame.start();
+
+    // Jobs first, they may request frames of views updated below
+    while(!pendingJobs.isEmpty())
+    {
+        QVector<QPair<QString,std::function<void()> > > jobs;
+        jobs.swap(pendingJobs);
+        for(int i=0; i<jobs.size(); i++)
+            jobs[i].second();
+    }
+
+    QVector<QPointer<VizWidget> > widgets;
+    widgets.swap(pendingWidgets);
+    for(int i=0; i<widgets.size(); i++)
+    {
+        if(!widgets.at(i).isNull())
+            widgets[i]->frameUpdate();
+    }
+
+    running = false;
+
+    // Unfinished progressive work or animation asked for another frame
+    if(!pendingWidgets.isEmpty() || !pendingJobs.isEmpty())
+        schedule();
+}
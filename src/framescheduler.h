@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QVector>
+#include <QPair>
+
+#include <functional>
+
+#define FRAME_INTERVAL_MS 16
+#define FRAME_BUDGET_MS 12
+
+class VizWidget;
+
+// Runs frames only when something asked for one. Views request a frame when
+// their state changes, compute jobs are posted under a key so repeated posts
+// before the next frame collapse into one. A frame runs the pending jobs, then
+// updates the requesting views, and is never started sooner than one frame
+// interval after the previous one.
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameScheduler(QObject *parent = 0);
+
+    void requestFrame(VizWidget *w);
+    void postJob(const QString &key, const std::function<void()> &fn);
+
+    // Milliseconds left of the budget of the frame being run
+    qint64 remainingBudget() const;
+    bool inFrame() const { return running; }
+
+private slots:
+    void runFrame();
+
+private:
+    void schedule();
+
+private:
+    QTimer timer;
+    QElapsedTimer frameClock;
+    QElapsedTimer lastFrame;
+    bool running;
+
+    QVector<QPointer<VizWidget> > pendingWidgets;
+    QVector<QPair<QString,std::function<void()> > > pendingJobs;
+};
+
+#endif // FRAMESCHEDULER_H
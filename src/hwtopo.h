@@ -42,6 +42,7 @@
 #include <QFile>
 #include <QXmlStreamReader>
 #include <QMap>
+#include <QVector>
 
 #include <vector>
 
@@ -56,8 +57,15 @@ struct SampleSet
 {
     int totCycles;
     int selCycles;
+    int totWeight;      // samples counted with their weight
+    int selWeight;
     ElemSet totSamples;
     ElemSet selSamples;
+
+    // Per selection group, indexed by group id up to DataObject::maxGroup().
+    // Group 0 counts the unselected samples.
+    QVector<int> groupWeights;
+    QVector<int> groupCycles;
 };
 
 // class hwNode
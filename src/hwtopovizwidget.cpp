@@ -39,6 +39,7 @@
 #include "hwtopovizwidget.h"
 
 #include <iostream>
+#include <algorithm>
 #include <cmath>
 
 using namespace std;
@@ -107,6 +108,7 @@ void HWTopoVizWidget::processData()
     processed = true;
 
     needsCalcMinMaxes = true;
+    requestFrame();
 }
 
 void HWTopoVizWidget::selectionChangedSlot()
@@ -115,6 +117,7 @@ void HWTopoVizWidget::selectionChangedSlot()
         return;
 
     needsCalcMinMaxes = true;
+    requestFrame();
 }
 
 void HWTopoVizWidget::visibilityChangedSlot()
@@ -123,6 +126,7 @@ void HWTopoVizWidget::visibilityChangedSlot()
         return;
 
     needsCalcMinMaxes = true;
+    requestFrame();
 }
 
 void HWTopoVizWidget::drawTopo(QPainter *painter, QRectF rect, ColorMap &cm, QVector<NodeBox> &nb, QVector<LinkBox> &lb)
@@ -220,6 +224,8 @@ void HWTopoVizWidget::mouseMoveEvent(QMouseEvent* e)
 
         int numCycles = 0;
         int numSamples = 0;
+        QVector<int> groupSamples;
+        QVector<int> groupCycles;
         //QMap<DataObject*,SampleSet>*sampleSets = (QMap<DataObject*,SampleSet>*)c->attrib["sampleSets"];
         // numSamples += (*sampleSets)[dataSet].selSamples.size();
         // numCycles += (*sampleSets)[dataSet].selCycles;
@@ -235,8 +241,16 @@ void HWTopoVizWidget::mouseMoveEvent(QMouseEvent* e)
         c->GetAllDpByType(&dp_vec, SYS_SAGE_MITOS_SAMPLE, direction);
         for(DataPath* dp : dp_vec) {
             SampleSet *ss = (SampleSet*)dp->attrib["sample_set"];
-            numSamples += ss->selSamples.size();
+            numSamples += ss->selWeight;
             numCycles += ss->selCycles;
+
+            groupSamples.resize(std::max(groupSamples.size(),ss->groupWeights.size()));
+            groupCycles.resize(groupSamples.size());
+            for(int g=0; g<ss->groupWeights.size(); g++)
+            {
+                groupSamples[g] += ss->groupWeights.at(g);
+                groupCycles[g] += ss->groupCycles.value(g);
+            }
         }
 
         label += "Samples: " + QString::number(numSamples) + "\n";
@@ -245,6 +259,20 @@ void HWTopoVizWidget::mouseMoveEvent(QMouseEvent* e)
         label += "\n";
         label += "Cycles/Access: " + QString::number((float)numCycles / (float)numSamples) + "\n";
 
+        // Compare the selection groups on this component
+        if(dataSet->maxGroup() > 1)
+        {
+            label += "\n";
+            for(int g=1; g<groupSamples.size(); g++)
+            {
+                if(groupSamples.at(g) == 0)
+                    continue;
+                label += QString("Group %1: %2 samples, %3 cycles/access\n")
+                         .arg(g).arg(groupSamples.at(g))
+                         .arg((float)groupCycles.at(g) / (float)groupSamples.at(g));
+            }
+        }
+
         QToolTip::showText(e->globalPos(),label,this, rect() );
     }
     else
@@ -261,7 +289,7 @@ void HWTopoVizWidget::resizeEvent(QResizeEvent *e)
         return;
 
     needsConstructNodeBoxes = true;
-    frameUpdate();
+    requestFrame();
 }
 
 void HWTopoVizWidget::calcMinMaxes()
@@ -291,7 +319,7 @@ void HWTopoVizWidget::calcMinMaxes()
             // ElemSet &samples = (*sampleSets)[dataSet].selSamples;
             // int numCycles = (*sampleSets)[dataSet].selCycles;
 
-            ElemSet samples;
+            int numSamples = 0;
             int numCycles = 0;
             int direction;
             if(c->GetComponentType() == SYS_SAGE_COMPONENT_THREAD)
@@ -304,12 +332,12 @@ void HWTopoVizWidget::calcMinMaxes()
             c->GetAllDpByType(&dp_vec, SYS_SAGE_MITOS_SAMPLE, direction);
             for(DataPath* dp : dp_vec) {
                 SampleSet *ss = (SampleSet*)dp->attrib["sample_set"];
-                samples.insert(ss->selSamples.begin(),ss->selSamples.end());
+                numSamples += ss->selWeight;
                 numCycles += ss->selCycles;
             }
 
 
-            qreal val = (dataMode == COLORBY_CYCLES) ? numCycles : samples.size();
+            qreal val = (dataMode == COLORBY_CYCLES) ? numCycles : numSamples;
             //val = (qreal)(*numCycles) / (qreal)samples->size();
 
             depthValRanges[i].first=0;//min(depthValRanges[i].first,val);
@@ -381,7 +409,7 @@ void HWTopoVizWidget::constructNodeBoxes(QRectF rect,
             nb.component->GetAllDpByType(&dp_vec, SYS_SAGE_MITOS_SAMPLE, direction);
             for(DataPath* dp : dp_vec) {
                 SampleSet *ss = (SampleSet*)dp->attrib["sample_set"];
-                numSamples += ss->selSamples.size();
+                numSamples += ss->selWeight;
                 numCycles += ss->selCycles;
             }
 
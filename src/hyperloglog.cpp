@@ -0,0 +1,88 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "hyperloglog.h"
+
+#include <algorithm>
+#include <cmath>
+
+HyperLogLog::HyperLogLog(int precision)
+{
+    p = std::max(HLL_MIN_PRECISION,std::min(HLL_MAX_PRECISION,precision));
+    regs.fill(0,1 << p);
+}
+
+void HyperLogLog::merge(const HyperLogLog &other)
+{
+    if(other.p != p)
+        return;
+
+    quint8 *r = regs.data();
+    const quint8 *o = other.regs.constData();
+    for(int i=0; i<regs.size(); i++)
+        r[i] = std::max(r[i],o[i]);
+}
+
+qreal HyperLogLog::estimate() const
+{
+    int m = regs.size();
+    qreal sum = 0;
+    int zeros = 0;
+    for(int i=0; i<m; i++)
+    {
+        sum += std::ldexp(1.0,-regs.at(i));
+        zeros += regs.at(i) == 0;
+    }
+
+    qreal alpha;
+    if(m == 16)
+        alpha = 0.673;
+    else if(m == 32)
+        alpha = 0.697;
+    else if(m == 64)
+        alpha = 0.709;
+    else
+        alpha = 0.7213/(1+1.079/m);
+
+    // Linear counting is more accurate while many registers are empty. The
+    // 64 bit hash needs no large range correction.
+    qreal e = alpha*m*m/sum;
+    if(e <= 2.5*m && zeros > 0)
+        e = m*std::log((qreal)m/zeros);
+    return e;
+}
@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#include <QVector>
+#include <QtAlgorithms>
+
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 16
+
+// Distinct count sketch (Flajolet et al. HyperLogLog) with 2^precision one
+// byte registers, relative error about 1.04/sqrt(2^precision). Merging two
+// sketches of equal precision gives the sketch of the union.
+class HyperLogLog
+{
+public:
+    explicit HyperLogLog(int precision = 12);
+
+    int precision() const { return p; }
+
+    void add(quint64 key)
+    {
+        quint64 h = hash(key);
+        quint64 rest = h << p;
+        quint8 rank = rest ? qCountLeadingZeroBits(rest)+1 : 64-p+1;
+        quint8 &r = regs[(int)(h >> (64-p))];
+        if(rank > r)
+            r = rank;
+    }
+
+    void merge(const HyperLogLog &other);
+    qreal estimate() const;
+
+    // 64 bit finalizer of MurmurHash3, keys are often aligned addresses
+    static quint64 hash(quint64 key)
+    {
+        key ^= key >> 33;
+        key *= Q_UINT64_C(0xff51afd7ed558ccd);
+        key ^= key >> 33;
+        key *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+        key ^= key >> 33;
+        return key;
+    }
+
+private:
+    int p;
+    QVector<quint8> regs;
+};
+
+#endif // HYPERLOGLOG_H
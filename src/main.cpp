@@ -37,10 +37,18 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "mainwindow.h"
+#include "batch.h"
 #include <QApplication>
+#include <QCoreApplication>
 
 int main(int argc, char *argv[])
 {
+    if(isBatchMode(argc, argv))
+    {
+        QCoreApplication a(argc, argv);
+        return runBatch(a.arguments());
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
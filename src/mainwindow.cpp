@@ -43,8 +43,8 @@
 #include <iostream>
 using namespace std;
 
-#include <QTimer>
 #include <QFileDialog>
+#include <QShortcut>
 
 // NEW FEATURES
 // Mem topo 1d memory range
@@ -94,6 +94,10 @@ MainWindow::MainWindow(QWidget *parent) :
 
     // Visibility buttons
     connect(ui->hideSelected, SIGNAL(clicked()), this, SLOT(hideSelected()));
+
+    // Selection history
+    connect(new QShortcut(QKeySequence::Undo,this), SIGNAL(activated()), this, SLOT(undoSelection()));
+    connect(new QShortcut(QKeySequence::Redo,this), SIGNAL(activated()), this, SLOT(redoSelection()));
     connect(ui->showSelectedOnly, SIGNAL(clicked()), this, SLOT(showSelectedOnly()));
     connect(ui->showAll, SIGNAL(clicked()), this, SLOT(showAll()));
 
@@ -144,6 +148,24 @@ MainWindow::MainWindow(QWidget *parent) :
 
     vizWidgets.push_back(memViz);
 
+    /*
+     * Address / Time Viz
+     */
+
+    AddrTimeViz *addrTimeViz = new AddrTimeViz(this);
+    ui->addressTimeLayout->addWidget(addrTimeViz);
+
+    vizWidgets.push_back(addrTimeViz);
+
+    /*
+     * Application Context Viz
+     */
+
+    volumeVizWidget = new VolumeVizWidget(this);
+    ui->applicationLayout->addWidget(volumeVizWidget);
+
+    vizWidgets.push_back(volumeVizWidget);
+
     /*
      * Parallel Coords Viz
      */
@@ -161,29 +183,40 @@ MainWindow::MainWindow(QWidget *parent) :
      * All VizWidgets
      */
 
+    // Frames are only run when a widget asks for one
+    frameScheduler = new FrameScheduler(this);
+    computePool = new ComputePool(this);
+
     // Set viz widgets to use new data
     for(int i=0; i<vizWidgets.size(); i++)
     {
         vizWidgets[i]->setDataSet(dataSet);
         vizWidgets[i]->setConsole(con);
+        vizWidgets[i]->setFrameScheduler(frameScheduler);
+        vizWidgets[i]->setComputePool(computePool);
     }
 
     dataSet->setConsole(con);
+    dataSet->setComputePool(computePool);
 
     connect(con, SIGNAL(selectionChangedSig()), this, SLOT(selectionChangedSlot()));
+    connect(con, SIGNAL(visibilityChangedSig()), this, SLOT(visibilityChangedSlot()));
+    connect(con, SIGNAL(axesChangedSig()), this, SLOT(axesChangedSlot()));
 
     for(int i=0; i<vizWidgets.size(); i++)
     {
         connect(vizWidgets[i], SIGNAL(selectionChangedSig()), this, SLOT(selectionChangedSlot()));
-        connect(this, SIGNAL(selectionChangedSig()), vizWidgets[i], SLOT(selectionChangedSlot()));
         connect(vizWidgets[i], SIGNAL(visibilityChangedSig()), this, SLOT(visibilityChangedSlot()));
+
+        // The topology view reads the sample sets, which are filled in the
+        // background, and is refreshed once they are
+        if(vizWidgets[i] == memViz)
+            continue;
+
+        connect(this, SIGNAL(selectionChangedSig()), vizWidgets[i], SLOT(selectionChangedSlot()));
         connect(this, SIGNAL(visibilityChangedSig()), vizWidgets[i], SLOT(visibilityChangedSlot()));
     }
-
-    frameTimer = new QTimer(this);
-    frameTimer->setInterval(1000/60); // 60fps
-    connect(frameTimer,SIGNAL(timeout()),this,SLOT(frameUpdateAll()));
-    frameTimer->start();
+    connect(this, SIGNAL(topoSamplesChangedSig()), memViz, SLOT(selectionChangedSlot()));
 }
 
 MainWindow::~MainWindow()
@@ -194,20 +227,52 @@ void MainWindow::frameUpdateAll()
 {
     for(int i=0; i<vizWidgets.size(); i++)
     {
-        vizWidgets[i]->frameUpdate();
+        frameScheduler->requestFrame(vizWidgets[i]);
     }
 }
 
 void MainWindow::selectionChangedSlot()
 {
-    dataSet->selectionChanged();
-    emit selectionChangedSig();
+    // Coalesce bursts of selection changes into one update per frame
+    frameScheduler->postJob("selection",[this]()
+    {
+        dataSet->recordSelection();
+        collectTopoSamples();
+        emit selectionChangedSig();
+    });
 }
 
 void MainWindow::visibilityChangedSlot()
 {
-    dataSet->visibilityChanged();
-    emit visibilityChangedSig();
+    frameScheduler->postJob("visibility",[this]()
+    {
+        collectTopoSamples();
+        emit visibilityChangedSig();
+    });
+}
+
+void MainWindow::axesChangedSlot()
+{
+    for(int i=0; i<vizWidgets.size(); i++)
+    {
+        vizWidgets[i]->processData();
+    }
+    frameUpdateAll();
+    visibilityChangedSlot();
+}
+
+void MainWindow::collectTopoSamples()
+{
+    computePool->submit<TopoSelection>("topo",COMPUTE_SELECTION,this,
+                                       [this](const ComputeToken &token)
+    {
+        return dataSet->computeTopoSelection(token);
+    },
+    [this](const TopoSelection &sel)
+    {
+        dataSet->applyTopoSelection(sel);
+        emit topoSamplesChangedSig();
+    });
 }
 
 void errdiag(QString str)
@@ -235,6 +300,7 @@ int MainWindow::loadData()
     }
     //QString dataSetDir(dataDir+QString("/data/samples.out"));
     QString dataSetDir(dataDir+QString("/data/samples.csv"));
+    dataSet->setMergeDuplicates(ui->actionMerge_Duplicates->isChecked());
     err = dataSet->loadData(dataSetDir);
     if(err != 0)
     {
@@ -244,8 +310,8 @@ int MainWindow::loadData()
     for(int i=0; i<vizWidgets.size(); i++)
     {
         vizWidgets[i]->processData();
-        vizWidgets[i]->update();
     }
+    frameUpdateAll();
     visibilityChangedSlot();
     return 0;
 }
@@ -289,6 +355,18 @@ void MainWindow::deselectAll()
     selectionChangedSlot();
 }
 
+void MainWindow::undoSelection()
+{
+    if(dataSet->undoSelection())
+        selectionChangedSlot();
+}
+
+void MainWindow::redoSelection()
+{
+    if(dataSet->redoSelection())
+        selectionChangedSlot();
+}
+
 void MainWindow::showAll()
 {
     dataSet->showAll();
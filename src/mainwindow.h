@@ -41,7 +41,6 @@
 
 #include <QMainWindow>
 #include <QErrorMessage>
-#include <QTimer>
 
 #include <QVector>
 
@@ -50,12 +49,14 @@
 #include "varvizwidget.h"
 #include "pcvizwidget.h"
 #include "hwtopovizwidget.h"
+#include "addrtimevizwidget.h"
+#include "framescheduler.h"
 
 #include "hwtopo.h"
 #include "codeeditor.h"
 #include "console.h"
 
-//#include "volumevizwidget.h"
+#include "volumevizwidget.h"
 
 namespace Ui {
 class MainWindow;
@@ -72,11 +73,13 @@ public:
 signals:
     void selectionChangedSig();
     void visibilityChangedSig();
+    void topoSamplesChangedSig();
 
 public slots:
     void frameUpdateAll();
     void selectionChangedSlot();
     void visibilityChangedSlot();
+    void axesChangedSlot();
     int loadData();
     int selectDataDirectory();
     void showSelectedOnly();
@@ -85,15 +88,21 @@ public slots:
     void selectAllVisible();
     void selectAll();
     void deselectAll();
+    void undoSelection();
+    void redoSelection();
     void setSelectModeAND(bool on);
     void setSelectModeOR(bool on);
     void setSelectModeXOR(bool on);
     void setCodeLabel(QFile *file);
 
+private:
+    void collectTopoSamples();
+
 private:
     Ui::MainWindow *ui;
 
-    QTimer *frameTimer;
+    FrameScheduler *frameScheduler;
+    ComputePool *computePool;
 
     CodeEditor *codeEditor;
     CodeViz *codeViz;
@@ -101,7 +110,7 @@ private:
     VarViz *varViz;
 
     QVector<VizWidget*> vizWidgets;
-    //VolumeVizWidget *volumeVizWidget;
+    VolumeVizWidget *volumeVizWidget;
 
     QString dataDir;
     DataObject *dataSet;
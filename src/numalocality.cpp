@@ -0,0 +1,346 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "numalocality.h"
+#include "parseUtil.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+NumaMap::NumaMap(DataObject *d)
+{
+    topology = false;
+
+    QVector<qint64> cpus = d->column(SampleAxes::cpu);
+    std::sort(cpus.begin(),cpus.end());
+    cpus.erase(std::unique(cpus.begin(),cpus.end()),cpus.end());
+
+    // Domain of every cpu, NUMA nodes win over chips when both exist
+    QVector<Component*> domain(cpus.size(),NULL);
+    bool haveNuma = false;
+    for(int i=0; i<cpus.size() && d->node; i++)
+    {
+        Component *numa = NULL, *chip = NULL;
+        Component *c = d->node->FindSubcomponentById(cpus.at(i), SYS_SAGE_COMPONENT_THREAD);
+        for(; c != NULL; c = c->GetParent())
+        {
+            if(!numa && c->GetComponentType() == SYS_SAGE_COMPONENT_NUMA)
+                numa = c;
+            if(!chip && c->GetComponentType() == SYS_SAGE_COMPONENT_CHIP)
+                chip = c;
+        }
+        domain[i] = numa ? numa : chip;
+        haveNuma = haveNuma || numa;
+    }
+
+    QHash<Component*,int> index;
+    for(int i=0; i<cpus.size(); i++)
+    {
+        Component *c = domain.at(i);
+        if(c && haveNuma && c->GetComponentType() != SYS_SAGE_COMPONENT_NUMA)
+            c = NULL;
+        if(c == NULL)
+            continue;
+
+        if(!index.contains(c))
+        {
+            index.insert(c,ids.size());
+            ids.push_back(c->GetId());
+        }
+        cpuNode.insert(cpus.at(i),index.value(c));
+    }
+
+    // Without domains every cpu is on one node
+    topology = !ids.isEmpty();
+    if(ids.isEmpty())
+        ids.push_back(0);
+}
+
+int NumaMap::homeOf(int node, int remote) const
+{
+    if(remote == 0)
+        return node;
+    if(remote == 1 && numNodes() == 2)
+        return 1-node;
+    return -1;
+}
+
+static inline void addAccess(LocalityAgg &a, int remote, const Sample &s)
+{
+    qreal latency = (qreal)s.latency*s.weight;
+    if(remote)
+    {
+        a.remote += s.weight;
+        a.remoteLatency += latency;
+    }
+    else
+    {
+        a.local += s.weight;
+        a.localLatency += latency;
+    }
+}
+
+static inline void mergeAgg(LocalityAgg &a, const LocalityAgg &b)
+{
+    a.local += b.local;
+    a.remote += b.remote;
+    a.localLatency += b.localLatency;
+    a.remoteLatency += b.remoteLatency;
+}
+
+static int numChunksFor(const Bitmap &mask)
+{
+    return parallelChunkCount(mask.numWords(),256);
+}
+
+NumaLocality numaLocality(DataObject *d, const Bitmap &mask, const NumaMap &map)
+{
+    const LocalityAgg zero = {0, 0, 0, 0};
+    int numNodes = std::min(map.numNodes(),NUMA_MAX_NODES);
+    const Sample *samples = d->samples.constData();
+    const quint64 *words = mask.constData();
+    int numWords = mask.numWords();
+    int numChunks = numChunksFor(mask);
+
+    QVector<QVector<LocalityAgg> > nodes(numChunks), vars(numChunks);
+    QVector<QVector<ElemIndex> > varSample(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        QVector<LocalityAgg> &n = nodes[c];
+        QVector<LocalityAgg> &v = vars[c];
+        QVector<ElemIndex> &vs = varSample[c];
+        n.fill(zero,numNodes);
+
+        int begin = (qint64)numWords*c/numChunks;
+        int end = (qint64)numWords*(c+1)/numChunks;
+        for(int w=begin; w<end; w++)
+        {
+            quint64 bits = words[w];
+            while(bits)
+            {
+                ElemIndex e = ((qint64)w << 6) + qCountTrailingZeroBits(bits);
+                bits &= bits-1;
+
+                const Sample &s = samples[e];
+                int remote = dseRemote(s.data_src_enc);
+                if(remote < 0)
+                    continue;
+
+                int node = map.nodeOf(s.cpu) % numNodes;
+                int var = s.variableUid;
+                if(var >= vs.size())
+                {
+                    v.resize((var+1)*numNodes);
+                    vs.resize(var+1);
+                }
+
+                addAccess(n[node],remote,s);
+                addAccess(v[var*numNodes+node],remote,s);
+                vs[var] = e;
+            }
+        }
+    });
+
+    NumaLocality result;
+    result.numNodes = numNodes;
+    result.numVariables = 0;
+    for(int c=0; c<numChunks; c++)
+        result.numVariables = std::max(result.numVariables,varSample.at(c).size());
+
+    result.nodes.fill(zero,numNodes);
+    result.variables.fill(zero,result.numVariables*numNodes);
+    result.variableSample.fill(0,result.numVariables);
+    for(int c=0; c<numChunks; c++)
+    {
+        for(int n=0; n<numNodes; n++)
+            mergeAgg(result.nodes[n],nodes.at(c).at(n));
+
+        // Chunks only grow their tables up to the variables they saw
+        for(int i=0; i<vars.at(c).size(); i++)
+            mergeAgg(result.variables[i],vars.at(c).at(i));
+        for(int i=0; i<varSample.at(c).size(); i++)
+        {
+            const LocalityAgg *a = vars.at(c).constData() + i*numNodes;
+            bool seen = false;
+            for(int n=0; n<numNodes; n++)
+                seen = seen || a[n].local || a[n].remote;
+            if(seen)
+                result.variableSample[i] = varSample.at(c).at(i);
+        }
+    }
+
+    return result;
+}
+
+struct PageAgg
+{
+    qint64 accesses[NUMA_MAX_NODES];
+    qint64 remote;
+    qreal remoteLatency;
+};
+
+typedef QHash<qint64,PageAgg> PageTable;
+
+QVector<PageRange> numaPageRanges(DataObject *d, const Bitmap &mask,
+                                  const NumaMap &map, int pageShift,
+                                  int maxRanges)
+{
+    int numNodes = std::min(map.numNodes(),NUMA_MAX_NODES);
+    const Sample *samples = d->samples.constData();
+    const quint64 *words = mask.constData();
+    int numWords = mask.numWords();
+    int numChunks = numChunksFor(mask);
+
+    QVector<PageTable> tables(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        PageTable &t = tables[c];
+        int begin = (qint64)numWords*c/numChunks;
+        int end = (qint64)numWords*(c+1)/numChunks;
+        for(int w=begin; w<end; w++)
+        {
+            quint64 bits = words[w];
+            while(bits)
+            {
+                const Sample &s = samples[((qint64)w << 6) + qCountTrailingZeroBits(bits)];
+                bits &= bits-1;
+
+                int remote = dseRemote(s.data_src_enc);
+                if(remote < 0)
+                    continue;
+
+                qint64 page = (quint64)s.addr >> pageShift;
+                PageTable::iterator it = t.find(page);
+                if(it == t.end())
+                {
+                    PageAgg p;
+                    std::memset(&p,0,sizeof(p));
+                    it = t.insert(page,p);
+                }
+
+                PageAgg &p = it.value();
+                p.accesses[map.nodeOf(s.cpu) % numNodes] += s.weight;
+                if(remote)
+                {
+                    p.remote += s.weight;
+                    p.remoteLatency += (qreal)s.latency*s.weight;
+                }
+            }
+        }
+    });
+
+    PageTable pages = tables.at(0);
+    for(int c=1; c<numChunks; c++)
+    {
+        for(PageTable::const_iterator it=tables.at(c).constBegin(); it!=tables.at(c).constEnd(); it++)
+        {
+            PageTable::iterator m = pages.find(it.key());
+            if(m == pages.end())
+            {
+                pages.insert(it.key(),it.value());
+                continue;
+            }
+
+            PageAgg &p = m.value();
+            for(int n=0; n<numNodes; n++)
+                p.accesses[n] += it.value().accesses[n];
+            p.remote += it.value().remote;
+            p.remoteLatency += it.value().remoteLatency;
+        }
+    }
+
+    QVector<qint64> order;
+    order.reserve(pages.size());
+    for(PageTable::const_iterator it=pages.constBegin(); it!=pages.constEnd(); it++)
+        order.push_back(it.key());
+    std::sort(order.begin(),order.end());
+
+    // A page belongs to the node with three quarters of its accesses,
+    // anything more spread out is better interleaved
+    QVector<PageRange> ranges;
+    for(int i=0; i<order.size(); i++)
+    {
+        const PageAgg &p = pages[order.at(i)];
+        qint64 total = 0, most = 0;
+        int home = 0;
+        for(int n=0; n<numNodes; n++)
+        {
+            total += p.accesses[n];
+            if(p.accesses[n] > most)
+            {
+                most = p.accesses[n];
+                home = n;
+            }
+        }
+        if(most*4 < total*3)
+            home = NUMA_INTERLEAVE;
+
+        if(ranges.isEmpty() || ranges.last().last+1 != order.at(i) || ranges.last().home != home)
+        {
+            PageRange r;
+            r.first = order.at(i);
+            r.last = order.at(i);
+            r.pages = 0;
+            r.accesses.fill(0,numNodes);
+            r.remote = 0;
+            r.remoteLatency = 0;
+            r.home = home;
+            ranges.push_back(r);
+        }
+
+        PageRange &r = ranges.last();
+        r.last = order.at(i);
+        r.pages++;
+        for(int n=0; n<numNodes; n++)
+            r.accesses[n] += p.accesses[n];
+        r.remote += p.remote;
+        r.remoteLatency += p.remoteLatency;
+    }
+
+    ranges.erase(std::remove_if(ranges.begin(),ranges.end(),
+                                [](const PageRange &r) { return r.remote == 0; }),
+                 ranges.end());
+    std::sort(ranges.begin(),ranges.end(),
+              [](const PageRange &a, const PageRange &b)
+              { return a.remoteLatency > b.remoteLatency; });
+    if(maxRanges >= 0 && ranges.size() > maxRanges)
+        ranges.resize(maxRanges);
+
+    return ranges;
+}
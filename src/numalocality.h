@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef NUMALOCALITY_H
+#define NUMALOCALITY_H
+
+#include <QVector>
+#include <QHash>
+
+#include "dataobject.h"
+
+// Nodes beyond this share counters with node % NUMA_MAX_NODES
+#define NUMA_MAX_NODES 16
+
+// PageRange::home of pages used evenly by several nodes
+#define NUMA_INTERLEAVE -1
+
+struct LocalityAgg
+{
+    qint64 local;
+    qint64 remote;
+    qreal localLatency;
+    qreal remoteLatency;
+};
+
+// NUMA domain of every cpu of the samples. Domains are the NUMA nodes of
+// the topology, or its chips when it has none.
+class NumaMap
+{
+public:
+    explicit NumaMap(DataObject *d);
+
+    int numNodes() const { return ids.size(); }
+    int nodeOf(int cpu) const { return cpuNode.value(cpu,0); }
+    qint64 nodeId(int node) const { return ids.at(node); }
+    bool fromTopology() const { return topology; }
+
+    // Node holding the data of a RAM access, -1 if it is remote with more
+    // than one candidate
+    int homeOf(int node, int remote) const;
+
+private:
+    QHash<int,int> cpuNode;
+    QVector<qint64> ids;
+    bool topology;
+};
+
+// Local and remote RAM accesses of every accessing node and of every
+// variable per accessing node. Only the console reports these; the topology
+// view still counts every RAM access on the accessing thread's domain.
+struct NumaLocality
+{
+    int numNodes;
+    int numVariables;
+    QVector<LocalityAgg> nodes;
+    QVector<LocalityAgg> variables;     // variable*numNodes + node
+    QVector<ElemIndex> variableSample;  // any sample of the variable
+
+    const LocalityAgg &at(int variable, int node) const
+    { return variables.at(variable*numNodes+node); }
+};
+
+NumaLocality numaLocality(DataObject *d, const Bitmap &mask, const NumaMap &map);
+
+// Adjacent pages with the same suggested placement
+struct PageRange
+{
+    qint64 first;       // page numbers, inclusive
+    qint64 last;
+    qint64 pages;       // pages with samples
+    QVector<qint64> accesses;   // RAM accesses per accessing node
+    qint64 remote;
+    qreal remoteLatency;
+
+    // Node to first-touch the range from, or NUMA_INTERLEAVE
+    int home;
+};
+
+// Page ranges of the RAM accesses in mask with remote traffic, highest
+// remote latency first
+QVector<PageRange> numaPageRanges(DataObject *d, const Bitmap &mask,
+                                  const NumaMap &map, int pageShift,
+                                  int maxRanges);
+
+#endif // NUMALOCALITY_H
@@ -0,0 +1,99 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "parallel.h"
+
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+int parallelWorkerCount()
+{
+    return std::max(1,QThreadPool::globalInstance()->maxThreadCount());
+}
+
+int parallelChunkCount(qint64 n, qint64 grain)
+{
+    // A few chunks per worker keeps the pool busy when chunks are uneven
+    grain = std::max((qint64)1,grain);
+    return (int)std::max((qint64)1,std::min((n+grain-1)/grain,(qint64)parallelWorkerCount()*4));
+}
+
+void parallelFor(qint64 n,
+                 const std::function<void(qint64,qint64)> &fn,
+                 qint64 grain)
+{
+    if(n <= 0)
+        return;
+
+    qint64 numChunks = parallelChunkCount(n,grain);
+    if(numChunks == 1 || parallelWorkerCount() == 1)
+    {
+        fn(0,n);
+        return;
+    }
+
+    qint64 chunkSize = (n+numChunks-1)/numChunks;
+
+    QVector<IndexRange> chunks;
+    for(qint64 begin=0; begin<n; begin+=chunkSize)
+        chunks.push_back(IndexRange(begin,std::min(n,begin+chunkSize)));
+
+    QtConcurrent::blockingMap(chunks,[&fn](IndexRange &r) { fn(r.first,r.second); });
+}
+
+void parallelTasks(int count, const std::function<void(int)> &fn)
+{
+    if(count <= 0)
+        return;
+
+    if(count == 1 || parallelWorkerCount() == 1)
+    {
+        for(int i=0; i<count; i++)
+            fn(i);
+        return;
+    }
+
+    QVector<int> tasks(count);
+    for(int i=0; i<count; i++)
+        tasks[i] = i;
+
+    QtConcurrent::blockingMap(tasks,[&fn](int &i) { fn(i); });
+}
@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QtGlobal>
+#include <QPair>
+
+#include <functional>
+
+typedef QPair<qint64,qint64> IndexRange;
+
+// Number of worker threads available in the global thread pool
+int parallelWorkerCount();
+
+// Number of chunks to split n units of work into, about grain units each
+// but no more than a few per worker. Always at least one.
+int parallelChunkCount(qint64 n, qint64 grain);
+
+// Partition in [0,1 << bits) of a key, from the top bits of a Fibonacci hash
+inline int hashPartition(quint64 key, int bits)
+{
+    return (int)((key * Q_UINT64_C(0x9E3779B97F4A7C15)) >> (64-bits));
+}
+
+// Split [0,n) into contiguous chunks of at least grain elements and call
+// fn(begin,end) for each chunk on the global thread pool. Blocks until done.
+void parallelFor(qint64 n,
+                 const std::function<void(qint64,qint64)> &fn,
+                 qint64 grain = 4096);
+
+// Call fn(i) for every i in [0,count) as an independent task. Blocks until done.
+void parallelTasks(int count, const std::function<void(int)> &fn);
+
+#endif // PARALLEL_H
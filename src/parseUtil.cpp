@@ -94,6 +94,22 @@ int dseDirty(int enc)
     return -1;
 }
 
+int dseRemote(int enc)
+{
+    int src = enc & 0xF;
+    switch(src)
+    {
+        case(0x8): return 0; // local ram?
+        case(0xA): return 0; // local RAM (clean)
+        case(0xB): return 1; // remote RAM (clean)
+        case(0xC): return 0; // local RAM (dirty)
+        case(0xD): return 1; // remote RAM (dirty)
+    }
+
+    // Not from RAM
+    return -1;
+}
+
 
 std::string encToString(int enc)
 {
@@ -132,3 +148,66 @@ int dseLocked(int enc)
 {
     return enc & 0x20;
 }
+
+int dseFlags(int enc)
+{
+    int src = enc & 0xF;
+    int flags = 0;
+    if(dseSTLB(enc))
+        flags |= DSE_FLAG_STLB;
+    if(dseLocked(enc))
+        flags |= DSE_FLAG_LOCKED;
+    if(dseDirty(enc) == 1 || src == 0x7)
+        flags |= DSE_FLAG_DIRTY;
+    if(src >= 0x5 && src <= 0x7)
+        flags |= DSE_FLAG_SNOOP;
+    if(dseRemote(enc) == 1)
+        flags |= DSE_FLAG_REMOTE;
+    return flags;
+}
+
+QString quoteCSVField(const QString &field)
+{
+    if(!field.contains(',') && !field.contains('"') &&
+       !field.contains('\n') && !field.contains('\r'))
+        return field;
+
+    QString quoted = field;
+    quoted.replace("\"","\"\"");
+    return "\""+quoted+"\"";
+}
+
+QStringList splitCSVLine(const QString &line, bool *complete)
+{
+    QStringList fields;
+    QString field;
+    bool quoted = false;
+
+    for(int i=0; i<line.size(); i++)
+    {
+        QChar c = line.at(i);
+        if(quoted)
+        {
+            if(c != '"')
+                field += c;
+            else if(i+1 < line.size() && line.at(i+1) == '"')
+                field += line.at(++i);
+            else
+                quoted = false;
+        }
+        else if(c == '"')
+            quoted = true;
+        else if(c == ',')
+        {
+            fields.push_back(field);
+            field.clear();
+        }
+        else
+            field += c;
+    }
+    fields.push_back(field);
+
+    if(complete)
+        *complete = !quoted;
+    return fields;
+}
@@ -38,10 +38,28 @@
 
 #include <QVector>
 #include <QString>
+#include <QStringList>
+
+// Bits of dseFlags()
+#define DSE_FLAG_STLB   0x1
+#define DSE_FLAG_LOCKED 0x2
+#define DSE_FLAG_DIRTY  0x4
+#define DSE_FLAG_SNOOP  0x8
+#define DSE_FLAG_REMOTE 0x10
 
 size_t createUniqueID(QVector<QString> &existing, QString name);
 int dseDepth(int enc);
 int dseDirty(int enc);
+int dseRemote(int enc);
 std::string encToString(int enc);
 int dseSTLB(int enc);
 int dseLocked(int enc);
+int dseFlags(int enc);
+
+// CSV fields as in RFC 4180: a field containing a comma, quote or line
+// break is quoted, with embedded quotes doubled
+QString quoteCSVField(const QString &field);
+
+// Splits one record; complete is set to false if the record ends inside a
+// quoted field and continues on the next line
+QStringList splitCSVLine(const QString &line, bool *complete = 0);
@@ -39,12 +39,28 @@
 #include "pcvizwidget.h"
 
 #include <QPaintEvent>
+#include <QResizeEvent>
+#include <QElapsedTimer>
 #include <QMenu>
 
 #include <iostream>
 #include <algorithm>
 
 #include "util.h"
+#include "parallel.h"
+
+// Layer 0 holds unselected lines, then one layer per non-empty selection
+// group. Past PC_MAX_GROUP_LAYERS groups the rest share the last layer, so
+// the rasters stay a few planes however many groups clustering makes.
+#define LAYER_UNSELECTED 0
+#define PC_MAX_GROUP_LAYERS 16
+#define LAYER_FOLDED_GROUPS -1
+
+// Color of a layer's selection group, gray for the layer of folded groups
+static QColor layerColor(int group)
+{
+    return (group == LAYER_FOLDED_GROUPS) ? QColor(128,128,128) : groupColor(group);
+}
 
 PCVizWidget::PCVizWidget(QWidget *parent)
     : VizWidget(parent)
@@ -66,15 +82,26 @@ PCVizWidget::PCVizWidget(QWidget *parent)
     needsCalcMinMaxes = true;
     needsProcessData = true;
     needsProcessSelection = true;
-    needsRecalcLines = true;
+    needsRecalcLineLayers = true;
+    needsRasterize = true;
+    needsToneMap = true;
     needsRepaint = true;
 
+    calcGroupLayers(histGroupLayers,histLayerGroups);
+    calcGroupLayers(lineGroupLayers,lineLayerGroups);
+    numHistLayers = 1;
+    lineRaster.setNumLayers(1);
+    visVersion = 0;
+
     selOpacity = 0.4;
     unselOpacity = 0.1;
 
     numHistBins = 100;
     showHistograms = true;
 
+    histProgress = 0;
+    rasterProgress = 0;
+
     cursorPos.setX(-1);
     selectionAxis = -1;
     animationAxis = -1;
@@ -89,11 +116,6 @@ PCVizWidget::PCVizWidget(QWidget *parent)
             this, SLOT(showContextMenu(const QPoint &)));
 }
 
-#define LINES_PER_DATAPT    (numDimensions-1)
-#define POINTS_PER_LINE     2
-#define FLOATS_PER_POINT    2
-#define FLOATS_PER_COLOR    4
-
 void PCVizWidget::processData()
 {
     processed = false;
@@ -101,15 +123,11 @@ void PCVizWidget::processData()
     if(dataSet->empty())
         return;
 
-    // numDimensions = dataSet->numDimensions;
-    numDimensions = NUM_SAMPLE_AXES;
+    numDimensions = dataSet->numAxes();
 
     dimMins.resize(numDimensions);
     dimMaxes.resize(numDimensions);
 
-    dimMins.fill(std::numeric_limits<double>::max());
-    dimMaxes.fill(std::numeric_limits<double>::min());
-
     selMins.resize(numDimensions);
     selMaxes.resize(numDimensions);
 
@@ -119,6 +137,7 @@ void PCVizWidget::processData()
     axesPositions.resize(numDimensions);
     axesOrder.resize(numDimensions);
 
+    histCounts.resize(numDimensions);
     histVals.resize(numDimensions);
     histMaxVals.resize(numDimensions);
     histMaxVals.fill(0);
@@ -131,21 +150,32 @@ void PCVizWidget::processData()
 
         axesPositions[axesOrder[i]] = i*(1.0/(numDimensions-1));
 
-        histVals[i].resize(numHistBins);
+        // Bins of every layer side by side, layer*numHistBins+bin
+        histCounts[i].resize(numHistLayers*numHistBins);
+        histCounts[i].fill(0);
+        histVals[i].resize(numHistLayers*numHistBins);
         histVals[i].fill(0);
     }
 
     processed = true;
 
+    // Histograms follow once the new ranges are in
     needsCalcMinMaxes = true;
-    needsCalcHistBins = true;
-    needsRecalcLines = true;
 }
 
 void PCVizWidget::leaveEvent(QEvent *e)
 {
     VizWidget::leaveEvent(e);
     needsRepaint = true;
+    requestFrame();
+}
+
+void PCVizWidget::resizeEvent(QResizeEvent *e)
+{
+    VizWidget::resizeEvent(e);
+    needsRasterize = true;
+    needsRepaint = true;
+    requestFrame();
 }
 
 void PCVizWidget::mousePressEvent(QMouseEvent *mouseEvent)
@@ -182,6 +212,7 @@ void PCVizWidget::mouseReleaseEvent(QMouseEvent *event)
     }
 
     needsProcessSelection = true;
+    requestFrame();
 
     movingAxis = -1;
     selectionAxis = -1;
@@ -250,7 +281,8 @@ bool PCVizWidget::eventFilter(QObject *obj, QEvent *event)
                 }
             }
 
-            needsRecalcLines = true;
+            // Line geometry is per axis, only the raster changes
+            needsRasterize = true;
             needsRepaint = true;
         }
     }
@@ -258,6 +290,10 @@ bool PCVizWidget::eventFilter(QObject *obj, QEvent *event)
     prevMousePos = mousePos;
     prevCursorPos = cursorPos;
 
+    // Mouse moves only post a frame, a burst of them is drawn once
+    if(needsRepaint)
+        requestFrame();
+
     return false;
 }
 
@@ -327,7 +363,7 @@ void PCVizWidget::processSelection()
         selMaxes.fill(-1);
     }
 
-    needsRecalcLines = true;
+    needsRecalcLineLayers = true;
 
     emit selectionChangedSig();
 }
@@ -337,33 +373,53 @@ void PCVizWidget::calcMinMaxes()
     if(!processed)
         return;
 
-    dimMins.fill(std::numeric_limits<double>::max());
-    dimMaxes.fill(std::numeric_limits<double>::min());
+    // Ranges and normalized lines only depend on visibility, computed in the
+    // background and swapped in whole
+    int dims = numDimensions;
+    runCompute<LineGeometry>("pclines",COMPUTE_VISIBILITY,
+                             [this,dims](const ComputeToken &token)
+    {
+        return calcLineGeometry(token,dims);
+    },
+    [this](const LineGeometry &g)
+    {
+        if(g.mins.size() != numDimensions)
+            return;
+
+        dimMins = g.mins;
+        dimMaxes = g.maxes;
+        lineSamples = g.samples;
+        lineCols = g.cols;
+        lineWeights = g.weights;
+
+        needsCalcHistBins = true;
+        needsRecalcLineLayers = true;
+        needsRepaint = true;
+        requestFrame();
+    });
+}
 
-    for( Sample s : dataSet->samples)
+void PCVizWidget::calcGroupLayers(QVector<quint8> &groupLayers, QVector<int> &layerGroups) const
+{
+    groupLayers.fill(LAYER_UNSELECTED,MAX_SELECTION_GROUPS+1);
+    layerGroups.fill(LAYER_UNSELECTED,1);
+    if(dataSet == NULL || dataSet->numElements == 0)
+        return;
+
+    QVector<int> used;
+    for(int g=1; g<=dataSet->maxGroup(); g++)
+        if(dataSet->numSelectedIn(g) > 0)
+            used.push_back(g);
+
+    int numOwn = (used.size() > PC_MAX_GROUP_LAYERS) ? PC_MAX_GROUP_LAYERS-1 : used.size();
+    for(int i=0; i<used.size(); i++)
     {
-        if(!dataSet->visible(s.sampleId))
-            continue;
-        for(int i=0; i<numDimensions; i++)
-        {
-            long long val = dataSet->GetSampleAttribByIndex(&s, i);
-            dimMins[i] = std::min(dimMins[i],(qreal)val);
-            dimMaxes[i] = std::max(dimMaxes[i],(qreal)val);
-        }
+        if(i < numOwn)
+            layerGroups.push_back(used.at(i));
+        else if(i == numOwn)
+            layerGroups.push_back(LAYER_FOLDED_GROUPS);
+        groupLayers[used.at(i)] = layerGroups.size()-1;
     }
-    // int elem;
-    // QVector<qreal>::Iterator p;
-    // for(elem=0, p=dataSet->begin; p!=dataSet->end; elem++, p+=numDimensions)
-    // {
-    //     if(!dataSet->visible(elem))
-    //         continue;
-    //
-    //     for(int i=0; i<numDimensions; i++)
-    //     {
-    //         dimMins[i] = std::min(dimMins[i],*(p+i));
-    //         dimMaxes[i] = std::max(dimMaxes[i],*(p+i));
-    //     }
-    // }
 }
 
 void PCVizWidget::calcHistBins()
@@ -371,175 +427,281 @@ void PCVizWidget::calcHistBins()
     if(!processed)
         return;
 
-    histMaxVals.fill(0);
-
-    for( Sample s : dataSet->samples)
+    // Restart the progressive passes, refine() fills the bins. One layer
+    // per non-empty group up to the cap.
+    calcGroupLayers(histGroupLayers,histLayerGroups);
+    numHistLayers = histLayerGroups.size();
+    for(int i=0; i<numDimensions; i++)
     {
-        if(dataSet->selectionDefined() && !dataSet->selected(s.sampleId))
-            continue;
+        histCounts[i].fill(0,numHistLayers*numHistBins);
+        histVals[i].fill(0,numHistLayers*numHistBins);
+    }
 
-        for(int i=0; i<numDimensions; i++)
+    histProgress = 0;
+}
+
+void PCVizWidget::refineHistBins(qint64 end)
+{
+    if(!processed)
+        return;
+
+    end = std::min(end,(qint64)dataSet->numElements);
+    if(end <= histProgress)
+        return;
+
+    const ElemIndex *order = dataSet->progressiveOrder.constData();
+    const Sample *samples = dataSet->samples.constData();
+    const quint8 *groups = dataSet->groupColumn();
+    const quint8 *layers = histGroupLayers.constData();
+    bool selectionDefined = dataSet->selectionDefined();
+
+    QVector<qreal*> counts(numDimensions);
+    for(int i=0; i<numDimensions; i++)
+        counts[i] = histCounts[i].data();
+
+    // Axes are independent, one task each. Every group gets its own bins in
+    // the same pass, without a selection all samples count as unselected.
+    parallelTasks(numDimensions,[&](int i)
+    {
+        qreal *axisCounts = counts.at(i);
+        qreal axisMin = dimMins.at(i);
+        qreal axisMax = dimMaxes.at(i);
+        for(qint64 o=histProgress; o<end; o++)
         {
-            long long val = dataSet->GetSampleAttribByIndex(&s, i);
+            ElemIndex elem = order[o];
+            // Groups made since the last restart have no layer yet and
+            // wait for the next one
+            int layer = layers[groups[elem]];
+            if(selectionDefined && layer == LAYER_UNSELECTED)
+                continue;
+
+            long long val = dataSet->GetSampleAttribByIndex(&samples[elem], i);
 
-            int histBin = floor(scale(val,dimMins[i],dimMaxes[i],0,numHistBins));
+            int histBin = floor(scale(val,axisMin,axisMax,0,numHistBins));
 
             if(histBin >= numHistBins)
                 histBin = numHistBins-1;
             if(histBin < 0)
                 histBin = 0;
 
-            histVals[i][histBin] += 1;
-            histMaxVals[i] = std::max(histMaxVals[i],histVals[i][histBin]);
+            axisCounts[layer*numHistBins+histBin] += samples[elem].weight;
         }
-    }
+    });
+
+    histProgress = end;
 
-    // int elem;
-    // QVector<qreal>::Iterator p;
-    // for(elem=0, p=dataSet->begin; p!=dataSet->end; elem++, p+=numDimensions)
-    // {
-    //     if(dataSet->selectionDefined() && !dataSet->selected(elem))
-    //         continue;
-    //
-    //     for(int i=0; i<numDimensions; i++)
-    //     {
-    //         int histBin = floor(scale(*(p+i),dimMins[i],dimMaxes[i],0,numHistBins));
-    //
-    //         if(histBin >= numHistBins)
-    //             histBin = numHistBins-1;
-    //         if(histBin < 0)
-    //             histBin = 0;
-    //
-    //         histVals[i][histBin] += 1;
-    //         histMaxVals[i] = std::max(histMaxVals[i],histVals[i][histBin]);
-    //     }
-    // }
-
-    // Scale hist values to [0,1]
+    // Scale hist values to [0,1] of the tallest stacked bin, a stratified
+    // prefix has the shape of the full set
     for(int i=0; i<numDimensions; i++)
+    {
+        histMaxVals[i] = 0;
         for(int j=0; j<numHistBins; j++)
-            histVals[i][j] = scale(histVals[i][j],0,histMaxVals[i],0,1);
+        {
+            qreal total = 0;
+            for(int l=0; l<numHistLayers; l++)
+                total += histCounts[i][l*numHistBins+j];
+            histMaxVals[i] = std::max(histMaxVals[i],total);
+        }
+
+        for(int j=0; j<numHistLayers*numHistBins; j++)
+            histVals[i][j] = scale(histCounts[i][j],0,histMaxVals[i],0,1);
+    }
 }
 
-void PCVizWidget::recalcLines(int dirtyAxis)
+PCVizWidget::LineGeometry PCVizWidget::calcLineGeometry(const ComputeToken &token, int dims) const
 {
-    QVector4D col;
-    QVector2D a, b;
-    int i, axis, nextAxis;//, elem;
-    // QVector<double>::Iterator p;
-
-    if(!processed)
-        return;
+    LineGeometry g;
+    g.mins.fill(std::numeric_limits<double>::max(),dims);
+    g.maxes.fill(std::numeric_limits<double>::min(),dims);
 
-    verts.clear();
-    colors.clear();
+    const Sample *samples = dataSet->samples.constData();
 
-    QVector4D redVec = QVector4D(255,0,0,255);
-    QColor dataSetColor = colorMap.at(0);
-    qreal Cr,Cg,Cb;
-    dataSetColor.getRgbF(&Cr,&Cg,&Cb);
-    QVector4D dataColor = QVector4D(Cr,Cg,Cb,1);
-
-    for( Sample s : dataSet->samples)
+    // Only the set bits of the visibility bitmap are touched
+    dataSet->visibilityMask().forEachSet([&](qint64 elem)
     {
-        if(!dataSet->visible(s.sampleId))
+        const Sample *s = &samples[elem];
+        for(int i=0; i<dims; i++)
         {
-            continue;
+            long long val = dataSet->GetSampleAttribByIndex(s, i);
+            g.mins[i] = std::min(g.mins[i],(qreal)val);
+            g.maxes[i] = std::max(g.maxes[i],(qreal)val);
         }
-        else if(dataSet->selected(s.sampleId))
+    });
+
+    if(token.cancelled())
+        return LineGeometry();
+
+    // Keep the progressive order so any prefix of lines is a stratified sample
+    for(ElemIndex o=0; o<dataSet->numElements; o++)
+    {
+        ElemIndex elem = dataSet->progressiveOrder.at(o);
+        if(dataSet->visible(elem))
+            g.samples.push_back(elem);
+    }
+
+    int numLines = g.samples.size();
+    const ElemIndex *lineIdx = g.samples.constData();
+
+    // Normalize every axis once per range change
+    g.weights.resize(numLines);
+    for(int l=0; l<numLines; l++)
+        g.weights[l] = samples[lineIdx[l]].weight;
+
+    g.cols.resize(dims);
+    QVector<float*> cols(dims);
+    for(int axis=0; axis<dims; axis++)
+    {
+        g.cols[axis].resize(numLines);
+        cols[axis] = g.cols[axis].data();
+    }
+
+    parallelFor(numLines,[&](qint64 begin, qint64 end)
+    {
+        if(token.cancelled())
+            return;
+
+        for(int axis=0; axis<dims; axis++)
         {
-            col = redVec;
-            col.setW(selOpacity);
+            float *col = cols.at(axis);
+            qreal axisMin = g.mins.at(axis);
+            qreal axisMax = g.maxes.at(axis);
+            for(qint64 l=begin; l<end; l++)
+            {
+                long long val = dataSet->GetSampleAttribByIndex(&samples[lineIdx[l]], axis);
+                col[l] = scale(val,axisMin,axisMax,0,1);
+            }
         }
-        else
+    });
+
+    if(token.cancelled())
+        return LineGeometry();
+
+    return g;
+}
+
+void PCVizWidget::recalcLineLayers()
+{
+    if(!processed)
+        return;
+
+    // Selection only changes the layer of each line, never its geometry
+    calcGroupLayers(lineGroupLayers,lineLayerGroups);
+    int numLines = lineSamples.size();
+    lineLayers.resize(numLines);
+    for(int l=0; l<numLines; l++)
+        lineLayers[l] = lineGroupLayers.at(dataSet->selected(lineSamples.at(l)));
+    lineRaster.setNumLayers(lineLayerGroups.size());
+
+    needsRasterize = true;
+}
+
+void PCVizWidget::updatePlotBBox()
+{
+    int mx=40;
+    int my=30;
+
+    plotBBox = QRectF(mx,my,
+                      width()-mx-mx,
+                      height()-my-my);
+}
+
+void PCVizWidget::rasterizeLines()
+{
+    if(!processed)
+        return;
+
+    updatePlotBBox();
+    lineRaster.resize(plotBBox.width(),plotBBox.height());
+
+    // One bundle of segments per pair of adjacent axes
+    lineRaster.clearBundles();
+    if(lineCols.size() == numDimensions && lineLayers.size() == lineSamples.size())
+    {
+        for(int i=0; i<numDimensions-1; i++)
         {
-            col = dataColor;
-            col.setW(unselOpacity);
+            int axis = axesOrder[i];
+            int nextAxis = axesOrder[i+1];
+            lineRaster.addBundle(axesPositions[axis],
+                                 axesPositions[nextAxis],
+                                 lineCols.at(axis).constData(),
+                                 lineCols.at(nextAxis).constData(),
+                                 lineLayers.constData(),
+                                 lineWeights.constData(),
+                                 lineLayers.size());
         }
+    }
 
-        for(i=0; i<numDimensions-1; i++)
-        {
-            if(dirtyAxis != -1  && i != dirtyAxis && i != dirtyAxis-1)
-                continue;
+    // Restart the progressive passes, refine() draws the lines
+    lineRaster.clear();
+    rasterProgress = 0;
 
-            axis = axesOrder[i];
-            nextAxis = axesOrder[i+1];
+    needsToneMap = true;
+}
 
-            float orig_aVal = dataSet->GetSampleAttribByIndex(&s, axis);
-            float aVal = scale(orig_aVal,dimMins[axis],dimMaxes[axis],0,1);
-            a = QVector2D(axesPositions[axis],aVal);
+void PCVizWidget::refineLines(qint64 end)
+{
+    if(!processed)
+        return;
+
+    end = std::min(end,(qint64)lineSamples.size());
+    if(end <= rasterProgress)
+        return;
 
-            float orig_bVal = dataSet->GetSampleAttribByIndex(&s, nextAxis);
-            float bVal = scale(orig_bVal,dimMins[nextAxis],dimMaxes[nextAxis],0,1);
-            b = QVector2D(axesPositions[nextAxis],bVal);
+    lineRaster.rasterize(rasterProgress,end);
+    rasterProgress = end;
 
-            verts.push_back(a.x());
-            verts.push_back(a.y());
+    needsToneMap = true;
+}
 
-            verts.push_back(b.x());
-            verts.push_back(b.y());
+void PCVizWidget::refine()
+{
+    if(!processed)
+        return;
 
-            colors.push_back(col.x());
-            colors.push_back(col.y());
-            colors.push_back(col.z());
-            colors.push_back(col.w());
+    qint64 numHistSamples = dataSet->numElements;
+    qint64 numLines = lineSamples.size();
 
-            colors.push_back(col.x());
-            colors.push_back(col.y());
-            colors.push_back(col.z());
-            colors.push_back(col.w());
-        }
+    // The first pass is drawn whatever it costs, later passes add one more
+    // stratified chunk at a time until the frame budget is spent. Any change
+    // of input restarts the passes, which cancels the remaining refinement.
+    qint64 budget = frameTimeLeft();
+    QElapsedTimer timer;
+    timer.start();
+    do
+    {
+        if(histProgress < numHistSamples)
+            refineHistBins(histProgress+PROGRESSIVE_STRATA);
+        if(rasterProgress < numLines)
+            refineLines(rasterProgress+PROGRESSIVE_STRATA);
+    }
+    while((histProgress < numHistSamples || rasterProgress < numLines) &&
+          timer.elapsed() < budget);
+
+    needsRepaint = true;
+}
+
+void PCVizWidget::toneMapLines()
+{
+    if(!processed)
+        return;
+
+    int numLayers = lineRaster.numLayers();
+    QVector<QColor> layerColors(numLayers);
+    QVector<qreal> layerOpacities(numLayers);
+    layerColors[LAYER_UNSELECTED] = colorMap.at(0);
+    layerOpacities[LAYER_UNSELECTED] = unselOpacity;
+    for(int l=1; l<numLayers; l++)
+    {
+        layerColors[l] = layerColor(lineLayerGroups.value(l,LAYER_FOLDED_GROUPS));
+        layerOpacities[l] = selOpacity;
     }
-    //
-    // for(p=dataSet->begin, elem=0; p!=dataSet->end; p+=numDimensions, elem++)
-    // {
-    //     if(!dataSet->visible(elem))
-    //     {
-    //         continue;
-    //     }
-    //     else if(dataSet->selected(elem))
-    //     {
-    //         col = redVec;
-    //         col.setW(selOpacity);
-    //     }
-    //     else
-    //     {
-    //         col = dataColor;
-    //         col.setW(unselOpacity);
-    //     }
-    //
-    //
-    //     for(i=0; i<numDimensions-1; i++)
-    //     {
-    //         if(dirtyAxis != -1  && i != dirtyAxis && i != dirtyAxis-1)
-    //             continue;
-    //
-    //         axis = axesOrder[i];
-    //         nextAxis = axesOrder[i+1];
-    //
-    //         float aVal = scale(*(p+axis),dimMins[axis],dimMaxes[axis],0,1);
-    //         a = QVector2D(axesPositions[axis],aVal);
-    //
-    //         float bVal = scale(*(p+nextAxis),dimMins[nextAxis],dimMaxes[nextAxis],0,1);
-    //         b = QVector2D(axesPositions[nextAxis],bVal);
-    //
-    //         verts.push_back(a.x());
-    //         verts.push_back(a.y());
-    //
-    //         verts.push_back(b.x());
-    //         verts.push_back(b.y());
-    //
-    //         colors.push_back(col.x());
-    //         colors.push_back(col.y());
-    //         colors.push_back(col.z());
-    //         colors.push_back(col.w());
-    //
-    //         colors.push_back(col.x());
-    //         colors.push_back(col.y());
-    //         colors.push_back(col.z());
-    //         colors.push_back(col.w());
-    //     }
-    // }
+
+    // Extrapolate a partial pass to the density of the full set
+    qreal densityScale = 1.0;
+    if(rasterProgress > 0)
+        densityScale = (qreal)lineSamples.size() / (qreal)rasterProgress;
+
+    lineImage = lineRaster.toneMap(layerColors,layerOpacities,densityScale);
 }
 
 void PCVizWidget::showContextMenu(const QPoint &pos)
@@ -558,35 +720,45 @@ void PCVizWidget::showContextMenu(const QPoint &pos)
 void PCVizWidget::selectionChangedSlot()
 {
     needsCalcHistBins = true;
-    needsRecalcLines = true;
+    needsRecalcLineLayers = true;
     needsRepaint = true;
+    requestFrame();
 }
 
 void PCVizWidget::visibilityChangedSlot()
 {
+    // Nothing flipped since the lines were built, e.g. show all twice
+    if(processed && dataSet->visibilityVersion() == visVersion)
+        return;
+    visVersion = dataSet->visibilityVersion();
+
     needsProcessData = true;
     needsCalcMinMaxes = true;
     needsRepaint = true;
+    requestFrame();
 }
 
 void PCVizWidget::setSelOpacity(int val)
 {
     selOpacity = (qreal)val/1000.0;
-    needsRecalcLines = true;
+    needsToneMap = true;
     needsRepaint = true;
+    requestFrame();
 }
 
 void PCVizWidget::setUnselOpacity(int val)
 {
     unselOpacity = (qreal)val/1000.0;
-    needsRecalcLines = true;
+    needsToneMap = true;
     needsRepaint = true;
+    requestFrame();
 }
 
 void PCVizWidget::setShowHistograms(bool checked)
 {
     showHistograms = checked;
     needsRepaint = true;
+    requestFrame();
 }
 
 void PCVizWidget::frameUpdate()
@@ -605,6 +777,10 @@ void PCVizWidget::frameUpdate()
             endAnimation();
             needsProcessSelection = false;
         }
+        else
+        {
+            requestFrame();
+        }
     }
 
     // Necessary updates
@@ -628,10 +804,30 @@ void PCVizWidget::frameUpdate()
         calcHistBins();
         needsCalcHistBins = false;
     }
-    if(needsRecalcLines)
+    if(needsRecalcLineLayers)
     {
-        recalcLines();
-        needsRecalcLines = false;
+        recalcLineLayers();
+        needsRecalcLineLayers = false;
+    }
+    if(needsRasterize)
+    {
+        rasterizeLines();
+        needsRasterize = false;
+    }
+
+    // Progressive refinement of histograms and lines, continued next frame
+    if(processed && (histProgress < (qint64)dataSet->numElements ||
+                     rasterProgress < (qint64)lineSamples.size()))
+    {
+        refine();
+        requestFrame();
+    }
+
+    if(needsToneMap)
+    {
+        toneMapLines();
+        needsToneMap = false;
+        needsRepaint = true;
     }
     if(needsRepaint)
     {
@@ -673,6 +869,7 @@ void PCVizWidget::beginAnimation()
 
     needsProcessSelection = true;
     needsRepaint = true;
+    requestFrame();
 }
 
 void PCVizWidget::endAnimation()
@@ -695,57 +892,16 @@ void PCVizWidget::endAnimation()
     animSet.clear();
 }
 
-void PCVizWidget::paintGL()
-{
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    if(!processed)
-        return;
-
-    makeCurrent();
-
-    int mx=40;
-    int my=30;
-
-    glViewport(mx,
-               my,
-               width()-2*mx,
-               height()-2*my);
-
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0.0, 1.0, 0.0, 1.0, 0, 1);
-
-    glShadeModel(GL_FLAT);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
-    glEnable(GL_MULTISAMPLE);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
-
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_COLOR_ARRAY);
-
-    glVertexPointer(FLOATS_PER_POINT,GL_FLOAT,0,verts.constData());
-    glColorPointer(FLOATS_PER_COLOR,GL_FLOAT,0,colors.constData());
-
-    //glDrawArrays(GL_LINES,0,verts.size() / POINTS_PER_LINE);
-
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_COLOR_ARRAY);
-}
-
 void PCVizWidget::drawQtPainter(QPainter *painter)
 {
     if(!processed)
         return;
 
-    int mx=40;
-    int my=30;
+    updatePlotBBox();
 
-    plotBBox = QRectF(mx,my,
-                      width()-mx-mx,
-                      height()-my-my);
+    // Draw line density
+    if(!lineImage.isNull())
+        painter->drawImage(plotBBox.topLeft(),lineImage);
 
     // Draw axes
     QPointF a = plotBBox.bottomLeft();
@@ -760,7 +916,7 @@ void PCVizWidget::drawQtPainter(QPainter *painter)
 
         painter->drawLine(a,b);
 
-        QString text = SampleAxes::SampleAxesNames[i];
+        QString text = dataSet->axisName(i);
         QPointF center = b - QPointF(fm.width(text)/2,15);
         painter->drawText(center,text);
 
@@ -812,7 +968,6 @@ void PCVizWidget::drawQtPainter(QPainter *painter)
         b = plotBBox.topLeft();
 
         painter->setPen(Qt::NoPen);
-        painter->setBrush(QColor(31,120,180));
         painter->setOpacity(0.7);
 
         for(int i=0; i<numDimensions; i++)
@@ -820,15 +975,26 @@ void PCVizWidget::drawQtPainter(QPainter *painter)
             a.setX(plotBBox.left() + axesPositions[i]*plotBBox.width());
             b.setX(a.x());
 
+            // Groups are stacked along each bin in their line colors
             for(int j=0; j<numHistBins; j++)
             {
                 qreal histTop = a.y()-(j+1)*(plotBBox.height()/numHistBins);
-                qreal histLeft = a.x();//-30*histVals[i][j];
                 qreal histBottom = a.y()-(j)*(plotBBox.height()/numHistBins);
-                qreal histRight = a.x()+60*histVals[i][j];
-                painter->drawRect(QRectF(QPointF(histLeft,histTop),QPointF(histRight,histBottom)));
+                qreal histLeft = a.x();
+                for(int l=0; l<numHistLayers; l++)
+                {
+                    qreal w = 60*histVals[i][l*numHistBins+j];
+                    if(w <= 0)
+                        continue;
+
+                    painter->setBrush(l == LAYER_UNSELECTED ? QColor(31,120,180)
+                                                            : layerColor(histLayerGroups.at(l)));
+                    painter->drawRect(QRectF(QPointF(histLeft,histTop),QPointF(histLeft+w,histBottom)));
+                    histLeft += w;
+                }
             }
 
+            painter->setBrush(Qt::NoBrush);
             painter->drawLine(a,b);
         }
     }
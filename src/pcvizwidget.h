@@ -40,9 +40,9 @@
 #define PCVIZWIDGET_H
 
 #include "vizwidget.h"
+#include "densityraster.h"
 
-#include <QVector2D>
-#include <QVector4D>
+#include <QImage>
 
 class PCVizWidget
         : public VizWidget
@@ -52,9 +52,6 @@ class PCVizWidget
 public:
     PCVizWidget(QWidget *parent = 0);
 
-public:
-    void recalcLines(int dirtyAxis = -1);
-
 signals:
     void lineSelected(int line);
 
@@ -72,10 +69,10 @@ public slots:
 
 protected:
     void processData();
-    void paintGL();
     void drawQtPainter(QPainter *painter);
 
     void leaveEvent(QEvent *e);
+    void resizeEvent(QResizeEvent *e);
     void mousePressEvent(QMouseEvent *e);
     void mouseReleaseEvent(QMouseEvent *e);
     bool eventFilter(QObject *obj, QEvent *event);
@@ -84,15 +81,37 @@ private:
     int getClosestAxis(int xval);
     void processSelection();
     void calcMinMaxes();
+    void calcGroupLayers(QVector<quint8> &groupLayers, QVector<int> &layerGroups) const;
     void calcHistBins();
+    void refineHistBins(qint64 end);
+    struct LineGeometry
+    {
+        QVector<qreal> mins;
+        QVector<qreal> maxes;
+        QVector<ElemIndex> samples;
+        QVector<QVector<float> > cols;
+        QVector<float> weights;
+    };
+    LineGeometry calcLineGeometry(const ComputeToken &token, int dims) const;
+    void recalcLineLayers();
+    void updatePlotBBox();
+    void rasterizeLines();
+    void refineLines(qint64 end);
+    void refine();
+    void toneMapLines();
 
 private:
-    bool needsRecalcLines;
+    bool needsRecalcLineLayers;
+    bool needsRasterize;
+    bool needsToneMap;
     bool needsCalcHistBins;
     bool needsCalcMinMaxes;
     bool needsProcessData;
     bool needsProcessSelection;
 
+    // Visibility the lines were last built from
+    quint64 visVersion;
+
     ElemSet animSet;
     bool emptySet;
 
@@ -102,6 +121,13 @@ private:
     QRectF plotBBox;
     ColorMap colorMap;
 
+    // Unselected plus one layer per non-empty selection group, see
+    // calcGroupLayers(). groupLayers maps a group to its layer and
+    // layerGroups a layer back to its group.
+    int numHistLayers;
+    QVector<quint8> histGroupLayers;
+    QVector<int> histLayerGroups;
+    QVector<QVector<qreal> > histCounts;
     QVector<QVector<qreal> > histVals;
     QVector<qreal> histMaxVals;
 
@@ -132,9 +158,22 @@ private:
     qreal selOpacity;
     qreal unselOpacity;
 
-    // OpenGL
-    QVector<GLfloat> verts;
-    QVector<GLfloat> colors;
+    // Line density. lineCols holds one normalized coordinate column per
+    // axis for the visible samples, so the segments between any two axes
+    // are just a pair of columns and reordering axes rebuilds nothing.
+    QVector<ElemIndex> lineSamples;
+    QVector<QVector<float> > lineCols;
+    QVector<float> lineWeights;     // a merged sample draws as weight lines
+    QVector<quint8> lineLayers;
+    QVector<quint8> lineGroupLayers;
+    QVector<int> lineLayerGroups;
+    DensityRaster lineRaster;
+    QImage lineImage;
+
+    // Progressive passes, number of entries of the progressive order
+    // (histograms) and of lineSamples (lines) accumulated so far
+    qint64 histProgress;
+    qint64 rasterProgress;
 };
 
 #endif // PARALLELCOORDINATESVIZ_H
@@ -0,0 +1,925 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "query.h"
+#include "dataobject.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// Planner costs, roughly in ns per unit of work
+#define QUERY_COST_SCAN 1.0     // per sample, column scan
+#define QUERY_COST_COLUMN 4.0   // per sample, building a column
+#define QUERY_COST_RANDOM 8.0   // per row, setting or testing a random bit
+#define QUERY_COST_SORT 30.0    // per sample and log2(n), building a sorted index
+#define QUERY_COST_STRING 20.0  // per sample, comparing a name
+#define QUERY_COST_HASH 40.0    // per sample, building posting lists
+#define QUERY_COST_WORD 1.0     // per 64 samples, combining bitmaps
+
+// Indices and posting lists are kept, their build cost is spread over reuses
+#define QUERY_INDEX_REUSE 8.0
+
+// Samples checked to estimate the selectivity of a predicate
+#define QUERY_ESTIMATE_SAMPLES 4096
+
+static const qint64 QMIN = std::numeric_limits<qint64>::min();
+static const qint64 QMAX = std::numeric_limits<qint64>::max();
+
+enum QueryTokenKind {
+    QTOK_WORD = 0,
+    QTOK_STRING,
+    QTOK_OP,
+    QTOK_LPAREN,
+    QTOK_RPAREN,
+    QTOK_COLON,
+    QTOK_END
+};
+
+struct QueryToken
+{
+    QueryTokenKind kind;
+    QString text;
+};
+
+static bool isWordChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == '_' || c == '.' || c == '-' || c == '/' || c == '+';
+}
+
+static QVector<QueryToken> tokenize(const QString &text, QString &error)
+{
+    QVector<QueryToken> tokens;
+    int i = 0;
+    while(i < text.size())
+    {
+        QChar c = text.at(i);
+        if(c.isSpace())
+        {
+            i++;
+            continue;
+        }
+
+        QueryToken t;
+        if(c == '(' || c == ')' || c == ':')
+        {
+            t.kind = (c == '(') ? QTOK_LPAREN : (c == ')') ? QTOK_RPAREN : QTOK_COLON;
+            t.text = c;
+            i++;
+        }
+        else if(c == '"' || c == '\'')
+        {
+            int end = text.indexOf(c,i+1);
+            if(end < 0)
+            {
+                error = "Unterminated string";
+                return QVector<QueryToken>();
+            }
+            t.kind = QTOK_STRING;
+            t.text = text.mid(i+1,end-i-1);
+            i = end+1;
+        }
+        else if(QString("=!<>~&|").contains(c))
+        {
+            QString two = text.mid(i,2);
+            t.kind = QTOK_OP;
+            if(two == "==" || two == "!=" || two == "<=" || two == ">=" || two == "&&" || two == "||")
+                t.text = two;
+            else
+                t.text = c;
+            i += t.text.size();
+        }
+        else if(isWordChar(c))
+        {
+            int start = i;
+            while(i < text.size() && isWordChar(text.at(i)))
+                i++;
+            t.kind = QTOK_WORD;
+            t.text = text.mid(start,i-start);
+        }
+        else
+        {
+            error = QString("Unexpected character '%1'").arg(c);
+            return QVector<QueryToken>();
+        }
+        tokens.push_back(t);
+    }
+
+    QueryToken end = {QTOK_END, QString()};
+    tokens.push_back(end);
+    return tokens;
+}
+
+static bool parseNumber(const QString &s, qreal &val)
+{
+    bool ok = false;
+    qint64 i = s.toLongLong(&ok,0);
+    if(ok)
+    {
+        val = i;
+        return true;
+    }
+    val = s.toDouble(&ok);
+    return ok;
+}
+
+static QueryNodePtr newNode(QueryNodeType type, const QString &text = QString())
+{
+    QueryNodePtr n(new QueryNode());
+    n->type = type;
+    n->axis = -1;
+    n->lo = QMIN;
+    n->hi = QMAX;
+    n->field = QFIELD_SOURCE;
+    n->substring = false;
+    n->resourceId = -1;
+    n->text = text;
+    n->access = QACCESS_SCAN;
+    n->rows = 0;
+    n->cost = 0;
+    return n;
+}
+
+static QueryNodePtr negate(QueryNodePtr child)
+{
+    QueryNodePtr n = newNode(QNODE_NOT,"NOT");
+    n->children.push_back(child);
+    return n;
+}
+
+// Resource types a resource predicate can name, l1 to l3 are cache levels
+static bool isResourceType(const QString &type)
+{
+    return type == "thread" || type == "hwthread" || type == "core" ||
+           type == "numa" || type == "chip" || type == "socket" ||
+           type == "cache" || type == "l1" || type == "l2" || type == "l3";
+}
+
+// Recursive descent over: or := and (OR and)*, and := unary ([AND] unary)*,
+// unary := NOT unary | '(' or ')' | predicate
+class QueryParser
+{
+public:
+    QueryParser(const QVector<QueryToken> &t, DataObject *d) : tokens(t), pos(0), dataSet(d) {}
+
+    QueryNodePtr parse()
+    {
+        QueryNodePtr n = parseOr();
+        if(n && peek().kind != QTOK_END)
+            return fail("Unexpected '"+peek().text+"'");
+        return n;
+    }
+
+    QString error;
+
+private:
+    const QueryToken &peek() const { return tokens.at(pos); }
+    const QueryToken &next() { return tokens.at(pos++); }
+
+    bool isKeyword(const QueryToken &t, const char *word) const
+    {
+        return t.kind == QTOK_WORD && t.text.compare(word,Qt::CaseInsensitive) == 0;
+    }
+
+    QueryNodePtr fail(const QString &msg)
+    {
+        if(error.isEmpty())
+            error = msg;
+        return QueryNodePtr();
+    }
+
+    QueryNodePtr parseOr()
+    {
+        QueryNodePtr n = parseAnd();
+        if(!n)
+            return n;
+
+        QueryNodePtr orNode;
+        while(isKeyword(peek(),"or") || (peek().kind == QTOK_OP && peek().text == "||"))
+        {
+            next();
+            QueryNodePtr rhs = parseAnd();
+            if(!rhs)
+                return rhs;
+            if(!orNode)
+            {
+                orNode = newNode(QNODE_OR,"OR");
+                orNode->children.push_back(n);
+            }
+            orNode->children.push_back(rhs);
+        }
+        return orNode ? orNode : n;
+    }
+
+    bool startsUnary(const QueryToken &t) const
+    {
+        return (t.kind == QTOK_WORD && !isKeyword(t,"or") && !isKeyword(t,"and")) ||
+               t.kind == QTOK_LPAREN ||
+               (t.kind == QTOK_OP && t.text == "!");
+    }
+
+    QueryNodePtr parseAnd()
+    {
+        QueryNodePtr n = parseUnary();
+        if(!n)
+            return n;
+
+        QueryNodePtr andNode;
+        forever
+        {
+            // Juxtaposed predicates are ANDed, as in DIMRANGE queries
+            if(isKeyword(peek(),"and") || (peek().kind == QTOK_OP && peek().text == "&&"))
+                next();
+            else if(!startsUnary(peek()))
+                break;
+
+            QueryNodePtr rhs = parseUnary();
+            if(!rhs)
+                return rhs;
+            if(!andNode)
+            {
+                andNode = newNode(QNODE_AND,"AND");
+                andNode->children.push_back(n);
+            }
+            andNode->children.push_back(rhs);
+        }
+        return andNode ? andNode : n;
+    }
+
+    QueryNodePtr parseUnary()
+    {
+        if(isKeyword(peek(),"not") || (peek().kind == QTOK_OP && peek().text == "!"))
+        {
+            next();
+            QueryNodePtr child = parseUnary();
+            return child ? negate(child) : child;
+        }
+
+        if(peek().kind == QTOK_LPAREN)
+        {
+            next();
+            QueryNodePtr n = parseOr();
+            if(!n)
+                return n;
+            if(next().kind != QTOK_RPAREN)
+                return fail("Missing ')'");
+            return n;
+        }
+
+        return parsePredicate();
+    }
+
+    bool parseValue(QString &val)
+    {
+        const QueryToken &t = next();
+        if(t.kind != QTOK_WORD && t.kind != QTOK_STRING)
+            return false;
+        val = t.text;
+        return true;
+    }
+
+    QueryNodePtr parsePredicate()
+    {
+        const QueryToken &fieldTok = next();
+        if(fieldTok.kind != QTOK_WORD)
+            return fail(fieldTok.kind == QTOK_END ? QString("Incomplete query")
+                                                  : "Unexpected '"+fieldTok.text+"'");
+
+        QString field = fieldTok.text.toLower();
+        if(field == "selected")
+            return newNode(QNODE_SELECTED,"selected");
+        if(field == "unselected")
+            return negate(newNode(QNODE_SELECTED,"selected"));
+        if(field == "visible")
+            return newNode(QNODE_VISIBLE,"visible");
+        if(field == "hidden")
+            return negate(newNode(QNODE_VISIBLE,"visible"));
+        if(field == "all")
+            return newNode(QNODE_ALL,"all");
+
+        QString op;
+        if(isKeyword(peek(),"in"))
+            op = "in";
+        else if(peek().kind == QTOK_OP)
+            op = peek().text;
+        else
+            return fail("Missing operator after "+fieldTok.text);
+        next();
+
+        if(field == "source" || field == "file" || field == "variable" || field == "var")
+        {
+            if(op != "=" && op != "==" && op != "!=" && op != "~")
+                return fail("Names support =, != and ~");
+
+            QueryNodePtr n = newNode(QNODE_NAME);
+            n->field = (field == "source" || field == "file") ? QFIELD_SOURCE : QFIELD_VARIABLE;
+            n->substring = (op == "~");
+            if(!parseValue(n->name))
+                return fail("Missing name after "+fieldTok.text);
+            n->text = QString("%1 %2 \"%3\"").arg(field).arg(n->substring ? "~" : "=").arg(n->name);
+            return (op == "!=") ? negate(n) : n;
+        }
+
+        if(field == "resource")
+        {
+            if(op != "=" && op != "==")
+                return fail("Resources support =");
+
+            QueryNodePtr n = newNode(QNODE_RESOURCE);
+            QString first;
+            if(!parseValue(first))
+                return fail("Missing resource");
+
+            QString idStr = first;
+            n->resourceType = "thread";
+            if(peek().kind == QTOK_COLON)
+            {
+                next();
+                n->resourceType = first.toLower();
+                if(!isResourceType(n->resourceType))
+                    return fail("Unknown resource type "+first);
+                if(!parseValue(idStr))
+                    return fail("Missing resource id");
+            }
+
+            bool ok = false;
+            n->resourceId = idStr.toInt(&ok);
+            if(!ok)
+                return fail("Invalid resource id "+idStr);
+            n->text = QString("resource = %1:%2").arg(n->resourceType).arg(n->resourceId);
+            return n;
+        }
+
+        int axis = dataSet->axisIndex(fieldTok.text);
+        if(axis < 0)
+            return fail("Unknown dimension "+fieldTok.text);
+
+        QueryNodePtr n = newNode(QNODE_RANGE);
+        n->axis = axis;
+
+        QString a, b;
+        qreal va = 0, vb = 0;
+        if(!parseValue(a) || !parseNumber(a,va))
+            return fail("Missing number after "+fieldTok.text+" "+op);
+
+        bool isRange = false;
+        if(peek().kind == QTOK_COLON)
+        {
+            next();
+            if(!parseValue(b) || !parseNumber(b,vb))
+                return fail("Invalid range after "+fieldTok.text);
+            isRange = true;
+        }
+
+        if(op == "in" && !isRange)
+            return fail("'in' needs a range vmin:vmax");
+        if(isRange && op != "in" && op != "=" && op != "==")
+            return fail("Ranges need 'in' or '='");
+
+        // Everything becomes an inclusive integer range
+        bool negated = false;
+        if(isRange)
+        {
+            n->lo = (qint64)std::ceil(va);
+            n->hi = (qint64)std::floor(vb);
+        }
+        else if(op == "=" || op == "==" || op == "!=")
+        {
+            n->lo = (qint64)std::ceil(va);
+            n->hi = (qint64)std::floor(va);
+            negated = (op == "!=");
+        }
+        else if(op == "<")
+            n->hi = (qint64)std::ceil(va)-1;
+        else if(op == "<=")
+            n->hi = (qint64)std::floor(va);
+        else if(op == ">")
+            n->lo = (qint64)std::floor(va)+1;
+        else if(op == ">=")
+            n->lo = (qint64)std::ceil(va);
+        else
+            return fail("Invalid operator "+op);
+
+        QString loStr = (n->lo == QMIN) ? QString("min") : QString::number(n->lo);
+        QString hiStr = (n->hi == QMAX) ? QString("max") : QString::number(n->hi);
+        n->text = QString("%1 in [%2, %3]").arg(fieldTok.text).arg(loStr).arg(hiStr);
+
+        return negated ? negate(n) : n;
+    }
+
+private:
+    QVector<QueryToken> tokens;
+    int pos;
+    DataObject *dataSet;
+};
+
+Query::Query(DataObject *d)
+{
+    dataSet = d;
+}
+
+bool Query::parse(QString text)
+{
+    err.clear();
+    root.clear();
+
+    QVector<QueryToken> tokens = tokenize(text,err);
+    if(tokens.isEmpty())
+        return false;
+
+    QueryParser parser(tokens,dataSet);
+    root = parser.parse();
+    if(!root)
+    {
+        err = parser.error;
+        return false;
+    }
+    return true;
+}
+
+// Components matching a resource predicate
+static QVector<Component*> resourceComponents(DataObject *dataSet, const QueryNode *node)
+{
+    QVector<Component*> result;
+    if(dataSet->cpu == NULL)
+        return result;
+
+    QString type = node->resourceType;
+    int cacheLevel = 0;
+    if(type == "l1" || type == "l2" || type == "l3")
+        cacheLevel = type.at(1).digitValue();
+
+    std::vector<Component*> allComponents;
+    dataSet->cpu->GetSubtreeNodeList(&allComponents);
+    for(Component *c : allComponents)
+    {
+        if(c->GetId() != node->resourceId)
+            continue;
+
+        int ct = c->GetComponentType();
+        bool match = false;
+        if(type == "thread" || type == "hwthread")
+            match = (ct == SYS_SAGE_COMPONENT_THREAD);
+        else if(type == "core")
+            match = (ct == SYS_SAGE_COMPONENT_CORE);
+        else if(type == "numa")
+            match = (ct == SYS_SAGE_COMPONENT_NUMA);
+        else if(type == "chip" || type == "socket")
+            match = (ct == SYS_SAGE_COMPONENT_CHIP);
+        else if(type == "cache")
+            match = (ct == SYS_SAGE_COMPONENT_CACHE);
+        else if(cacheLevel > 0)
+            match = (ct == SYS_SAGE_COMPONENT_CACHE && ((Cache*)c)->GetCacheLevel() == cacheLevel);
+
+        if(match)
+            result.push_back(c);
+    }
+    return result;
+}
+
+// Sample sets of the data paths ending or starting at the components
+static QVector<SampleSet*> resourceSampleSets(DataObject *dataSet, const QueryNode *node)
+{
+    QVector<SampleSet*> sets;
+    QVector<Component*> comps = resourceComponents(dataSet,node);
+    for(Component *c : comps)
+    {
+        std::vector<DataPath*> dp_vec;
+        c->GetAllDpByType(&dp_vec, SYS_SAGE_MITOS_SAMPLE, SYS_SAGE_DATAPATH_INCOMING | SYS_SAGE_DATAPATH_OUTGOING);
+        for(DataPath *dp : dp_vec)
+            sets.push_back((SampleSet*)dp->attrib["sample_set"]);
+    }
+    return sets;
+}
+
+bool Query::matches(const QueryNode *node, qint64 elem)
+{
+    const Sample *s = &dataSet->samples.at(elem);
+    switch(node->type)
+    {
+    case(QNODE_RANGE):
+    {
+        qint64 v = dataSet->GetSampleAttribByIndex(s,node->axis);
+        return v >= node->lo && v <= node->hi;
+    }
+    case(QNODE_NAME):
+    {
+        const QString &name = (node->field == QFIELD_SOURCE) ? s->source : s->variable;
+        return node->substring ? name.contains(node->name,Qt::CaseInsensitive)
+                               : name == node->name;
+    }
+    default:
+        return false;
+    }
+}
+
+bool Query::probeable(const QueryNode *node) const
+{
+    return node->type == QNODE_RANGE || node->type == QNODE_NAME;
+}
+
+qreal Query::sampleSelectivity(QueryNode *node)
+{
+    // The progressive order is a stratified sample of the whole set
+    qint64 n = dataSet->numElements;
+    qint64 m = std::min(n,(qint64)QUERY_ESTIMATE_SAMPLES);
+    if(m == 0)
+        return 0;
+
+    qint64 hits = 0;
+    for(qint64 i=0; i<m; i++)
+        if(matches(node,dataSet->progressiveOrder.at(i)))
+            hits++;
+
+    return (qreal)hits/m;
+}
+
+static void indexBounds(DataObject *dataSet, const QueryNode *node,
+                        const ElemIndex *&first, const ElemIndex *&last)
+{
+    const QVector<ElemIndex> &idx = dataSet->sortedIndex(node->axis);
+    const qint64 *col = dataSet->column(node->axis).constData();
+    qint64 lo = node->lo;
+    qint64 hi = node->hi;
+
+    first = std::partition_point(idx.constBegin(),idx.constEnd(),
+                                 [col,lo](ElemIndex e) { return col[e] < lo; });
+    last = std::partition_point(first,idx.constEnd(),
+                                [col,hi](ElemIndex e) { return col[e] <= hi; });
+}
+
+void Query::planNode(QueryNode *node)
+{
+    qreal n = dataSet->numElements;
+    qreal logn = std::log2(std::max(n,2.0));
+    qreal combine = n/64*QUERY_COST_WORD;
+
+    switch(node->type)
+    {
+    case(QNODE_RANGE):
+    {
+        if(dataSet->hasSortedIndex(node->axis))
+        {
+            const ElemIndex *first, *last;
+            indexBounds(dataSet,node,first,last);
+            node->rows = last-first;
+        }
+        else
+        {
+            node->rows = n*sampleSelectivity(node);
+        }
+
+        qreal columnCost = dataSet->hasColumn(node->axis) ? 0 : n*QUERY_COST_COLUMN;
+        qreal scanCost = columnCost + n*QUERY_COST_SCAN;
+        qreal indexCost = columnCost + 2*logn + node->rows*QUERY_COST_RANDOM + combine;
+        if(!dataSet->hasSortedIndex(node->axis))
+            indexCost += n*logn*QUERY_COST_SORT/QUERY_INDEX_REUSE;
+
+        node->access = (indexCost < scanCost) ? QACCESS_INDEX : QACCESS_SCAN;
+        node->cost = std::min(indexCost,scanCost);
+        break;
+    }
+    case(QNODE_NAME):
+    {
+        node->rows = n*sampleSelectivity(node);
+
+        qreal scanCost = n*QUERY_COST_STRING;
+        qreal postCost = node->rows*QUERY_COST_RANDOM + combine;
+        if(!dataSet->hasPostings())
+            postCost += n*QUERY_COST_HASH/QUERY_INDEX_REUSE;
+
+        node->access = (postCost < scanCost) ? QACCESS_POSTINGS : QACCESS_SCAN;
+        node->cost = std::min(postCost,scanCost);
+        break;
+    }
+    case(QNODE_RESOURCE):
+    {
+        QVector<SampleSet*> sets = resourceSampleSets(dataSet,node);
+        node->rows = 0;
+        for(SampleSet *ss : sets)
+            node->rows += ss->totSamples.size();
+        node->rows = std::min(node->rows,n);
+        node->access = QACCESS_POSTINGS;
+        node->cost = node->rows*QUERY_COST_RANDOM + combine;
+        break;
+    }
+    case(QNODE_SELECTED):
+        node->rows = dataSet->numSelectedIn(dataSet->activeGroup());
+        node->access = QACCESS_SCAN;
+        node->cost = n*QUERY_COST_SCAN;
+        break;
+    case(QNODE_VISIBLE):
+        node->rows = dataSet->numVisible;
+        node->access = QACCESS_SCAN;
+        node->cost = n*QUERY_COST_SCAN;
+        break;
+    case(QNODE_ALL):
+        node->rows = n;
+        node->access = QACCESS_SCAN;
+        node->cost = combine;
+        break;
+    case(QNODE_NOT):
+        planNode(node->children[0].data());
+        node->rows = n - node->children.at(0)->rows;
+        node->access = QACCESS_COMBINE;
+        node->cost = node->children.at(0)->cost + combine;
+        break;
+    case(QNODE_AND):
+    {
+        for(int i=0; i<node->children.size(); i++)
+            planNode(node->children[i].data());
+
+        // Most selective first, later predicates either combine their own
+        // bitmap or only test the rows still matching
+        std::stable_sort(node->children.begin(),node->children.end(),
+                         [](const QueryNodePtr &a, const QueryNodePtr &b) { return a->rows < b->rows; });
+
+        qreal rows = node->children.at(0)->rows;
+        qreal cost = node->children.at(0)->cost;
+        for(int i=1; i<node->children.size(); i++)
+        {
+            QueryNode *c = node->children[i].data();
+            qreal combineCost = c->cost + combine;
+            qreal probeCost = std::numeric_limits<qreal>::max();
+            if(probeable(c))
+                probeCost = rows*(QUERY_COST_RANDOM + (c->type == QNODE_NAME ? QUERY_COST_STRING : 0)) + combine;
+
+            if(probeCost < combineCost)
+            {
+                c->access = QACCESS_PROBE;
+                cost += probeCost;
+            }
+            else
+            {
+                cost += combineCost;
+            }
+
+            rows = (n > 0) ? rows*c->rows/n : 0;
+        }
+
+        node->rows = rows;
+        node->access = QACCESS_COMBINE;
+        node->cost = cost;
+        break;
+    }
+    case(QNODE_OR):
+    {
+        qreal none = 1;
+        qreal cost = 0;
+        for(int i=0; i<node->children.size(); i++)
+        {
+            planNode(node->children[i].data());
+            none *= (n > 0) ? 1 - node->children.at(i)->rows/n : 1;
+            cost += node->children.at(i)->cost + combine;
+        }
+        node->rows = n*(1-none);
+        node->access = QACCESS_COMBINE;
+        node->cost = cost;
+        break;
+    }
+    }
+}
+
+void Query::plan()
+{
+    if(root)
+        planNode(root.data());
+}
+
+Bitmap Query::scanRange(const QueryNode *node)
+{
+    qint64 n = dataSet->numElements;
+    const qint64 *col = dataSet->column(node->axis).constData();
+
+    // One unsigned compare per sample, lo <= v <= hi
+    quint64 lo = (quint64)node->lo;
+    quint64 span = (quint64)node->hi - lo;
+    if(node->hi < node->lo)
+        return Bitmap(n);
+
+    Bitmap b(n);
+    quint64 *w = b.data();
+    parallelFor(b.numWords(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+        {
+            qint64 first = i << 6;
+            int num = std::min((qint64)64,n-first);
+            const qint64 *v = col+first;
+            quint64 bits = 0;
+            for(int k=0; k<num; k++)
+                bits |= (quint64)((quint64)v[k]-lo <= span) << k;
+            w[i] = bits;
+        }
+    }, 1024);
+
+    return b;
+}
+
+Bitmap Query::indexRange(const QueryNode *node)
+{
+    Bitmap b(dataSet->numElements);
+    if(node->hi < node->lo)
+        return b;
+
+    const ElemIndex *first, *last;
+    indexBounds(dataSet,node,first,last);
+    for(const ElemIndex *e=first; e!=last; e++)
+        b.set(*e);
+
+    return b;
+}
+
+Bitmap Query::names(const QueryNode *node)
+{
+    qint64 n = dataSet->numElements;
+    Bitmap b(n);
+
+    if(node->access == QACCESS_POSTINGS)
+    {
+        const QHash<QString,QVector<ElemIndex> > &posts =
+            (node->field == QFIELD_SOURCE) ? dataSet->sourcePostings() : dataSet->variablePostings();
+
+        QHash<QString,QVector<ElemIndex> >::const_iterator it;
+        for(it=posts.constBegin(); it!=posts.constEnd(); it++)
+        {
+            bool match = node->substring ? it.key().contains(node->name,Qt::CaseInsensitive)
+                                         : it.key() == node->name;
+            if(!match)
+                continue;
+            for(ElemIndex e : it.value())
+                b.set(e);
+        }
+        return b;
+    }
+
+    quint64 *w = b.data();
+    parallelFor(b.numWords(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+        {
+            qint64 first = i << 6;
+            int num = std::min((qint64)64,n-first);
+            quint64 bits = 0;
+            for(int k=0; k<num; k++)
+                bits |= (quint64)matches(node,first+k) << k;
+            w[i] = bits;
+        }
+    }, 256);
+
+    return b;
+}
+
+Bitmap Query::resource(const QueryNode *node)
+{
+    Bitmap b(dataSet->numElements);
+    QVector<SampleSet*> sets = resourceSampleSets(dataSet,node);
+    for(SampleSet *ss : sets)
+        for(ElemIndex e : ss->totSamples)
+            if((qint64)e < b.size())
+                b.set(e);
+    return b;
+}
+
+void Query::probe(Bitmap &acc, const QueryNode *node)
+{
+    quint64 *w = acc.data();
+    parallelFor(acc.numWords(),[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+        {
+            quint64 bits = w[i];
+            quint64 keep = bits;
+            while(bits)
+            {
+                int k = qCountTrailingZeroBits(bits);
+                if(!matches(node,(i << 6) + k))
+                    keep &= ~((quint64)1 << k);
+                bits &= bits-1;
+            }
+            w[i] = keep;
+        }
+    }, 1024);
+}
+
+Bitmap Query::execNode(QueryNode *node)
+{
+    switch(node->type)
+    {
+    case(QNODE_RANGE):
+        return (node->access == QACCESS_INDEX) ? indexRange(node) : scanRange(node);
+    case(QNODE_NAME):
+        return names(node);
+    case(QNODE_RESOURCE):
+        return resource(node);
+    case(QNODE_SELECTED):
+        return dataSet->selectionMask();
+    case(QNODE_VISIBLE):
+        return dataSet->visibilityMask();
+    case(QNODE_ALL):
+        return Bitmap(dataSet->numElements,true);
+    case(QNODE_NOT):
+    {
+        Bitmap b = execNode(node->children[0].data());
+        b.invert();
+        return b;
+    }
+    case(QNODE_AND):
+    {
+        Bitmap acc = execNode(node->children[0].data());
+        for(int i=1; i<node->children.size() && acc.any(); i++)
+        {
+            QueryNode *c = node->children[i].data();
+            if(c->access == QACCESS_PROBE)
+                probe(acc,c);
+            else
+                acc &= execNode(c);
+        }
+        return acc;
+    }
+    case(QNODE_OR):
+    {
+        Bitmap acc = execNode(node->children[0].data());
+        for(int i=1; i<node->children.size(); i++)
+            acc |= execNode(node->children[i].data());
+        return acc;
+    }
+    }
+    return Bitmap(dataSet->numElements);
+}
+
+Bitmap Query::execute()
+{
+    if(!root)
+        return Bitmap(dataSet->numElements);
+    return execNode(root.data());
+}
+
+static const char *accessName(QueryAccess a)
+{
+    switch(a)
+    {
+    case(QACCESS_SCAN): return "scan";
+    case(QACCESS_INDEX): return "sorted index";
+    case(QACCESS_POSTINGS): return "posting list";
+    case(QACCESS_PROBE): return "probe";
+    case(QACCESS_COMBINE): return "combine";
+    }
+    return "";
+}
+
+void Query::explainNode(const QueryNode *node, int depth, QStringList &lines) const
+{
+    lines.push_back(QString("%1%2  [%3, ~%4 rows, cost %5]")
+                    .arg(QString(depth*2,' '))
+                    .arg(node->text)
+                    .arg(accessName(node->access))
+                    .arg((qint64)node->rows)
+                    .arg(node->cost,0,'g',3));
+    for(int i=0; i<node->children.size(); i++)
+        explainNode(node->children.at(i).data(),depth+1,lines);
+}
+
+QString Query::explain() const
+{
+    QStringList lines;
+    if(root)
+        explainNode(root.data(),0,lines);
+    return lines.join("\n");
+}
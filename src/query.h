@@ -0,0 +1,151 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSharedPointer>
+
+#include "bitmap.h"
+
+class DataObject;
+
+// Sample queries of the console. Predicates over axes, source and variable
+// names and hardware resources, combined with AND, OR and NOT:
+//
+//   latency > 200 and (source ~ lulesh or not cpu in 0:3)
+//   resource = L3:0 and time in 1000:2000
+//
+// A query is parsed into a tree, a cost based planner picks how every node
+// is evaluated (column scan, sorted index, posting list, or probing the rows
+// already matched by an AND) and execution produces a bitmap of samples.
+
+enum QueryNodeType {
+    QNODE_AND = 0,
+    QNODE_OR,
+    QNODE_NOT,
+    QNODE_RANGE,
+    QNODE_NAME,
+    QNODE_RESOURCE,
+    QNODE_SELECTED,
+    QNODE_VISIBLE,
+    QNODE_ALL
+};
+
+enum QueryAccess {
+    QACCESS_SCAN = 0,
+    QACCESS_INDEX,
+    QACCESS_POSTINGS,
+    QACCESS_PROBE,
+    QACCESS_COMBINE
+};
+
+enum QueryNameField {
+    QFIELD_SOURCE = 0,
+    QFIELD_VARIABLE
+};
+
+struct QueryNode
+{
+    QueryNodeType type;
+    QVector<QSharedPointer<QueryNode> > children;
+
+    // Range over an axis, inclusive
+    int axis;
+    qint64 lo;
+    qint64 hi;
+
+    // Source or variable name, exact or substring
+    int field;
+    QString name;
+    bool substring;
+
+    // Hardware resource, type and id
+    QString resourceType;
+    int resourceId;
+
+    QString text;
+
+    // Filled in by the planner
+    QueryAccess access;
+    qreal rows;
+    qreal cost;
+};
+
+typedef QSharedPointer<QueryNode> QueryNodePtr;
+
+class Query
+{
+public:
+    Query(DataObject *d);
+
+    // Returns false and sets error() if the text is not a valid query
+    bool parse(QString text);
+    QString error() const { return err; }
+
+    void plan();
+    Bitmap execute();
+
+    // Plan as an indented tree
+    QString explain() const;
+
+private:
+    void planNode(QueryNode *node);
+    qreal sampleSelectivity(QueryNode *node);
+    bool matches(const QueryNode *node, qint64 elem);
+    bool probeable(const QueryNode *node) const;
+
+    Bitmap execNode(QueryNode *node);
+    Bitmap scanRange(const QueryNode *node);
+    Bitmap indexRange(const QueryNode *node);
+    Bitmap names(const QueryNode *node);
+    Bitmap resource(const QueryNode *node);
+    void probe(Bitmap &acc, const QueryNode *node);
+
+    void explainNode(const QueryNode *node, int depth, QStringList &lines) const;
+
+private:
+    DataObject *dataSet;
+    QueryNodePtr root;
+    QString err;
+};
+
+#endif // QUERY_H
@@ -0,0 +1,211 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "reusedistance.h"
+#include "parallel.h"
+
+#include <QHash>
+
+#include <algorithm>
+
+// Prefix sums over trace positions, 1-based internally
+class FenwickTree
+{
+public:
+    explicit FenwickTree(int n) : tree(n+1,0) {}
+
+    void add(int i, int v)
+    {
+        for(i++; i<tree.size(); i+=i&-i)
+            tree[i] += v;
+    }
+
+    // Sum of [0,i]
+    int prefix(int i) const
+    {
+        int s = 0;
+        for(i++; i>0; i-=i&-i)
+            s += tree.at(i);
+        return s;
+    }
+
+private:
+    QVector<int> tree;
+};
+
+static void streamDistances(const ElemIndex *trace, int n,
+                            const qint64 *keys, qint64 *out)
+{
+    FenwickTree marks(n);
+    QHash<qint64,int> last;
+    last.reserve(n);
+
+    for(int i=0; i<n; i++)
+    {
+        ElemIndex e = trace[i];
+        QHash<qint64,int>::iterator it = last.find(keys[e]);
+        if(it == last.end())
+        {
+            out[e] = REUSE_COLD;
+            last.insert(keys[e],i);
+        }
+        else
+        {
+            // Marks after the previous access are distinct keys touched since
+            int p = it.value();
+            out[e] = marks.prefix(i-1) - marks.prefix(p);
+            marks.add(p,-1);
+            it.value() = i;
+        }
+        marks.add(i,1);
+    }
+}
+
+void reuseDistances(DataObject *d,
+                    const QVector<qint64> &keys,
+                    const QVector<qint64> &streams,
+                    QVector<qint64> &out)
+{
+    qint64 n = d->numElements;
+    out.resize(n);
+    if(n == 0)
+        return;
+
+    // Time order within every stream, same as delta()
+    const qint64 *s = streams.constData();
+    QVector<ElemIndex> order = d->sortedIndex(SampleAxes::time);
+    std::stable_sort(order.begin(),order.end(),
+                     [s](ElemIndex a, ElemIndex b) { return s[a] < s[b]; });
+
+    QVector<IndexRange> ranges;
+    qint64 begin = 0;
+    for(qint64 i=1; i<=n; i++)
+    {
+        if(i == n || s[order.at(i)] != s[order.at(begin)])
+        {
+            ranges.push_back(IndexRange(begin,i));
+            begin = i;
+        }
+    }
+
+    // Longest streams first so one big thread does not finish last
+    std::sort(ranges.begin(),ranges.end(),
+              [](const IndexRange &a, const IndexRange &b)
+              { return a.second-a.first > b.second-b.first; });
+
+    const ElemIndex *trace = order.constData();
+    const qint64 *k = keys.constData();
+    qint64 *o = out.data();
+    parallelTasks(ranges.size(),[&](int r)
+    {
+        const IndexRange &range = ranges.at(r);
+        streamDistances(trace+range.first,range.second-range.first,k,o);
+    });
+}
+
+int reuseBucket(qint64 distance)
+{
+    if(distance <= 0)
+        return 0;
+
+    int b = 64 - qCountLeadingZeroBits((quint64)distance);
+    return std::min(b,REUSE_BUCKETS-1);
+}
+
+ReuseHistogram reuseHistogram(const QVector<qint64> &distances, const Bitmap *mask)
+{
+    qint64 n = distances.size();
+    int numChunks = parallelChunkCount(n,65536);
+    QVector<QVector<qint64> > counts(numChunks);
+    const qint64 *dist = distances.constData();
+
+    // One extra slot per chunk for cold accesses
+    parallelTasks(numChunks,[&](int c)
+    {
+        qint64 begin = n*c/numChunks;
+        qint64 end = n*(c+1)/numChunks;
+        QVector<qint64> &count = counts[c];
+        count.fill(0,REUSE_BUCKETS+1);
+        for(qint64 e=begin; e<end; e++)
+        {
+            if(mask && !mask->test(e))
+                continue;
+            count[dist[e] == REUSE_COLD ? REUSE_BUCKETS : reuseBucket(dist[e])]++;
+        }
+    });
+
+    ReuseHistogram h;
+    h.buckets.fill(0,REUSE_BUCKETS);
+    h.cold = 0;
+    for(int c=0; c<numChunks; c++)
+    {
+        for(int b=0; b<REUSE_BUCKETS; b++)
+            h.buckets[b] += counts.at(c).at(b);
+        h.cold += counts.at(c).at(REUSE_BUCKETS);
+    }
+
+    h.total = h.cold;
+    for(int b=0; b<REUSE_BUCKETS; b++)
+        h.total += h.buckets.at(b);
+
+    return h;
+}
+
+qreal reuseMissRatio(const ReuseHistogram &h, qint64 capacity, qreal period)
+{
+    if(h.total == 0)
+        return 0;
+
+    // Accesses with distance >= capacity miss, distances are assumed to be
+    // spread evenly within a bucket
+    qreal misses = h.cold;
+    for(int b=0; b<REUSE_BUCKETS; b++)
+    {
+        qreal lo = (b == 0) ? 0 : (qreal)((quint64)1 << (b-1));
+        qreal hi = (b == 0) ? 1 : (qreal)((quint64)1 << b);
+        lo *= period;
+        hi *= period;
+
+        if(lo >= capacity)
+            misses += h.buckets.at(b);
+        else if(hi > capacity)
+            misses += h.buckets.at(b) * (hi-capacity)/(hi-lo);
+    }
+
+    return misses / h.total;
+}
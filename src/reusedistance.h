@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef REUSEDISTANCE_H
+#define REUSEDISTANCE_H
+
+#include <QVector>
+
+#include "dataobject.h"
+
+// Distance of a first touch, nothing to reuse
+#define REUSE_COLD -1
+
+// Bucket 0 holds distance 0, bucket b distances in [2^(b-1),2^b)
+#define REUSE_BUCKETS 48
+
+// Reuse (LRU stack) distance of every sample: the number of distinct keys
+// touched by the same stream since the previous access to the same key,
+// REUSE_COLD for the first one. Streams are replayed in time order.
+//
+// Olken's algorithm: a Fenwick tree over trace positions marks the most
+// recent access of every key, the distance is the number of marks between
+// the two accesses. O(N log N), streams run in parallel.
+void reuseDistances(DataObject *d,
+                    const QVector<qint64> &keys,
+                    const QVector<qint64> &streams,
+                    QVector<qint64> &out);
+
+struct ReuseHistogram
+{
+    QVector<qint64> buckets;
+    qint64 cold;
+    qint64 total;
+};
+
+int reuseBucket(qint64 distance);
+
+// Histogram of the samples in mask, or all of them without one
+ReuseHistogram reuseHistogram(const QVector<qint64> &distances,
+                              const Bitmap *mask = NULL);
+
+// Miss ratio of a fully associative LRU cache holding the given number of
+// keys. Sampled traces see 1/period of the accesses, so distances are
+// scaled by the period first.
+qreal reuseMissRatio(const ReuseHistogram &h, qint64 capacity, qreal period = 1);
+
+#endif // REUSEDISTANCE_H
@@ -0,0 +1,1926 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "scriptengine.h"
+#include "dataobject.h"
+#include "parallel.h"
+#include "query.h"
+#include "reusedistance.h"
+#include "cachesim.h"
+#include "falsesharing.h"
+#include "numalocality.h"
+#include "tlbpages.h"
+#include "flatclustering.h"
+#include "accesspattern.h"
+#include "workingset.h"
+#include "parseUtil.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QSet>
+
+#include <algorithm>
+
+static QString helpStr(
+    "Commands : \n"
+    "    \n"
+    "    select [--mode={new,append,filter}] [--group=<n>] <query>\n"
+    "    hide <query>\n"
+    "    show <query>\n"
+    "    \n"
+    "        <query> combines predicates with and, or, not and ( ):\n"
+    "           dim <op> value      <op> is one of = != < <= > >=\n"
+    "           dim in vmin:vmax    also dim=vmin:vmax\n"
+    "           source = name       also variable, ~ matches a substring\n"
+    "           resource = type:id  type is thread, core, L1-L3, numa, chip\n"
+    "           selected unselected visible hidden all\n"
+    "        dim is an axis number or name, spaces written as '_'\n"
+    "        stlbMiss, locked, dirty and snoop are 0/1 data source flags\n"
+    "        DIMRANGE dim=vmin:vmax ... is still accepted\n"
+    "    explain <query>\n"
+    "    undo, redo              step through the selection history\n"
+    "    selgroup [<n>|clear]    show or set the active selection group (1-255)\n"
+    "    \n"
+    "    inspect\n"
+    "    groups                  samples and latency of every selection group\n"
+    "    groupby <dim>\n"
+    "    compare <dim>           groupby with one column set per selection group\n"
+    "    cluster <dim> [<k>] | cluster cancel\n"
+    "        cluster the visible samples grouped by <dim> by their latency at\n"
+    "        every memory level, the k clusters become selection groups; in\n"
+    "        the GUI it runs in the background until done or cancelled\n"
+    "    kmeans <k> <dim>... [--batch=<n>] [--iter=<n>]\n"
+    "    dbscan <eps> <minPts> <dim>...\n"
+    "        cluster the visible samples on the given dims scaled to [0,1],\n"
+    "        eps is in scaled units, dbscan takes up to 4 dims; the clusters\n"
+    "        become the 'cluster' dim (-1 for noise) and selection groups,\n"
+    "        largest first\n"
+    "    patterns [<top>]\n"
+    "        address deltas of every instruction per thread over time, and\n"
+    "        its class: sequential, strided or irregular; sets the 'pattern'\n"
+    "        (0-2, -1 unknown) and 'stride' dims; the ranked table is only\n"
+    "        printed here, the code view labels each line with its class\n"
+    "    workingset [<windows>] [thread|variable]\n"
+    "        distinct cache lines and pages of the selection per time window\n"
+    "        and their growth, or per thread or variable, estimated with\n"
+    "        HyperLogLog sketches and compared with the L2/L3 sizes\n"
+    "    reuse [thread|variable] [<period>]\n"
+    "        cache line reuse distances of the selection and predicted miss\n"
+    "        ratios, <period> is the sampling period of the capture\n"
+    "    cachesim [L<n>=<size>[:<ways>] ...] [--select]\n"
+    "        replay the samples through the caches of hardware.xml, or the\n"
+    "        given sizes, and compare with the measured data source;\n"
+    "        --select selects the samples where both disagree\n"
+    "    falseshare [<top>] [--select]\n"
+    "        cache lines shared by several cpus with HITM loads, ranked by\n"
+    "        their latency; --select selects the samples on those lines\n"
+    "    numa [variables|pages [<top>] [--page=<bytes>]]\n"
+    "        local and remote RAM accesses per NUMA node, per variable, or\n"
+    "        per page range with a first-touch or interleave suggestion\n"
+    "    tlb [<top>] [--page=<bytes>] [--select]\n"
+    "        pages with STLB misses, 4K by default; --select selects the\n"
+    "        STLB misses on those pages\n"
+    "    export {table,samples} <file>\n"
+    "    \n"
+    "    derivedim [<name> =] <expression>\n"
+    "        <expression> combines dims and integers with:\n"
+    "            + - * / % << >> & | ^ ( )\n"
+    "            abs(x) min(a,b) max(a,b)\n"
+    "            delta(x)  change since the previous sample of the thread\n"
+    "            reuse(x[,s])  distinct x since the last x of the thread,\n"
+    "                          or of the samples with equal s, -1 if none\n"
+    "Examples : \n"
+    "    select DIMRANGE 4=30:40 5=4:5\n"
+    "    select --mode=filter DIMRANGE load_latency=100:100000\n"
+    "    select latency > 200 and (source ~ lulesh or not cpu in 0:3)\n"
+    "    hide resource = L3:1\n"
+    "    explain variable = x and latency >= 500\n"
+    "    derivedim page = addr >> 12\n"
+    "    derivedim gap = delta(time)\n"
+    "    derivedim rd = reuse(addr >> 6)\n"
+    "    groupby data_source\n"
+    "    select --group=2 source ~ lulesh\n"
+    "    compare data_source\n"
+    "    cluster instructionUid 6\n"
+    "    kmeans 8 addr latency time\n"
+    "    dbscan 0.02 50 addr time\n"
+    "    patterns 20\n"
+    "    workingset 32\n"
+    "    select pattern = 2 and latency > 100\n"
+    "    cachesim L3=16M:16\n"
+    "    falseshare 10 --select\n"
+    "    numa pages 20 --page=2M\n"
+    "    select stlbMiss = 1 and latency > 100\n"
+    "    tlb 20 --page=2M\n"
+    "    export table latency_by_source.csv\n"
+    "    \n"
+//    "    select RESOURCE cpu=4 cache=L3\n"
+);
+
+struct groupAgg
+{
+    ElemIndex count;
+    qreal latency;
+};
+
+ScriptEngine::ScriptEngine(QObject *parent) :
+    QObject(parent)
+{
+    dataSet = NULL;
+}
+
+void ScriptEngine::setDataSet(DataObject *dsobj)
+{
+    dataSet = dsobj;
+}
+
+void ScriptEngine::setOutputDir(QString dir)
+{
+    outputDir = dir;
+}
+
+QString ScriptEngine::helpText()
+{
+    return helpStr;
+}
+
+bool ScriptEngine::requireData()
+{
+    if(dataSet == NULL || dataSet->empty())
+    {
+        emit output("Unable to select from the void, please load data first");
+        return false;
+    }
+    return true;
+}
+
+QString ScriptEngine::outputPath(QString fileName)
+{
+    if(outputDir.isEmpty() || QFileInfo(fileName).isAbsolute())
+        return fileName;
+    return QDir(outputDir).filePath(fileName);
+}
+
+bool ScriptEngine::execute(QString cmdLine)
+{
+    cmdLine = cmdLine.simplified();
+    if(cmdLine.isEmpty() || cmdLine.startsWith("#"))
+        return true;
+
+    QStringList cmdArgs = cmdLine.split(" ");
+    QString cmd = cmdArgs.first();
+
+    CMD_TYPE cmdType = getCommandType(cmd);
+    switch(cmdType)
+    {
+    case(CMD_HELP):
+        return helpCommand(&cmdArgs);
+    case(CMD_SELECT):
+        return selectCommand(&cmdArgs);
+    case(CMD_HIDE):
+        return hideCommand(&cmdArgs);
+    case(CMD_SHOW):
+        return showCommand(&cmdArgs);
+    case(CMD_INSPECT):
+        return inspectCommand(&cmdArgs);
+    case(CMD_GROUPBY):
+        return groupbyCommand(&cmdArgs);
+    case(CMD_EXPORT):
+        return exportCommand(&cmdArgs);
+    case(CMD_EXPLAIN):
+        return explainCommand(&cmdArgs);
+    case(CMD_DERIVEDIM):
+        return derivedimCommand(&cmdArgs);
+    case(CMD_UNDO):
+        return undoCommand(&cmdArgs,false);
+    case(CMD_REDO):
+        return undoCommand(&cmdArgs,true);
+    case(CMD_SELGROUP):
+        return selgroupCommand(&cmdArgs);
+    case(CMD_GROUPS):
+        return groupsCommand(&cmdArgs);
+    case(CMD_COMPARE):
+        return compareCommand(&cmdArgs);
+    case(CMD_REUSE):
+        return reuseCommand(&cmdArgs);
+    case(CMD_CACHESIM):
+        return cachesimCommand(&cmdArgs);
+    case(CMD_FALSESHARE):
+        return falseshareCommand(&cmdArgs);
+    case(CMD_NUMA):
+        return numaCommand(&cmdArgs);
+    case(CMD_TLB):
+        return tlbCommand(&cmdArgs);
+    case(CMD_CLUSTER):
+        return clusterCommand(&cmdArgs);
+    case(CMD_KMEANS):
+        return kmeansCommand(&cmdArgs);
+    case(CMD_DBSCAN):
+        return dbscanCommand(&cmdArgs);
+    case(CMD_PATTERNS):
+        return patternsCommand(&cmdArgs);
+    case(CMD_WORKINGSET):
+        return workingsetCommand(&cmdArgs);
+    default:
+        emit output("Command unrecognized, type 'help' or 'h' for a list of commands");
+        return false;
+    }
+}
+
+bool ScriptEngine::executeScript(QString fileName)
+{
+    QFile file(fileName);
+    bool ok = (fileName == "-") ? file.open(stdin,QIODevice::ReadOnly | QIODevice::Text)
+                                : file.open(QIODevice::ReadOnly | QIODevice::Text);
+    if(!ok)
+    {
+        emit output("Unable to open script "+fileName);
+        return false;
+    }
+
+    QTextStream in(&file);
+    int lineNum = 0;
+    while(!in.atEnd())
+    {
+        QString line = in.readLine().simplified();
+        lineNum++;
+        if(line.isEmpty() || line.startsWith("#"))
+            continue;
+
+        emit output("$ "+line);
+        if(!execute(line))
+        {
+            emit output(QString("Script stopped at line %1").arg(lineNum));
+            return false;
+        }
+    }
+    return true;
+}
+
+CMD_TYPE ScriptEngine::getCommandType(QString cmd)
+{
+    cmd = cmd.toLower();
+    if(cmd == "help" || cmd == "h")
+        return CMD_HELP;
+    else if(cmd == "select" || cmd == "sel")
+        return CMD_SELECT;
+    else if(cmd == "hide")
+        return CMD_HIDE;
+    else if(cmd == "show")
+        return CMD_SHOW;
+    else if(cmd == "inspect" || cmd == "ins")
+        return CMD_INSPECT;
+    else if(cmd == "groupby" || cmd == "group")
+        return CMD_GROUPBY;
+    else if(cmd == "export")
+        return CMD_EXPORT;
+    else if(cmd == "explain")
+        return CMD_EXPLAIN;
+    else if(cmd == "derivedim" || cmd == "derive")
+        return CMD_DERIVEDIM;
+    else if(cmd == "undo")
+        return CMD_UNDO;
+    else if(cmd == "redo")
+        return CMD_REDO;
+    else if(cmd == "selgroup")
+        return CMD_SELGROUP;
+    else if(cmd == "groups")
+        return CMD_GROUPS;
+    else if(cmd == "compare")
+        return CMD_COMPARE;
+    else if(cmd == "reuse")
+        return CMD_REUSE;
+    else if(cmd == "cachesim")
+        return CMD_CACHESIM;
+    else if(cmd == "falseshare")
+        return CMD_FALSESHARE;
+    else if(cmd == "numa")
+        return CMD_NUMA;
+    else if(cmd == "tlb")
+        return CMD_TLB;
+    else if(cmd == "cluster")
+        return CMD_CLUSTER;
+    else if(cmd == "kmeans")
+        return CMD_KMEANS;
+    else if(cmd == "dbscan")
+        return CMD_DBSCAN;
+    else if(cmd == "patterns")
+        return CMD_PATTERNS;
+    else if(cmd == "workingset")
+        return CMD_WORKINGSET;
+    return CMD_UNKNOWN;
+}
+
+QUERY_TYPE ScriptEngine::getQueryType(QString qtype)
+{
+    qtype = qtype.toLower();
+    if(qtype == "dimrange")
+        return QUERY_DIMRANGE;
+    else if(qtype == "resource")
+        return QUERY_RESOURCE;
+    else if(qtype == "selected")
+        return QUERY_SELECTED;
+    else if(qtype == "unselected")
+        return QUERY_UNSELECTED;
+    else if(qtype == "all")
+        return QUERY_ALL;
+    return QUERY_UNKNOWN;
+}
+
+int ScriptEngine::axisIndex(QString dim)
+{
+    if(dataSet == NULL)
+        return SampleAxes::axisIndex(dim);
+    return dataSet->axisIndex(dim);
+}
+
+QString ScriptEngine::queryText(QStringList *args, int first)
+{
+    if(args->size() <= first)
+        return QString();
+
+    QUERY_TYPE qt = getQueryType(args->at(first));
+    QStringList terms = args->mid(first+1);
+    if(qt == QUERY_DIMRANGE)
+        return terms.join(" ");
+
+    // RESOURCE type=id  ->  resource = type:id
+    if(qt == QUERY_RESOURCE)
+    {
+        for(int i=0; i<terms.size(); i++)
+            terms[i] = "resource = "+QString(terms.at(i)).replace("=",":");
+        return terms.join(" ");
+    }
+
+    return args->mid(first).join(" ");
+}
+
+// Evaluate the query starting at args[first] into a bitmap of samples
+static bool evalQuery(ScriptEngine *engine, DataObject *dataSet,
+                      QStringList *args, int first, Bitmap &result,
+                      QString &error)
+{
+    QString text = engine->queryText(args,first);
+    if(text.isEmpty())
+    {
+        error = "Invalid arguments";
+        return false;
+    }
+
+    Query query(dataSet);
+    if(!query.parse(text))
+    {
+        error = query.error();
+        return false;
+    }
+
+    query.plan();
+    result = query.execute();
+    return true;
+}
+
+bool ScriptEngine::helpCommand(QStringList *args)
+{
+    Q_UNUSED(args);
+    emit output(helpStr);
+    return true;
+}
+
+bool ScriptEngine::inspectCommand(QStringList *args)
+{
+    Q_UNUSED(args);
+
+    if(!requireData())
+        return false;
+
+    // Print out some info about the current selection, merged samples
+    // count as many as they stand for
+    emit output("Selected Samples : ");
+    emit output(QString::number(dataSet->selectedWeight));
+    emit output("Visible Samples : ");
+    emit output(QString::number(dataSet->visibleWeight));
+    emit output("Total Samples : ");
+    emit output(QString::number(dataSet->totalWeight));
+    if(dataSet->totalWeight != dataSet->numElements)
+    {
+        emit output("Merged Into Rows : ");
+        emit output(QString::number(dataSet->numElements));
+    }
+
+    return true;
+}
+
+bool ScriptEngine::selectCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    int first = 1;
+    int group = ACTIVE_GROUP;
+    selection_mode mode = dataSet->selectionMode();
+    for(; first<args->size() && args->at(first).startsWith("--"); first++)
+    {
+        QString opt = args->at(first);
+        bool ok = true;
+        if(opt.startsWith("--mode="))
+        {
+            QString m = opt.mid(7).toLower();
+            if(m == "new")
+                mode = MODE_NEW;
+            else if(m == "append")
+                mode = MODE_APPEND;
+            else if(m == "filter")
+                mode = MODE_FILTER;
+            else
+                ok = false;
+        }
+        else if(opt.startsWith("--group="))
+        {
+            group = opt.mid(8).toInt(&ok);
+            ok = ok && group >= 1 && group <= MAX_SELECTION_GROUPS;
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if(!ok)
+        {
+            emit output("Invalid arguments");
+            return false;
+        }
+    }
+
+    Bitmap selMask;
+    QString error;
+    if(!evalQuery(this,dataSet,args,first,selMask,error))
+    {
+        emit output(error);
+        return false;
+    }
+
+    selection_mode prevMode = dataSet->selectionMode();
+    dataSet->setSelectionMode(mode,true);
+    dataSet->selectMask(selMask,group);
+    dataSet->setSelectionMode(prevMode,true);
+    dataSet->recordSelection();
+
+    emit output(QString::number(dataSet->selectedWeight)+" samples selected");
+    emit selectionChangedSig();
+    return true;
+}
+
+bool ScriptEngine::hideCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    Bitmap hideMask;
+    QString error;
+    if(!evalQuery(this,dataSet,args,1,hideMask,error))
+    {
+        emit output(error);
+        return false;
+    }
+
+    dataSet->hideMask(hideMask);
+
+    emit output(QString("%1 samples hidden, %2 visible")
+                .arg(dataSet->weightHiddenLast()).arg(dataSet->visibleWeight));
+    emit visibilityChangedSig();
+    return true;
+}
+
+bool ScriptEngine::showCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    if(args->size() == 2 && getQueryType(args->at(1)) == QUERY_ALL)
+    {
+        dataSet->showAll();
+    }
+    else
+    {
+        Bitmap showMask;
+        QString error;
+        if(!evalQuery(this,dataSet,args,1,showMask,error))
+        {
+            emit output(error);
+            return false;
+        }
+        dataSet->showMask(showMask);
+    }
+
+    emit output(QString("%1 samples shown, %2 visible")
+                .arg(dataSet->weightShownLast()).arg(dataSet->visibleWeight));
+    emit visibilityChangedSig();
+    return true;
+}
+
+bool ScriptEngine::groupbyCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    if(args->size() != 2)
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    int axis = axisIndex(args->at(1));
+    if(axis < 0)
+    {
+        emit output("Unknown dimension "+args->at(1));
+        return false;
+    }
+
+    // Aggregate the selection, or everything visible without one. Every
+    // chunk fills its own table, merged afterwards.
+    bool selectionDefined = dataSet->selectionDefined();
+    ElemIndex numElements = dataSet->numElements;
+    int numChunks = parallelChunkCount(numElements,1);
+    QVector<QHash<long long,groupAgg> > chunkGroups(numChunks);
+
+    parallelTasks(numChunks,[&](int c)
+    {
+        ElemIndex begin = numElements*c/numChunks;
+        ElemIndex end = numElements*(c+1)/numChunks;
+        QHash<long long,groupAgg> &groups = chunkGroups[c];
+
+        for(ElemIndex elem=begin; elem<end; elem++)
+        {
+            if(!dataSet->visible(elem))
+                continue;
+            if(selectionDefined && !dataSet->selected(elem))
+                continue;
+
+            const Sample *s = &dataSet->samples.at(elem);
+            groupAgg &g = groups[dataSet->GetSampleAttribByIndex(s,axis)];
+            g.count += s->weight;
+            g.latency += (qreal)s->latency*s->weight;
+        }
+    });
+
+    QHash<long long,groupAgg> groups;
+    for(int c=0; c<numChunks; c++)
+    {
+        QHash<long long,groupAgg>::const_iterator it;
+        for(it=chunkGroups.at(c).constBegin(); it!=chunkGroups.at(c).constEnd(); it++)
+        {
+            groupAgg &g = groups[it.key()];
+            g.count += it.value().count;
+            g.latency += it.value().latency;
+        }
+    }
+
+    // Highest total latency first
+    QVector<QPair<long long,groupAgg> > rows;
+    QHash<long long,groupAgg>::const_iterator it;
+    for(it=groups.constBegin(); it!=groups.constEnd(); it++)
+        rows.push_back(qMakePair(it.key(),it.value()));
+    std::sort(rows.begin(),rows.end(),
+              [](const QPair<long long,groupAgg> &a, const QPair<long long,groupAgg> &b)
+              { return a.second.latency > b.second.latency; });
+
+    QString axisName = dataSet->axisName(axis);
+    lastTable.clear();
+    lastTable.push_back(quoteCSVField(axisName)+",samples,total latency,mean latency");
+    for(int r=0; r<rows.size(); r++)
+    {
+        const groupAgg &g = rows.at(r).second;
+        lastTable.push_back(QString("%1,%2,%3,%4")
+                            .arg(rows.at(r).first)
+                            .arg(g.count)
+                            .arg(g.latency,0,'f',0)
+                            .arg(g.latency/g.count,0,'f',2));
+    }
+
+    emit output(QString("%1 groups by %2").arg(rows.size()).arg(axisName));
+    for(int r=0; r<lastTable.size() && r<=20; r++)
+        emit output(lastTable.at(r));
+    if(lastTable.size() > 21)
+        emit output("...");
+
+    return true;
+}
+
+bool ScriptEngine::exportCommand(QStringList *args)
+{
+    if(args->size() != 3)
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    QString what = args->at(1).toLower();
+    QString fileName = outputPath(args->at(2));
+
+    if(what != "table" && what != "samples")
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+    if(what == "table" && lastTable.isEmpty())
+    {
+        emit output("No table to export, run groupby first");
+        return false;
+    }
+    if(what == "samples" && !requireData())
+        return false;
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate))
+    {
+        emit output("Unable to write "+fileName);
+        return false;
+    }
+
+    QTextStream out(&file);
+    if(what == "table")
+    {
+        for(int r=0; r<lastTable.size(); r++)
+            out << lastTable.at(r) << "\n";
+        emit output(QString("%1 rows written to %2").arg(lastTable.size()-1).arg(fileName));
+        return true;
+    }
+
+    // Selected samples, or everything visible without a selection
+    int numAxes = dataSet->numAxes();
+    for(int i=0; i<numAxes; i++)
+        out << quoteCSVField(dataSet->axisName(i)) << ",";
+    out << "source,variable,function\n";
+
+    bool selectionDefined = dataSet->selectionDefined();
+    ElemIndex written = 0;
+    for(ElemIndex elem=0; elem<dataSet->numElements; elem++)
+    {
+        if(!dataSet->visible(elem))
+            continue;
+        if(selectionDefined && !dataSet->selected(elem))
+            continue;
+
+        const Sample *s = &dataSet->samples.at(elem);
+        for(int i=0; i<numAxes; i++)
+            out << dataSet->GetSampleAttribByIndex(s,i) << ",";
+        out << quoteCSVField(s->source) << ","
+            << quoteCSVField(s->variable) << ","
+            << quoteCSVField(s->function) << "\n";
+        written++;
+    }
+
+    emit output(QString("%1 samples written to %2").arg(written).arg(fileName));
+    return true;
+}
+
+bool ScriptEngine::explainCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    QString text = queryText(args,1);
+    Query query(dataSet);
+    if(text.isEmpty() || !query.parse(text))
+    {
+        emit output(text.isEmpty() ? QString("Invalid arguments") : query.error());
+        return false;
+    }
+
+    query.plan();
+    emit output(query.explain());
+
+    // Run it too, so the estimates can be compared with the real count
+    QElapsedTimer timer;
+    timer.start();
+    Bitmap result = query.execute();
+    emit output(QString("%1 samples match, %2 ms").arg(result.count()).arg(timer.elapsed()));
+    return true;
+}
+
+bool ScriptEngine::derivedimCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    QString expr = args->mid(1).join(" ");
+    QString name = QString(expr).remove(' ');
+
+    // Optional name in front, the expression itself has no '='
+    int eq = expr.indexOf('=');
+    if(eq >= 0)
+    {
+        name = expr.left(eq).trimmed();
+        expr = expr.mid(eq+1).trimmed();
+    }
+
+    if(expr.isEmpty() || name.contains(' '))
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    QString error;
+    int axis = dataSet->addDerivedAxis(name,expr,error);
+    if(axis < 0)
+    {
+        emit output(error);
+        return false;
+    }
+
+    emit output(QString("Added dimension %1 (%2)").arg(name).arg(axis));
+    emit axesChangedSig();
+    return true;
+}
+
+bool ScriptEngine::undoCommand(QStringList *args, bool redo)
+{
+    Q_UNUSED(args);
+
+    if(!requireData())
+        return false;
+
+    bool ok = redo ? dataSet->redoSelection() : dataSet->undoSelection();
+    if(!ok)
+    {
+        emit output(redo ? "Nothing to redo" : "Nothing to undo");
+        return true;
+    }
+
+    emit output(QString::number(dataSet->selectedWeight)+" samples selected");
+    emit selectionChangedSig();
+    return true;
+}
+
+bool ScriptEngine::selgroupCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    if(args->size() > 2)
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    if(args->size() == 2)
+    {
+        if(args->at(1).toLower() == "clear")
+        {
+            dataSet->deselectGroup(ACTIVE_GROUP);
+            dataSet->recordSelection();
+            emit selectionChangedSig();
+        }
+        else
+        {
+            bool ok;
+            int group = args->at(1).toInt(&ok);
+            if(!ok || group < 1 || group > MAX_SELECTION_GROUPS)
+            {
+                emit output("Invalid arguments");
+                return false;
+            }
+            dataSet->setActiveGroup(group);
+        }
+    }
+
+    int group = dataSet->activeGroup();
+    emit output(QString("Active group %1, %2 samples")
+                .arg(group).arg(dataSet->selectedWeightIn(group)));
+    return true;
+}
+
+bool ScriptEngine::groupsCommand(QStringList *args)
+{
+    Q_UNUSED(args);
+
+    if(!requireData())
+        return false;
+
+    // Samples and latency of every group in one pass over the group column
+    int numGroups = dataSet->maxGroup()+1;
+    ElemIndex numElements = dataSet->numElements;
+    const quint8 *groupIds = dataSet->groupColumn();
+    int numChunks = parallelChunkCount(numElements,1);
+    QVector<QVector<groupAgg> > chunkAggs(numChunks);
+
+    parallelTasks(numChunks,[&](int c)
+    {
+        ElemIndex begin = numElements*c/numChunks;
+        ElemIndex end = numElements*(c+1)/numChunks;
+        QVector<groupAgg> &aggs = chunkAggs[c];
+        groupAgg zero = {0,0};
+        aggs.fill(zero,numGroups);
+
+        for(ElemIndex elem=begin; elem<end; elem++)
+        {
+            const Sample &s = dataSet->samples.at(elem);
+            groupAgg &g = aggs[groupIds[elem]];
+            g.count += s.weight;
+            g.latency += (qreal)s.latency*s.weight;
+        }
+    });
+
+    int numNonEmpty = 0;
+    lastTable.clear();
+    lastTable.push_back("group,samples,total latency,mean latency");
+    for(int g=0; g<numGroups; g++)
+    {
+        if(dataSet->numSelectedIn(g) == 0)
+            continue;
+        if(g > 0)
+            numNonEmpty++;
+
+        ElemIndex count = 0;
+        qreal latency = 0;
+        for(int c=0; c<numChunks; c++)
+        {
+            count += chunkAggs.at(c).at(g).count;
+            latency += chunkAggs.at(c).at(g).latency;
+        }
+
+        lastTable.push_back(QString("%1,%2,%3,%4")
+                            .arg(g)
+                            .arg(count)
+                            .arg(latency,0,'f',0)
+                            .arg(latency/count,0,'f',2));
+    }
+
+    emit output(QString("%1 selected in %2 groups, active group %3")
+                .arg(dataSet->selectedWeight)
+                .arg(numNonEmpty)
+                .arg(dataSet->activeGroup()));
+    for(int r=0; r<lastTable.size(); r++)
+        emit output(lastTable.at(r));
+
+    return true;
+}
+
+bool ScriptEngine::compareCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    if(args->size() != 2)
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    int axis = axisIndex(args->at(1));
+    if(axis < 0)
+    {
+        emit output("Unknown dimension "+args->at(1));
+        return false;
+    }
+
+    // Non-empty groups become columns
+    QVector<int> column(MAX_SELECTION_GROUPS+1,-1);
+    QVector<int> groupIds;
+    for(int g=1; g<=MAX_SELECTION_GROUPS; g++)
+    {
+        if(dataSet->numSelectedIn(g) == 0)
+            continue;
+        column[g] = groupIds.size();
+        groupIds.push_back(g);
+    }
+
+    if(groupIds.empty())
+    {
+        emit output("No selection groups to compare");
+        return false;
+    }
+
+    // Same pass as groupby, every key keeps one aggregate per group
+    int numCols = groupIds.size();
+    ElemIndex numElements = dataSet->numElements;
+    const quint8 *sampleGroups = dataSet->groupColumn();
+    int numChunks = parallelChunkCount(numElements,1);
+    QVector<QHash<long long,QVector<groupAgg> > > chunkGroups(numChunks);
+
+    parallelTasks(numChunks,[&](int c)
+    {
+        ElemIndex begin = numElements*c/numChunks;
+        ElemIndex end = numElements*(c+1)/numChunks;
+        QHash<long long,QVector<groupAgg> > &groups = chunkGroups[c];
+        groupAgg zero = {0,0};
+
+        for(ElemIndex elem=begin; elem<end; elem++)
+        {
+            int col = column.at(sampleGroups[elem]);
+            if(col < 0 || !dataSet->visible(elem))
+                continue;
+
+            const Sample *s = &dataSet->samples.at(elem);
+            QVector<groupAgg> &aggs = groups[dataSet->GetSampleAttribByIndex(s,axis)];
+            if(aggs.empty())
+                aggs.fill(zero,numCols);
+            aggs[col].count += s->weight;
+            aggs[col].latency += (qreal)s->latency*s->weight;
+        }
+    });
+
+    QHash<long long,QVector<groupAgg> > groups;
+    for(int c=0; c<numChunks; c++)
+    {
+        QHash<long long,QVector<groupAgg> >::const_iterator it;
+        for(it=chunkGroups.at(c).constBegin(); it!=chunkGroups.at(c).constEnd(); it++)
+        {
+            QVector<groupAgg> &aggs = groups[it.key()];
+            if(aggs.empty())
+            {
+                aggs = it.value();
+                continue;
+            }
+            for(int i=0; i<numCols; i++)
+            {
+                aggs[i].count += it.value().at(i).count;
+                aggs[i].latency += it.value().at(i).latency;
+            }
+        }
+    }
+
+    // Highest latency over all groups first
+    QVector<QPair<long long,qreal> > rows;
+    QHash<long long,QVector<groupAgg> >::const_iterator it;
+    for(it=groups.constBegin(); it!=groups.constEnd(); it++)
+    {
+        qreal total = 0;
+        for(int i=0; i<numCols; i++)
+            total += it.value().at(i).latency;
+        rows.push_back(qMakePair(it.key(),total));
+    }
+    std::sort(rows.begin(),rows.end(),
+              [](const QPair<long long,qreal> &a, const QPair<long long,qreal> &b)
+              { return a.second > b.second; });
+
+    QString axisName = dataSet->axisName(axis);
+    QString header = quoteCSVField(axisName);
+    for(int i=0; i<numCols; i++)
+        header += QString(",g%1 samples,g%1 mean latency").arg(groupIds.at(i));
+
+    lastTable.clear();
+    lastTable.push_back(header);
+    for(int r=0; r<rows.size(); r++)
+    {
+        const QVector<groupAgg> &aggs = groups[rows.at(r).first];
+        QString line = QString::number(rows.at(r).first);
+        for(int i=0; i<numCols; i++)
+        {
+            const groupAgg &g = aggs.at(i);
+            line += QString(",%1,%2").arg(g.count)
+                    .arg(g.count ? g.latency/g.count : 0,0,'f',2);
+        }
+        lastTable.push_back(line);
+    }
+
+    emit output(QString("%1 groups by %2 across %3 selection groups")
+                .arg(rows.size()).arg(axisName).arg(numCols));
+    for(int r=0; r<lastTable.size() && r<=20; r++)
+        emit output(lastTable.at(r));
+    if(lastTable.size() > 21)
+        emit output("...");
+
+    return true;
+}
+
+bool ScriptEngine::reuseCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    int streamAxis = SampleAxes::tid;
+    qreal period = 1;
+    for(int i=1; i<args->size(); i++)
+    {
+        QString a = args->at(i).toLower();
+        if(a == "thread")
+        {
+            streamAxis = SampleAxes::tid;
+            continue;
+        }
+        if(a == "variable" || a == "var")
+        {
+            streamAxis = SampleAxes::variableUid;
+            continue;
+        }
+
+        bool ok;
+        period = a.toDouble(&ok);
+        if(!ok || period < 1)
+        {
+            emit output("Invalid arguments");
+            return false;
+        }
+    }
+
+    // Cache lines of the whole trace, only the histogram is restricted
+    QVector<qint64> lines = dataSet->column(SampleAxes::addr);
+    for(int i=0; i<lines.size(); i++)
+        lines[i] >>= 6;
+
+    QVector<qint64> distances;
+    reuseDistances(dataSet,lines,dataSet->column(streamAxis),distances);
+
+    Bitmap mask = dataSet->selectionDefined() ? dataSet->selectionMask(ANY_GROUP)
+                                              : dataSet->visibilityMask();
+    ReuseHistogram h = reuseHistogram(distances,&mask);
+
+    lastTable.clear();
+    lastTable.push_back("distance,samples");
+    lastTable.push_back(QString("cold,%1").arg(h.cold));
+    for(int b=0; b<REUSE_BUCKETS; b++)
+    {
+        if(h.buckets.at(b) == 0)
+            continue;
+        qint64 lo = (b == 0) ? 0 : ((qint64)1 << (b-1));
+        qint64 hi = ((qint64)1 << b) - 1;
+        lastTable.push_back(QString("%1-%2,%3").arg(lo).arg(hi).arg(h.buckets.at(b)));
+    }
+
+    emit output(QString("Reuse distances of %1 samples in cache lines, per %2")
+                .arg(h.total).arg(streamAxis == SampleAxes::tid ? "thread" : "variable"));
+    for(int r=0; r<lastTable.size(); r++)
+        emit output(lastTable.at(r));
+
+    // Fully associative LRU with 64 byte lines
+    static const int cacheKB[] = {32, 256, 1024, 8192, 32768};
+    emit output("Predicted miss ratio :");
+    for(int c=0; c<5; c++)
+    {
+        qint64 capacity = (qint64)cacheKB[c]*1024/64;
+        emit output(QString("    %1 KB : %2")
+                    .arg(cacheKB[c])
+                    .arg(reuseMissRatio(h,capacity,period),0,'f',3));
+    }
+
+    return true;
+}
+
+// 32K, 8M or plain bytes
+static qint64 parseSize(QString s, bool *ok)
+{
+    qint64 unit = 1;
+    s = s.toUpper();
+    if(s.endsWith("K"))
+        unit = 1024;
+    else if(s.endsWith("M"))
+        unit = 1024*1024;
+    else if(s.endsWith("G"))
+        unit = 1024*1024*1024;
+    if(unit > 1)
+        s.chop(1);
+
+    return s.toLongLong(ok) * unit;
+}
+
+bool ScriptEngine::cachesimCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    CacheSimulator sim(dataSet);
+    bool selectMismatch = false;
+
+    // What-if overrides of single levels
+    for(int i=1; i<args->size(); i++)
+    {
+        QString a = args->at(i);
+        if(a == "--select")
+        {
+            selectMismatch = true;
+            continue;
+        }
+
+        QStringList kv = a.split("=");
+        bool ok = kv.size() == 2 && kv.at(0).size() == 2 && kv.at(0).at(0).toUpper() == 'L';
+        int level = ok ? kv.at(0).mid(1).toInt(&ok) : 0;
+        ok = ok && level >= 1 && level <= sim.numLevels();
+
+        CacheGeometry g = ok ? sim.geometry(level) : CacheGeometry();
+        QStringList sw = ok ? kv.at(1).split(":") : QStringList();
+        if(ok)
+            g.size = parseSize(sw.at(0),&ok);
+        if(ok && sw.size() > 1)
+            g.ways = sw.at(1).toInt(&ok);
+
+        if(!ok || g.size <= 0 || g.ways <= 0 || sw.size() > 2)
+        {
+            emit output("Invalid arguments");
+            return false;
+        }
+        sim.setGeometry(level,g);
+    }
+
+    emit output(sim.fromTopology() ? "Cache hierarchy from hardware.xml :"
+                                   : "No caches in the topology, defaults :");
+    for(int l=1; l<=sim.numLevels(); l++)
+    {
+        CacheGeometry g = sim.geometry(l);
+        emit output(QString("    L%1 : %2 KB, %3 ways, %4 byte lines")
+                    .arg(l).arg(g.size/1024).arg(g.ways).arg(g.lineSize));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<qint8> predicted;
+    sim.run(predicted);
+    qint64 elapsed = timer.elapsed();
+
+    // Measured (rows) against predicted (columns) source, row 0 collects
+    // samples without a known source. The replay is per row, the matrix
+    // counts every row by its weight.
+    Bitmap mask = dataSet->selectionDefined() ? dataSet->selectionMask(ANY_GROUP)
+                                              : dataSet->visibilityMask();
+    qint64 matrix[SIM_MEMORY+1][SIM_MEMORY+1] = {{0}};
+    qint64 total = 0, agree = 0;
+    Bitmap mismatch(dataSet->numElements);
+    mask.forEachSet([&](qint64 e)
+    {
+        int measured = dataSet->samples.at(e).data_src;
+        int p = predicted.at(e);
+        measured = (measured >= 1 && measured <= SIM_MEMORY) ? measured : 0;
+        qint64 weight = dataSet->samples.at(e).weight;
+        matrix[measured][p] += weight;
+        if(!measured)
+            return;
+
+        total += weight;
+        if(measured == p)
+            agree += weight;
+        else
+            mismatch.set(e);
+    });
+
+    QStringList names;
+    names << "other";
+    for(int l=1; l<SIM_MEMORY; l++)
+        names << QString("L%1").arg(l);
+    names << "RAM";
+
+    QString header = "measured/predicted";
+    for(int p=1; p<=SIM_MEMORY; p++)
+        header += ","+names.at(p);
+
+    lastTable.clear();
+    lastTable.push_back(header);
+    for(int m=1; m<=SIM_MEMORY+1; m++)
+    {
+        int row = m % (SIM_MEMORY+1);
+        QString line = names.at(row);
+        for(int p=1; p<=SIM_MEMORY; p++)
+            line += QString(",%1").arg(matrix[row][p]);
+        lastTable.push_back(line);
+    }
+
+    emit output(QString("Replayed %1 rows in %2 ms").arg(dataSet->numElements).arg(elapsed));
+    for(int r=0; r<lastTable.size(); r++)
+        emit output(lastTable.at(r));
+    emit output(QString("Agreement : %1%").arg(total ? 100.0*agree/total : 0,0,'f',1));
+
+    if(selectMismatch)
+    {
+        dataSet->selectMask(mismatch);
+        dataSet->recordSelection();
+        emit output(QString::number(dataSet->selectedWeight)+" samples selected");
+        emit selectionChangedSig();
+    }
+
+    return true;
+}
+
+bool ScriptEngine::falseshareCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    int top = 20;
+    bool selectLines = false;
+    for(int i=1; i<args->size(); i++)
+    {
+        bool ok = true;
+        if(args->at(i) == "--select")
+            selectLines = true;
+        else
+            top = args->at(i).toInt(&ok);
+
+        if(!ok || top <= 0)
+        {
+            emit output("Invalid arguments");
+            return false;
+        }
+    }
+
+    Bitmap mask = dataSet->selectionDefined() ? dataSet->selectionMask(ANY_GROUP)
+                                              : dataSet->visibilityMask();
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<LineContention> lines = findLineContention(dataSet,mask,top);
+    qint64 elapsed = timer.elapsed();
+
+    lastTable.clear();
+    lastTable.push_back("line,samples,hitm,cpus,hitm_latency,sharing,variable,source");
+    for(int i=0; i<lines.size(); i++)
+    {
+        const LineContention &lc = lines.at(i);
+        const Sample &var = dataSet->samples.at(lc.variableSample);
+        const Sample &src = dataSet->samples.at(lc.sourceSample);
+        lastTable.push_back(QString("0x%1,%2,%3,%4,%5,%6,%7,%8:%9")
+                            .arg((quint64)lc.line << CACHE_LINE_SHIFT,0,16)
+                            .arg(lc.samples)
+                            .arg(lc.hitm)
+                            .arg(lc.numCpus)
+                            .arg(lc.hitmLatency)
+                            .arg(lc.falseSharing ? "false" : "true")
+                            .arg(var.variable)
+                            .arg(src.source)
+                            .arg(src.line));
+    }
+
+    emit output(QString("%1 contended lines, analyzed in %2 ms").arg(lines.size()).arg(elapsed));
+    for(int r=0; r<lastTable.size(); r++)
+        emit output(lastTable.at(r));
+
+    if(selectLines)
+    {
+        QSet<qint64> reported;
+        for(int i=0; i<lines.size(); i++)
+            reported.insert(lines.at(i).line);
+
+        Bitmap onLines(dataSet->numElements);
+        mask.forEachSet([&](qint64 e)
+        {
+            if(reported.contains(dataSet->samples.at(e).addr >> CACHE_LINE_SHIFT))
+                onLines.set(e);
+        });
+
+        dataSet->selectMask(onLines);
+        dataSet->recordSelection();
+        emit output(QString::number(dataSet->selectedWeight)+" samples selected");
+        emit selectionChangedSig();
+    }
+
+    return true;
+}
+
+bool ScriptEngine::numaCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    QString mode = args->size() > 1 ? args->at(1) : QString("nodes");
+    int top = 20;
+    qint64 pageSize = 4096;
+    bool ok = mode == "nodes" || mode == "variables" || mode == "pages";
+    for(int i=2; i<args->size() && ok; i++)
+    {
+        if(args->at(i).startsWith("--page="))
+            pageSize = parseSize(args->at(i).mid(7),&ok);
+        else
+            top = args->at(i).toInt(&ok);
+    }
+
+    if(!ok || top <= 0 || pageSize <= 0 || (pageSize & (pageSize-1)))
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    NumaMap map(dataSet);
+    Bitmap mask = dataSet->selectionDefined() ? dataSet->selectionMask(ANY_GROUP)
+                                              : dataSet->visibilityMask();
+    emit output(map.fromTopology() ? QString("%1 NUMA domains").arg(map.numNodes())
+                                   : QString("No NUMA domains in the topology, one node assumed"));
+
+    lastTable.clear();
+    if(mode == "pages")
+    {
+        int pageShift = qCountTrailingZeroBits((quint64)pageSize);
+        QVector<PageRange> ranges = numaPageRanges(dataSet,mask,map,pageShift,top);
+
+        QString header = "first,last,pages";
+        for(int n=0; n<std::min(map.numNodes(),NUMA_MAX_NODES); n++)
+            header += QString(",node%1").arg(map.nodeId(n));
+        lastTable.push_back(header+",remote,remote_latency,suggestion");
+
+        for(int i=0; i<ranges.size(); i++)
+        {
+            const PageRange &r = ranges.at(i);
+            QString line = QString("0x%1,0x%2,%3")
+                    .arg((quint64)r.first << pageShift,0,16)
+                    .arg(((quint64)r.last+1) << pageShift,0,16)
+                    .arg(r.pages);
+            for(int n=0; n<r.accesses.size(); n++)
+                line += QString(",%1").arg(r.accesses.at(n));
+            line += QString(",%1,%2,").arg(r.remote).arg(r.remoteLatency);
+            line += r.home == NUMA_INTERLEAVE ? QString("interleave")
+                                              : QString("first touch on node %1").arg(map.nodeId(r.home));
+            lastTable.push_back(line);
+        }
+    }
+    else
+    {
+        NumaLocality loc = numaLocality(dataSet,mask,map);
+
+        // With two nodes the home of remote accesses is known
+        bool twoNodes = loc.numNodes == 2;
+        lastTable.push_back(QString(mode == "variables" ? "variable," : "")
+                            + (twoNodes ? "node,home0,home1,local,remote,local_latency,remote_latency"
+                                        : "node,local,remote,local_latency,remote_latency"));
+
+        int rows = mode == "variables" ? loc.numVariables : 1;
+        for(int v=0; v<rows; v++)
+        {
+            for(int n=0; n<loc.numNodes; n++)
+            {
+                const LocalityAgg &a = mode == "variables" ? loc.at(v,n) : loc.nodes.at(n);
+                if(a.local == 0 && a.remote == 0)
+                    continue;
+
+                QString line;
+                if(mode == "variables")
+                    line = dataSet->samples.at(loc.variableSample.at(v)).variable + ",";
+                line += QString::number(map.nodeId(n));
+                if(twoNodes)
+                    line += QString(",%1,%2").arg(n == 0 ? a.local : a.remote)
+                                             .arg(n == 1 ? a.local : a.remote);
+                line += QString(",%1,%2,%3,%4").arg(a.local).arg(a.remote)
+                                               .arg(a.localLatency).arg(a.remoteLatency);
+                lastTable.push_back(line);
+            }
+        }
+    }
+
+    for(int r=0; r<lastTable.size(); r++)
+        emit output(lastTable.at(r));
+
+    return true;
+}
+
+bool ScriptEngine::tlbCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    int top = 20;
+    qint64 pageSize = 4096;
+    bool selectMisses = false;
+    bool ok = true;
+    for(int i=1; i<args->size() && ok; i++)
+    {
+        if(args->at(i) == "--select")
+            selectMisses = true;
+        else if(args->at(i).startsWith("--page="))
+            pageSize = parseSize(args->at(i).mid(7),&ok);
+        else
+            top = args->at(i).toInt(&ok);
+    }
+
+    if(!ok || top <= 0 || pageSize < 4096 || (pageSize & (pageSize-1)))
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    Bitmap mask = dataSet->selectionDefined() ? dataSet->selectionMask(ANY_GROUP)
+                                              : dataSet->visibilityMask();
+
+    // Flag totals, the flags are one byte per sample
+    QVector<qint64> flagCounts(5,0);
+    qint64 total = 0;
+    mask.forEachSet([&](qint64 e)
+    {
+        const Sample &s = dataSet->samples.at(e);
+        total += s.weight;
+        for(int b=0; b<flagCounts.size(); b++)
+            flagCounts[b] += ((s.dse_flags >> b) & 1)*s.weight;
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    int pageShift = qCountTrailingZeroBits((quint64)pageSize);
+    QVector<TlbPage> pages = stlbPages(dataSet,mask,pageShift,top);
+    qint64 elapsed = timer.elapsed();
+
+    emit output(QString("%1 samples : %2 STLB misses, %3 locked, %4 dirty, %5 snoop, %6 remote")
+                .arg(total).arg(flagCounts.at(0)).arg(flagCounts.at(1))
+                .arg(flagCounts.at(2)).arg(flagCounts.at(3)).arg(flagCounts.at(4)));
+
+    lastTable.clear();
+    lastTable.push_back("page,samples,stlb_misses,miss_ratio,stlb_latency,4k_pages");
+    for(int i=0; i<pages.size(); i++)
+    {
+        const TlbPage &p = pages.at(i);
+        lastTable.push_back(QString("0x%1,%2,%3,%4,%5,%6")
+                            .arg((quint64)p.page << pageShift,0,16)
+                            .arg(p.samples)
+                            .arg(p.stlbMisses)
+                            .arg((qreal)p.stlbMisses/p.samples,0,'f',3)
+                            .arg(p.stlbLatency)
+                            .arg(p.smallPages));
+    }
+
+    emit output(QString("%1 pages with STLB misses, aggregated in %2 ms").arg(pages.size()).arg(elapsed));
+    for(int r=0; r<lastTable.size(); r++)
+        emit output(lastTable.at(r));
+
+    if(selectMisses)
+    {
+        QSet<qint64> reported;
+        for(int i=0; i<pages.size(); i++)
+            reported.insert(pages.at(i).page);
+
+        Bitmap misses(dataSet->numElements);
+        mask.forEachSet([&](qint64 e)
+        {
+            const Sample &s = dataSet->samples.at(e);
+            if((s.dse_flags & DSE_FLAG_STLB) && reported.contains((quint64)s.addr >> pageShift))
+                misses.set(e);
+        });
+
+        dataSet->selectMask(misses);
+        dataSet->recordSelection();
+        emit output(QString::number(dataSet->selectedWeight)+" samples selected");
+        emit selectionChangedSig();
+    }
+
+    return true;
+}
+
+bool ScriptEngine::clusterCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    ComputePool *pool = dataSet->computePool();
+    if(args->size() == 2 && args->at(1) == "cancel")
+    {
+        if(pool)
+            pool->cancel(this);
+        emit output("Clustering cancelled");
+        return true;
+    }
+
+    bool ok = args->size() == 2 || args->size() == 3;
+    int k = 4;
+    if(ok && args->size() == 3)
+        k = args->at(2).toInt(&ok);
+    if(!ok || k < 1 || k > MAX_SELECTION_GROUPS)
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    int axis = axisIndex(args->at(1));
+    if(axis < 0)
+    {
+        emit output("Unknown dimension "+args->at(1));
+        return false;
+    }
+
+    QSharedPointer<QElapsedTimer> timer(new QElapsedTimer);
+    timer->start();
+
+    // Batch mode has no pool and waits for the result
+    if(!pool)
+    {
+        dataSet->cluster(distanceHardware,axis);
+        finishCluster(k,timer->elapsed());
+        return true;
+    }
+
+    // In the GUI the pool runs it, a visibility change or a newer cluster
+    // command cancels it. The axis columns are taken here on the GUI thread.
+    DataObject *d = dataSet;
+    QVector<qint64> keys = d->column(axis);
+    QVector<ElemIndex> order = d->sortedIndex(axis);
+    pool->submit<SampleClusters>("cluster",COMPUTE_VISIBILITY,this,
+                                 [d,keys,order](const ComputeToken &token)
+    {
+        return d->computeClusters(token,distanceHardware,keys,order);
+    },
+    [this,d,k,timer](const SampleClusters &c)
+    {
+        if(d != dataSet || c.leaf.isEmpty())
+            return;
+        dataSet->applyClusters(c);
+        finishCluster(k,timer->elapsed());
+    });
+    emit output("Clustering in the background, 'cluster cancel' stops it");
+
+    return true;
+}
+
+void ScriptEngine::finishCluster(int k, qint64 elapsed)
+{
+    const Dendrogram &tree = dataSet->clusterDendrogram();
+    emit output(QString("Clustered %1 groups in %2 ms").arg(tree.numLeaves).arg(elapsed));
+
+    dataSet->selectClusters(k);
+    dataSet->recordSelection();
+    emit output(QString::number(dataSet->selectedWeight)+" samples in "
+                +QString::number(std::min(k,tree.numLeaves))+" groups, see 'groups'");
+    emit selectionChangedSig();
+}
+
+bool ScriptEngine::flatClusterAxes(QStringList *args, int first, QVector<int> *axes)
+{
+    for(int i=first; i<args->size(); i++)
+    {
+        if(args->at(i).startsWith("--"))
+            continue;
+
+        int axis = axisIndex(args->at(i));
+        if(axis < 0)
+        {
+            emit output("Unknown dimension "+args->at(i));
+            return false;
+        }
+        axes->push_back(axis);
+    }
+
+    if(axes->isEmpty())
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+    return true;
+}
+
+bool ScriptEngine::applyClusters(const FeatureMatrix &f, const QVector<int> &labels,
+                                 const QVector<int> &axes, qint64 elapsed)
+{
+    QVector<qint64> values(dataSet->numElements,-1);
+    int numClusters = 0;
+    for(int r=0; r<f.rows; r++)
+    {
+        values[f.elems.at(r)] = labels.at(r);
+        numClusters = std::max(numClusters,labels.at(r)+1);
+    }
+
+    if(dataSet->setColumnAxis("cluster",values) < 0)
+    {
+        emit output("Dimension cluster already exists");
+        return false;
+    }
+
+    // Weighted mean of every clustered dim, clusters past the selection
+    // groups are only counted
+    int listed = std::min(numClusters,MAX_SELECTION_GROUPS);
+    QVector<qint64> sizes(listed,0);
+    QVector<qreal> sums(listed*axes.size(),0);
+    qint64 noise = 0;
+    qint64 weight = 0;
+    for(int a=0; a<axes.size(); a++)
+    {
+        const qint64 *col = dataSet->column(axes.at(a)).constData();
+        for(int r=0; r<f.rows; r++)
+        {
+            int l = labels.at(r);
+            if(l >= 0 && l < listed)
+                sums[l*axes.size()+a] += (qreal)col[f.elems.at(r)]*f.weights.at(r);
+        }
+    }
+    for(int r=0; r<f.rows; r++)
+    {
+        weight += f.weights.at(r);
+        if(labels.at(r) < 0)
+            noise += f.weights.at(r);
+        else if(labels.at(r) < listed)
+            sizes[labels.at(r)] += f.weights.at(r);
+    }
+
+    lastTable.clear();
+    QString header = "cluster,samples";
+    for(int a=0; a<axes.size(); a++)
+        header += ","+dataSet->axisName(axes.at(a));
+    lastTable.push_back(header);
+    for(int c=0; c<listed; c++)
+    {
+        QString row = QString("%1,%2").arg(c).arg(sizes.at(c));
+        for(int a=0; a<axes.size(); a++)
+            row += ","+QString::number(sums.at(c*axes.size()+a)/sizes.at(c),'f',2);
+        lastTable.push_back(row);
+    }
+
+    emit output(QString("%1 clusters of %2 samples in %3 ms, %4 noise")
+                .arg(numClusters).arg(weight).arg(elapsed).arg(noise));
+    for(int r=0; r<lastTable.size(); r++)
+        emit output(lastTable.at(r));
+
+    dataSet->selectLabels(values);
+    dataSet->recordSelection();
+    emit output(QString::number(dataSet->selectedWeight)+" samples in "
+                +QString::number(listed)+" groups, see 'groups'");
+    emit axesChangedSig();
+    emit selectionChangedSig();
+
+    return true;
+}
+
+bool ScriptEngine::kmeansCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    bool ok = args->size() >= 3;
+    int k = ok ? args->at(1).toInt(&ok) : 0;
+    int batchSize = 1024;
+    int iterations = 100;
+    for(int i=2; i<args->size() && ok; i++)
+    {
+        if(args->at(i).startsWith("--batch="))
+            batchSize = args->at(i).mid(8).toInt(&ok);
+        else if(args->at(i).startsWith("--iter="))
+            iterations = args->at(i).mid(7).toInt(&ok);
+    }
+
+    if(!ok || k < 1 || k > MAX_SELECTION_GROUPS || batchSize < 1 || iterations < 0)
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    QVector<int> axes;
+    if(!flatClusterAxes(args,2,&axes))
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    FeatureMatrix f = featureMatrix(dataSet,dataSet->visibilityMask(),axes);
+    QVector<int> labels = kmeansMiniBatch(f,k,batchSize,iterations,1);
+
+    return applyClusters(f,labels,axes,timer.elapsed());
+}
+
+bool ScriptEngine::dbscanCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    bool ok = args->size() >= 4;
+    float eps = ok ? args->at(1).toFloat(&ok) : 0;
+    int minPts = ok ? args->at(2).toInt(&ok) : 0;
+
+    // Grid coordinates are 16 bits
+    if(!ok || eps < 1e-4f || eps > 1 || minPts < 1)
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    QVector<int> axes;
+    if(!flatClusterAxes(args,3,&axes))
+        return false;
+    if(axes.size() > DBSCAN_MAX_DIMS)
+    {
+        emit output(QString("dbscan takes at most %1 dimensions").arg(DBSCAN_MAX_DIMS));
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    FeatureMatrix f = featureMatrix(dataSet,dataSet->visibilityMask(),axes);
+    QVector<int> labels = dbscan(f,eps,minPts);
+
+    return applyClusters(f,labels,axes,timer.elapsed());
+}
+
+bool ScriptEngine::patternsCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    bool ok = args->size() <= 2;
+    int top = 20;
+    if(ok && args->size() == 2)
+        top = args->at(1).toInt(&ok);
+    if(!ok || top <= 0)
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    Bitmap mask = dataSet->selectionDefined() ? dataSet->selectionMask(ANY_GROUP)
+                                              : dataSet->visibilityMask();
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<qint64> patterns, strides;
+    QVector<AccessPattern> found = accessPatterns(dataSet,mask,&patterns,&strides);
+    qint64 elapsed = timer.elapsed();
+
+    if(dataSet->setColumnAxis("pattern",patterns) < 0 ||
+       dataSet->setColumnAxis("stride",strides) < 0)
+    {
+        emit output("Dimensions pattern and stride already exist");
+        return false;
+    }
+
+    QVector<qreal> classLatency(3,0);
+    qreal total = 0;
+    for(int i=0; i<found.size(); i++)
+    {
+        total += found.at(i).latency;
+        if(found.at(i).pattern >= 0)
+            classLatency[found.at(i).pattern] += found.at(i).latency;
+    }
+
+    lastTable.clear();
+    lastTable.push_back("instruction,ip,source,line,samples,latency,pattern,stride,stride_share,top_deltas");
+    for(int i=0; i<found.size() && i<top; i++)
+    {
+        const AccessPattern &p = found.at(i);
+        const Sample &s = dataSet->samples.at(p.sample);
+
+        QStringList deltas;
+        for(int t=0; t<p.topDeltas.size(); t++)
+            deltas << QString("%1x%2").arg(p.topDeltas.at(t).delta).arg(p.topDeltas.at(t).count);
+
+        lastTable.push_back(QString("%1,0x%2,%3,%4,%5,%6,%7,%8,%9,%10")
+                            .arg(p.instruction)
+                            .arg((quint64)s.ip,0,16)
+                            .arg(s.source)
+                            .arg(s.line)
+                            .arg(p.samples)
+                            .arg(p.latency)
+                            .arg(patternName(p.pattern))
+                            .arg(p.stride)
+                            .arg(p.strideShare,0,'f',2)
+                            .arg(deltas.join(";")));
+    }
+
+    emit output(QString("%1 instructions classified in %2 ms").arg(found.size()).arg(elapsed));
+    for(int c=0; c<classLatency.size(); c++)
+        emit output(QString("  %1 : %2% of latency").arg(patternName(c))
+                    .arg(total > 0 ? 100*classLatency.at(c)/total : 0,0,'f',1));
+    for(int r=0; r<lastTable.size(); r++)
+        emit output(lastTable.at(r));
+
+    emit axesChangedSig();
+    return true;
+}
+
+bool ScriptEngine::workingsetCommand(QStringList *args)
+{
+    if(!requireData())
+        return false;
+
+    int windows = 16;
+    QString mode;
+    bool ok = true;
+    for(int i=1; i<args->size() && ok; i++)
+    {
+        if(args->at(i) == "thread" || args->at(i) == "variable")
+            mode = args->at(i);
+        else
+            windows = args->at(i).toInt(&ok);
+    }
+
+    if(!ok || windows < 1 || windows > 4096)
+    {
+        emit output("Invalid arguments");
+        return false;
+    }
+
+    Bitmap mask = dataSet->selectionDefined() ? dataSet->selectionMask(ANY_GROUP)
+                                              : dataSet->visibilityMask();
+
+    QElapsedTimer timer;
+    timer.start();
+    WorkingSet ws(dataSet,mask,windows);
+    qint64 elapsed = timer.elapsed();
+
+    emit output(QString("%1 threads, %2 variables sketched in %3 ms")
+                .arg(ws.numThreads()).arg(ws.numVariables()).arg(elapsed));
+    if(ws.numWindows() < windows)
+    {
+        emit output(QString("Using %1 windows, more do not fit in %2 MB of sketches")
+                    .arg(ws.numWindows()).arg(WS_MAX_WINDOW_BYTES >> 20));
+        windows = ws.numWindows();
+    }
+
+    // Sizes to compare against, samples only see part of the accesses so
+    // these are lower bounds of the real working set
+    CacheSimulator sim(dataSet);
+    QVector<qint64> cacheSizes;
+    QStringList cacheNames;
+    for(int l=2; l<=sim.numLevels(); l++)
+    {
+        cacheSizes.push_back(sim.geometry(l).size);
+        cacheNames << QString("L%1").arg(l);
+        emit output(QString("    L%1 : %2 KB%3").arg(l).arg(sim.geometry(l).size/1024)
+                    .arg(sim.fromTopology() ? "" : " (default)"));
+    }
+
+    lastTable.clear();
+    if(mode == "thread")
+    {
+        lastTable.push_back("tid,lines,pages,bytes,peak_window_bytes");
+        for(int t=0; t<ws.numThreads(); t++)
+        {
+            WorkingSetSize total = ws.size(0,windows-1,t);
+            qreal peak = 0;
+            for(int w=0; w<windows; w++)
+                peak = std::max(peak,ws.size(w,w,t).lines);
+
+            lastTable.push_back(QString("%1,%2,%3,%4,%5")
+                                .arg(ws.threadId(t))
+                                .arg(qRound64(total.lines))
+                                .arg(qRound64(total.pages))
+                                .arg(qRound64(total.lines) << WS_LINE_SHIFT)
+                                .arg(qRound64(peak) << WS_LINE_SHIFT));
+        }
+    }
+    else if(mode == "variable")
+    {
+        lastTable.push_back("variable,lines,pages,bytes");
+        for(int v=0; v<ws.numVariables(); v++)
+        {
+            WorkingSetSize total = ws.variableSize(v);
+            lastTable.push_back(QString("%1,%2,%3,%4")
+                                .arg(dataSet->samples.at(ws.variableSample(v)).variable)
+                                .arg(qRound64(total.lines))
+                                .arg(qRound64(total.pages))
+                                .arg(qRound64(total.lines) << WS_LINE_SHIFT));
+        }
+    }
+    else
+    {
+        // Per window and merged from the start, the first window a merged
+        // working set outgrows each cache is reported
+        QVector<WorkingSetSize> growth = ws.growth();
+        QVector<int> exceeded(cacheSizes.size(),-1);
+        lastTable.push_back("window,start_time,lines,pages,bytes,cumulative_bytes");
+        for(int w=0; w<windows; w++)
+        {
+            WorkingSetSize win = ws.size(w,w);
+            qint64 cumulative = qRound64(growth.at(w).lines) << WS_LINE_SHIFT;
+            for(int c=0; c<cacheSizes.size(); c++)
+                if(exceeded.at(c) < 0 && cumulative > cacheSizes.at(c))
+                    exceeded[c] = w;
+
+            lastTable.push_back(QString("%1,%2,%3,%4,%5,%6")
+                                .arg(w)
+                                .arg(ws.windowStart(w))
+                                .arg(qRound64(win.lines))
+                                .arg(qRound64(win.pages))
+                                .arg(qRound64(win.lines) << WS_LINE_SHIFT)
+                                .arg(cumulative));
+        }
+
+        for(int c=0; c<cacheSizes.size(); c++)
+        {
+            if(exceeded.at(c) < 0)
+                emit output("Working set fits in "+cacheNames.at(c));
+            else
+                emit output(QString("Working set outgrows %1 in window %2")
+                            .arg(cacheNames.at(c)).arg(exceeded.at(c)));
+        }
+    }
+
+    for(int r=0; r<lastTable.size(); r++)
+        emit output(lastTable.at(r));
+
+    return true;
+}
@@ -0,0 +1,163 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef SCRIPTENGINE_H
+#define SCRIPTENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class DataObject;
+struct FeatureMatrix;
+
+enum CMD_TYPE {
+    CMD_HELP = 0,
+    CMD_SELECT,
+    CMD_HIDE,
+    CMD_SHOW,
+    CMD_INSPECT,
+    CMD_GROUPBY,
+    CMD_EXPORT,
+    CMD_EXPLAIN,
+    CMD_DERIVEDIM,
+    CMD_UNDO,
+    CMD_REDO,
+    CMD_SELGROUP,
+    CMD_GROUPS,
+    CMD_COMPARE,
+    CMD_REUSE,
+    CMD_CACHESIM,
+    CMD_FALSESHARE,
+    CMD_NUMA,
+    CMD_TLB,
+    CMD_CLUSTER,
+    CMD_KMEANS,
+    CMD_DBSCAN,
+    CMD_PATTERNS,
+    CMD_WORKINGSET,
+    CMD_UNKNOWN
+};
+
+enum QUERY_TYPE {
+    QUERY_DIMRANGE = 0,
+    QUERY_RESOURCE,
+    QUERY_SELECTED,
+    QUERY_UNSELECTED,
+    QUERY_ALL,
+    QUERY_UNKNOWN
+};
+
+// Executes console commands on a data set. Shared by the GUI console and the
+// headless batch mode, so it must not touch any widget.
+class ScriptEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    ScriptEngine(QObject *parent = 0);
+
+    void setDataSet(DataObject *dsobj);
+    void setOutputDir(QString dir);
+
+    // Returns false if the command failed
+    bool execute(QString cmdLine);
+
+    // Runs every line of a script, stops at the first failing command
+    bool executeScript(QString fileName);
+
+    static QString helpText();
+
+signals:
+    void output(QString msg);
+    void selectionChangedSig();
+    void visibilityChangedSig();
+    void axesChangedSig();
+
+public:
+    CMD_TYPE getCommandType(QString cmd);
+    QUERY_TYPE getQueryType(QString qtype);
+
+    // Query text of args[first..], legacy DIMRANGE and RESOURCE forms
+    // rewritten into the query language
+    QString queryText(QStringList *args, int first);
+
+    int axisIndex(QString dim);
+
+private:
+    bool helpCommand(QStringList *args);
+    bool inspectCommand(QStringList *args);
+    bool selectCommand(QStringList *args);
+    bool hideCommand(QStringList *args);
+    bool showCommand(QStringList *args);
+    bool groupbyCommand(QStringList *args);
+    bool exportCommand(QStringList *args);
+    bool explainCommand(QStringList *args);
+    bool derivedimCommand(QStringList *args);
+    bool undoCommand(QStringList *args, bool redo);
+    bool selgroupCommand(QStringList *args);
+    bool groupsCommand(QStringList *args);
+    bool compareCommand(QStringList *args);
+    bool reuseCommand(QStringList *args);
+    bool cachesimCommand(QStringList *args);
+    bool falseshareCommand(QStringList *args);
+    bool numaCommand(QStringList *args);
+    bool tlbCommand(QStringList *args);
+    bool clusterCommand(QStringList *args);
+    void finishCluster(int k, qint64 elapsed);
+    bool kmeansCommand(QStringList *args);
+    bool dbscanCommand(QStringList *args);
+    bool patternsCommand(QStringList *args);
+    bool workingsetCommand(QStringList *args);
+    bool flatClusterAxes(QStringList *args, int first, QVector<int> *axes);
+    bool applyClusters(const FeatureMatrix &f, const QVector<int> &labels,
+                       const QVector<int> &axes, qint64 elapsed);
+
+    bool requireData();
+    QString outputPath(QString fileName);
+
+private:
+    DataObject *dataSet;
+    QString outputDir;
+
+    // Result of the last group-by, written out by "export table"
+    QStringList lastTable;
+};
+
+#endif // SCRIPTENGINE_H
@@ -0,0 +1,168 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "selectionhistory.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Oldest steps are dropped past either limit
+#define HISTORY_MAX_STEPS 1000
+#define HISTORY_MAX_BYTES (256*1024*1024)
+
+SelectionHistory::SelectionHistory()
+{
+    nextId = 1;
+    reset(0);
+}
+
+void SelectionHistory::reset(qint64 size)
+{
+    n = size;
+    current.fill(0,(size+7)/8);
+    deltas.clear();
+    ids.clear();
+    ids.push_back(nextId++);
+    pos = 0;
+    bytes = 0;
+}
+
+bool SelectionHistory::record(const QVector<quint8> &groups)
+{
+    if(groups.size() != n)
+        return false;
+
+    // Differing words per chunk, concatenated in order afterwards
+    int numWords = current.size();
+    int numChunks = parallelChunkCount(numWords,4096);
+    QVector<SelectionDelta> parts(numChunks);
+
+    const quint64 *a = current.constData();
+    const quint8 *g = groups.constData();
+    qint64 size = n;
+    parallelTasks(numChunks,[&](int c)
+    {
+        int begin = (qint64)numWords*c/numChunks;
+        int end = (qint64)numWords*(c+1)/numChunks;
+        SelectionDelta &part = parts[c];
+        part.changed = 0;
+        for(int w=begin; w<end; w++)
+        {
+            quint64 b = 0;
+            std::memcpy(&b,g+(qint64)w*8,std::min((qint64)8,size-(qint64)w*8));
+
+            quint64 x = a[w] ^ b;
+            if(x)
+            {
+                part.words.push_back(w);
+                part.bits.push_back(x);
+                for(int k=0; k<8; k++)
+                    part.changed += ((x >> (k*8)) & 0xff) != 0;
+            }
+        }
+    });
+
+    SelectionDelta d;
+    d.changed = 0;
+    for(int c=0; c<numChunks; c++)
+    {
+        d.words += parts.at(c).words;
+        d.bits += parts.at(c).bits;
+        d.changed += parts.at(c).changed;
+    }
+
+    if(d.changed == 0)
+        return false;
+
+    // A new branch replaces whatever could have been redone
+    for(int i=pos; i<deltas.size(); i++)
+        bytes -= deltas.at(i).words.size()*(sizeof(int)+sizeof(quint64));
+    deltas.resize(pos);
+    ids.resize(pos+1);
+
+    apply(d);
+    deltas.push_back(d);
+    ids.push_back(nextId++);
+    pos++;
+    bytes += d.words.size()*(sizeof(int)+sizeof(quint64));
+
+    trim();
+    return true;
+}
+
+const SelectionDelta &SelectionHistory::undo()
+{
+    Q_ASSERT(canUndo());
+    pos--;
+    apply(deltas.at(pos));
+    return deltas.at(pos);
+}
+
+const SelectionDelta &SelectionHistory::redo()
+{
+    Q_ASSERT(canRedo());
+    apply(deltas.at(pos));
+    pos++;
+    return deltas.at(pos-1);
+}
+
+void SelectionHistory::apply(const SelectionDelta &d)
+{
+    quint64 *w = current.data();
+    for(int i=0; i<d.words.size(); i++)
+        w[d.words.at(i)] ^= d.bits.at(i);
+}
+
+void SelectionHistory::trim()
+{
+    int drop = 0;
+    while(drop < pos &&
+          (deltas.size()-drop > HISTORY_MAX_STEPS || bytes > HISTORY_MAX_BYTES))
+    {
+        bytes -= deltas.at(drop).words.size()*(sizeof(int)+sizeof(quint64));
+        drop++;
+    }
+
+    if(drop == 0)
+        return;
+
+    deltas.remove(0,drop);
+    ids.remove(0,drop);
+    pos -= drop;
+}
@@ -0,0 +1,101 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef SELECTIONHISTORY_H
+#define SELECTIONHISTORY_H
+
+#include <QVector>
+
+// Samples whose group changes between two consecutive selections, stored as
+// the nonzero 8-byte words of the XOR of the group columns. Applying it
+// twice is a no-op, so one delta serves both undo and redo.
+struct SelectionDelta
+{
+    QVector<int> words;
+    QVector<quint64> bits;
+    qint64 changed;
+};
+
+// Undo/redo stack of selection group columns, one byte per sample. Only
+// the latest state is kept in full, every step stores the delta to its
+// predecessor, so moving through the history costs as much as the samples
+// that change.
+class SelectionHistory
+{
+public:
+    SelectionHistory();
+
+    // Starts over with an empty selection of the given size
+    void reset(qint64 size);
+
+    // Pushes groups if it differs from the current state, dropping the redo
+    // steps. Returns false if nothing changed.
+    bool record(const QVector<quint8> &groups);
+
+    bool canUndo() const { return pos > 0; }
+    bool canRedo() const { return pos < deltas.size(); }
+
+    // Step and return the delta to apply to the live selection
+    const SelectionDelta &undo();
+    const SelectionDelta &redo();
+
+    // Unique id of the current state, for caching results computed from it
+    quint64 state() const { return ids.at(pos); }
+
+    int position() const { return pos; }
+    int numStates() const { return ids.size(); }
+
+private:
+    void apply(const SelectionDelta &d);
+    void trim();
+
+private:
+    // Group column packed 8 samples per word, zero padded
+    QVector<quint64> current;
+    qint64 n;
+
+    // deltas[i] turns state i into state i+1
+    QVector<SelectionDelta> deltas;
+    QVector<quint64> ids;
+    int pos;
+
+    quint64 nextId;
+    qint64 bytes;
+};
+
+#endif // SELECTIONHISTORY_H
@@ -0,0 +1,754 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "symbolizer.h"
+#include "parallel.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+#define CACHE_MAGIC 0x4d415859
+#define CACHE_VERSION 1
+
+// ELF constants
+#define SHT_SYMTAB 2
+#define SHT_NOTE 7
+#define SHT_NOBITS 8
+#define SHT_DYNSYM 11
+#define SHF_COMPRESSED 0x800
+#define STT_FUNC 2
+#define NT_GNU_BUILD_ID 3
+
+// DWARF line program opcodes and forms
+#define DW_LNS_copy 1
+#define DW_LNS_advance_pc 2
+#define DW_LNS_advance_line 3
+#define DW_LNS_set_file 4
+#define DW_LNS_const_add_pc 8
+#define DW_LNS_fixed_advance_pc 9
+#define DW_LNE_end_sequence 1
+#define DW_LNE_set_address 2
+#define DW_LNE_define_file 3
+#define DW_LNCT_path 1
+#define DW_LNCT_directory_index 2
+
+// Bounds checked little endian reader, ok is cleared on overrun
+struct ByteReader
+{
+    const uchar *p;
+    const uchar *end;
+    bool ok;
+
+    ByteReader(const uchar *b, const uchar *e) : p(b), end(e), ok(b <= e) {}
+
+    bool has(qint64 n)
+    {
+        if(!ok || end-p < n)
+            ok = false;
+        return ok;
+    }
+
+    void skip(qint64 n) { if(has(n)) p += n; }
+    quint8 u8() { return has(1) ? *p++ : 0; }
+    quint16 u16() { quint16 v = has(2) ? qFromLittleEndian<quint16>(p) : 0; skip(2); return v; }
+    quint32 u32() { quint32 v = has(4) ? qFromLittleEndian<quint32>(p) : 0; skip(4); return v; }
+    quint64 u64() { quint64 v = has(8) ? qFromLittleEndian<quint64>(p) : 0; skip(8); return v; }
+    quint64 offset(bool dwarf64) { return dwarf64 ? u64() : u32(); }
+
+    quint64 sized(int n)
+    {
+        quint64 v = 0;
+        for(int i=0; i<n && i<8; i++)
+            v |= (quint64)u8() << (8*i);
+        skip(n > 8 ? n-8 : 0);
+        return v;
+    }
+
+    quint64 uleb()
+    {
+        quint64 v = 0;
+        int shift = 0;
+        while(has(1))
+        {
+            quint8 b = *p++;
+            if(shift < 64)
+                v |= (quint64)(b & 0x7f) << shift;
+            shift += 7;
+            if(!(b & 0x80))
+                break;
+        }
+        return v;
+    }
+
+    qint64 sleb()
+    {
+        qint64 v = 0;
+        int shift = 0;
+        quint8 b = 0;
+        while(has(1))
+        {
+            b = *p++;
+            if(shift < 64)
+                v |= (qint64)(b & 0x7f) << shift;
+            shift += 7;
+            if(!(b & 0x80))
+                break;
+        }
+        if(shift < 64 && (b & 0x40))
+            v |= -((qint64)1 << shift);
+        return v;
+    }
+
+    QString cstr()
+    {
+        const uchar *s = p;
+        while(p < end && *p)
+            p++;
+        if(p >= end)
+        {
+            ok = false;
+            return QString();
+        }
+        return QString::fromUtf8((const char*)s,(int)(p++-s));
+    }
+};
+
+static QString stringAt(const QByteArray &section, quint64 offset)
+{
+    if(offset >= (quint64)section.size())
+        return QString();
+    return QString::fromUtf8(section.constData()+offset);
+}
+
+static QString joinPath(const QString &dir, const QString &name)
+{
+    if(dir.isEmpty() || name.startsWith('/'))
+        return name;
+    return dir + "/" + name;
+}
+
+// Line ranges of one unit of .debug_line, files numbered per unit
+struct UnitLines
+{
+    QVector<QString> files;
+    QVector<LineRange> ranges;
+};
+
+// Reads one attribute of a DWARF 5 directory or file entry, strings go to
+// str and numbers to num
+static bool readForm(ByteReader &r, quint64 form, bool dwarf64,
+                     const QByteArray &lineStr, const QByteArray &debugStr,
+                     QString *str, quint64 *num)
+{
+    switch(form)
+    {
+    case 0x08: *str = r.cstr(); break;                                  // string
+    case 0x1f: *str = stringAt(lineStr,r.offset(dwarf64)); break;       // line_strp
+    case 0x0e: *str = stringAt(debugStr,r.offset(dwarf64)); break;      // strp
+    case 0x0f: *num = r.uleb(); break;                                  // udata
+    case 0x0b: *num = r.u8(); break;                                    // data1
+    case 0x05: *num = r.u16(); break;                                   // data2
+    case 0x06: *num = r.u32(); break;                                   // data4
+    case 0x07: *num = r.u64(); break;                                   // data8
+    case 0x1e: r.skip(16); break;                                       // data16
+    case 0x09: r.skip(r.uleb()); break;                                 // block
+    default: return false;
+    }
+    return r.ok;
+}
+
+// Directories or files of a DWARF 5 line table header
+static bool readEntries(ByteReader &r, bool dwarf64,
+                        const QByteArray &lineStr, const QByteArray &debugStr,
+                        QVector<QString> &paths, QVector<quint64> &dirs)
+{
+    int numFormats = r.u8();
+    QVector<QPair<quint64,quint64> > formats;
+    for(int i=0; i<numFormats; i++)
+    {
+        quint64 type = r.uleb();
+        quint64 form = r.uleb();
+        formats.push_back(qMakePair(type,form));
+    }
+
+    quint64 count = r.uleb();
+    for(quint64 i=0; i<count && r.ok; i++)
+    {
+        QString path;
+        quint64 dir = 0;
+        for(int f=0; f<formats.size(); f++)
+        {
+            QString s;
+            quint64 v = 0;
+            if(!readForm(r,formats.at(f).second,dwarf64,lineStr,debugStr,&s,&v))
+                return false;
+            if(formats.at(f).first == DW_LNCT_path)
+                path = s;
+            else if(formats.at(f).first == DW_LNCT_directory_index)
+                dir = v;
+        }
+        paths.push_back(path);
+        dirs.push_back(dir);
+    }
+    return r.ok;
+}
+
+static void parseLineUnit(const uchar *begin, const uchar *end,
+                          const QByteArray &lineStr, const QByteArray &debugStr,
+                          UnitLines &out)
+{
+    ByteReader r(begin,end);
+    quint64 length = r.u32();
+    bool dwarf64 = (length == 0xffffffff);
+    if(dwarf64)
+        length = r.u64();
+    if(!r.has(length))
+        return;
+    r.end = r.p + length;
+
+    int version = r.u16();
+    if(version < 2 || version > 5)
+        return;
+    if(version >= 5)
+    {
+        r.u8(); // address size, set_address carries its own
+        r.u8(); // segment selector size
+    }
+
+    quint64 headerLength = r.offset(dwarf64);
+    if(!r.has(headerLength))
+        return;
+    const uchar *program = r.p + headerLength;
+
+    int minInstLength = r.u8();
+    if(version >= 4)
+        r.u8(); // max ops per instruction
+    r.u8(); // default is_stmt
+    int lineBase = (qint8)r.u8();
+    int lineRange = r.u8();
+    int opcodeBase = r.u8();
+    if(lineRange == 0 || opcodeBase == 0)
+        return;
+
+    QVector<int> opcodeLengths(opcodeBase,0);
+    for(int i=1; i<opcodeBase; i++)
+        opcodeLengths[i] = r.u8();
+
+    // Files are numbered from 1 before DWARF 5 and from 0 since
+    int firstFile = 1;
+    QVector<QString> dirNames;
+    if(version >= 5)
+    {
+        firstFile = 0;
+        QVector<QString> dirPaths, filePaths;
+        QVector<quint64> unused, fileDirs;
+        if(!readEntries(r,dwarf64,lineStr,debugStr,dirPaths,unused) ||
+           !readEntries(r,dwarf64,lineStr,debugStr,filePaths,fileDirs))
+            return;
+        for(int i=0; i<filePaths.size(); i++)
+        {
+            quint64 d = fileDirs.at(i);
+            out.files.push_back(joinPath(d < (quint64)dirPaths.size() ? dirPaths.at(d) : QString(),
+                                         filePaths.at(i)));
+        }
+    }
+    else
+    {
+        dirNames.push_back(QString());  // compilation directory, not known here
+        for(QString d = r.cstr(); r.ok && !d.isEmpty(); d = r.cstr())
+            dirNames.push_back(d);
+        for(QString f = r.cstr(); r.ok && !f.isEmpty(); f = r.cstr())
+        {
+            quint64 d = r.uleb();
+            r.uleb(); // modification time
+            r.uleb(); // length
+            out.files.push_back(joinPath(d < (quint64)dirNames.size() ? dirNames.at(d) : QString(),f));
+        }
+    }
+    if(!r.ok || program > r.end)
+        return;
+    r.p = program;
+
+    // Rows of a sequence turn into ranges up to the next row's address
+    quint64 address = 0;
+    int file = 1, line = 1;
+    bool havePrev = false;
+    quint64 prevAddress = 0;
+    int prevFile = 0, prevLine = 0;
+    auto row = [&](bool endSequence)
+    {
+        if(havePrev && address > prevAddress && prevAddress != 0)
+        {
+            int f = prevFile - firstFile;
+            LineRange range = {prevAddress, address,
+                               (f >= 0 && f < out.files.size()) ? f : -1, prevLine};
+            out.ranges.push_back(range);
+        }
+        havePrev = !endSequence;
+        prevAddress = address;
+        prevFile = file;
+        prevLine = line;
+        if(endSequence)
+        {
+            address = 0;
+            file = 1;
+            line = 1;
+        }
+    };
+
+    while(r.ok && r.p < r.end)
+    {
+        int op = r.u8();
+        if(op >= opcodeBase)
+        {
+            int adjusted = op - opcodeBase;
+            address += (adjusted / lineRange) * minInstLength;
+            line += lineBase + adjusted % lineRange;
+            row(false);
+            continue;
+        }
+
+        switch(op)
+        {
+        case 0:
+        {
+            quint64 len = r.uleb();
+            if(len == 0 || !r.has(len))
+                return;
+            const uchar *next = r.p + len;
+            int sub = r.u8();
+            if(sub == DW_LNE_end_sequence)
+                row(true);
+            else if(sub == DW_LNE_set_address)
+                address = r.sized((int)len-1);
+            else if(sub == DW_LNE_define_file)
+            {
+                QString f = r.cstr();
+                quint64 d = r.uleb();
+                out.files.push_back(joinPath(d < (quint64)dirNames.size() ? dirNames.at(d) : QString(),f));
+            }
+            r.p = next;
+            break;
+        }
+        case DW_LNS_copy:
+            row(false);
+            break;
+        case DW_LNS_advance_pc:
+            address += r.uleb() * minInstLength;
+            break;
+        case DW_LNS_advance_line:
+            line += (int)r.sleb();
+            break;
+        case DW_LNS_set_file:
+            file = (int)r.uleb();
+            break;
+        case DW_LNS_const_add_pc:
+            address += ((255 - opcodeBase) / lineRange) * minInstLength;
+            break;
+        case DW_LNS_fixed_advance_pc:
+            address += r.u16();
+            break;
+        default:
+            for(int i=0; i<opcodeLengths.at(op); i++)
+                r.uleb();
+            break;
+        }
+    }
+}
+
+static QString demangle(const char *name)
+{
+#ifdef __GNUG__
+    int status = 0;
+    char *d = abi::__cxa_demangle(name,NULL,NULL,&status);
+    if(d && status == 0)
+    {
+        QString s = QString::fromUtf8(d);
+        free(d);
+        return s;
+    }
+    free(d);
+#endif
+    return QString::fromUtf8(name);
+}
+
+SymbolIndex::SymbolIndex()
+{
+    cached = false;
+}
+
+int SymbolIndex::load(QString binary)
+{
+    QFile file(binary);
+    if(!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    qint64 size = file.size();
+    const uchar *data = file.map(0,size);
+    if(!data)
+        return -1;
+
+    lines.clear();
+    funcs.clear();
+    files.clear();
+    functions.clear();
+    id.clear();
+    cached = false;
+
+    bool ok = parseElf(data,size);
+    file.close();
+    return ok ? 0 : -1;
+}
+
+bool SymbolIndex::parseElf(const uchar *data, qint64 size)
+{
+    // 64 bit little endian ELF only
+    if(size < 64 || memcmp(data,"\x7f" "ELF",4) != 0 || data[4] != 2 || data[5] != 1)
+        return false;
+
+    ByteReader h(data+40,data+64);
+    quint64 shoff = h.u64();
+    h.skip(10);
+    int shentsize = h.u16();
+    int shnum = h.u16();
+    int shstrndx = h.u16();
+    if(shentsize < 64 || shoff + (quint64)shnum*shentsize > (quint64)size || shstrndx >= shnum)
+        return false;
+
+    struct Section { quint32 nameOffset; QString name; quint32 type; quint64 flags; quint64 offset; quint64 size; quint32 link; };
+    QVector<Section> sections(shnum);
+    for(int i=0; i<shnum; i++)
+    {
+        ByteReader s(data+shoff+(quint64)i*shentsize,data+size);
+        Section &sec = sections[i];
+        sec.nameOffset = s.u32();
+        sec.type = s.u32();
+        sec.flags = s.u64();
+        s.u64(); // address
+        sec.offset = s.u64();
+        sec.size = s.u64();
+        sec.link = s.u32();
+        if(sec.type == SHT_NOBITS || sec.offset + sec.size > (quint64)size)
+            sec.size = 0;
+    }
+
+    const Section &strtab = sections.at(shstrndx);
+    for(int i=0; i<shnum; i++)
+    {
+        quint64 nameOffset = sections.at(i).nameOffset;
+        if(nameOffset < strtab.size)
+            sections[i].name = QString::fromUtf8((const char*)data+strtab.offset+nameOffset);
+    }
+
+    // Section contents, inflated when compressed
+    auto contents = [&](int i) -> QByteArray
+    {
+        const Section &sec = sections.at(i);
+        if(sec.size == 0)
+            return QByteArray();
+        QByteArray raw = QByteArray::fromRawData((const char*)data+sec.offset,(int)sec.size);
+        if(!(sec.flags & SHF_COMPRESSED))
+            return raw;
+
+        ByteReader c((const uchar*)raw.constData(),(const uchar*)raw.constData()+raw.size());
+        quint32 type = c.u32();
+        c.u32();
+        quint64 full = c.u64();
+        c.u64();
+        if(type != 1 || !c.ok || full > 0x7fffffff)
+            return QByteArray();
+
+        // qUncompress wants the size up front, big endian
+        QByteArray z(4,0);
+        qToBigEndian<quint32>((quint32)full,(uchar*)z.data());
+        z.append(raw.mid(24));
+        return qUncompress(z);
+    };
+
+    auto find = [&](const QString &name) -> int
+    {
+        for(int i=0; i<shnum; i++)
+            if(sections.at(i).name == name)
+                return i;
+        return -1;
+    };
+
+    // Build id from the GNU note, else a hash of the whole file
+    for(int i=0; i<shnum && id.isEmpty(); i++)
+    {
+        if(sections.at(i).type != SHT_NOTE)
+            continue;
+        QByteArray note = contents(i);
+        ByteReader n((const uchar*)note.constData(),(const uchar*)note.constData()+note.size());
+        while(n.ok && n.p < n.end)
+        {
+            quint32 nameSize = n.u32();
+            quint32 descSize = n.u32();
+            quint32 type = n.u32();
+            const uchar *name = n.p;
+            n.skip((nameSize+3) & ~3u);
+            const uchar *desc = n.p;
+            n.skip((descSize+3) & ~3u);
+            if(n.ok && type == NT_GNU_BUILD_ID && nameSize == 4 && memcmp(name,"GNU",4) == 0)
+            {
+                id = QString::fromLatin1(QByteArray((const char*)desc,descSize).toHex());
+                break;
+            }
+        }
+    }
+    if(id.isEmpty())
+        id = "sha1-" + QString::fromLatin1(QCryptographicHash::hash(
+                 QByteArray::fromRawData((const char*)data,(int)size),
+                 QCryptographicHash::Sha1).toHex());
+
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QString cacheFile = cacheDir.isEmpty() ? QString() : cacheDir + "/symbols/" + id + ".idx";
+    if(!cacheFile.isEmpty() && readCache(cacheFile))
+    {
+        cached = true;
+        return true;
+    }
+
+    // Line table units are independent, found first and parsed in parallel
+    int lineSec = find(".debug_line");
+    QByteArray debugLine = lineSec >= 0 ? contents(lineSec) : QByteArray();
+    int lineStrSec = find(".debug_line_str");
+    QByteArray lineStr = lineStrSec >= 0 ? contents(lineStrSec) : QByteArray();
+    int strSec = find(".debug_str");
+    QByteArray debugStr = strSec >= 0 ? contents(strSec) : QByteArray();
+
+    const uchar *lb = (const uchar*)debugLine.constData();
+    const uchar *le = lb + debugLine.size();
+    QVector<const uchar*> units;
+    ByteReader u(lb,le);
+    while(u.ok && u.p < u.end)
+    {
+        const uchar *start = u.p;
+        quint64 length = u.u32();
+        if(length == 0xffffffff)
+            length = u.u64();
+        if(!u.has(length))
+            break;
+        units.push_back(start);
+        u.skip(length);
+    }
+
+    QVector<UnitLines> parsed(units.size());
+    parallelTasks(units.size(),[&](int i)
+    {
+        parseLineUnit(units.at(i),le,lineStr,debugStr,parsed[i]);
+    });
+
+    QHash<QString,int> fileIds;
+    for(int i=0; i<parsed.size(); i++)
+    {
+        const UnitLines &unit = parsed.at(i);
+        QVector<int> ids(unit.files.size());
+        for(int f=0; f<unit.files.size(); f++)
+        {
+            QHash<QString,int>::const_iterator it = fileIds.constFind(unit.files.at(f));
+            if(it == fileIds.constEnd())
+            {
+                it = fileIds.insert(unit.files.at(f),files.size());
+                files.push_back(unit.files.at(f));
+            }
+            ids[f] = it.value();
+        }
+
+        for(int r=0; r<unit.ranges.size(); r++)
+        {
+            LineRange range = unit.ranges.at(r);
+            range.file = range.file >= 0 ? ids.at(range.file) : -1;
+            lines.push_back(range);
+        }
+    }
+    std::sort(lines.begin(),lines.end(),
+              [](const LineRange &a, const LineRange &b) { return a.start < b.start; });
+
+    // Functions from the symbol tables, demangled
+    QHash<QString,int> functionIds;
+    for(int i=0; i<shnum; i++)
+    {
+        const Section &sec = sections.at(i);
+        if((sec.type != SHT_SYMTAB && sec.type != SHT_DYNSYM) || sec.link >= (quint32)shnum)
+            continue;
+
+        QByteArray syms = contents(i);
+        QByteArray names = contents(sec.link);
+        for(int off=0; off+24 <= syms.size(); off+=24)
+        {
+            ByteReader s((const uchar*)syms.constData()+off,(const uchar*)syms.constData()+off+24);
+            quint32 nameOffset = s.u32();
+            quint8 info = s.u8();
+            s.skip(3);
+            quint64 value = s.u64();
+            quint64 symSize = s.u64();
+            if((info & 0xf) != STT_FUNC || value == 0 || symSize == 0 ||
+               nameOffset >= (quint32)names.size())
+                continue;
+
+            QString name = demangle(names.constData()+nameOffset);
+            QHash<QString,int>::const_iterator it = functionIds.constFind(name);
+            if(it == functionIds.constEnd())
+            {
+                it = functionIds.insert(name,functions.size());
+                functions.push_back(name);
+            }
+            FunctionRange f = {value, value+symSize, it.value()};
+            funcs.push_back(f);
+        }
+    }
+
+    // The same function often shows up in both tables
+    std::sort(funcs.begin(),funcs.end(),
+              [](const FunctionRange &a, const FunctionRange &b)
+              { return a.start < b.start || (a.start == b.start && a.end > b.end); });
+    funcs.erase(std::unique(funcs.begin(),funcs.end(),
+                            [](const FunctionRange &a, const FunctionRange &b)
+                            { return a.start == b.start; }),funcs.end());
+
+    if(!cacheFile.isEmpty())
+        writeCache(cacheFile);
+    return true;
+}
+
+SymbolInfo SymbolIndex::resolve(quint64 ip) const
+{
+    SymbolInfo info = {-1, -1, -1};
+
+    QVector<LineRange>::const_iterator l =
+            std::upper_bound(lines.constBegin(),lines.constEnd(),ip,
+                             [](quint64 a, const LineRange &r) { return a < r.start; });
+    if(l != lines.constBegin() && ip < (l-1)->end)
+    {
+        info.file = (l-1)->file;
+        info.line = (l-1)->line;
+    }
+
+    QVector<FunctionRange>::const_iterator f =
+            std::upper_bound(funcs.constBegin(),funcs.constEnd(),ip,
+                             [](quint64 a, const FunctionRange &r) { return a < r.start; });
+    if(f != funcs.constBegin() && ip < (f-1)->end)
+        info.function = (f-1)->name;
+
+    return info;
+}
+
+bool SymbolIndex::readCache(const QString &path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version;
+    in >> magic >> version;
+    if(magic != CACHE_MAGIC || version != CACHE_VERSION)
+        return false;
+
+    quint32 numLines, numFuncs;
+    in >> files >> functions >> numLines >> numFuncs;
+    if(in.status() != QDataStream::Ok)
+        return false;
+
+    lines.resize(numLines);
+    for(quint32 i=0; i<numLines; i++)
+    {
+        LineRange &r = lines[i];
+        qint32 f, l;
+        in >> r.start >> r.end >> f >> l;
+        r.file = f;
+        r.line = l;
+    }
+    funcs.resize(numFuncs);
+    for(quint32 i=0; i<numFuncs; i++)
+    {
+        FunctionRange &r = funcs[i];
+        qint32 n;
+        in >> r.start >> r.end >> n;
+        r.name = n;
+    }
+
+    if(in.status() != QDataStream::Ok)
+    {
+        lines.clear();
+        funcs.clear();
+        files.clear();
+        functions.clear();
+        return false;
+    }
+    return true;
+}
+
+void SymbolIndex::writeCache(const QString &path) const
+{
+    QDir().mkpath(QFileInfo(path).path());
+
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << (quint32)CACHE_MAGIC << (quint32)CACHE_VERSION
+        << files << functions << (quint32)lines.size() << (quint32)funcs.size();
+    for(int i=0; i<lines.size(); i++)
+        out << lines.at(i).start << lines.at(i).end
+            << (qint32)lines.at(i).file << (qint32)lines.at(i).line;
+    for(int i=0; i<funcs.size(); i++)
+        out << funcs.at(i).start << funcs.at(i).end << (qint32)funcs.at(i).name;
+
+    file.commit();
+}
@@ -0,0 +1,108 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef SYMBOLIZER_H
+#define SYMBOLIZER_H
+
+#include <QVector>
+#include <QString>
+
+// Executable of the samples, read from the data directory
+#define SYMBOL_BINARY "binary"
+
+struct LineRange
+{
+    quint64 start;
+    quint64 end;
+    int file;
+    int line;
+};
+
+struct FunctionRange
+{
+    quint64 start;
+    quint64 end;
+    int name;
+};
+
+// File, line and function of an address, -1 where unknown
+struct SymbolInfo
+{
+    int file;
+    int line;
+    int function;
+};
+
+// Address index of an ELF binary, built from its DWARF line tables
+// (.debug_line, versions 2 to 5) and its symbol tables. Both are sorted
+// address ranges searched by bisection. The index is cached on disk under
+// the build id of the binary, so later loads of the same build skip the
+// parsing.
+class SymbolIndex
+{
+public:
+    SymbolIndex();
+
+    int load(QString binary);
+
+    bool isEmpty() const { return lines.isEmpty() && funcs.isEmpty(); }
+    const QString &buildId() const { return id; }
+    bool fromCache() const { return cached; }
+
+    SymbolInfo resolve(quint64 ip) const;
+
+    int numFiles() const { return files.size(); }
+    const QString &file(int i) const { return files.at(i); }
+    const QString &function(int i) const { return functions.at(i); }
+
+private:
+    bool parseElf(const uchar *data, qint64 size);
+    bool readCache(const QString &path);
+    void writeCache(const QString &path) const;
+
+private:
+    QString id;
+    bool cached;
+
+    QVector<LineRange> lines;
+    QVector<FunctionRange> funcs;
+    QVector<QString> files;
+    QVector<QString> functions;
+};
+
+#endif // SYMBOLIZER_H
@@ -0,0 +1,154 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "tlbpages.h"
+#include "parseUtil.h"
+#include "parallel.h"
+
+#include <QHash>
+
+#include <algorithm>
+
+// 4K pages are spread over 1 << PARTITION_BITS hash partitions
+#define PARTITION_BITS 6
+
+struct SmallPageAgg
+{
+    qint64 samples;
+    qint64 stlbMisses;
+    qreal latency;
+    qreal stlbLatency;
+};
+
+typedef QHash<qint64,SmallPageAgg> SmallPageTable;
+
+QVector<TlbPage> stlbPages(DataObject *d, const Bitmap &mask,
+                           int pageShift, int maxPages)
+{
+    const int numParts = 1 << PARTITION_BITS;
+    pageShift = std::max(pageShift,SMALL_PAGE_SHIFT);
+    int shift = pageShift-SMALL_PAGE_SHIFT;
+    const Sample *samples = d->samples.constData();
+    const quint64 *words = mask.constData();
+    int numWords = mask.numWords();
+    int numChunks = parallelChunkCount(numWords,256);
+
+    QVector<QVector<SmallPageTable> > tables(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        QVector<SmallPageTable> &parts = tables[c];
+        parts.resize(numParts);
+
+        int begin = (qint64)numWords*c/numChunks;
+        int end = (qint64)numWords*(c+1)/numChunks;
+        for(int w=begin; w<end; w++)
+        {
+            quint64 bits = words[w];
+            while(bits)
+            {
+                const Sample &s = samples[((qint64)w << 6) + qCountTrailingZeroBits(bits)];
+                bits &= bits-1;
+
+                qint64 small = (quint64)s.addr >> SMALL_PAGE_SHIFT;
+                SmallPageAgg &a = parts[hashPartition(small >> shift,PARTITION_BITS)][small];
+                qreal latency = (qreal)s.latency*s.weight;
+                a.samples += s.weight;
+                a.latency += latency;
+                if(s.dse_flags & DSE_FLAG_STLB)
+                {
+                    a.stlbMisses += s.weight;
+                    a.stlbLatency += latency;
+                }
+            }
+        }
+    });
+
+    QVector<QVector<TlbPage> > found(numParts);
+    parallelTasks(numParts,[&](int p)
+    {
+        SmallPageTable merged = tables.at(0).at(p);
+        for(int c=1; c<numChunks; c++)
+        {
+            const SmallPageTable &t = tables.at(c).at(p);
+            for(SmallPageTable::const_iterator it=t.constBegin(); it!=t.constEnd(); it++)
+            {
+                SmallPageAgg &a = merged[it.key()];
+                a.samples += it.value().samples;
+                a.stlbMisses += it.value().stlbMisses;
+                a.latency += it.value().latency;
+                a.stlbLatency += it.value().stlbLatency;
+            }
+        }
+
+        // Roll 4K pages up into pages of pageShift
+        QHash<qint64,TlbPage> pages;
+        for(SmallPageTable::const_iterator it=merged.constBegin(); it!=merged.constEnd(); it++)
+        {
+            qint64 page = it.key() >> shift;
+            QHash<qint64,TlbPage>::iterator pg = pages.find(page);
+            if(pg == pages.end())
+            {
+                TlbPage zero = {page, 0, 0, 0, 0, 0};
+                pg = pages.insert(page,zero);
+            }
+
+            TlbPage &t = pg.value();
+            t.samples += it.value().samples;
+            t.stlbMisses += it.value().stlbMisses;
+            t.latency += it.value().latency;
+            t.stlbLatency += it.value().stlbLatency;
+            t.smallPages++;
+        }
+
+        for(QHash<qint64,TlbPage>::const_iterator it=pages.constBegin(); it!=pages.constEnd(); it++)
+            if(it.value().stlbMisses > 0)
+                found[p].push_back(it.value());
+    });
+
+    QVector<TlbPage> result;
+    for(int p=0; p<numParts; p++)
+        result += found.at(p);
+
+    std::sort(result.begin(),result.end(),
+              [](const TlbPage &a, const TlbPage &b)
+              { return a.stlbLatency > b.stlbLatency; });
+    if(maxPages >= 0 && result.size() > maxPages)
+        result.resize(maxPages);
+
+    return result;
+}
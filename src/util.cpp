@@ -145,6 +145,28 @@ QColor valToColor(qreal val, ColorMap colorMap)
     return colorMap.at(colIdx);
 }
 
+QColor groupColor(int group)
+{
+    static const QColor colors[GROUP_PALETTE_SIZE] = {
+        QColor(255,0,0),
+        QColor(51,160,44),
+        QColor(255,127,0),
+        QColor(106,61,154),
+        QColor(31,120,180),
+        QColor(177,89,40),
+        QColor(227,26,200),
+        QColor(0,170,170)
+    };
+
+    if(group <= 0)
+        return Qt::gray;
+    if(group <= GROUP_PALETTE_SIZE)
+        return colors[group-1];
+
+    // Further groups step around the hue circle by the golden angle
+    return QColor::fromHsv((int)((group-1)*137.508) % 360,200,220);
+}
+
 QPointF radialTransform(QPointF point, QRectF rectSpace)
 {
     // Get radius
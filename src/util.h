@@ -49,6 +49,9 @@
 #define DBGLN(x) std::cerr << #x << std::endl; x;
 #define DBGVAR(x) std::cerr << #x << " : " << x << std::endl;
 
+// Fixed colors of the first selection groups, see groupColor()
+#define GROUP_PALETTE_SIZE 8
+
 typedef QVector<QColor> ColorMap;
 typedef QPair<int,int> IntRange;
 typedef QPair<qreal,qreal> RealRange;
@@ -71,4 +74,6 @@ QVector<QPointF> rectToRadialSegment(QRectF rect, QRectF rectSpace);
 ColorMap gradientColorMap(QColor col0, QColor col1, int steps);
 QColor valToColor(qreal val, ColorMap colorMap);
 
+QColor groupColor(int group);
+
 #endif // UTIL_H
@@ -39,6 +39,7 @@
 #include "varvizwidget.h"
 
 #include <QFile>
+#include <QHash>
 #include <QMouseEvent>
 
 #include <iostream>
@@ -51,6 +52,42 @@ bool operator<(const varBlock &lhs, const varBlock &rhs)
     return lhs.val > rhs.val; // reverse sort ;-)
 }
 
+// Adds sign times a sample to the block of its variable, creating it on
+// first use. Merged samples stand for weight samples of their mean latency.
+static void addToBlocks(QVector<varBlock> &blocks, QHash<QString,int> &varIds,
+                        const Sample &s, int sign)
+{
+    int varIdx = varIds.value(s.variable,-1);
+    if(varIdx == -1)
+    {
+        varBlock newBlock = {s.variable, 0, QRect(), 0};
+        varIdx = blocks.size();
+        blocks.push_back(newBlock);
+        varIds.insert(s.variable,varIdx);
+    }
+    blocks[varIdx].val += sign*(qreal)s.latency*s.weight;
+    blocks[varIdx].samples += sign*(qint64)s.weight;
+}
+
+// Drops emptied blocks and sorts the rest by value
+static void finishBlocks(QVector<varBlock> &blocks)
+{
+    int numKept = 0;
+    for(int i=0; i<blocks.size(); i++)
+        if(blocks.at(i).samples > 0)
+            blocks[numKept++] = blocks.at(i);
+    blocks.resize(numKept);
+
+    qSort(blocks.begin(),blocks.end());
+}
+
+static void indexBlocks(const QVector<varBlock> &blocks, QHash<QString,int> &varIds)
+{
+    varIds.clear();
+    for(int i=0; i<blocks.size(); i++)
+        varIds.insert(blocks.at(i).name,i);
+}
+
 VarViz::VarViz(QWidget *parent) :
     VizWidget(parent)
 {
@@ -59,70 +96,105 @@ VarViz::VarViz(QWidget *parent) :
 
     this->setMinimumHeight(20);
     this->installEventFilter(this);
+
+    varMaxVal = 0;
+    visVersion = 0;
+    pending = false;
 }
 
 VarViz::~VarViz()
 {
 }
 
-int VarViz::getVariableID(QString name)
+void VarViz::processData()
 {
-    for(int i=0; i<varBlocks.size(); i++)
+    // Visibility changes cancel the task, so the result matches this version
+    visVersion = dataSet->visibilityVersion();
+    pending = true;
+
+    runCompute<QVector<varBlock> >("varviz",COMPUTE_SELECTION|COMPUTE_VISIBILITY,
+                                   [this](const ComputeToken &token)
     {
-        if(varBlocks[i].name == name)
-            return i;
-    }
+        QVector<varBlock> blocks;
+        QHash<QString,int> varIds;
 
-    // First time we see this name, new entry
-    varBlock newBlock = {name, 0, QRect()};
-    varBlocks.push_back(newBlock);
+        // Get metric values
+        bool selectionDefined = dataSet->selectionDefined();
+        for(ElemIndex elem=0; elem<dataSet->numElements; elem++)
+        {
+            if((elem & 0xffff) == 0 && token.cancelled())
+                break;
 
-    return varBlocks.size()-1;
-}
+            if(!dataSet->visible(elem) || (selectionDefined && !dataSet->selected(elem)))
+                continue;
 
-void VarViz::processData()
-{
-    processed = false;
+            addToBlocks(blocks,varIds,dataSet->samples.at(elem),1);
+        }
 
-    varMaxVal = 0;
-    varBlocks.clear();
+        // Sort based on value
+        finishBlocks(blocks);
 
-    // Get metric values
-    for(Sample s: dataSet->samples)
+        return blocks;
+    },
+    [this](const QVector<varBlock> &blocks)
     {
-        if(dataSet->selectionDefined() && !dataSet->selected(s.sampleId))
-            continue;
+        pending = false;
+        varBlocks = blocks;
+        indexBlocks(varBlocks,varIds);
+        updateMaxVal();
+
+        processed = true;
+        needsRepaint = true;
+        requestFrame();
+    });
+}
 
-        int varIdx = this->getVariableID(s.variable);
-        varBlocks[varIdx].val += s.latency;
-        varMaxVal = std::max(varMaxVal,varBlocks[varIdx].val);
+void VarViz::updateMaxVal()
+{
+    varMaxVal = 0;
+    for(int i=0; i<varBlocks.size(); i++)
+        varMaxVal = std::max(varMaxVal,varBlocks[i].val);
+}
 
+void VarViz::selectionChangedSlot()
+{
+    // A dropped first result leaves processed unset, so check the data
+    if(dataSet && !dataSet->empty())
+    {
+        processData();
     }
-    // int elem = 0;
-    // QVector<qreal>::Iterator p;
-    // for(elem=0, p=dataSet->begin; p!=dataSet->end; elem++, p+=dataSet->numDimensions)
-    // {
-    //     if(dataSet->selectionDefined() && !dataSet->selected(elem))
-    //         continue;
-    //
-    //     int varIdx = this->getVariableID(dataSet->varNames[elem]);
-    //     varBlocks[varIdx].val += *(p+dataSet->latencyDim);
-    //     varMaxVal = std::max(varMaxVal,varBlocks[varIdx].val);
-    // }
-
-    // Sort based on value
-    qSort(varBlocks.begin(),varBlocks.end());
-
-    processed = true;
 }
 
-void VarViz::selectionChangedSlot()
+void VarViz::visibilityChangedSlot()
 {
-    if(processed)
+    if(!dataSet || dataSet->empty())
+        return;
+
+    // The sums are additive, so a small change only moves the samples that
+    // flipped. Anything else aggregates again.
+    if(!processed || pending || !visibilityDeltaApplies(visVersion))
     {
         processData();
-        repaint();
+        return;
     }
+
+    bool selectionDefined = dataSet->selectionDefined();
+    dataSet->visibilityDelta().forEachSet([&](qint64 elem)
+    {
+        if(selectionDefined && !dataSet->selected(elem))
+            return;
+
+        addToBlocks(varBlocks,varIds,dataSet->samples.at(elem),
+                    dataSet->visible(elem) ? 1 : -1);
+    });
+
+    finishBlocks(varBlocks);
+    indexBlocks(varBlocks,varIds);
+    updateMaxVal();
+    visVersion = dataSet->visibilityVersion();
+
+    needsRepaint = true;
+    requestFrame();
 }
 
 void VarViz::drawQtPainter(QPainter *painter)
@@ -41,11 +41,14 @@
 
 #include "vizwidget.h"
 
+#include <QHash>
+
 struct varBlock
 {
     QString name;
     qreal val;
     QRect block;
+    qint64 samples;     // counted with their weight
 };
 
 class VarViz : public VizWidget
@@ -61,12 +64,13 @@ signals:
 protected:
     void processData();
     void selectionChangedSlot();
+    void visibilityChangedSlot();
     void drawQtPainter(QPainter *painter);
 
     void mouseReleaseEvent(QMouseEvent *e);
 
 private:
-    int getVariableID(QString name);
+    void updateMaxVal();
 
 private:
     int margin;
@@ -76,6 +80,12 @@ private:
 
     QVector<varBlock> varBlocks;
     qreal varMaxVal;
+
+    // Blocks by variable name and the visibility they were aggregated
+    // from, for applying visibility deltas
+    QHash<QString,int> varIds;
+    quint64 visVersion;
+    bool pending;
 };
 
 #endif // VARVIZ_H
@@ -37,12 +37,14 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "vizwidget.h"
+#include "framescheduler.h"
 
 #include <iostream>
 using namespace std;
 
 #include <QPaintEvent>
 #include <QElapsedTimer>
+#include <QTimer>
 
 VizWidget::VizWidget(QWidget *parent) :
     QGLWidget(QGLFormat(QGL::SampleBuffers), parent)
@@ -57,10 +59,15 @@ VizWidget::VizWidget(QWidget *parent) :
     needsRepaint = false;
 
     dataSet = NULL;
+    scheduler = NULL;
+    computePool = NULL;
 }
 
 VizWidget::~VizWidget()
 {
+    // No task may outlive the view it delivers to
+    if(computePool)
+        computePool->cancel(this);
 }
 
 QSize VizWidget::sizeHint() const
@@ -80,11 +87,35 @@ void VizWidget::frameUpdate()
 void VizWidget::selectionChangedSlot()
 {
     needsRepaint = true;
+    requestFrame();
 }
 
 void VizWidget::visibilityChangedSlot()
 {
     needsRepaint = true;
+    requestFrame();
+}
+
+void VizWidget::requestFrame()
+{
+    if(scheduler)
+        scheduler->requestFrame(this);
+    else
+        QTimer::singleShot(0,this,SLOT(frameUpdate()));
+}
+
+bool VizWidget::visibilityDeltaApplies(quint64 version) const
+{
+    ElemIndex flipped = dataSet->numShownLast() + dataSet->numHiddenLast();
+    return dataSet->visibilityVersion() == version+1 &&
+           flipped*VIZ_DELTA_FRACTION <= dataSet->numElements;
+}
+
+qint64 VizWidget::frameTimeLeft() const
+{
+    if(scheduler)
+        return scheduler->remainingBudget();
+    return FRAME_BUDGET_MS;
 }
 
 void VizWidget::initializeGL()
@@ -144,6 +175,16 @@ void VizWidget::setConsole(console *iCon)
     con = iCon;
 }
 
+void VizWidget::setFrameScheduler(FrameScheduler *iScheduler)
+{
+    scheduler = iScheduler;
+}
+
+void VizWidget::setComputePool(ComputePool *iPool)
+{
+    computePool = iPool;
+}
+
 void VizWidget::processData()
 {
 }
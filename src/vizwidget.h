@@ -40,8 +40,17 @@
 #define VIZWIDGET_H
 
 #include <QGLWidget>
+#include <QPointer>
 
 #include "dataobject.h"
+#include "computepool.h"
+
+class FrameScheduler;
+
+// Views that aggregate by visibility apply a change flipping at most
+// 1/VIZ_DELTA_FRACTION of the samples to their aggregate in place, larger
+// ones are aggregated again in the pool
+#define VIZ_DELTA_FRACTION 8
 
 class VizWidget : public QGLWidget
 {
@@ -64,9 +73,34 @@ public slots:
 public:
     void setDataSet(DataObject *iDataSet);
     void setConsole(console *iCon);
+    void setFrameScheduler(FrameScheduler *iScheduler);
+    void setComputePool(ComputePool *iPool);
     virtual void processData();
 
 protected:
+    // Ask for frameUpdate() to be called in the next frame. Views repaint
+    // whole: the GL back buffer is undefined after a swap, so there are no
+    // dirty regions to track.
+    void requestFrame();
+    qint64 frameTimeLeft() const;
+
+    // True if exactly one small visibility change followed version, so
+    // visibilityDelta() holds everything that changed since
+    bool visibilityDeltaApplies(quint64 version) const;
+
+    // Run work in the compute pool and done with its result on this thread,
+    // or both right away without a pool
+    template<typename T>
+    void runCompute(const QString &key, int inputs,
+                    const std::function<T(const ComputeToken&)> &work,
+                    const std::function<void(const T&)> &done)
+    {
+        if(computePool)
+            computePool->submit<T>(key,inputs,this,work,done);
+        else
+            done(work(ComputeToken()));
+    }
+
     void initializeGL();
     void paintEvent(QPaintEvent *event);
 
@@ -82,6 +116,8 @@ protected:
     bool processed;
     console *con;
     DataObject *dataSet;
+    FrameScheduler *scheduler;
+    QPointer<ComputePool> computePool;
 
     int margin;
     QColor bgColor;
@@ -0,0 +1,393 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "volumevizwidget.h"
+#include "parallel.h"
+
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+
+#include <algorithm>
+#include <cmath>
+
+// Splats are sorted into this many depth slices
+#define DEPTH_BINS 65536
+
+// Largest splat side in pixels
+#define MAX_SPLAT 32
+
+// Rows composited per task
+#define BAND_ROWS 16
+
+struct RGBA
+{
+    float r;
+    float g;
+    float b;
+    float a;
+};
+
+VolumeVizWidget::VolumeVizWidget(QWidget *parent) :
+    VizWidget(parent)
+{
+    yaw = 0.6;
+    pitch = 0.4;
+    zoom = 1;
+    needsRender = true;
+    countedVis = 0;
+}
+
+VolumeVizWidget::~VolumeVizWidget()
+{
+}
+
+void VolumeVizWidget::processData()
+{
+    // The grid reads the samples, so loading data must wait for it. Any
+    // selection or visibility change cancels it as well, the slots then
+    // start it over.
+    processed = false;
+    runCompute<VoxelGrid>("volumevoxels",COMPUTE_SELECTION|COMPUTE_VISIBILITY,
+                          [this](const ComputeToken &token)
+    {
+        Q_UNUSED(token);
+
+        VoxelGrid g;
+        g.setSamples(dataSet);
+        return g;
+    },
+    [this](const VoxelGrid &g)
+    {
+        grid = g;
+        countedSel = Bitmap();
+        processed = true;
+        updateCounts(false);
+    });
+}
+
+void VolumeVizWidget::updateCounts(bool selectionChanged)
+{
+    if(!processed)
+        return;
+
+    Bitmap sel = dataSet->selectionDefined() ? dataSet->selectionMask(ANY_GROUP)
+                                             : Bitmap(dataSet->numElements,true);
+    const Bitmap &visible = dataSet->visibilityMask();
+    Bitmap mask = visible;
+    mask &= sel;
+
+    // Only the samples that entered or left the mask are recounted. Any
+    // other sequence of changes, or a new grid, counts the mask from scratch.
+    Bitmap changed;
+    bool counted = (countedSel.size() == sel.size());
+    if(counted && selectionChanged && dataSet->visibilityVersion() == countedVis)
+    {
+        changed = sel;
+        changed ^= countedSel;
+        changed &= visible;
+    }
+    else if(counted && !selectionChanged && dataSet->visibilityVersion() == countedVis+1)
+    {
+        changed = dataSet->visibilityDelta();
+        changed &= sel;
+    }
+    else
+    {
+        grid.clearCounts();
+        changed = mask;
+    }
+    grid.update(mask,changed);
+
+    countedSel = sel;
+    countedVis = dataSet->visibilityVersion();
+
+    needsRender = true;
+    needsRepaint = true;
+    requestFrame();
+}
+
+void VolumeVizWidget::selectionChangedSlot()
+{
+    if(!processed && dataSet && !dataSet->empty())
+        processData();
+    else
+        updateCounts(true);
+}
+
+void VolumeVizWidget::visibilityChangedSlot()
+{
+    if(!processed && dataSet && !dataSet->empty())
+        processData();
+    else
+        updateCounts(false);
+}
+
+QPointF VolumeVizWidget::project(qreal x, qreal y, qreal z, qreal *depth) const
+{
+    qreal ex = grid.extent(0), ey = grid.extent(1), ez = grid.extent(2);
+    qreal diag = std::max(1.0,std::sqrt(ex*ex+ey*ey+ez*ez));
+    qreal s = zoom*std::min(width(),height())/diag;
+
+    x -= ex/2;
+    y -= ey/2;
+    z -= ez/2;
+
+    qreal cy = std::cos(yaw), sy = std::sin(yaw);
+    qreal cp = std::cos(pitch), sp = std::sin(pitch);
+    qreal rx = cy*x + sy*z;
+    qreal rz = -sy*x + cy*z;
+    qreal ry = cp*y - sp*rz;
+    if(depth)
+        *depth = sp*y + cp*rz;
+
+    return QPointF(width()/2.0 + rx*s, height()/2.0 - ry*s);
+}
+
+void VolumeVizWidget::renderImage()
+{
+    int w = width();
+    int h = height();
+    image = QImage(w,h,QImage::Format_RGB32);
+    image.fill(bgColor);
+
+    const QVector<Voxel> &voxels = grid.occupied();
+    int n = voxels.size();
+    if(n == 0 || w <= 0 || h <= 0)
+        return;
+
+    qreal ex = grid.extent(0), ey = grid.extent(1), ez = grid.extent(2);
+    qreal diag = std::max(1.0,std::sqrt(ex*ex+ey*ey+ez*ez));
+    int side = (int)clamp(std::ceil(zoom*std::min(w,h)/diag),1,MAX_SPLAT);
+
+    // Screen position and depth slice of every voxel center
+    QVector<float> xs(n), ys(n);
+    QVector<int> bins(n);
+    parallelFor(n,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+        {
+            const Voxel &v = voxels.at(i);
+            qreal depth;
+            QPointF p = project(v.x+0.5,v.y+0.5,v.z+0.5,&depth);
+            xs[i] = p.x();
+            ys[i] = p.y();
+            bins[i] = (int)clamp((0.5-depth/diag)*(DEPTH_BINS-1),0,DEPTH_BINS-1);
+        }
+    });
+
+    // Counting sort, nearest slice first
+    QVector<int> offsets(DEPTH_BINS+1,0);
+    for(int i=0; i<n; i++)
+        offsets[bins.at(i)+1]++;
+    for(int b=0; b<DEPTH_BINS; b++)
+        offsets[b+1] += offsets.at(b);
+    QVector<int> order(n);
+    for(int i=0; i<n; i++)
+        order[offsets[bins.at(i)]++] = i;
+
+    // Transfer function from the README: blue and nearly transparent at
+    // the bottom, half opaque green at the mean and opaque red at the top
+    qreal mean = grid.meanCount();
+    qreal top = grid.maxCount();
+    QVector<RGBA> colors(n);
+    parallelFor(n,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 i=begin; i<end; i++)
+        {
+            qreal c = voxels.at(i).count;
+            RGBA &col = colors[i];
+            if(c <= mean)
+            {
+                qreal t = mean > 1 ? (c-1)/(mean-1) : 1;
+                col.r = 0;
+                col.g = t;
+                col.b = 1-t;
+                col.a = lerp(t,0.02,0.5);
+            }
+            else
+            {
+                qreal t = top > mean ? (c-mean)/(top-mean) : 1;
+                col.r = t;
+                col.g = 1-t;
+                col.b = 0;
+                col.a = lerp(t,0.5,1.0);
+            }
+        }
+    });
+
+    // Bands of rows are composited front to back in parallel, each walking
+    // the sorted splats and skipping those outside it
+    QVector<RGBA> accum(w*h);
+    accum.fill(RGBA());
+    int numBands = (h+BAND_ROWS-1)/BAND_ROWS;
+    int half = side/2;
+    parallelTasks(numBands,[&](int band)
+    {
+        int y0 = band*BAND_ROWS;
+        int y1 = std::min(h,y0+BAND_ROWS);
+        RGBA *acc = accum.data();
+        for(int j=0; j<n; j++)
+        {
+            int i = order.at(j);
+            int py = (int)ys.at(i) - half;
+            if(py >= y1 || py+side <= y0)
+                continue;
+
+            int px = (int)xs.at(i) - half;
+            const RGBA &c = colors.at(i);
+            for(int y=std::max(py,y0); y<std::min(py+side,y1); y++)
+            {
+                RGBA *row = acc + y*w;
+                for(int x=std::max(px,0); x<std::min(px+side,w); x++)
+                {
+                    RGBA &d = row[x];
+                    if(d.a > 0.995f)
+                        continue;
+
+                    float k = (1-d.a)*c.a;
+                    d.r += k*c.r;
+                    d.g += k*c.g;
+                    d.b += k*c.b;
+                    d.a += k;
+                }
+            }
+        }
+    });
+
+    float br = bgColor.redF(), bg = bgColor.greenF(), bb = bgColor.blueF();
+    parallelFor(h,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 y=begin; y<end; y++)
+        {
+            QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            const RGBA *acc = accum.constData()+y*w;
+            for(int x=0; x<w; x++)
+            {
+                const RGBA &d = acc[x];
+                if(d.a == 0)
+                    continue;
+                line[x] = qRgb((d.r+(1-d.a)*br)*255,
+                               (d.g+(1-d.a)*bg)*255,
+                               (d.b+(1-d.a)*bb)*255);
+            }
+        }
+    },BAND_ROWS);
+}
+
+void VolumeVizWidget::drawQtPainter(QPainter *painter)
+{
+    painter->fillRect(rect(),bgColor);
+
+    if(!processed)
+        return;
+
+    if(needsRender || image.size() != size())
+    {
+        renderImage();
+        needsRender = false;
+    }
+    painter->drawImage(0,0,image);
+
+    // Bounds of the index space
+    qreal ex = grid.extent(0), ey = grid.extent(1), ez = grid.extent(2);
+    QPointF c[8];
+    for(int i=0; i<8; i++)
+        c[i] = project((i & 1) ? ex : 0, (i & 2) ? ey : 0, (i & 4) ? ez : 0);
+
+    painter->setPen(Qt::gray);
+    for(int i=0; i<8; i++)
+        for(int a=1; a<8; a<<=1)
+            if(!(i & a))
+                painter->drawLine(c[i],c[i|a]);
+
+    painter->setPen(Qt::black);
+    painter->drawText(c[1]+QPointF(4,0),"x");
+    painter->drawText(c[2]+QPointF(4,0),"y");
+    painter->drawText(c[4]+QPointF(4,0),"z");
+
+    QString info = QString::number(grid.occupied().size()) + " voxels";
+    for(int a=0; a<3; a++)
+        if(grid.coarsening(a) > 0)
+            info += QString(", %1 %2 indices per voxel")
+                    .arg(1 << grid.coarsening(a)).arg(QString("xyz").at(a));
+    painter->drawText(QPoint(margin,margin),info);
+}
+
+void VolumeVizWidget::mousePressEvent(QMouseEvent *e)
+{
+    lastPos = e->pos();
+}
+
+void VolumeVizWidget::mouseMoveEvent(QMouseEvent *e)
+{
+    if(!(e->buttons() & Qt::LeftButton))
+        return;
+
+    QPoint d = e->pos()-lastPos;
+    lastPos = e->pos();
+
+    yaw += d.x()*0.01;
+    pitch = clamp(pitch+d.y()*0.01,-1.5,1.5);
+
+    needsRender = true;
+    needsRepaint = true;
+    requestFrame();
+}
+
+void VolumeVizWidget::mouseDoubleClickEvent(QMouseEvent *e)
+{
+    Q_UNUSED(e);
+
+    yaw = 0.6;
+    pitch = 0.4;
+    zoom = 1;
+
+    needsRender = true;
+    needsRepaint = true;
+    requestFrame();
+}
+
+void VolumeVizWidget::wheelEvent(QWheelEvent *e)
+{
+    zoom = clamp(zoom*std::pow(1.2,e->angleDelta().y()/120.0),0.1,1000.0);
+
+    needsRender = true;
+    needsRepaint = true;
+    requestFrame();
+}
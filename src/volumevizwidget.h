@@ -0,0 +1,97 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef VOLUMEVIZWIDGET_H
+#define VOLUMEVIZWIDGET_H
+
+#include <QImage>
+
+#include "vizwidget.h"
+#include "voxelgrid.h"
+
+// Application context: samples of the selection, or all visible samples
+// without one, counted over the mesh indices and splatted front to back.
+// The transfer function shows low counts in transparent blue, the mean
+// in half opaque green and the maximum in opaque red. Dragging rotates,
+// the wheel zooms and double click resets the view.
+class VolumeVizWidget : public VizWidget
+{
+    Q_OBJECT
+public:
+    VolumeVizWidget(QWidget *parent = 0);
+    ~VolumeVizWidget();
+
+public slots:
+    void selectionChangedSlot();
+    void visibilityChangedSlot();
+
+protected:
+    void processData();
+    void drawQtPainter(QPainter *painter);
+
+    void mousePressEvent(QMouseEvent *e);
+    void mouseMoveEvent(QMouseEvent *e);
+    void mouseDoubleClickEvent(QMouseEvent *e);
+    void wheelEvent(QWheelEvent *e);
+
+private:
+    void updateCounts(bool selectionChanged);
+    void renderImage();
+
+    // Screen position and depth of a point of the index space
+    QPointF project(qreal x, qreal y, qreal z, qreal *depth = NULL) const;
+
+private:
+    VoxelGrid grid;
+
+    // Selection and visibility version the grid counts. Selection changes
+    // are diffed against the former, a visibility change right after the
+    // latter uses the data set's delta.
+    Bitmap countedSel;
+    quint64 countedVis;
+
+    qreal yaw;
+    qreal pitch;
+    qreal zoom;
+
+    QImage image;
+    bool needsRender;
+    QPoint lastPos;
+};
+
+#endif // VOLUMEVIZWIDGET_H
@@ -0,0 +1,236 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "voxelgrid.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <limits>
+
+VoxelGrid::VoxelGrid()
+{
+    parts.resize(1 << VOXEL_PARTITION_BITS);
+    extents[0] = extents[1] = extents[2] = 0;
+    shifts[0] = shifts[1] = shifts[2] = 0;
+    maxVal = 0;
+    meanVal = 0;
+}
+
+void VoxelGrid::setSamples(DataObject *d)
+{
+    const Sample *samples = d->samples.constData();
+    qint64 numElements = d->numElements;
+
+    // Bounds of the mesh indices, per chunk and merged
+    int numChunks = parallelChunkCount(numElements,1 << 14);
+    QVector<qint64> mins(numChunks*3,std::numeric_limits<qint64>::max());
+    QVector<qint64> maxs(numChunks*3,-1);
+    parallelTasks(numChunks,[&](int c)
+    {
+        qint64 *lo = mins.data()+c*3;
+        qint64 *hi = maxs.data()+c*3;
+        qint64 begin = numElements*c/numChunks;
+        qint64 end = numElements*(c+1)/numChunks;
+        for(qint64 e=begin; e<end; e++)
+        {
+            const Sample &s = samples[e];
+            if(s.xidx < 0 || s.yidx < 0 || s.zidx < 0)
+                continue;
+
+            int idx[3] = {s.xidx, s.yidx, s.zidx};
+            for(int a=0; a<3; a++)
+            {
+                lo[a] = std::min(lo[a],(qint64)idx[a]);
+                hi[a] = std::max(hi[a],(qint64)idx[a]);
+            }
+        }
+    });
+
+    qint64 lo[3];
+    for(int a=0; a<3; a++)
+    {
+        lo[a] = mins.at(a);
+        qint64 hi = maxs.at(a);
+        for(int c=1; c<numChunks; c++)
+        {
+            lo[a] = std::min(lo[a],mins.at(c*3+a));
+            hi = std::max(hi,maxs.at(c*3+a));
+        }
+        if(hi < lo[a])
+            lo[a] = hi = 0;
+
+        shifts[a] = 0;
+        while(((hi-lo[a]) >> shifts[a]) >= ((qint64)1 << VOXEL_COORD_BITS))
+            shifts[a]++;
+        extents[a] = (int)((hi-lo[a]) >> shifts[a])+1;
+    }
+
+    keys.resize(numElements);
+    weights.resize(numElements);
+    quint64 *k = keys.data();
+    quint32 *wt = weights.data();
+    parallelFor(numElements,[&](qint64 begin, qint64 end)
+    {
+        for(qint64 e=begin; e<end; e++)
+        {
+            const Sample &s = samples[e];
+            wt[e] = s.weight;
+            if(s.xidx < 0 || s.yidx < 0 || s.zidx < 0)
+                k[e] = VOXEL_NONE;
+            else
+                k[e] = pack((s.xidx-lo[0]) >> shifts[0],
+                            (s.yidx-lo[1]) >> shifts[1],
+                            (s.zidx-lo[2]) >> shifts[2]);
+        }
+    });
+
+    // Counts start over from an empty mask
+    clearCounts();
+}
+
+void VoxelGrid::clearCounts()
+{
+    for(int p=0; p<parts.size(); p++)
+        parts[p].clear();
+    voxels.clear();
+    maxVal = 0;
+    meanVal = 0;
+}
+
+void VoxelGrid::update(const Bitmap &mask, const Bitmap &changed)
+{
+    if(mask.size() != keys.size() || changed.size() != mask.size())
+        return;
+
+    const quint64 *now = mask.constData();
+    const quint64 *flipped = changed.constData();
+    const quint64 *k = keys.constData();
+    const quint32 *wt = weights.constData();
+    int numParts = parts.size();
+    int numWords = mask.numWords();
+    int numChunks = parallelChunkCount(numWords,256);
+
+    // Voxels of the samples that entered or left the mask, by partition
+    typedef QPair<quint64,int> Change;
+    QVector<QVector<QVector<Change> > > changes(numChunks);
+    parallelTasks(numChunks,[&](int c)
+    {
+        QVector<QVector<Change> > &out = changes[c];
+        out.resize(numParts);
+
+        int begin = (qint64)numWords*c/numChunks;
+        int end = (qint64)numWords*(c+1)/numChunks;
+        for(int w=begin; w<end; w++)
+        {
+            quint64 diff = flipped[w];
+            while(diff)
+            {
+                int b = qCountTrailingZeroBits(diff);
+                diff &= diff-1;
+
+                qint64 e = ((qint64)w << 6) + b;
+                quint64 key = k[e];
+                if(key == VOXEL_NONE)
+                    continue;
+
+                int delta = ((now[w] >> b) & 1) ? (int)wt[e] : -(int)wt[e];
+                out[hashPartition(key,VOXEL_PARTITION_BITS)].push_back(qMakePair(key,delta));
+            }
+        }
+    });
+
+    parallelTasks(numParts,[&](int p)
+    {
+        QHash<quint64,quint32> &counts = parts[p];
+        for(int c=0; c<numChunks; c++)
+        {
+            const QVector<Change> &in = changes.at(c).at(p);
+            for(int i=0; i<in.size(); i++)
+            {
+                QHash<quint64,quint32>::iterator it = counts.find(in.at(i).first);
+                if(it == counts.end())
+                    it = counts.insert(in.at(i).first,0);
+
+                it.value() += in.at(i).second;
+                if(it.value() == 0)
+                    counts.erase(it);
+            }
+        }
+    });
+
+    collect();
+}
+
+void VoxelGrid::collect()
+{
+    int numParts = parts.size();
+    QVector<int> offsets(numParts+1,0);
+    for(int p=0; p<numParts; p++)
+        offsets[p+1] = offsets.at(p) + parts.at(p).size();
+
+    const quint64 mask = (Q_UINT64_C(1) << VOXEL_COORD_BITS)-1;
+    voxels.resize(offsets.last());
+    QVector<quint32> maxs(numParts,0);
+    QVector<qreal> sums(numParts,0);
+    parallelTasks(numParts,[&](int p)
+    {
+        Voxel *out = voxels.data()+offsets.at(p);
+        const QHash<quint64,quint32> &counts = parts.at(p);
+        for(QHash<quint64,quint32>::const_iterator it=counts.constBegin(); it!=counts.constEnd(); it++)
+        {
+            quint64 key = it.key();
+            Voxel v = {(int)(key >> (2*VOXEL_COORD_BITS)),
+                       (int)((key >> VOXEL_COORD_BITS) & mask),
+                       (int)(key & mask),
+                       it.value()};
+            *out++ = v;
+
+            maxs[p] = std::max(maxs.at(p),it.value());
+            sums[p] += it.value();
+        }
+    });
+
+    maxVal = 0;
+    qreal sum = 0;
+    for(int p=0; p<numParts; p++)
+    {
+        maxVal = std::max(maxVal,maxs.at(p));
+        sum += sums.at(p);
+    }
+    meanVal = voxels.isEmpty() ? 0 : sum/voxels.size();
+}
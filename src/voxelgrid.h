@@ -0,0 +1,114 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef VOXELGRID_H
+#define VOXELGRID_H
+
+#include <QVector>
+#include <QHash>
+
+#include "dataobject.h"
+
+// Voxel coordinates are packed 21 bits per axis
+#define VOXEL_COORD_BITS 21
+#define VOXEL_NONE (~Q_UINT64_C(0))
+
+// Voxels are hashed into 1 << VOXEL_PARTITION_BITS partitions
+#define VOXEL_PARTITION_BITS 6
+
+struct Voxel
+{
+    int x;
+    int y;
+    int z;
+    quint32 count;
+};
+
+// Sparse sample counts over the (xidx,yidx,zidx) mesh index space. Only
+// occupied voxels are stored, in hash partitions that are updated in
+// parallel. The counts follow a mask of samples and every update only
+// touches the samples that entered or left it, as told by the caller.
+class VoxelGrid
+{
+public:
+    VoxelGrid();
+
+    // Voxel of every sample of d. Indices are shifted to start at zero and
+    // every axis is coarsened by powers of two until it fits
+    // VOXEL_COORD_BITS. Samples without a mesh index (negative) are left out.
+    void setSamples(DataObject *d);
+
+    // Counts the samples of mask by their weight. changed holds exactly the
+    // samples whose membership in mask flipped since the last update, such
+    // as the visibility delta of the data set; only those are touched.
+    void update(const Bitmap &mask, const Bitmap &changed);
+
+    // Drops all counts, as if the last mask was empty
+    void clearCounts();
+
+    bool isEmpty() const { return voxels.isEmpty(); }
+    int extent(int axis) const { return extents[axis]; }
+    int coarsening(int axis) const { return shifts[axis]; }
+
+    // Occupied voxels, rebuilt after every update
+    const QVector<Voxel> &occupied() const { return voxels; }
+    quint32 maxCount() const { return maxVal; }
+    qreal meanCount() const { return meanVal; }
+
+private:
+    static inline quint64 pack(quint64 x, quint64 y, quint64 z)
+    {
+        return (x << (2*VOXEL_COORD_BITS)) | (y << VOXEL_COORD_BITS) | z;
+    }
+
+    void collect();
+
+private:
+    QVector<quint64> keys;      // per sample
+    QVector<quint32> weights;   // per sample
+    QVector<QHash<quint64,quint32> > parts;
+
+    int extents[3];
+    int shifts[3];
+
+    QVector<Voxel> voxels;
+    quint32 maxVal;
+    qreal meanVal;
+};
+
+#endif // VOXELGRID_H
@@ -0,0 +1,180 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "workingset.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+// Ranges of equal value on axis among the samples sorted by it, only those
+// with samples in mask
+static QVector<IndexRange> maskedRuns(DataObject *d, const Bitmap &mask, int axis)
+{
+    const qint64 *col = d->column(axis).constData();
+    const QVector<ElemIndex> &order = d->sortedIndex(axis);
+
+    QVector<IndexRange> runs;
+    qint64 begin = 0;
+    bool masked = false;
+    for(qint64 i=0; i<(qint64)d->numElements; i++)
+    {
+        if(i > 0 && col[order.at(i)] != col[order.at(i-1)])
+        {
+            if(masked)
+                runs.push_back(IndexRange(begin,i));
+            begin = i;
+            masked = false;
+        }
+        masked = masked || mask.test(order.at(i));
+    }
+    if(masked)
+        runs.push_back(IndexRange(begin,d->numElements));
+
+    return runs;
+}
+
+WorkingSet::WorkingSet(DataObject *d, const Bitmap &mask, int numWindows)
+{
+    windows = std::max(1,numWindows);
+
+    const Sample *samples = d->samples.constData();
+    qint64 timeMax = 0;
+    timeMin = 0;
+    bool first = true;
+    mask.forEachSet([&](qint64 e)
+    {
+        qint64 t = samples[e].time;
+        timeMin = first ? t : std::min(timeMin,t);
+        timeMax = first ? t : std::max(timeMax,t);
+        first = false;
+    });
+    timeSpan = timeMax-timeMin+1;
+
+    // Every thread fills its own column of window sketches
+    const QVector<ElemIndex> &byThread = d->sortedIndex(SampleAxes::tid);
+    QVector<IndexRange> threadRuns = maskedRuns(d,mask,SampleAxes::tid);
+    for(int t=0; t<threadRuns.size(); t++)
+        tids.push_back(samples[byThread.at(threadRuns.at(t).first)].tid);
+
+    // A line and a page sketch per window and thread
+    int numThreads = tids.size();
+    qint64 windowBytes = (Q_INT64_C(2)*std::max(1,numThreads)) << WS_PRECISION;
+    windows = (int)std::max(Q_INT64_C(1),std::min((qint64)windows,WS_MAX_WINDOW_BYTES/windowBytes));
+
+    lineSketches.fill(HyperLogLog(WS_PRECISION),windows*numThreads);
+    pageSketches.fill(HyperLogLog(WS_PRECISION),windows*numThreads);
+    HyperLogLog *lines = lineSketches.data();
+    HyperLogLog *pages = pageSketches.data();
+    parallelTasks(numThreads,[&](int t)
+    {
+        for(qint64 i=threadRuns.at(t).first; i<threadRuns.at(t).second; i++)
+        {
+            ElemIndex e = byThread.at(i);
+            if(!mask.test(e))
+                continue;
+
+            const Sample &s = samples[e];
+            int w = std::min(windows-1,(int)((double)(s.time-timeMin)*windows/timeSpan));
+            lines[w*numThreads+t].add((quint64)s.addr >> WS_LINE_SHIFT);
+            pages[w*numThreads+t].add((quint64)s.addr >> WS_PAGE_SHIFT);
+        }
+    });
+
+    const QVector<ElemIndex> &byVariable = d->sortedIndex(SampleAxes::variableUid);
+    QVector<IndexRange> variableRuns = maskedRuns(d,mask,SampleAxes::variableUid);
+    for(int v=0; v<variableRuns.size(); v++)
+        variableSamples.push_back(byVariable.at(variableRuns.at(v).first));
+
+    int numVars = variableSamples.size();
+    variableLines.fill(HyperLogLog(WS_PRECISION),numVars);
+    variablePages.fill(HyperLogLog(WS_PRECISION),numVars);
+    HyperLogLog *vlines = variableLines.data();
+    HyperLogLog *vpages = variablePages.data();
+    parallelTasks(numVars,[&](int v)
+    {
+        for(qint64 i=variableRuns.at(v).first; i<variableRuns.at(v).second; i++)
+        {
+            ElemIndex e = byVariable.at(i);
+            if(!mask.test(e))
+                continue;
+
+            vlines[v].add((quint64)samples[e].addr >> WS_LINE_SHIFT);
+            vpages[v].add((quint64)samples[e].addr >> WS_PAGE_SHIFT);
+        }
+    });
+}
+
+void WorkingSet::mergeInto(HyperLogLog &lineSum, HyperLogLog &pageSum, int w, int t) const
+{
+    int begin = t < 0 ? 0 : t;
+    int end = t < 0 ? tids.size() : t+1;
+    for(int i=begin; i<end; i++)
+    {
+        lineSum.merge(sketch(lineSketches,w,i));
+        pageSum.merge(sketch(pageSketches,w,i));
+    }
+}
+
+WorkingSetSize WorkingSet::size(int first, int last, int t) const
+{
+    HyperLogLog lineSum(WS_PRECISION), pageSum(WS_PRECISION);
+    for(int w=std::max(first,0); w<=std::min(last,windows-1); w++)
+        mergeInto(lineSum,pageSum,w,t);
+
+    WorkingSetSize ws = {lineSum.estimate(), pageSum.estimate()};
+    return ws;
+}
+
+QVector<WorkingSetSize> WorkingSet::growth(int t) const
+{
+    QVector<WorkingSetSize> result;
+    HyperLogLog lineSum(WS_PRECISION), pageSum(WS_PRECISION);
+    for(int w=0; w<windows; w++)
+    {
+        mergeInto(lineSum,pageSum,w,t);
+        WorkingSetSize ws = {lineSum.estimate(), pageSum.estimate()};
+        result.push_back(ws);
+    }
+    return result;
+}
+
+WorkingSetSize WorkingSet::variableSize(int v) const
+{
+    WorkingSetSize ws = {variableLines.at(v).estimate(), variablePages.at(v).estimate()};
+    return ws;
+}
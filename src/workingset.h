@@ -0,0 +1,111 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef WORKINGSET_H
+#define WORKINGSET_H
+
+#include <QVector>
+
+#include "dataobject.h"
+#include "hyperloglog.h"
+
+#define WS_LINE_SHIFT 6
+#define WS_PAGE_SHIFT 12
+
+// 2 KB per sketch, about 2.3% error
+#define WS_PRECISION 11
+
+// Memory for the window sketches of all threads, fewer windows are used
+// when the requested ones would not fit
+#define WS_MAX_WINDOW_BYTES (Q_INT64_C(64) << 20)
+
+// Distinct lines and pages
+struct WorkingSetSize
+{
+    qreal lines;
+    qreal pages;
+};
+
+// HyperLogLog sketches of the cache lines and pages touched by the samples
+// of a mask, one per time window and thread and one per variable. Working
+// sets of any window range and thread are merged from the sketches instead
+// of rescanning addresses. Threads and variables are sketched in parallel.
+class WorkingSet
+{
+public:
+    // numWindows is lowered to fit WS_MAX_WINDOW_BYTES, see numWindows()
+    WorkingSet(DataObject *d, const Bitmap &mask, int numWindows);
+
+    int numWindows() const { return windows; }
+    qint64 windowStart(int w) const { return timeMin + (timeSpan*w)/windows; }
+
+    int numThreads() const { return tids.size(); }
+    int threadId(int t) const { return tids.at(t); }
+
+    int numVariables() const { return variableSamples.size(); }
+    ElemIndex variableSample(int v) const { return variableSamples.at(v); }
+
+    // Windows first..last, of thread t or of all threads with t < 0
+    WorkingSetSize size(int first, int last, int t = -1) const;
+
+    // Every window of thread t, or all threads, merged up to window w
+    QVector<WorkingSetSize> growth(int t = -1) const;
+
+    WorkingSetSize variableSize(int v) const;
+
+private:
+    const HyperLogLog &sketch(const QVector<HyperLogLog> &s, int w, int t) const
+        { return s.at(w*tids.size()+t); }
+    void mergeInto(HyperLogLog &lineSum, HyperLogLog &pageSum, int w, int t) const;
+
+private:
+    int windows;
+    qint64 timeMin;
+    qint64 timeSpan;
+    QVector<int> tids;
+
+    // [window*numThreads()+thread]
+    QVector<HyperLogLog> lineSketches;
+    QVector<HyperLogLog> pageSketches;
+
+    QVector<ElemIndex> variableSamples;
+    QVector<HyperLogLog> variableLines;
+    QVector<HyperLogLog> variablePages;
+};
+
+#endif // WORKINGSET_H
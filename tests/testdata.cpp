@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "testdata.h"
+
+#include <QFile>
+#include <QTextStream>
+
+TestSample testSample(long long addr, long long time, int tid)
+{
+    TestSample s;
+    s.source = "test.c";
+    s.variable = "data";
+    s.line = 1;
+    s.ip = 0x400000;
+    s.addr = addr;
+    s.time = time;
+    s.latency = 10;
+    s.bytes = 8;
+    s.cpu = tid;
+    s.tid = tid;
+    s.dataSrc = 0x1;
+    return s;
+}
+
+bool loadTestSamples(DataObject &d, const QString &dir, const QVector<TestSample> &samples)
+{
+    QString fileName = dir+"/samples.csv";
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate))
+        return false;
+
+    QTextStream out(&file);
+    out << "source,line,instruction,bytes,ip,variable,buffer_size,dims,"
+           "xidx,yidx,zidx,pid,tid,time,addr,cpu,latency,data_src\n";
+    for(int i=0; i<samples.size(); i++)
+    {
+        const TestSample &s = samples.at(i);
+        out << s.source << "," << s.line << ",load," << s.bytes << ","
+            << s.ip << "," << s.variable << ",0,1,0,0,0,1,"
+            << s.tid << "," << s.time << "," << s.addr << ","
+            << s.cpu << "," << s.latency << "," << s.dataSrc << "\n";
+    }
+    file.close();
+
+    return d.loadData(fileName) == 0;
+}
@@ -0,0 +1,188 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QTextStream>
+
+#include "allocations.h"
+
+#include <random>
+
+class TestAllocations : public QObject
+{
+    Q_OBJECT
+private slots:
+    void loadAndFind();
+    void freeEvents();
+    void matchesBruteForce();
+    void quotedAndMalformed();
+    void missingColumns();
+
+private:
+    QString writeLog(const QString &text);
+
+    QTemporaryDir dir;
+};
+
+QString TestAllocations::writeLog(const QString &text)
+{
+    QString fileName = dir.path()+"/"+ALLOCATION_LOG;
+    QFile file(fileName);
+    file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate);
+    QTextStream(&file) << text;
+    return fileName;
+}
+
+void TestAllocations::loadAndFind()
+{
+    AllocationIndex idx;
+    QCOMPARE(idx.load(writeLog("addr,size,time,free_time,name\n"
+                               "0x1000,256,0,100,a\n"
+                               "0x2000,16,0,,b\n"
+                               "0x1000,64,200,,c\n")),0);
+    QCOMPARE(idx.size(),3);
+    QCOMPARE(idx.labels().size(),3);
+
+    int a = idx.find(0x1080,50);
+    QVERIFY(a >= 0);
+    QCOMPARE(idx.labels().at(idx.at(a).label),QString("a"));
+
+    // One past the end and after the free
+    QCOMPARE(idx.find(0x1100,50),-1);
+    QCOMPARE(idx.find(0x1080,150),-1);
+
+    // The address is reused by a later allocation
+    int c = idx.find(0x1010,300);
+    QVERIFY(c >= 0);
+    QCOMPARE(idx.labels().at(idx.at(c).label),QString("c"));
+
+    int b = idx.find(0x200f,1000000);
+    QVERIFY(b >= 0);
+    QCOMPARE(idx.at(b).freeTime,ALLOCATION_NEVER_FREED);
+}
+
+void TestAllocations::freeEvents()
+{
+    AllocationIndex idx;
+    QCOMPARE(idx.load(writeLog("event,addr,size,time,site\n"
+                               "alloc,4096,128,10,main.c:12\n"
+                               "free,4096,0,20,\n"
+                               "alloc,4096,128,30,main.c:40\n")),0);
+    QCOMPARE(idx.size(),2);
+
+    QVERIFY(idx.find(4100,15) >= 0);
+    QCOMPARE(idx.find(4100,25),-1);
+
+    int i = idx.find(4100,35);
+    QVERIFY(i >= 0);
+    QCOMPARE(idx.labels().at(idx.at(i).label),QString("main.c:40"));
+}
+
+void TestAllocations::matchesBruteForce()
+{
+    std::mt19937_64 rng(7);
+    QString text = "addr,size,time,free_time\n";
+    QVector<Allocation> allocs;
+    for(int i=0; i<3000; i++)
+    {
+        quint64 start = (rng()%100000)*16;
+        quint64 size = (rng()%500 == 0) ? 100000+rng()%200000 : 16+rng()%4096;
+        qint64 t0 = rng()%1000;
+        qint64 t1 = (rng()%3 == 0) ? ALLOCATION_NEVER_FREED : t0+(qint64)(rng()%500);
+
+        Allocation a = {start, start+size, t0, t1, 0, 0};
+        allocs.push_back(a);
+        text += QString("%1,%2,%3,%4\n").arg(start).arg(size).arg(t0)
+                .arg(t1 == ALLOCATION_NEVER_FREED ? QString() : QString::number(t1));
+    }
+
+    AllocationIndex idx;
+    QCOMPARE(idx.load(writeLog(text)),0);
+    QCOMPARE(idx.size(),allocs.size());
+
+    for(int q=0; q<5000; q++)
+    {
+        quint64 addr = rng()%1700000;
+        qint64 time = rng()%1500;
+
+        // Newest allocation live at time holding addr
+        qint64 expected = -1;
+        for(const Allocation &a : allocs)
+            if(a.start <= addr && addr < a.end && time >= a.allocTime && time < a.freeTime)
+                expected = std::max(expected,a.allocTime);
+
+        int found = idx.find(addr,time);
+        QCOMPARE(found < 0 ? (qint64)-1 : idx.at(found).allocTime,expected);
+        if(found >= 0)
+            QVERIFY(idx.at(found).start <= addr && addr < idx.at(found).end);
+    }
+}
+
+void TestAllocations::quotedAndMalformed()
+{
+    AllocationIndex idx;
+    QCOMPARE(idx.load(writeLog("addr,size,time,name\n"
+                               "0x1000,64,0,\"vec<int, 4>\"\n"
+                               "0x2000,64,0\n"
+                               "zzz,64,0,b\n"
+                               "0x3000,many,0,c\n"
+                               "0x4000,64,0,\"d\n e\"\n")),0);
+    QCOMPARE(idx.size(),2);
+    QCOMPARE(idx.skippedRows(),3);
+
+    int a = idx.find(0x1010,0);
+    QVERIFY(a >= 0);
+    QCOMPARE(idx.labels().at(idx.at(a).label),QString("vec<int, 4>"));
+
+    int d = idx.find(0x4010,0);
+    QVERIFY(d >= 0);
+    QCOMPARE(idx.labels().at(idx.at(d).label),QString("d\n e"));
+}
+
+void TestAllocations::missingColumns()
+{
+    AllocationIndex idx;
+    QCOMPARE(idx.load(writeLog("addr,time\n0x1000,0\n")),-1);
+    QCOMPARE(idx.load(dir.path()+"/none.csv"),-1);
+    QCOMPARE(idx.find(0x1000,0),-1);
+}
+
+QTEST_GUILESS_MAIN(TestAllocations)
+#include "tst_allocations.moc"
@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "cachesim.h"
+#include "testdata.h"
+
+class TestCacheSim : public QObject
+{
+    Q_OBJECT
+private slots:
+    void lruReplacement();
+    void nonPowerOfTwoSets();
+    void hierarchy();
+
+private:
+    QTemporaryDir dir;
+};
+
+void TestCacheSim::lruReplacement()
+{
+    // Two sets of two ways, lines 0, 2 and 4 share set 0
+    CacheGeometry g = {4*64, 2, 64};
+    SetAssocCache cache(g);
+
+    QVERIFY(!cache.access(0));
+    QVERIFY(!cache.access(2*64));
+    QVERIFY(cache.access(63));
+    QVERIFY(!cache.access(64));
+
+    // Line 4 evicts line 2, the least recently used
+    QVERIFY(!cache.access(4*64));
+    QVERIFY(cache.access(0));
+    QVERIFY(!cache.access(2*64));
+    QVERIFY(cache.access(64));
+}
+
+void TestCacheSim::nonPowerOfTwoSets()
+{
+    // Direct mapped with three sets, lines 0 and 3 conflict
+    CacheGeometry g = {3*64, 1, 64};
+    SetAssocCache cache(g);
+
+    QVERIFY(!cache.access(0));
+    QVERIFY(!cache.access(64));
+    QVERIFY(!cache.access(2*64));
+    QVERIFY(cache.access(0));
+    QVERIFY(!cache.access(3*64));
+    QVERIFY(!cache.access(0));
+    QVERIFY(cache.access(64));
+}
+
+void TestCacheSim::hierarchy()
+{
+    // Lines A, B, C on cpu 0, then A again on cpu 0 and cpu 1
+    const long long A = 0x10000, B = 0x20000, C = 0x30000;
+    QVector<TestSample> rows;
+    rows << testSample(A,0,0)
+         << testSample(A,1,0)
+         << testSample(B,2,0)
+         << testSample(C,3,0)
+         << testSample(A,4,0)
+         << testSample(A,5,1);
+
+    DataObject d;
+    QVERIFY(loadTestSamples(d,dir.path(),rows));
+
+    // Without a topology every cpu gets private L1 and L2 and one L3
+    CacheSimulator sim(&d);
+    QVERIFY(!sim.fromTopology());
+    QCOMPARE(sim.numLevels(),3);
+
+    // An L1 of one set holding two lines
+    CacheGeometry l1 = {2*64, 2, 64};
+    sim.setGeometry(1,l1);
+
+    QVector<qint8> levels;
+    sim.run(levels);
+    QCOMPARE(levels.size(),rows.size());
+
+    QCOMPARE((int)levels.at(0),SIM_MEMORY);
+    QCOMPARE((int)levels.at(1),1);
+    QCOMPARE((int)levels.at(2),SIM_MEMORY);
+    QCOMPARE((int)levels.at(3),SIM_MEMORY);
+
+    // Evicted from L1 by B and C, still in L2
+    QCOMPARE((int)levels.at(4),2);
+
+    // Another cpu only shares the L3
+    QCOMPARE((int)levels.at(5),3);
+}
+
+QTEST_GUILESS_MAIN(TestCacheSim)
+#include "tst_cachesim.moc"
@@ -0,0 +1,218 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <QtTest>
+
+#include "clustering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+class TestClustering : public QObject
+{
+    Q_OBJECT
+private slots:
+    void wardMatchesBruteForce();
+    void wardCutSeparatesBlobs();
+    void pairwiseCutSeparatesBlobs();
+    void cutSizes();
+    void singleLeaf();
+    void cancelledStopsEarly();
+};
+
+// Ward heights of the greedy O(n^3) algorithm, sorted
+static QVector<qreal> bruteWard(QVector<QVector<qreal> > c, QVector<qreal> w)
+{
+    QVector<qreal> heights;
+    QVector<bool> alive(c.size(),true);
+    for(int it=0; it+1<c.size(); it++)
+    {
+        qreal best = std::numeric_limits<qreal>::max();
+        int ba = -1, bb = -1;
+        for(int a=0; a<c.size(); a++)
+        {
+            for(int b=a+1; alive.at(a) && b<c.size(); b++)
+            {
+                if(!alive.at(b))
+                    continue;
+                qreal sq = 0;
+                for(int k=0; k<c.at(a).size(); k++)
+                    sq += (c[a][k]-c[b][k])*(c[a][k]-c[b][k]);
+                qreal d = w.at(a)*w.at(b)/(w.at(a)+w.at(b))*sq;
+                if(d < best)
+                {
+                    best = d;
+                    ba = a;
+                    bb = b;
+                }
+            }
+        }
+
+        heights.push_back(best);
+        for(int k=0; k<c.at(ba).size(); k++)
+            c[ba][k] = (w.at(ba)*c[ba][k] + w.at(bb)*c[bb][k]) / (w.at(ba)+w.at(bb));
+        w[ba] += w.at(bb);
+        alive[bb] = false;
+    }
+    std::sort(heights.begin(),heights.end());
+    return heights;
+}
+
+void TestClustering::wardMatchesBruteForce()
+{
+    const int n = 80, dims = 3;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> u(0,100);
+
+    QVector<float> features(n*dims);
+    QVector<qreal> weights(n);
+    QVector<QVector<qreal> > coords(n,QVector<qreal>(dims));
+    for(int i=0; i<n; i++)
+    {
+        for(int k=0; k<dims; k++)
+            coords[i][k] = features[i*dims+k] = u(rng);
+        weights[i] = 1 + rng()%10;
+    }
+
+    Dendrogram dg = clusterFeatures(features,dims,weights);
+    QCOMPARE(dg.numLeaves,n);
+    QCOMPARE(dg.merges.size(),n-1);
+    QCOMPARE(dg.merges.last().size,n);
+
+    QVector<qreal> heights;
+    for(const ClusterMerge &m : dg.merges)
+        heights.push_back(m.distance);
+    std::sort(heights.begin(),heights.end());
+
+    QVector<qreal> expected = bruteWard(coords,weights);
+    for(int i=0; i<n-1; i++)
+        QVERIFY(std::fabs(heights.at(i)-expected.at(i)) <= 1e-3*std::max((qreal)1,expected.at(i)));
+}
+
+void TestClustering::wardCutSeparatesBlobs()
+{
+    // 30 points around the origin, 10 around (100,100)
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> u(0,5);
+    QVector<float> features;
+    for(int i=0; i<40; i++)
+    {
+        float offset = (i < 30) ? 0 : 100;
+        features << offset+u(rng) << offset+u(rng);
+    }
+
+    Dendrogram dg = clusterFeatures(features,2,QVector<qreal>(40,1));
+    QVector<int> labels = dg.cut(2);
+    QCOMPARE(labels.size(),40);
+    for(int i=0; i<40; i++)
+        QCOMPARE(labels.at(i),i < 30 ? 0 : 1);
+}
+
+void TestClustering::pairwiseCutSeparatesBlobs()
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<qreal> u(0,100);
+    QVector<qreal> points(200);
+    for(int i=0; i<200; i++)
+        points[i] = (i < 100 ? 0 : 1000) + u(rng);
+
+    Dendrogram dg = clusterPairwise(QVector<qreal>(200,1),
+                                    [&](int i, int j) { return std::fabs(points.at(i)-points.at(j)); });
+    QCOMPARE(dg.merges.size(),199);
+
+    QVector<int> labels = dg.cut(2);
+    QVERIFY(labels.first() != labels.last());
+    for(int i=0; i<200; i++)
+        QCOMPARE(labels.at(i),labels.at(i < 100 ? 0 : 199));
+}
+
+void TestClustering::cutSizes()
+{
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> u(0,100);
+    QVector<float> features(50*2);
+    for(int i=0; i<features.size(); i++)
+        features[i] = u(rng);
+
+    Dendrogram dg = clusterFeatures(features,2,QVector<qreal>(50,1));
+    for(int k=1; k<=5; k++)
+    {
+        QVector<int> labels = dg.cut(k);
+        QVector<int> count(k,0);
+        for(int l : labels)
+        {
+            QVERIFY(l >= 0 && l < k);
+            count[l]++;
+        }
+
+        // Every cluster is populated and 0 is the largest
+        for(int c=0; c<k; c++)
+        {
+            QVERIFY(count.at(c) > 0);
+            QVERIFY(count.at(c) <= count.at(0));
+        }
+    }
+}
+
+void TestClustering::singleLeaf()
+{
+    Dendrogram dg = clusterFeatures(QVector<float>(3,1),3,QVector<qreal>(1,1));
+    QCOMPARE(dg.numLeaves,1);
+    QVERIFY(dg.merges.isEmpty());
+    QCOMPARE(dg.cut(1),QVector<int>(1,0));
+}
+
+void TestClustering::cancelledStopsEarly()
+{
+    QVector<float> features(1000*2);
+    for(int i=0; i<features.size(); i++)
+        features[i] = i % 97;
+
+    ComputeToken cancelled(QSharedPointer<QAtomicInt>(new QAtomicInt(1)));
+    Dendrogram dg = clusterFeatures(features,2,QVector<qreal>(1000,1),cancelled);
+    QCOMPARE(dg.numLeaves,1000);
+    QVERIFY(dg.merges.isEmpty());
+
+    dg = clusterPairwise(QVector<qreal>(100,1),[](int i, int j) { return (qreal)std::abs(i-j); },
+                         cancelled);
+    QVERIFY(dg.merges.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestClustering)
+#include "tst_clustering.moc"
@@ -0,0 +1,195 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <limits>
+
+#include "derivedexpr.h"
+#include "reusedistance.h"
+#include "testdata.h"
+
+class TestDerivedExpr : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void arithmetic_data();
+    void arithmetic();
+    void delta();
+    void reuse();
+    void derivedAxes();
+    void errors_data();
+    void errors();
+
+private:
+    QVector<qint64> eval(const QString &text);
+
+    QTemporaryDir dir;
+    DataObject d;
+};
+
+void TestDerivedExpr::initTestCase()
+{
+    // Two threads, interleaved in time
+    QVector<TestSample> rows;
+    for(int i=0; i<8; i++)
+    {
+        TestSample s = testSample(0x1000 + i*40, i*10, i%2);
+        s.latency = 3*i+1;
+        s.bytes = (i%3)*4;
+        rows.push_back(s);
+    }
+    QVERIFY(loadTestSamples(d,dir.path(),rows));
+}
+
+QVector<qint64> TestDerivedExpr::eval(const QString &text)
+{
+    DerivedExpr expr;
+    QVector<qint64> out;
+    if(expr.compile(text,&d))
+        expr.evaluate(&d,out);
+    return out;
+}
+
+void TestDerivedExpr::arithmetic_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<int>("sample");
+    QTest::addColumn<qint64>("value");
+
+    // Sample 5: addr 0x10c8, latency 16, bytes 8
+    QTest::newRow("precedence") << "1 + 2 * 3" << 0 << Q_INT64_C(7);
+    QTest::newRow("parentheses") << "(1 + 2) * 3" << 0 << Q_INT64_C(9);
+    QTest::newRow("shift binds looser") << "1 + 1 << 2" << 0 << Q_INT64_C(8);
+    QTest::newRow("axis") << "latency" << 5 << Q_INT64_C(16);
+    QTest::newRow("division") << "latency / bytes" << 5 << Q_INT64_C(2);
+    QTest::newRow("division by zero") << "latency / bytes" << 3 << Q_INT64_C(0);
+    QTest::newRow("modulo by zero") << "latency % bytes" << 0 << Q_INT64_C(0);
+    QTest::newRow("line") << "addr >> 6" << 5 << Q_INT64_C(0x43);
+    QTest::newRow("offset") << "addr & 63" << 5 << Q_INT64_C(8);
+    QTest::newRow("hex") << "addr ^ 0x1000" << 5 << Q_INT64_C(0xc8);
+    QTest::newRow("unary minus") << "-latency" << 5 << Q_INT64_C(-16);
+    QTest::newRow("abs") << "abs(1 - latency)" << 5 << Q_INT64_C(15);
+    QTest::newRow("min") << "min(latency, 10)" << 5 << Q_INT64_C(10);
+    QTest::newRow("max") << "max(latency, 10)" << 5 << Q_INT64_C(16);
+
+    // Overflow wraps around, INT64_MIN / -1 does not trap
+    QTest::newRow("wrapping multiply") << "0x4000000000000000 * 4" << 0 << Q_INT64_C(0);
+    QTest::newRow("wrapping add") << "0x7fffffffffffffff + 1" << 0 << std::numeric_limits<qint64>::min();
+    QTest::newRow("min by -1") << "(-0x7fffffffffffffff - 1) / -1" << 0 << std::numeric_limits<qint64>::min();
+    QTest::newRow("min mod -1") << "(-0x7fffffffffffffff - 1) % -1" << 0 << Q_INT64_C(0);
+    QTest::newRow("divide by -1") << "latency / -1" << 5 << Q_INT64_C(-16);
+    QTest::newRow("negate min") << "-(-0x7fffffffffffffff - 1)" << 0 << std::numeric_limits<qint64>::min();
+}
+
+void TestDerivedExpr::arithmetic()
+{
+    QFETCH(QString,text);
+    QFETCH(int,sample);
+    QFETCH(qint64,value);
+
+    QVector<qint64> out = eval(text);
+    QCOMPARE(out.size(),(int)d.numElements);
+    QCOMPARE(out.at(sample),value);
+}
+
+void TestDerivedExpr::delta()
+{
+    // Change since the previous sample of the same thread, 0 for the first
+    QVector<qint64> out = eval("delta(time)");
+    QCOMPARE(out.size(),8);
+    QCOMPARE(out.at(0),Q_INT64_C(0));
+    QCOMPARE(out.at(1),Q_INT64_C(0));
+    for(int i=2; i<8; i++)
+        QCOMPARE(out.at(i),Q_INT64_C(20));
+
+    out = eval("delta(latency * 2)");
+    QCOMPARE(out.at(7),Q_INT64_C(12));
+}
+
+void TestDerivedExpr::reuse()
+{
+    QVector<qint64> keys = eval("addr >> 6");
+    QVector<qint64> expected;
+    reuseDistances(&d,keys,d.column(SampleAxes::tid),expected);
+
+    QCOMPARE(eval("reuse(addr >> 6)"),expected);
+
+    // One stream for all samples
+    reuseDistances(&d,keys,QVector<qint64>(d.numElements,0),expected);
+    QCOMPARE(eval("reuse(addr >> 6, 0)"),expected);
+}
+
+void TestDerivedExpr::derivedAxes()
+{
+    QString error;
+    int axis = d.addDerivedAxis("line_addr","addr >> 6",error);
+    QVERIFY2(axis >= NUM_SAMPLE_AXES,qPrintable(error));
+    QCOMPARE(d.axisIndex("line_addr"),axis);
+    QCOMPARE(d.column(axis),eval("addr >> 6"));
+
+    // Later expressions can use it
+    QCOMPARE(eval("line_addr & 1"),eval("(addr >> 6) & 1"));
+}
+
+void TestDerivedExpr::errors_data()
+{
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("empty") << "";
+    QTest::newRow("dangling operator") << "latency +";
+    QTest::newRow("unknown axis") << "nosuchaxis * 2";
+    QTest::newRow("unbalanced") << "(latency + 1";
+    QTest::newRow("unknown function") << "sqrt(latency)";
+    QTest::newRow("missing argument") << "delta()";
+    QTest::newRow("bad number") << "latency + 12abc";
+}
+
+void TestDerivedExpr::errors()
+{
+    QFETCH(QString,text);
+
+    DerivedExpr expr;
+    QVERIFY(!expr.compile(text,&d));
+    QVERIFY(!expr.error().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestDerivedExpr)
+#include "tst_derivedexpr.moc"
@@ -0,0 +1,239 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "query.h"
+#include "testdata.h"
+
+#include <functional>
+
+class TestQuery : public QObject
+{
+    Q_OBJECT
+private slots:
+    void matchesBruteForce();
+    void planUsesSortedIndex();
+    void planProbesSelectiveAnd();
+    void selectedAndVisible();
+    void parseErrors_data();
+    void parseErrors();
+
+private:
+    bool load(DataObject &d);
+
+    QTemporaryDir dir;
+};
+
+#define NUM_TEST_SAMPLES 5000
+
+bool TestQuery::load(DataObject &d)
+{
+    const char *sources[] = {"main.c", "src_b.c", "solver.c"};
+    const char *variables[] = {"x", "y", "mesh"};
+
+    QVector<TestSample> rows;
+    for(int i=0; i<NUM_TEST_SAMPLES; i++)
+    {
+        TestSample s = testSample(0x100000 + (i*7919 % 65536)*8, i, i%4);
+        s.latency = i%500;
+        s.cpu = i%8;
+        s.source = sources[i%3];
+        s.variable = variables[(i/3)%3];
+        rows.push_back(s);
+    }
+    return loadTestSamples(d,dir.path(),rows);
+}
+
+void TestQuery::matchesBruteForce()
+{
+    DataObject d;
+    QVERIFY(load(d));
+
+    typedef std::function<bool(const Sample&)> Pred;
+    QVector<QPair<QString,Pred> > cases;
+    cases << qMakePair(QString("latency > 200"),
+                       Pred([](const Sample &s) { return s.latency > 200; }))
+          << qMakePair(QString("latency = 7"),
+                       Pred([](const Sample &s) { return s.latency == 7; }))
+          << qMakePair(QString("latency != 7"),
+                       Pred([](const Sample &s) { return s.latency != 7; }))
+          << qMakePair(QString("cpu in 2:5"),
+                       Pred([](const Sample &s) { return s.cpu >= 2 && s.cpu <= 5; }))
+          << qMakePair(QString("time < 100 or time >= 4900"),
+                       Pred([](const Sample &s) { return s.time < 100 || s.time >= 4900; }))
+          << qMakePair(QString("source = main.c"),
+                       Pred([](const Sample &s) { return s.source == "main.c"; }))
+          << qMakePair(QString("source ~ SRC"),
+                       Pred([](const Sample &s) { return s.source == "src_b.c"; }))
+          << qMakePair(QString("variable != mesh and tid = 1"),
+                       Pred([](const Sample &s) { return s.variable != "mesh" && s.tid == 1; }))
+          << qMakePair(QString("latency = 7 and source ~ b"),
+                       Pred([](const Sample &s) { return s.latency == 7 && s.source == "src_b.c"; }))
+          << qMakePair(QString("not (latency < 250 && cpu = 3) || var = x"),
+                       Pred([](const Sample &s) { return !(s.latency < 250 && s.cpu == 3) || s.variable == "x"; }))
+          << qMakePair(QString("all and not tid in 0:2"),
+                       Pred([](const Sample &s) { return s.tid > 2; }));
+
+    for(int c=0; c<cases.size(); c++)
+    {
+        Query query(&d);
+        QVERIFY2(query.parse(cases.at(c).first),qPrintable(query.error()));
+        query.plan();
+        Bitmap result = query.execute();
+        QCOMPARE(result.size(),(qint64)d.numElements);
+
+        qint64 expected = 0;
+        for(ElemIndex e=0; e<d.numElements; e++)
+        {
+            bool match = cases.at(c).second(d.samples.at(e));
+            QVERIFY2(result.test(e) == match,qPrintable(cases.at(c).first));
+            expected += match;
+        }
+        QCOMPARE(result.count(),expected);
+    }
+}
+
+void TestQuery::planUsesSortedIndex()
+{
+    DataObject d;
+    QVERIFY(load(d));
+
+    // Building an index for one narrow range costs more than a scan
+    Query query(&d);
+    QVERIFY(query.parse("latency = 7"));
+    query.plan();
+    QVERIFY(query.explain().contains("[scan"));
+    QCOMPARE(query.execute().count(),(qint64)10);
+
+    // Once the index exists it is cheaper
+    d.sortedIndex(SampleAxes::latency);
+    query.plan();
+    QVERIFY(query.explain().contains("[sorted index"));
+    QCOMPARE(query.execute().count(),(qint64)10);
+
+    // A wide range still scans
+    Query wide(&d);
+    QVERIFY(wide.parse("latency > 10"));
+    wide.plan();
+    QVERIFY(wide.explain().contains("[scan"));
+}
+
+void TestQuery::planProbesSelectiveAnd()
+{
+    DataObject d;
+    QVERIFY(load(d));
+    d.sortedIndex(SampleAxes::latency);
+
+    // The name test only runs on the rows the range left
+    Query query(&d);
+    QVERIFY(query.parse("source ~ b and latency = 7"));
+    query.plan();
+    QString plan = query.explain();
+    QVERIFY2(plan.contains("[probe"),qPrintable(plan));
+
+    QStringList lines = plan.split('\n');
+    QCOMPARE(lines.size(),3);
+    QVERIFY(lines.at(1).contains("latency"));
+    QVERIFY(lines.at(2).contains("source"));
+
+    Bitmap result = query.execute();
+    for(ElemIndex e=0; e<d.numElements; e++)
+    {
+        const Sample &s = d.samples.at(e);
+        QCOMPARE(result.test(e),s.latency == 7 && s.source == "src_b.c");
+    }
+}
+
+void TestQuery::selectedAndVisible()
+{
+    DataObject d;
+    QVERIFY(load(d));
+
+    Query pick(&d);
+    QVERIFY(pick.parse("tid = 2"));
+    pick.plan();
+    d.selectMask(pick.execute());
+
+    Query query(&d);
+    QVERIFY(query.parse("selected and latency < 100"));
+    query.plan();
+    Bitmap result = query.execute();
+    for(ElemIndex e=0; e<d.numElements; e++)
+    {
+        const Sample &s = d.samples.at(e);
+        QCOMPARE(result.test(e),s.tid == 2 && s.latency < 100);
+    }
+
+    Query hidden(&d);
+    QVERIFY(hidden.parse("hidden"));
+    hidden.plan();
+    QCOMPARE(hidden.execute().count(),(qint64)0);
+}
+
+void TestQuery::parseErrors_data()
+{
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("no operator") << "latency";
+    QTest::newRow("no value") << "latency >";
+    QTest::newRow("unknown dimension") << "nosuchaxis > 3";
+    QTest::newRow("range without in") << "latency > 1:5";
+    QTest::newRow("in without range") << "latency in 5";
+    QTest::newRow("name operator") << "source > main.c";
+    QTest::newRow("unbalanced") << "(latency > 1";
+    QTest::newRow("dangling and") << "latency > 1 and";
+    QTest::newRow("unknown resource type") << "resource = cpu:4";
+    QTest::newRow("misspelled cache level") << "resource = l3x:1";
+}
+
+void TestQuery::parseErrors()
+{
+    QFETCH(QString,text);
+
+    DataObject d;
+    QVERIFY(load(d));
+
+    Query query(&d);
+    QVERIFY(!query.parse(text));
+    QVERIFY(!query.error().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestQuery)
+#include "tst_query.moc"
@@ -0,0 +1,170 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSet>
+
+#include "reusedistance.h"
+#include "testdata.h"
+
+#include <random>
+
+class TestReuseDistance : public QObject
+{
+    Q_OBJECT
+private slots:
+    void smallTrace();
+    void matchesBruteForce();
+    void buckets();
+    void histogramAndMissRatio();
+
+private:
+    QTemporaryDir dir;
+};
+
+void TestReuseDistance::smallTrace()
+{
+    // Keys A B C A B B on one thread, given out of time order
+    QVector<TestSample> rows;
+    long long keys[] = {0xA, 0xB, 0xC, 0xA, 0xB, 0xB};
+    for(int i=5; i>=0; i--)
+        rows.push_back(testSample(keys[i]*64,i*10));
+
+    DataObject d;
+    QVERIFY(loadTestSamples(d,dir.path(),rows));
+
+    QVector<qint64> out;
+    reuseDistances(&d,d.column(SampleAxes::addr),d.column(SampleAxes::tid),out);
+
+    // Sample e has time (5-e)*10
+    QVector<qint64> expected;
+    expected << 0 << 2 << 2 << REUSE_COLD << REUSE_COLD << REUSE_COLD;
+    QCOMPARE(out,expected);
+}
+
+void TestReuseDistance::matchesBruteForce()
+{
+    const int n = 3000;
+    std::mt19937 rng(5);
+
+    // Distinct times, so the time order is unique
+    QVector<long long> times(n);
+    for(int i=0; i<n; i++)
+        times[i] = i;
+    std::shuffle(times.begin(),times.end(),rng);
+
+    QVector<TestSample> rows;
+    for(int i=0; i<n; i++)
+        rows.push_back(testSample((rng()%200)*64,times.at(i),rng()%3));
+
+    DataObject d;
+    QVERIFY(loadTestSamples(d,dir.path(),rows));
+
+    QVector<qint64> out;
+    reuseDistances(&d,d.column(SampleAxes::addr),d.column(SampleAxes::tid),out);
+    QCOMPARE(out.size(),n);
+
+    // Time order within every thread
+    const QVector<qint64> &time = d.column(SampleAxes::time);
+    const QVector<qint64> &tid = d.column(SampleAxes::tid);
+    const QVector<qint64> &addr = d.column(SampleAxes::addr);
+    QVector<int> order(n);
+    for(int i=0; i<n; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(),order.end(),[&](int a, int b)
+        { return tid.at(a) < tid.at(b) || (tid.at(a) == tid.at(b) && time.at(a) < time.at(b)); });
+
+    for(int i=0; i<n; i++)
+    {
+        int e = order.at(i);
+        qint64 expected = REUSE_COLD;
+        QSet<qint64> between;
+        for(int j=i-1; j>=0 && tid.at(order.at(j)) == tid.at(e); j--)
+        {
+            if(addr.at(order.at(j)) == addr.at(e))
+            {
+                expected = between.size();
+                break;
+            }
+            between.insert(addr.at(order.at(j)));
+        }
+        QCOMPARE(out.at(e),expected);
+    }
+}
+
+void TestReuseDistance::buckets()
+{
+    QCOMPARE(reuseBucket(0),0);
+    QCOMPARE(reuseBucket(1),1);
+    QCOMPARE(reuseBucket(2),2);
+    QCOMPARE(reuseBucket(3),2);
+    QCOMPARE(reuseBucket(4),3);
+    QCOMPARE(reuseBucket(1023),10);
+    QCOMPARE(reuseBucket(1024),11);
+    QCOMPARE(reuseBucket(Q_INT64_C(1) << 62),REUSE_BUCKETS-1);
+}
+
+void TestReuseDistance::histogramAndMissRatio()
+{
+    QVector<qint64> distances;
+    distances << REUSE_COLD << 0 << 0 << 1 << 5 << 100;
+
+    ReuseHistogram h = reuseHistogram(distances);
+    QCOMPARE(h.total,(qint64)6);
+    QCOMPARE(h.cold,(qint64)1);
+    QCOMPARE(h.buckets.at(0),(qint64)2);
+    QCOMPARE(h.buckets.at(1),(qint64)1);
+    QCOMPARE(h.buckets.at(3),(qint64)1);
+    QCOMPARE(h.buckets.at(7),(qint64)1);
+
+    Bitmap mask(distances.size());
+    mask.set(1);
+    mask.set(5);
+    ReuseHistogram m = reuseHistogram(distances,&mask);
+    QCOMPARE(m.total,(qint64)2);
+    QCOMPARE(m.cold,(qint64)0);
+
+    // A cache of one line hits only distance 0, a huge one only misses cold
+    QCOMPARE(reuseMissRatio(h,1),4.0/6);
+    QCOMPARE(reuseMissRatio(h,1 << 20),1.0/6);
+    QCOMPARE(reuseMissRatio(ReuseHistogram(),16),0.0);
+}
+
+QTEST_GUILESS_MAIN(TestReuseDistance)
+#include "tst_reusedistance.moc"
@@ -0,0 +1,162 @@
+//////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2014, Lawrence Livermore National Security, LLC. Produced
+// at the Lawrence Livermore National Laboratory. Written by Alfredo
+// Gimenez (alfredo.gimenez@gmail.com). LLNL-CODE-663358. All rights
+// reserved.
+//
+// This file is part of MemAxes. For details, see
+// https://github.com/scalability-tools/MemAxes
+//
+// Please also read this link – Our Notice and GNU Lesser General Public
+// License. This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License (as
+// published by the Free Software Foundation) version 2.1 dated February
+// 1999.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the IMPLIED WARRANTY OF
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the terms and
+// conditions of the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+// OUR NOTICE AND TERMS AND CONDITIONS OF THE GNU GENERAL PUBLIC LICENSE
+// Our Preamble Notice
+// A. This notice is required to be provided under our contract with the
+// U.S. Department of Energy (DOE). This work was produced at the Lawrence
+// Livermore National Laboratory under Contract No. DE-AC52-07NA27344 with
+// the DOE.
+// B. Neither the United States Government nor Lawrence Livermore National
+// Security, LLC nor any of their employees, makes any warranty, express or
+// implied, or assumes any liability or responsibility for the accuracy,
+// completeness, or usefulness of any information, apparatus, product, or
+// process disclosed, or represents that its use would not infringe
+// privately-owned rights.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <QtTest>
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QFile>
+
+#include "symbolizer.h"
+
+#include <dlfcn.h>
+#include <elf.h>
+
+// Resolved from the test binary itself, which is built with -g
+extern "C" Q_DECL_NOINLINE int symbolizerTestTarget(int x) { return x*3+1; }
+static const int targetLine = __LINE__-1;
+
+class TestSymbolizer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void resolveOwnFunction();
+    void cachedIndex();
+    void unknownAddress();
+    void notAnElf();
+
+private:
+    quint64 linkAddress(void *p) const;
+
+    QString binary;
+};
+
+void TestSymbolizer::initTestCase()
+{
+    // Keeps the symbol cache out of the user's cache directory
+    QStandardPaths::setTestModeEnabled(true);
+    binary = QCoreApplication::applicationFilePath();
+}
+
+quint64 TestSymbolizer::linkAddress(void *p) const
+{
+    // Position independent executables are loaded at an offset
+    Dl_info info;
+    if(!dladdr(p,&info))
+        return 0;
+
+    QFile file(binary);
+    file.open(QIODevice::ReadOnly);
+    QByteArray header = file.read(sizeof(Elf64_Ehdr));
+    if(header.size() < (int)sizeof(Elf64_Ehdr))
+        return 0;
+
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr*)header.constData();
+    quint64 addr = (quint64)p;
+    if(eh->e_type == ET_DYN)
+        addr -= (quint64)info.dli_fbase;
+    return addr;
+}
+
+void TestSymbolizer::resolveOwnFunction()
+{
+    QCOMPARE(symbolizerTestTarget(1),4);
+
+    SymbolIndex idx;
+    QCOMPARE(idx.load(binary),0);
+    QVERIFY(!idx.isEmpty());
+    QVERIFY(!idx.buildId().isEmpty());
+
+    SymbolInfo info = idx.resolve(linkAddress((void*)&symbolizerTestTarget));
+    QVERIFY(info.function >= 0);
+    QCOMPARE(idx.function(info.function),QString("symbolizerTestTarget"));
+    QVERIFY(info.file >= 0);
+    QVERIFY(idx.file(info.file).endsWith("tst_symbolizer.cpp"));
+    QCOMPARE(info.line,targetLine);
+}
+
+void TestSymbolizer::cachedIndex()
+{
+    SymbolIndex first;
+    QCOMPARE(first.load(binary),0);
+
+    SymbolIndex second;
+    QCOMPARE(second.load(binary),0);
+    QCOMPARE(second.buildId(),first.buildId());
+
+    QString cacheFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                        + "/symbols/" + first.buildId() + ".idx";
+    if(QFile::exists(cacheFile))
+        QVERIFY(second.fromCache());
+
+    quint64 ip = linkAddress((void*)&symbolizerTestTarget);
+    SymbolInfo a = first.resolve(ip);
+    SymbolInfo b = second.resolve(ip);
+    QCOMPARE(first.function(a.function),second.function(b.function));
+    QCOMPARE(first.file(a.file),second.file(b.file));
+    QCOMPARE(a.line,b.line);
+}
+
+void TestSymbolizer::unknownAddress()
+{
+    SymbolIndex idx;
+    QCOMPARE(idx.load(binary),0);
+
+    SymbolInfo info = idx.resolve(0);
+    QCOMPARE(info.file,-1);
+    QCOMPARE(info.line,-1);
+    QCOMPARE(info.function,-1);
+}
+
+void TestSymbolizer::notAnElf()
+{
+    QTemporaryDir dir;
+    QString fileName = dir.path()+"/"+SYMBOL_BINARY;
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("#!/bin/sh\necho not an executable\n");
+    file.close();
+
+    SymbolIndex idx;
+    QVERIFY(idx.load(fileName) != 0);
+    QVERIFY(idx.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestSymbolizer)
+#include "tst_symbolizer.moc"